@@ -0,0 +1,737 @@
+/*
+CPUAmbientOcclusion class
+- CPU reference implementation of the screen space ambient occlusion techniques of the application:
+  ssao.frag (CryEngine 2 and StarCraft II AO), ssao_reconstr.frag, hbao.frag, alchemy_ao.frag, ue4_ao.frag and ssdo.frag
+- used for golden-value testing of shader changes without a GPU, and as a CPU fallback path
+- separable bilateral blur of the AO buffers (bilateral_blur.frag)
+
+The input is the G Buffer content (view space positions, normals and depth buffer) in the same layout of the OpenGL
+textures (bottom row first), sampled with the same rules of the shaders (nearest filtering, clamp to edge, 4x4 repeated noise).
+The image is split in tiles distributed among all the cores. Each pixel evaluates its samples in SIMD lanes:
+AVX2 (8 lanes, with hardware gathers) when compiled with AVX2 support (/arch:AVX2 or -mavx2), NEON on AArch64 (4 lanes),
+plain C++ otherwise. Setting useSIMD to false selects a literal scalar port of the shaders, used as reference.
+
+N.B.) HBAO is evaluated in its telescoped form: the sum of sin(angle) - sin(oldAngle) along a direction
+is equal to sin of the maximum horizon angle, i.e. the maximum of dot(normal, normalize(sampleDiff)). The directions
+are rotated one after the other as in the shader, so the samples fall on the same texels of the scalar code.
+The SIMD and scalar results are not bit exact: the tolerances measured by AOBench are described in ao_cpu_bench.cpp.
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <vector>
+#include <cmath>
+#include <functional>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <utils/thread_pool.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/////////////////// SIMD lanes ///////////////////////
+// Minimal set of lane-wise operations used by the AO kernels
+// Comparisons return masks, which can only be used with select()
+namespace aosimd {
+#if defined(__AVX2__)
+    const int WIDTH = 8;
+    const char *const NAME = "AVX2";
+    typedef __m256 vfloat;
+    typedef __m256i vint;
+    inline vfloat set1(float a) { return _mm256_set1_ps(a); }
+    inline vfloat load(const float *p) { return _mm256_loadu_ps(p); }
+    inline void store(float *p, vfloat a) { _mm256_storeu_ps(p, a); }
+    inline vfloat add(vfloat a, vfloat b) { return _mm256_add_ps(a, b); }
+    inline vfloat sub(vfloat a, vfloat b) { return _mm256_sub_ps(a, b); }
+    inline vfloat mul(vfloat a, vfloat b) { return _mm256_mul_ps(a, b); }
+    inline vfloat div(vfloat a, vfloat b) { return _mm256_div_ps(a, b); }
+    inline vfloat sqrt(vfloat a) { return _mm256_sqrt_ps(a); }
+    inline vfloat abs(vfloat a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    // min/max: if the first operand is NaN, the second one is returned
+    inline vfloat min(vfloat a, vfloat b) { return _mm256_min_ps(a, b); }
+    inline vfloat max(vfloat a, vfloat b) { return _mm256_max_ps(a, b); }
+    inline vfloat cmpge(vfloat a, vfloat b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    inline vfloat cmpgt(vfloat a, vfloat b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    inline vfloat cmplt(vfloat a, vfloat b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    inline vfloat select(vfloat mask, vfloat a, vfloat b) { return _mm256_blendv_ps(b, a, mask); }
+    // index of the texel selected by nearest filtering with clamp to edge
+    inline vint texel(vfloat u, vfloat v, int width, int height)
+    {
+        vint x = _mm256_cvttps_epi32(min(max(mul(u, set1((float)width)), set1(0.0f)), set1((float)(width - 1))));
+        vint y = _mm256_cvttps_epi32(min(max(mul(v, set1((float)height)), set1(0.0f)), set1((float)(height - 1))));
+        return _mm256_add_epi32(_mm256_mullo_epi32(y, _mm256_set1_epi32(width)), x);
+    }
+    inline vfloat gather(const float *base, vint index) { return _mm256_i32gather_ps(base, index, 4); }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    const int WIDTH = 4;
+    const char *const NAME = "NEON";
+    typedef float32x4_t vfloat;
+    typedef int32x4_t vint;
+    inline vfloat set1(float a) { return vdupq_n_f32(a); }
+    inline vfloat load(const float *p) { return vld1q_f32(p); }
+    inline void store(float *p, vfloat a) { vst1q_f32(p, a); }
+    inline vfloat add(vfloat a, vfloat b) { return vaddq_f32(a, b); }
+    inline vfloat sub(vfloat a, vfloat b) { return vsubq_f32(a, b); }
+    inline vfloat mul(vfloat a, vfloat b) { return vmulq_f32(a, b); }
+    inline vfloat div(vfloat a, vfloat b) { return vdivq_f32(a, b); }
+    inline vfloat sqrt(vfloat a) { return vsqrtq_f32(a); }
+    inline vfloat abs(vfloat a) { return vabsq_f32(a); }
+    inline vfloat min(vfloat a, vfloat b) { return vminnmq_f32(a, b); }
+    inline vfloat max(vfloat a, vfloat b) { return vmaxnmq_f32(a, b); }
+    inline vfloat cmpge(vfloat a, vfloat b) { return vreinterpretq_f32_u32(vcgeq_f32(a, b)); }
+    inline vfloat cmpgt(vfloat a, vfloat b) { return vreinterpretq_f32_u32(vcgtq_f32(a, b)); }
+    inline vfloat cmplt(vfloat a, vfloat b) { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+    inline vfloat select(vfloat mask, vfloat a, vfloat b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+    inline vint texel(vfloat u, vfloat v, int width, int height)
+    {
+        vint x = vcvtq_s32_f32(min(max(mul(u, set1((float)width)), set1(0.0f)), set1((float)(width - 1))));
+        vint y = vcvtq_s32_f32(min(max(mul(v, set1((float)height)), set1(0.0f)), set1((float)(height - 1))));
+        return vaddq_s32(vmulq_s32(y, vdupq_n_s32(width)), x);
+    }
+    inline vfloat gather(const float *base, vint index)
+    {
+        int i[4];
+        vst1q_s32(i, index);
+        float values[4] = { base[i[0]], base[i[1]], base[i[2]], base[i[3]] };
+        return vld1q_f32(values);
+    }
+#else
+    const int WIDTH = 4;
+    const char *const NAME = "generic";
+    struct vfloat { float v[4]; };
+    struct vint { int v[4]; };
+#define AOSIMD_LANES(expr) vfloat r; for (int l = 0; l < 4; l++) r.v[l] = (expr); return r
+    inline vfloat set1(float a) { AOSIMD_LANES(a); }
+    inline vfloat load(const float *p) { AOSIMD_LANES(p[l]); }
+    inline void store(float *p, vfloat a) { for (int l = 0; l < 4; l++) p[l] = a.v[l]; }
+    inline vfloat add(vfloat a, vfloat b) { AOSIMD_LANES(a.v[l] + b.v[l]); }
+    inline vfloat sub(vfloat a, vfloat b) { AOSIMD_LANES(a.v[l] - b.v[l]); }
+    inline vfloat mul(vfloat a, vfloat b) { AOSIMD_LANES(a.v[l] * b.v[l]); }
+    inline vfloat div(vfloat a, vfloat b) { AOSIMD_LANES(a.v[l] / b.v[l]); }
+    inline vfloat sqrt(vfloat a) { AOSIMD_LANES(std::sqrt(a.v[l])); }
+    inline vfloat abs(vfloat a) { AOSIMD_LANES(std::fabs(a.v[l])); }
+    inline vfloat min(vfloat a, vfloat b) { AOSIMD_LANES(a.v[l] < b.v[l] ? a.v[l] : b.v[l]); }
+    inline vfloat max(vfloat a, vfloat b) { AOSIMD_LANES(a.v[l] > b.v[l] ? a.v[l] : b.v[l]); }
+    inline vfloat cmpge(vfloat a, vfloat b) { AOSIMD_LANES(a.v[l] >= b.v[l] ? 1.0f : 0.0f); }
+    inline vfloat cmpgt(vfloat a, vfloat b) { AOSIMD_LANES(a.v[l] > b.v[l] ? 1.0f : 0.0f); }
+    inline vfloat cmplt(vfloat a, vfloat b) { AOSIMD_LANES(a.v[l] < b.v[l] ? 1.0f : 0.0f); }
+    inline vfloat select(vfloat mask, vfloat a, vfloat b) { AOSIMD_LANES(mask.v[l] != 0.0f ? a.v[l] : b.v[l]); }
+#undef AOSIMD_LANES
+    inline vint texel(vfloat u, vfloat v, int width, int height)
+    {
+        vint r;
+        for (int l = 0; l < 4; l++)
+        {
+            float x = u.v[l] * width, y = v.v[l] * height;
+            x = x > 0.0f ? (x < width - 1 ? x : width - 1) : 0.0f;
+            y = y > 0.0f ? (y < height - 1 ? y : height - 1) : 0.0f;
+            r.v[l] = (int)y * width + (int)x;
+        }
+        return r;
+    }
+    inline vfloat gather(const float *base, vint index)
+    {
+        vfloat r;
+        for (int l = 0; l < 4; l++)
+            r.v[l] = base[index.v[l]];
+        return r;
+    }
+#endif
+    // shared helpers
+    inline vfloat madd(vfloat a, vfloat b, vfloat c) { return add(mul(a, b), c); }
+    inline vfloat maskAnd(vfloat a, vfloat b) { return select(a, b, set1(0.0f)); }
+    inline float hsum(vfloat a)
+    {
+        float lanes[WIDTH];
+        store(lanes, a);
+        float sum = 0.0f;
+        for (int l = 0; l < WIDTH; l++)
+            sum += lanes[l];
+        return sum;
+    }
+    // smoothstep(0.0, 1.0, x)
+    inline vfloat smoothstep01(vfloat x)
+    {
+        vfloat t = min(max(x, set1(0.0f)), set1(1.0f));
+        return mul(mul(t, t), sub(set1(3.0f), add(t, t)));
+    }
+}
+
+// Techniques available in the CPU engine (the matching fragment shader in brackets)
+enum AOTechnique {
+    AO_CPU_SSAO,            // CryEngine 2 and StarCraft II AO (ssao.frag), the kernel makes the difference
+    AO_CPU_SSAO_RECONSTR,   // CryEngine 2 and StarCraft II AO with Depth Resolve (ssao_reconstr.frag)
+    AO_CPU_HBAO,            // Horizon Based Ambient Occlusion (hbao.frag)
+    AO_CPU_ALCHEMY,         // Alchemy AO (alchemy_ao.frag)
+    AO_CPU_UE4,             // Unreal Engine 4 AO (ue4_ao.frag)
+    AO_CPU_SSDO,            // Screen Space Directional Occlusion (ssdo.frag), RGB output
+    AO_CPU_TECHNIQUES_NUM
+};
+
+// G Buffer data, with the same layout of the OpenGL textures (width * height texels, bottom row first)
+struct AOInput {
+    int width;
+    int height;
+    const glm::vec3 *position;  // view space positions (gPosition)
+    const glm::vec3 *normal;    // view space normals (gNormal)
+    const float *depth;         // depth buffer in [0, 1] (gDepthBuffer), needed only by AO_CPU_SSAO_RECONSTR
+};
+
+// Uniforms of the AO shaders
+struct AOParameters {
+    vector<glm::vec3> kernel;   // samples from generateSphereSamples/generateHemiSphereSamples
+    int kernelSize;
+    float radius;               // kernelRadius (sampleRadius for HBAO)
+    float bias;
+    int numDirections;
+    int numSteps;
+    glm::mat4 projection;
+    glm::mat4 invView;          // used only by SSDO
+    vector<glm::vec3> noise;    // the 16 vectors of the 4x4 noise texture
+    function<glm::vec3(const glm::vec3&)> environment; // SSDO sky light lookup (the skybox cube map); white if empty
+};
+
+/////////////////// CPU AMBIENT OCCLUSION class ///////////////////////
+class CPUAmbientOcclusion
+{
+public:
+    // SIMD kernels (true) or literal scalar port of the shaders (false)
+    bool useSIMD = true;
+
+    // 0 threads means one per hardware core
+    CPUAmbientOcclusion(unsigned int numThreads = 0) : pool(numThreads) {}
+
+    static int Channels(AOTechnique technique) { return technique == AO_CPU_SSDO ? 3 : 1; }
+
+    // number of samples evaluated per pixel, used to report the throughput in pixels*samples per second
+    static int SamplesPerPixel(AOTechnique technique, const AOParameters &params)
+    {
+        return technique == AO_CPU_HBAO ? params.numDirections * params.numSteps : params.kernelSize;
+    }
+
+    unsigned int Threads() const { return this->pool.Size() + 1; }
+
+    //////////////////////////////////////////
+    // it computes the AO buffer: output must hold width * height * Channels(technique) floats
+    void Compute(AOTechnique technique, const AOInput &input, const AOParameters &params, float *output)
+    {
+        this->in = input;
+        this->params = &params;
+        this->invProjection = glm::inverse(params.projection);
+        this->prepareInput(technique);
+        this->prepareKernel(technique);
+
+        const int tileSize = 32;
+        int tilesX = (input.width + tileSize - 1) / tileSize;
+        int tilesY = (input.height + tileSize - 1) / tileSize;
+        int channels = Channels(technique);
+        this->pool.ParallelFor((size_t)tilesX * tilesY, [&](size_t tile) {
+            int x0 = (int)(tile % tilesX) * tileSize, y0 = (int)(tile / tilesX) * tileSize;
+            int x1 = min(x0 + tileSize, input.width), y1 = min(y0 + tileSize, input.height);
+            for (int y = y0; y < y1; y++)
+                for (int x = x0; x < x1; x++)
+                    this->computePixel(technique, x, y, output + ((size_t)y * input.width + x) * channels);
+        });
+    }
+
+    //////////////////////////////////////////
+    // separable bilateral blur of an AO buffer (bilateral_blur.frag): horizontal and vertical pass, the taps weighted
+    // by a gaussian of their offset and by their distance from the tangent plane of the pixel (1 / (1 + x^2), with x the
+    // distance relative to depthSigma times the depth of the pixel)
+    // The linear depth is computed from the depth buffer if the input has it, otherwise from the positions.
+    // image and output hold width * height * channels floats (output can not be image)
+    void Blur(const AOInput &input, const glm::mat4 &projection, int radius, float depthSigma, int channels, const float *image, float *output)
+    {
+        size_t count = (size_t)input.width * input.height;
+        this->blurDepth.resize(count);
+        this->blurTemp.resize(count * channels);
+        this->pool.ParallelFor(input.height, [&](size_t y) {
+            for (size_t i = y * input.width; i < (y + 1) * input.width; i++)
+                this->blurDepth[i] = input.depth ? projection[3][2] / ((input.depth[i] * 2.0f - 1.0f) + projection[2][2]) : -input.position[i].z;
+        });
+        this->blurPass(input, projection, radius, depthSigma, channels, 1, 0, image, this->blurTemp.data());
+        this->blurPass(input, projection, radius, depthSigma, channels, 0, 1, this->blurTemp.data(), output);
+    }
+
+private:
+    ThreadPool pool;
+    AOInput in;
+    const AOParameters *params;
+    glm::mat4 invProjection;
+    // G Buffer planes (structure of arrays), to gather single components
+    vector<float> posX, posY, posZ;
+    // padded kernel (structure of arrays); the weight is 0 for the padding samples
+    vector<float> kX, kY, kZ, kW;
+    // HBAO: incremental rotation between two directions, and weight of each direction (0 for the padding)
+    glm::mat2 dirRotation;
+    vector<float> dirW;
+    // blur: linear depth of the pixels, and result of the horizontal pass
+    vector<float> blurDepth, blurTemp;
+
+    //////////////////////////////////////////
+
+    void prepareInput(AOTechnique technique)
+    {
+        size_t count = (size_t)this->in.width * this->in.height;
+        if (technique == AO_CPU_SSAO_RECONSTR || !this->useSIMD)
+            return;
+        this->posX.resize(count);
+        this->posY.resize(count);
+        this->posZ.resize(count);
+        const glm::vec3 *position = this->in.position;
+        int width = this->in.width;
+        this->pool.ParallelFor(this->in.height, [&](size_t y) {
+            for (size_t i = y * width; i < (y + 1) * width; i++)
+            {
+                this->posX[i] = position[i].x;
+                this->posY[i] = position[i].y;
+                this->posZ[i] = position[i].z;
+            }
+        });
+    }
+
+    void prepareKernel(AOTechnique technique)
+    {
+        const int W = aosimd::WIDTH;
+        if (technique == AO_CPU_HBAO)
+        {
+            int numDirections = this->params->numDirections;
+            int padded = (numDirections + W - 1) / W * W;
+            this->dirW.assign(padded, 0.0f);
+            fill(this->dirW.begin(), this->dirW.begin() + numDirections, 1.0f);
+            // same matrix of the shader (and of hbao), which rotates the direction incrementally before each direction
+            float deltaRot = 2.0f * 3.14159265f / numDirections;
+            this->dirRotation = glm::mat2(cos(deltaRot), -sin(deltaRot), sin(deltaRot), cos(deltaRot));
+            return;
+        }
+        int kernelSize = min(this->params->kernelSize, (int)this->params->kernel.size());
+        int padded = (kernelSize + W - 1) / W * W;
+        this->kX.assign(padded, 0.0f);
+        this->kY.assign(padded, 0.0f);
+        this->kZ.assign(padded, 0.0f);
+        this->kW.assign(padded, 0.0f);
+        for (int i = 0; i < kernelSize; i++)
+        {
+            this->kX[i] = this->params->kernel[i].x;
+            this->kY[i] = this->params->kernel[i].y;
+            this->kZ[i] = this->params->kernel[i].z;
+            this->kW[i] = 1.0f;
+        }
+    }
+
+    //////////////////////////////////////////
+    // one pass of the bilateral blur, along (dx, dy)
+    void blurPass(const AOInput &input, const glm::mat4 &projection, int radius, float depthSigma, int channels, int dx, int dy,
+                  const float *image, float *output)
+    {
+        int width = input.width, height = input.height;
+        glm::vec2 scale(1.0f / projection[0][0], 1.0f / projection[1][1]);
+        glm::vec3 rayStep(glm::vec2(dx * 2.0f / width, dy * 2.0f / height) * scale, 0.0f);
+        float sigma = max((float)radius, 1.0f) * 0.5f;
+        float gaussianFactor = 1.4427f / (2.0f * sigma * sigma);
+        this->pool.ParallelFor(height, [&](size_t row) {
+            int y = (int)row;
+            for (int x = 0; x < width; x++)
+            {
+                size_t center = (size_t)y * width + x;
+                float depth = this->blurDepth[center];
+                glm::vec3 normal = input.normal[center];
+                // the position of a tap is depth * (ray + offset * rayStep)
+                glm::vec3 ray(glm::vec2((x + 0.5f) / width * 2.0f - 1.0f, (y + 0.5f) / height * 2.0f - 1.0f) * scale, -1.0f);
+                float normalRay = glm::dot(normal, ray), normalRayStep = glm::dot(normal, rayStep);
+                float planeOffset = depth * normalRay;
+                float sharpness = 1.0f / (depthSigma * depth);
+                float result[3] = { 0.0f, 0.0f, 0.0f };
+                float totalWeight = 0.0f;
+                for (int offset = -radius; offset <= radius; offset++)
+                {
+                    int tx = x + dx * offset, ty = y + dy * offset;
+                    size_t tap = (size_t)min(max(ty, 0), height - 1) * width + min(max(tx, 0), width - 1);
+                    // as in the shader, the position is computed at the unclamped coordinates
+                    float planeDistance = fabs(this->blurDepth[tap] * (normalRay + offset * normalRayStep) - planeOffset) * sharpness;
+                    float weight = offset == 0 ? 1.0f : exp2(-(float)(offset * offset) * gaussianFactor) / (1.0f + planeDistance * planeDistance);
+                    for (int c = 0; c < channels; c++)
+                        result[c] += image[tap * channels + c] * weight;
+                    totalWeight += weight;
+                }
+                for (int c = 0; c < channels; c++)
+                    output[center * channels + c] = result[c] / totalWeight;
+            }
+        });
+    }
+
+    //////////////////////////////////////////
+    // texture fetches with nearest filtering and clamp to edge (scalar path)
+
+    int texel(glm::vec2 uv) const
+    {
+        float x = uv.x * this->in.width, y = uv.y * this->in.height;
+        x = x > 0.0f ? (x < this->in.width - 1 ? x : this->in.width - 1) : 0.0f;
+        y = y > 0.0f ? (y < this->in.height - 1 ? y : this->in.height - 1) : 0.0f;
+        return (int)y * this->in.width + (int)x;
+    }
+
+    glm::vec3 position(glm::vec2 uv) const { return this->in.position[this->texel(uv)]; }
+
+    // CalcViewPos of the Depth Resolve shaders
+    glm::vec3 calcViewPos(glm::vec2 uv) const
+    {
+        glm::vec4 clip = glm::vec4(uv, this->in.depth[this->texel(uv)], 1.0f) * 2.0f - glm::vec4(1.0f);
+        glm::vec4 view = this->invProjection * clip;
+        return glm::vec3(view) / view.w;
+    }
+
+    // from view space to texture coordinates
+    glm::vec2 project(glm::vec3 p) const
+    {
+        glm::vec4 offset = this->params->projection * glm::vec4(p, 1.0f);
+        return glm::vec2(offset) / offset.w * 0.5f + 0.5f;
+    }
+
+    static float fastAcos(float x)
+    {
+        return (-0.69813170079773212f * x * x - 0.87266462599716477f) * x + 1.5707963267948966f;
+    }
+
+    //////////////////////////////////////////
+
+    void computePixel(AOTechnique technique, int x, int y, float *out)
+    {
+        glm::vec2 uv((x + 0.5f) / this->in.width, (y + 0.5f) / this->in.height);
+        int index = y * this->in.width + x;
+        glm::vec3 normal = this->in.normal[index];
+        glm::vec3 randomVec = this->params->noise[(y & 3) * 4 + (x & 3)];
+        glm::vec3 fragPos = technique == AO_CPU_SSAO_RECONSTR ? this->calcViewPos(uv) : this->in.position[index];
+        // SSDO uses normal and noise as they are, HBAO normalizes only the normal
+        if (technique != AO_CPU_SSDO)
+            normal = glm::normalize(normal);
+        if (technique != AO_CPU_SSDO && technique != AO_CPU_HBAO)
+            randomVec = glm::normalize(randomVec);
+
+        // TBN change-of-basis matrix: from tangent-space to view-space
+        glm::vec3 tangent = glm::normalize(randomVec - normal * glm::dot(randomVec, normal));
+        glm::vec3 bitangent = glm::cross(normal, tangent);
+        glm::mat3 TBN(tangent, bitangent, normal);
+
+        if (technique == AO_CPU_HBAO)
+        {
+            out[0] = this->useSIMD ? this->hbaoSIMD(uv, fragPos, normal, randomVec, tangent) : this->hbao(uv, fragPos, normal, randomVec, tangent);
+            return;
+        }
+        if (!this->useSIMD)
+        {
+            switch (technique)
+            {
+            case AO_CPU_SSAO: out[0] = this->ssao(fragPos, TBN, false); break;
+            case AO_CPU_SSAO_RECONSTR: out[0] = this->ssao(fragPos, TBN, true); break;
+            case AO_CPU_ALCHEMY: out[0] = this->alchemy(fragPos, normal, TBN); break;
+            case AO_CPU_UE4: out[0] = this->ue4(fragPos, TBN); break;
+            default: this->ssdo(fragPos, normal, TBN, out); break;
+            }
+            return;
+        }
+        this->kernelSIMD(technique, fragPos, normal, TBN, out);
+    }
+
+    //////////////////////////////////////////
+    // scalar reference (literal port of the shaders)
+
+    float ssao(glm::vec3 fragPos, const glm::mat3 &TBN, bool reconstr) const
+    {
+        const AOParameters &p = *this->params;
+        float occlusion = 0.0f;
+        for (int i = 0; i < p.kernelSize; ++i)
+        {
+            glm::vec3 samplePos = fragPos + TBN * p.kernel[i] * p.radius;
+            glm::vec2 offset = this->project(samplePos);
+            float sampleDepth = reconstr ? this->calcViewPos(offset).z : this->position(offset).z;
+            float rangeCheck = glm::smoothstep(0.0f, 1.0f, p.radius / std::fabs(fragPos.z - sampleDepth));
+            occlusion += (sampleDepth >= samplePos.z + p.bias ? 1.0f : 0.0f) * rangeCheck;
+        }
+        return 1.0f - (occlusion / p.kernelSize);
+    }
+
+    float hbao(glm::vec2 uv, glm::vec3 fragPos, glm::vec3 normal, glm::vec3 randomVec, glm::vec3 tangent) const
+    {
+        const AOParameters &p = *this->params;
+        const float PI = 3.14159265f;
+        float deltaRot = 2.0f * PI / p.numDirections;
+        glm::mat2 deltaRotationMatrix(cos(deltaRot), -sin(deltaRot), sin(deltaRot), cos(deltaRot));
+        glm::vec2 sampleDir = glm::vec2(tangent) * (p.radius / (float(p.numDirections * p.numSteps) + 1.0f));
+        glm::mat2 noiseMatrix(randomVec.x, -randomVec.y, randomVec.y, randomVec.x);
+        sampleDir = noiseMatrix * sampleDir;
+        float occlusion = 0.0f;
+        for (int i = 0; i < p.numDirections; ++i)
+        {
+            sampleDir = deltaRotationMatrix * sampleDir;
+            float oldAngle = 0.0f;
+            for (int j = 0; j < p.numSteps; ++j)
+            {
+                glm::vec3 sampleDiff = this->position(uv + (randomVec.z + float(j)) * sampleDir) - fragPos;
+                float tangentAngle = (PI / 2.0f) - acos(glm::dot(normal, glm::normalize(sampleDiff)));
+                if (tangentAngle > oldAngle)
+                {
+                    occlusion += sin(tangentAngle) - sin(oldAngle);
+                    oldAngle = tangentAngle;
+                }
+            }
+        }
+        return glm::clamp(1.0f - occlusion / p.numDirections, 0.0f, 1.0f);
+    }
+
+    float alchemy(glm::vec3 fragPos, glm::vec3 normal, const glm::mat3 &TBN) const
+    {
+        const AOParameters &p = *this->params;
+        float occlusion = 0.0f;
+        for (int i = 0; i < p.kernelSize; ++i)
+        {
+            glm::vec3 samplePos = fragPos + TBN * p.kernel[i] * p.radius;
+            glm::vec3 ray = this->position(this->project(samplePos)) - fragPos;
+            occlusion += max(0.0f, glm::dot(ray, normal) - p.bias) / (glm::dot(ray, ray) + 0.0001f);
+        }
+        return max(0.0f, 1.0f - 4.0f / float(p.kernelSize) * occlusion);
+    }
+
+    float ue4(glm::vec3 fragPos, const glm::mat3 &TBN) const
+    {
+        const AOParameters &p = *this->params;
+        float occlusion = 0.0f;
+        for (int i = 0; i < p.kernelSize; ++i)
+        {
+            glm::vec3 offset = TBN * p.kernel[i] * p.radius;
+            glm::vec3 v1 = this->position(this->project(fragPos + offset)) - fragPos;
+            glm::vec3 v2 = this->position(this->project(fragPos - offset)) - fragPos;
+            float angle = fastAcos(glm::dot(glm::normalize(v1), glm::normalize(v2)));
+            occlusion += angle > 0.0f ? angle : 0.0f; // max(NaN, 0) = 0, as on the GPU
+        }
+        return occlusion / (p.kernelSize * 3.14159265f);
+    }
+
+    void ssdo(glm::vec3 fragPos, glm::vec3 normal, const glm::mat3 &TBN, float *out) const
+    {
+        const AOParameters &p = *this->params;
+        glm::vec3 occlusion(0.0f);
+        for (int i = 0; i < p.kernelSize; ++i)
+        {
+            glm::vec3 samplePos = fragPos + TBN * p.kernel[i] * p.radius;
+            float sampleDepth = this->position(this->project(samplePos)).z;
+            if (sampleDepth < samplePos.z + p.bias)
+                occlusion += this->skyColor(samplePos - fragPos) * glm::dot(normal, glm::normalize(samplePos - fragPos));
+        }
+        occlusion /= p.kernelSize;
+        out[0] = occlusion.r;
+        out[1] = occlusion.g;
+        out[2] = occlusion.b;
+    }
+
+    glm::vec3 skyColor(glm::vec3 direction) const
+    {
+        if (!this->params->environment)
+            return glm::vec3(1.0f);
+        glm::vec4 skyboxDirection = this->params->invView * glm::vec4(direction, 1.0f);
+        return this->params->environment(glm::vec3(skyboxDirection) / skyboxDirection.w);
+    }
+
+    //////////////////////////////////////////
+    // SIMD kernels: W samples (or HBAO directions) are evaluated at once
+
+    void kernelSIMD(AOTechnique technique, glm::vec3 fragPos, glm::vec3 normal, const glm::mat3 &TBN, float *out)
+    {
+        using namespace aosimd;
+        const AOParameters &p = *this->params;
+        const glm::mat4 &P = p.projection;
+        const glm::mat4 &IP = this->invProjection;
+        const vfloat zero = set1(0.0f), one = set1(1.0f);
+        const vfloat radius = set1(p.radius), bias = set1(p.bias);
+        const vfloat fx = set1(fragPos.x), fy = set1(fragPos.y), fz = set1(fragPos.z);
+        const vfloat nx = set1(normal.x), ny = set1(normal.y), nz = set1(normal.z);
+
+        vfloat acc = zero;
+        if (technique == AO_CPU_SSDO)
+            out[0] = out[1] = out[2] = 0.0f;
+        int padded = (int)this->kW.size();
+        for (int i = 0; i < padded; i += WIDTH)
+        {
+            vfloat kx = load(&this->kX[i]), ky = load(&this->kY[i]), kz = load(&this->kZ[i]), kw = load(&this->kW[i]);
+            // offset = TBN * kernel[i] * radius
+            vfloat ox = mul(madd(set1(TBN[0].x), kx, madd(set1(TBN[1].x), ky, mul(set1(TBN[2].x), kz))), radius);
+            vfloat oy = mul(madd(set1(TBN[0].y), kx, madd(set1(TBN[1].y), ky, mul(set1(TBN[2].y), kz))), radius);
+            vfloat oz = mul(madd(set1(TBN[0].z), kx, madd(set1(TBN[1].z), ky, mul(set1(TBN[2].z), kz))), radius);
+            vfloat sx = add(fx, ox), sy = add(fy, oy), sz = add(fz, oz);
+            vint index = this->projectTexel(P, sx, sy, sz);
+
+            switch (technique)
+            {
+            case AO_CPU_SSAO:
+            case AO_CPU_SSAO_RECONSTR:
+            {
+                vfloat sampleDepth;
+                if (technique == AO_CPU_SSAO)
+                    sampleDepth = gather(&this->posZ[0], index);
+                else
+                {
+                    // CalcViewPos(offset.xy).z, with the depth of the texel and the (continuous) texture coordinates of the sample
+                    vfloat u, v;
+                    this->projectUV(P, sx, sy, sz, u, v);
+                    vfloat cx = sub(add(u, u), one), cy = sub(add(v, v), one);
+                    vfloat d = gather(this->in.depth, index);
+                    vfloat cz = sub(add(d, d), one);
+                    vfloat vz = madd(set1(IP[0].z), cx, madd(set1(IP[1].z), cy, madd(set1(IP[2].z), cz, set1(IP[3].z))));
+                    vfloat vw = madd(set1(IP[0].w), cx, madd(set1(IP[1].w), cy, madd(set1(IP[2].w), cz, set1(IP[3].w))));
+                    sampleDepth = div(vz, vw);
+                }
+                vfloat rangeCheck = smoothstep01(div(radius, abs(sub(fz, sampleDepth))));
+                vfloat occluded = select(cmpge(sampleDepth, add(sz, bias)), rangeCheck, zero);
+                acc = madd(occluded, kw, acc);
+                break;
+            }
+            case AO_CPU_ALCHEMY:
+            {
+                vfloat rx = sub(gather(&this->posX[0], index), fx);
+                vfloat ry = sub(gather(&this->posY[0], index), fy);
+                vfloat rz = sub(gather(&this->posZ[0], index), fz);
+                vfloat dotRN = madd(rx, nx, madd(ry, ny, mul(rz, nz)));
+                vfloat dotRR = madd(rx, rx, madd(ry, ry, mul(rz, rz)));
+                vfloat value = div(max(sub(dotRN, bias), zero), add(dotRR, set1(0.0001f)));
+                acc = madd(value, kw, acc);
+                break;
+            }
+            case AO_CPU_UE4:
+            {
+                vint index2 = this->projectTexel(P, sub(fx, ox), sub(fy, oy), sub(fz, oz));
+                vfloat ax = sub(gather(&this->posX[0], index), fx), ay = sub(gather(&this->posY[0], index), fy), az = sub(gather(&this->posZ[0], index), fz);
+                vfloat bx = sub(gather(&this->posX[0], index2), fx), by = sub(gather(&this->posY[0], index2), fy), bz = sub(gather(&this->posZ[0], index2), fz);
+                vfloat lengths = sqrt(mul(madd(ax, ax, madd(ay, ay, mul(az, az))), madd(bx, bx, madd(by, by, mul(bz, bz)))));
+                vfloat c = div(madd(ax, bx, madd(ay, by, mul(az, bz))), lengths);
+                vfloat angle = madd(sub(mul(set1(-0.69813170079773212f), mul(c, c)), set1(0.87266462599716477f)), c, set1(1.5707963267948966f));
+                angle = select(cmpgt(angle, zero), angle, zero); // NaN (degenerate vectors) gives 0
+                acc = madd(angle, kw, acc);
+                break;
+            }
+            default: // AO_CPU_SSDO
+            {
+                vfloat sampleDepth = gather(&this->posZ[0], index);
+                // dot(normal, normalize(samplePos - fragPos)): the difference is the offset
+                vfloat cosine = div(madd(nx, ox, madd(ny, oy, mul(nz, oz))), sqrt(madd(ox, ox, madd(oy, oy, mul(oz, oz)))));
+                vfloat weight = select(cmplt(sampleDepth, add(sz, bias)), mul(cosine, kw), zero);
+                if (!p.environment)
+                {
+                    acc = add(acc, weight);
+                    break;
+                }
+                float w[WIDTH], dx[WIDTH], dy[WIDTH], dz[WIDTH];
+                store(w, weight);
+                store(dx, ox);
+                store(dy, oy);
+                store(dz, oz);
+                glm::vec3 sum(0.0f);
+                for (int l = 0; l < WIDTH; l++)
+                    if (w[l] != 0.0f)
+                        sum += this->skyColor(glm::vec3(dx[l], dy[l], dz[l])) * w[l];
+                out[0] += sum.r;
+                out[1] += sum.g;
+                out[2] += sum.b;
+                break;
+            }
+            }
+        }
+
+        float occlusion = hsum(acc);
+        switch (technique)
+        {
+        case AO_CPU_SSAO:
+        case AO_CPU_SSAO_RECONSTR:
+            out[0] = 1.0f - occlusion / p.kernelSize;
+            break;
+        case AO_CPU_ALCHEMY:
+            out[0] = max(0.0f, 1.0f - 4.0f / float(p.kernelSize) * occlusion);
+            break;
+        case AO_CPU_UE4:
+            out[0] = occlusion / (p.kernelSize * 3.14159265f);
+            break;
+        default:
+            if (!p.environment)
+                out[0] = out[1] = out[2] = occlusion;
+            out[0] /= p.kernelSize;
+            out[1] /= p.kernelSize;
+            out[2] /= p.kernelSize;
+            break;
+        }
+    }
+
+    float hbaoSIMD(glm::vec2 uv, glm::vec3 fragPos, glm::vec3 normal, glm::vec3 randomVec, glm::vec3 tangent)
+    {
+        using namespace aosimd;
+        const AOParameters &p = *this->params;
+        glm::vec2 sampleDir = glm::vec2(tangent) * (p.radius / (float(p.numDirections * p.numSteps) + 1.0f));
+        glm::mat2 noiseMatrix(randomVec.x, -randomVec.y, randomVec.y, randomVec.x);
+        sampleDir = noiseMatrix * sampleDir;
+
+        const vfloat fx = set1(fragPos.x), fy = set1(fragPos.y), fz = set1(fragPos.z);
+        const vfloat nx = set1(normal.x), ny = set1(normal.y), nz = set1(normal.z);
+        vfloat total = set1(0.0f);
+        int padded = (int)this->dirW.size();
+        const int CHUNK = 64;
+        float dirX[CHUNK], dirY[CHUNK];
+        for (int i = 0; i < padded; i += WIDTH)
+        {
+            // the directions are rotated one after the other as in hbao (a rotation by (i + 1) * deltaRot computed
+            // directly differs in the last bits, enough to move some samples to the next texel). The dependency chain
+            // of a whole chunk is computed before its samples, so it overlaps with the gathers
+            if (i % CHUNK == 0)
+                for (int l = 0; l < CHUNK && i + l < padded; l++)
+                {
+                    sampleDir = this->dirRotation * sampleDir;
+                    dirX[l] = sampleDir.x;
+                    dirY[l] = sampleDir.y;
+                }
+            vfloat dx = load(&dirX[i % CHUNK]), dy = load(&dirY[i % CHUNK]);
+            // sin of the maximum horizon angle along the direction (0 if below the tangent plane)
+            vfloat horizon = set1(0.0f);
+            for (int j = 0; j < p.numSteps; ++j)
+            {
+                vfloat t = set1(randomVec.z + float(j));
+                // (not fused, to round the texture coordinates as the scalar code)
+                vint index = aosimd::texel(add(mul(t, dx), set1(uv.x)), add(mul(t, dy), set1(uv.y)), this->in.width, this->in.height);
+                vfloat ex = sub(gather(&this->posX[0], index), fx);
+                vfloat ey = sub(gather(&this->posY[0], index), fy);
+                vfloat ez = sub(gather(&this->posZ[0], index), fz);
+                vfloat sine = div(madd(nx, ex, madd(ny, ey, mul(nz, ez))), sqrt(madd(ex, ex, madd(ey, ey, mul(ez, ez)))));
+                horizon = select(cmpgt(sine, horizon), sine, horizon); // NaN samples are skipped, as in the shader
+            }
+            total = madd(horizon, load(&this->dirW[i]), total);
+        }
+        return glm::clamp(1.0f - hsum(total) / p.numDirections, 0.0f, 1.0f);
+    }
+
+    // projection of W view space positions to texture coordinates
+    void projectUV(const glm::mat4 &P, aosimd::vfloat x, aosimd::vfloat y, aosimd::vfloat z, aosimd::vfloat &u, aosimd::vfloat &v) const
+    {
+        using namespace aosimd;
+        vfloat cx = madd(set1(P[0].x), x, madd(set1(P[1].x), y, madd(set1(P[2].x), z, set1(P[3].x))));
+        vfloat cy = madd(set1(P[0].y), x, madd(set1(P[1].y), y, madd(set1(P[2].y), z, set1(P[3].y))));
+        vfloat cw = madd(set1(P[0].w), x, madd(set1(P[1].w), y, madd(set1(P[2].w), z, set1(P[3].w))));
+        u = madd(div(cx, cw), set1(0.5f), set1(0.5f));
+        v = madd(div(cy, cw), set1(0.5f), set1(0.5f));
+    }
+
+    aosimd::vint projectTexel(const glm::mat4 &P, aosimd::vfloat x, aosimd::vfloat y, aosimd::vfloat z) const
+    {
+        aosimd::vfloat u, v;
+        this->projectUV(P, x, y, z, u, v);
+        return aosimd::texel(u, v, this->in.width, this->in.height);
+    }
+};
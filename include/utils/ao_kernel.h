@@ -0,0 +1,74 @@
+/*
+Sample kernels for the screen space ambient occlusion techniques
+- generateSphereSamples: CryEngine2-like AO generator (Sphere around a point)
+- generateHemiSphereSamples: StarCraftII-like AO generator (Oriented Hemisphere considering point normal)
+
+The generators are deterministic (default seeded engine), so the GPU passes and the CPU reference engine
+(utils/ao_cpu.h) always work on the same samples for a given kernel size.
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+// Std. Includes
+#include <vector>
+#include <random>
+
+#include <glm/glm.hpp>
+
+// Functions used to generate samples for our SSAO techniques
+inline void generateSphereSamples(std::vector<glm::vec3>& SSAOKernel, int kernelSize) { // CryEngine2-like AO generator (Sphere around a point)
+    std::uniform_real_distribution<float> randomFloats(0.0, 1.0);
+    std::default_random_engine generator;
+    SSAOKernel.clear();
+    for (int i = 0; i < kernelSize; ++i)
+    {
+        glm::vec3 sample(
+            randomFloats(generator) * 2.0 - 1.0,
+            randomFloats(generator) * 2.0 - 1.0,
+            randomFloats(generator) * 2.0 - 1.0);
+        sample = glm::normalize(sample);
+        sample *= randomFloats(generator);
+        float scale = float(i) / float(kernelSize);
+
+        // Scale samples so that they're more aligned to the center of the kernel
+        scale = (scale * scale) * 0.9f + 0.1f;
+        sample *= scale;
+        SSAOKernel.push_back(sample);
+    }
+}
+inline void generateHemiSphereSamples(std::vector<glm::vec3>& SSAOKernel, int kernelSize) { // StarCraftII-like AO generator (Oriented Hemisphere considering point normal)
+    std::uniform_real_distribution<float> randomFloats(0.0, 1.0);
+    std::default_random_engine generator;
+    SSAOKernel.clear();
+    for (int i = 0; i < kernelSize; ++i)
+    {
+        glm::vec3 sample(
+            randomFloats(generator) * 2.0 - 1.0,
+            randomFloats(generator) * 2.0 - 1.0,
+            randomFloats(generator)); // By sampling Z only in [0, 1] range, we effectively sample inside an hemisphere
+        sample = glm::normalize(sample);
+        sample *= randomFloats(generator);
+        float scale = float(i) / float(kernelSize);
+
+        // Scale samples so that they're more aligned to center of kernel
+        scale = (scale * scale) * 0.9f + 0.1f;
+        sample *= scale;
+        SSAOKernel.push_back(sample);
+    }
+}
+
+// Noise vectors for the 4x4 noise texture (random rotations around the Z axis of the tangent space)
+inline void generateNoise(std::vector<glm::vec3>& SSAONoise) {
+    std::uniform_real_distribution<float> randomFloats(0.0, 1.0);
+    std::default_random_engine generator;
+    SSAONoise.clear();
+    for (unsigned int i = 0; i < 16; i++)
+    {
+        glm::vec3 noise(randomFloats(generator) * 2.0 - 1.0, randomFloats(generator) * 2.0 - 1.0, 0.0f);
+        SSAONoise.push_back(noise);
+    }
+}
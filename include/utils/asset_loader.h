@@ -0,0 +1,110 @@
+/*
+AssetLoader class
+- parallel loading of the assets: the CPU side of each asset (e.g., image decoding, mesh import) runs on the workers
+  of a thread pool (utils/thread_pool.h), and its GPU side (creation and upload of the OpenGL objects) on the thread
+  of the OpenGL context
+- each task returns the function uploading its results: the workers add it to a completion queue, and Finish()
+  runs the uploads on the calling thread, in the order of submission (so the OpenGL objects are always created in
+  the same order, whatever the order of completion of the tasks)
+
+The tasks must not call OpenGL, and they must not share data without synchronization.
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <iostream>
+
+#include <utils/thread_pool.h>
+
+/////////////////// ASSET LOADER class ///////////////////////
+class AssetLoader
+{
+public:
+    // GPU side of an asset, run on the thread of the OpenGL context
+    typedef function<void()> Upload;
+    // CPU side of an asset, run on a worker: it returns the upload of its results (or an empty function)
+    typedef function<Upload()> Task;
+
+    AssetLoader(const AssetLoader& copy) = delete; //disallow copy
+    AssetLoader& operator=(const AssetLoader &) = delete;
+
+    // constructor: 0 threads means one per hardware core
+    AssetLoader(unsigned int numThreads = 0) : pool(numThreads) {}
+
+    //////////////////////////////////////////
+    // it starts the CPU side of an asset on the workers
+    void Submit(Task task)
+    {
+        size_t index = this->uploads.size();
+        this->uploads.emplace_back();
+        this->done.push_back(false);
+        this->pool.Submit([this, index, task]() {
+            Upload upload;
+            try
+            {
+                upload = task();
+            }
+            catch (const exception &e)
+            {
+                cout << "ERROR::ASSET_LOADER:: " << e.what() << endl;
+            }
+            {
+                lock_guard<mutex> lock(this->queueMutex);
+                this->completed.push(make_pair(index, upload));
+            }
+            this->condition.notify_one();
+        });
+    }
+
+    // it waits for the submitted tasks, running their uploads in the order of submission as soon as they are available
+    void Finish()
+    {
+        while (this->nextUpload < this->uploads.size())
+        {
+            {
+                unique_lock<mutex> lock(this->queueMutex);
+                this->condition.wait(lock, [this]() { return !this->completed.empty(); });
+                // the completed tasks are moved out of the queue, so the workers are never blocked by the uploads
+                for (; !this->completed.empty(); this->completed.pop())
+                {
+                    this->uploads[this->completed.front().first] = this->completed.front().second;
+                    this->done[this->completed.front().first] = true;
+                }
+            }
+            for (; this->nextUpload < this->uploads.size() && this->done[this->nextUpload]; this->nextUpload++)
+            {
+                if (this->uploads[this->nextUpload])
+                    this->uploads[this->nextUpload]();
+                this->uploads[this->nextUpload] = nullptr;
+            }
+        }
+    }
+
+    unsigned int Threads() const { return this->pool.Size(); }
+    size_t Submitted() const { return this->uploads.size(); }
+
+private:
+    // completion queue: index of the task, and its upload
+    queue<pair<size_t, Upload>> completed;
+    mutex queueMutex;
+    condition_variable condition;
+    // uploads of the completed tasks, in the order of submission (accessed only by the thread of the context)
+    vector<Upload> uploads;
+    vector<bool> done;
+    size_t nextUpload = 0;
+    // (declared last, so the workers are joined before the queue is destroyed)
+    ThreadPool pool;
+};
@@ -0,0 +1,435 @@
+/*
+Benchmark class
+- automated sweep over the ambient occlusion configuration space, used together with the headless rendering mode
+- per-configuration frame time statistics, saved in CSV or JSON format
+- per-configuration memory of the transient render targets used by the frame
+- per-configuration frustum culling statistics: objects of the scene, visible ones, and culling time and throughput
+
+The sweep parameters can be set from the command line (e.g. --modes 1,5 --kernel-sizes 16,64) or from a
+configuration file (--config sweep.cfg) with one "key = value, value, ..." entry per line (# starts a comment).
+Accepted keys: modes, kernel-sizes, radii, directions, steps, blur, blur-radii, blur-gather (0 or 1: taps fetched with
+textureGather), ao-downscales (1 = full resolution AO, 2 = half, 4 = quarter), temporal (0 or 1: temporal accumulation
+of the AO buffer), depth-pyramids (0 = off, 1 = minimum, 2 = maximum, 3 = average reduction of the hierarchical depth
+buffer used by the samples), compute (0 or 1: AO and blur in a single compute dispatch,
+only swept for the blur radii of the compute path, up to --compute-max-blur-radius), specialized (0 or 1: AO and blur
+programs compiled with their parameters as constants), instances (number of instanced models of the stress scene),
+resolutions (WxH), frames, warmup, output.
+The Cartesian product of the values is rendered, collapsing the parameters not used by a given technique.
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+
+// a single point of the sweep
+struct BenchmarkConfig {
+    int ssao_mode;
+    int kernelSize;
+    float kernelRadius;
+    int numDirections;
+    int numSteps;
+    bool have_blur;
+    unsigned int width;
+    unsigned int height;
+    int aoDownscale;
+    int blurRadius;
+    bool blurGather;
+    bool temporalAO;
+    int depthPyramid;
+    bool computeAO;
+    bool specializedShaders;
+    int stressInstances;
+};
+
+// statistics of the frames rendered with a given configuration (times in milliseconds, memory in MB)
+struct BenchmarkResult {
+    BenchmarkConfig config;
+    int frames;
+    double mean, median, min, max, p95, stddev;
+    double targetMemory;
+    // frustum culling: objects and visible objects of the last frame, mean time (milliseconds) and objects per millisecond
+    int cullObjects, cullVisible;
+    double cullTime, cullThroughput;
+};
+
+/////////////////// BENCHMARK class ///////////////////////
+class Benchmark
+{
+public:
+    // values to sweep (an empty list means "use the value currently set in the application")
+    vector<int> modes;
+    vector<int> kernelSizes;
+    vector<float> radii;
+    vector<int> directions;
+    vector<int> steps;
+    vector<int> blur;
+    vector<int> blurRadii;
+    vector<int> blurGather;
+    vector<int> aoDownscales;
+    vector<int> temporal;
+    vector<int> depthPyramids;
+    vector<int> compute;
+    vector<int> specialized;
+    vector<int> instances;
+    vector<pair<unsigned int, unsigned int>> resolutions;
+
+    // number of measured frames per configuration, and number of frames discarded after each configuration change
+    int framesPerConfig = 100;
+    int warmupFrames = 10;
+    // output file: JSON if the extension is .json, CSV otherwise
+    string outputPath = "benchmark_results.csv";
+
+    //////////////////////////////////////////
+    // it parses the command line option at argv[i], advancing i over its value. Returns false if the option is unknown
+    bool ParseArgument(int argc, char **argv, int &i)
+    {
+        string option = argv[i];
+        if (option.size() < 3 || option.compare(0, 2, "--") != 0 || i + 1 >= argc)
+            return false;
+        if (!this->setOption(option.substr(2), argv[i + 1]))
+            return false;
+        i++;
+        return true;
+    }
+
+    //////////////////////////////////////////
+    // it loads the sweep parameters from a configuration file
+    bool LoadConfigFile(const string &path)
+    {
+        ifstream file(path);
+        if (!file.is_open())
+        {
+            cout << "ERROR::BENCHMARK:: unable to open configuration file " << path << endl;
+            return false;
+        }
+        string line;
+        while (getline(file, line))
+        {
+            line = line.substr(0, line.find('#'));
+            size_t separator = line.find('=');
+            if (separator == string::npos)
+                continue;
+            string key = trim(line.substr(0, separator));
+            string value = trim(line.substr(separator + 1));
+            if (!key.empty() && !this->setOption(key, value))
+                cout << "WARNING::BENCHMARK:: unknown key " << key << " in " << path << endl;
+        }
+        return true;
+    }
+
+    //////////////////////////////////////////
+    // it builds the list of configurations to render, starting from the current application values
+    // usesKernel(mode) tells if a technique uses the sample kernel (kernelSize) or the HBAO parameters (directions and steps),
+    // usesDepthPyramid(mode) if it can fetch its samples from the hierarchical depth buffer, usesCompute(mode, blurRadius,
+    // blurGather) if it has a compute shader path with the given blur (blurRadius 0: no blur)
+    void BuildSweep(const BenchmarkConfig &current, const function<bool(int)> &usesKernel, const function<bool(int)> &usesDepthPyramid,
+                    const function<bool(int, int, bool)> &usesCompute)
+    {
+        vector<int> sweepModes = this->modes.empty() ? vector<int>{ current.ssao_mode } : this->modes;
+        vector<int> sweepKernels = this->kernelSizes.empty() ? vector<int>{ current.kernelSize } : this->kernelSizes;
+        vector<float> sweepRadii = this->radii.empty() ? vector<float>{ current.kernelRadius } : this->radii;
+        vector<int> sweepDirections = this->directions.empty() ? vector<int>{ current.numDirections } : this->directions;
+        vector<int> sweepSteps = this->steps.empty() ? vector<int>{ current.numSteps } : this->steps;
+        vector<int> sweepBlur = this->blur.empty() ? vector<int>{ current.have_blur ? 1 : 0 } : this->blur;
+        vector<int> sweepBlurRadii = this->blurRadii.empty() ? vector<int>{ current.blurRadius } : this->blurRadii;
+        vector<int> sweepBlurGather = this->blurGather.empty() ? vector<int>{ current.blurGather ? 1 : 0 } : this->blurGather;
+        vector<int> sweepDownscales = this->aoDownscales.empty() ? vector<int>{ current.aoDownscale } : this->aoDownscales;
+        vector<int> sweepTemporal = this->temporal.empty() ? vector<int>{ current.temporalAO ? 1 : 0 } : this->temporal;
+        vector<int> sweepPyramids = this->depthPyramids.empty() ? vector<int>{ current.depthPyramid } : this->depthPyramids;
+        vector<int> sweepCompute = this->compute.empty() ? vector<int>{ current.computeAO ? 1 : 0 } : this->compute;
+        vector<int> sweepSpecialized = this->specialized.empty() ? vector<int>{ current.specializedShaders ? 1 : 0 } : this->specialized;
+        vector<int> sweepInstances = this->instances.empty() ? vector<int>{ current.stressInstances } : this->instances;
+        vector<pair<unsigned int, unsigned int>> sweepResolutions = this->resolutions;
+        if (sweepResolutions.empty())
+            sweepResolutions.push_back(make_pair(current.width, current.height));
+
+        this->configs.clear();
+        for (auto &resolution : sweepResolutions)
+            for (int mode : sweepModes)
+            {
+                // parameters not used by the technique are collapsed to a single value
+                vector<int> kernels = usesKernel(mode) ? sweepKernels : vector<int>{ current.kernelSize };
+                vector<int> dirs = usesKernel(mode) ? vector<int>{ current.numDirections } : sweepDirections;
+                vector<int> stps = usesKernel(mode) ? vector<int>{ current.numSteps } : sweepSteps;
+                vector<int> downscales = mode != 0 ? sweepDownscales : vector<int>{ current.aoDownscale }; // mode 0: no AO
+                vector<int> temporals = mode != 0 ? sweepTemporal : vector<int>{ current.temporalAO ? 1 : 0 };
+                vector<int> pyramids = usesDepthPyramid(mode) ? sweepPyramids : vector<int>{ 0 };
+                vector<int> specializations = mode != 0 ? sweepSpecialized : vector<int>{ current.specializedShaders ? 1 : 0 };
+                for (int kernel : kernels)
+                    for (float radius : sweepRadii)
+                        for (int dir : dirs)
+                            for (int stp : stps)
+                                for (int b : sweepBlur)
+                                {
+                                    // the blur parameters are collapsed without blur
+                                    vector<int> blurRadii = b != 0 ? sweepBlurRadii : vector<int>{ current.blurRadius };
+                                    vector<int> blurGather = b != 0 ? sweepBlurGather : vector<int>{ current.blurGather ? 1 : 0 };
+                                    for (int blurRadius : blurRadii)
+                                        for (int gather : blurGather)
+                                        {
+                                            vector<int> computes = usesCompute(mode, b != 0 ? blurRadius : 0, gather != 0) ? sweepCompute : vector<int>{ 0 };
+                                            for (int downscale : downscales)
+                                                for (int t : temporals)
+                                                    for (int pyramid : pyramids)
+                                                        for (int c : computes)
+                                                            for (int specialization : specializations)
+                                                                for (int instances : sweepInstances)
+                                                                {
+                                                                    BenchmarkConfig config = { mode, kernel, radius, dir, stp, b != 0, resolution.first, resolution.second,
+                                                                                               downscale, blurRadius, gather != 0, t != 0, pyramid, c != 0, specialization != 0,
+                                                                                               instances };
+                                                                    this->configs.push_back(config);
+                                                                }
+                                        }
+                                }
+            }
+        this->current = 0;
+        this->frame = 0;
+        this->frameTimes.clear();
+        this->targetBytes = 0;
+        this->cullTimes.clear();
+        this->results.clear();
+        cout << "BENCHMARK:: " << this->configs.size() << " configurations, " << this->framesPerConfig << " frames each" << endl;
+    }
+
+    bool Done() const { return this->current >= this->configs.size(); }
+    const BenchmarkConfig& Current() const { return this->configs[this->current]; }
+
+    //////////////////////////////////////////
+    // it records the frustum culling of the frame being rendered (objects tested, visible objects, time in seconds),
+    // added to the statistics by the next RecordFrame
+    void RecordCulling(int objects, int visible, double seconds)
+    {
+        this->cullObjects = objects;
+        this->cullVisible = visible;
+        this->cullTime = seconds;
+    }
+
+    // it records the time (in seconds) of the last rendered frame, and the memory (in bytes) of its render targets
+    // it returns true if the sweep moved to the next configuration, which must be applied before rendering the next frame
+    bool RecordFrame(double seconds, size_t targetBytes = 0)
+    {
+        if (this->Done())
+            return false;
+        if (this->frame++ >= this->warmupFrames)
+        {
+            this->frameTimes.push_back(seconds * 1000.0);
+            this->targetBytes = max(this->targetBytes, targetBytes);
+            this->cullTimes.push_back(this->cullTime * 1000.0);
+        }
+        if ((int)this->frameTimes.size() < this->framesPerConfig)
+            return false;
+
+        this->results.push_back(computeStatistics(this->configs[this->current], this->frameTimes));
+        BenchmarkResult &result = this->results.back();
+        result.targetMemory = this->targetBytes / 1048576.0;
+        result.cullObjects = this->cullObjects;
+        result.cullVisible = this->cullVisible;
+        result.cullTime = 0.0;
+        for (double t : this->cullTimes)
+            result.cullTime += t / this->cullTimes.size();
+        result.cullThroughput = result.cullTime > 0.0 ? this->cullObjects / result.cullTime : 0.0;
+        this->frameTimes.clear();
+        this->targetBytes = 0;
+        this->cullTimes.clear();
+        this->frame = 0;
+        this->current++;
+        return !this->Done();
+    }
+
+    //////////////////////////////////////////
+    // it saves the results; techniqueNames is indexed by ssao_mode
+    bool WriteResults(const char **techniqueNames) const
+    {
+        ofstream file(this->outputPath);
+        if (!file.is_open())
+        {
+            cout << "ERROR::BENCHMARK:: unable to write " << this->outputPath << endl;
+            return false;
+        }
+        bool json = this->outputPath.size() >= 5 && this->outputPath.compare(this->outputPath.size() - 5, 5, ".json") == 0;
+        file << fixed << setprecision(6);
+        if (json)
+            file << "[\n";
+        else
+            file << "technique,mode,width,height,kernel_size,kernel_radius,num_directions,num_steps,blur,blur_radius,blur_gather,ao_downscale,temporal,depth_pyramid,compute,specialized,instances,frames,mean_ms,median_ms,min_ms,max_ms,p95_ms,stddev_ms,target_memory_mb,cull_objects,cull_visible,cull_ms,cull_objects_per_ms\n";
+        for (size_t i = 0; i < this->results.size(); i++)
+        {
+            const BenchmarkResult &r = this->results[i];
+            const BenchmarkConfig &c = r.config;
+            if (json)
+            {
+                file << "  {\"technique\": \"" << techniqueNames[c.ssao_mode] << "\", \"mode\": " << c.ssao_mode
+                     << ", \"width\": " << c.width << ", \"height\": " << c.height
+                     << ", \"kernel_size\": " << c.kernelSize << ", \"kernel_radius\": " << c.kernelRadius
+                     << ", \"num_directions\": " << c.numDirections << ", \"num_steps\": " << c.numSteps
+                     << ", \"blur\": " << (c.have_blur ? "true" : "false") << ", \"blur_radius\": " << c.blurRadius
+                     << ", \"blur_gather\": " << (c.blurGather ? "true" : "false") << ", \"ao_downscale\": " << c.aoDownscale
+                     << ", \"temporal\": " << (c.temporalAO ? "true" : "false") << ", \"depth_pyramid\": " << c.depthPyramid
+                     << ", \"compute\": " << (c.computeAO ? "true" : "false") << ", \"specialized\": " << (c.specializedShaders ? "true" : "false")
+                     << ", \"instances\": " << c.stressInstances
+                     << ", \"frames\": " << r.frames
+                     << ", \"mean_ms\": " << r.mean << ", \"median_ms\": " << r.median << ", \"min_ms\": " << r.min
+                     << ", \"max_ms\": " << r.max << ", \"p95_ms\": " << r.p95 << ", \"stddev_ms\": " << r.stddev
+                     << ", \"target_memory_mb\": " << r.targetMemory
+                     << ", \"cull_objects\": " << r.cullObjects << ", \"cull_visible\": " << r.cullVisible
+                     << ", \"cull_ms\": " << r.cullTime << ", \"cull_objects_per_ms\": " << r.cullThroughput << "}"
+                     << (i + 1 < this->results.size() ? ",\n" : "\n");
+            }
+            else
+            {
+                file << "\"" << techniqueNames[c.ssao_mode] << "\"," << c.ssao_mode << "," << c.width << "," << c.height << ","
+                     << c.kernelSize << "," << c.kernelRadius << "," << c.numDirections << "," << c.numSteps << ","
+                     << (c.have_blur ? 1 : 0) << "," << c.blurRadius << "," << (c.blurGather ? 1 : 0) << "," << c.aoDownscale << "," << (c.temporalAO ? 1 : 0) << "," << c.depthPyramid << "," << (c.computeAO ? 1 : 0) << "," << (c.specializedShaders ? 1 : 0) << "," << c.stressInstances << "," << r.frames << "," << r.mean << "," << r.median << ","
+                     << r.min << "," << r.max << "," << r.p95 << "," << r.stddev << "," << r.targetMemory << ","
+                     << r.cullObjects << "," << r.cullVisible << "," << r.cullTime << "," << r.cullThroughput << "\n";
+            }
+        }
+        if (json)
+            file << "]\n";
+        cout << "BENCHMARK:: results saved in " << this->outputPath << endl;
+        return true;
+    }
+
+private:
+    vector<BenchmarkConfig> configs;
+    vector<BenchmarkResult> results;
+    vector<double> frameTimes;
+    size_t targetBytes = 0;
+    // culling of the frame being rendered, and culling times of the measured frames (milliseconds)
+    int cullObjects = 0, cullVisible = 0;
+    double cullTime = 0.0;
+    vector<double> cullTimes;
+    size_t current = 0;
+    int frame = 0;
+
+    //////////////////////////////////////////
+
+    bool setOption(const string &key, const string &value)
+    {
+        if (key == "modes")
+            this->modes = parseList<int>(value);
+        else if (key == "kernel-sizes")
+            this->kernelSizes = parseList<int>(value);
+        else if (key == "radii")
+            this->radii = parseList<float>(value);
+        else if (key == "directions")
+            this->directions = parseList<int>(value);
+        else if (key == "steps")
+            this->steps = parseList<int>(value);
+        else if (key == "blur")
+            this->blur = parseList<int>(value);
+        else if (key == "blur-radii")
+            this->blurRadii = parseList<int>(value);
+        else if (key == "blur-gather")
+            this->blurGather = parseList<int>(value);
+        else if (key == "ao-downscales")
+            this->aoDownscales = parseList<int>(value);
+        else if (key == "temporal")
+            this->temporal = parseList<int>(value);
+        else if (key == "depth-pyramids")
+            this->depthPyramids = parseList<int>(value);
+        else if (key == "compute")
+            this->compute = parseList<int>(value);
+        else if (key == "specialized")
+            this->specialized = parseList<int>(value);
+        else if (key == "instances")
+            this->instances = parseList<int>(value);
+        else if (key == "resolutions")
+        {
+            this->resolutions.clear();
+            for (const string &item : split(value))
+            {
+                unsigned int w, h;
+                char separator;
+                stringstream stream(item);
+                if (stream >> w >> separator >> h && (separator == 'x' || separator == 'X'))
+                    this->resolutions.push_back(make_pair(w, h));
+                else
+                    cout << "WARNING::BENCHMARK:: invalid resolution " << item << endl;
+            }
+        }
+        else if (key == "frames")
+            this->framesPerConfig = max(1, atoi(value.c_str()));
+        else if (key == "warmup")
+            this->warmupFrames = max(0, atoi(value.c_str()));
+        else if (key == "output")
+            this->outputPath = value;
+        else
+            return false;
+        return true;
+    }
+
+    static string trim(const string &s)
+    {
+        size_t first = s.find_first_not_of(" \t\r\n");
+        if (first == string::npos)
+            return "";
+        size_t last = s.find_last_not_of(" \t\r\n");
+        return s.substr(first, last - first + 1);
+    }
+
+    static vector<string> split(const string &s)
+    {
+        vector<string> items;
+        stringstream stream(s);
+        string item;
+        while (getline(stream, item, ','))
+        {
+            item = trim(item);
+            if (!item.empty())
+                items.push_back(item);
+        }
+        return items;
+    }
+
+    template<typename T>
+    static vector<T> parseList(const string &s)
+    {
+        vector<T> values;
+        for (const string &item : split(s))
+        {
+            T value;
+            stringstream stream(item);
+            if (stream >> value)
+                values.push_back(value);
+        }
+        return values;
+    }
+
+    static BenchmarkResult computeStatistics(const BenchmarkConfig &config, vector<double> times)
+    {
+        BenchmarkResult r;
+        r.config = config;
+        r.frames = (int)times.size();
+        sort(times.begin(), times.end());
+        double sum = 0.0;
+        for (double t : times)
+            sum += t;
+        r.mean = sum / times.size();
+        r.median = times[times.size() / 2];
+        r.min = times.front();
+        r.max = times.back();
+        r.p95 = times[min(times.size() - 1, (size_t)ceil(0.95 * times.size()) - 1)];
+        double variance = 0.0;
+        for (double t : times)
+            variance += (t - r.mean) * (t - r.mean);
+        r.stddev = sqrt(variance / times.size());
+        return r;
+    }
+};
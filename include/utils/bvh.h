@@ -0,0 +1,369 @@
+/*
+BVH class
+- bounding volume hierarchy of the objects of the scene (axis aligned boxes in world coordinates), used for the
+  frustum culling on the CPU: Cull returns the objects whose box intersects the view frustum
+- 8-wide nodes: the boxes of the children of a node are stored as a structure of arrays (minX[8], minY[8], ...), so a
+  node is tested against a plane of the frustum with a few AVX instructions, one lane per child, when compiled with
+  AVX support (/arch:AVX or -mavx); plain C++ otherwise. Setting useSIMD to false selects the plain C++ test, used as
+  reference
+- top-down build, splitting the objects near the median of their centers along the longest axis
+- incremental refit: Update changes the box of an object, and Refit updates only the nodes above the changed objects,
+  stopping where the box of a node does not change
+- the traversal keeps only the planes still intersecting the box of a node: the children fully inside the frustum are
+  accepted with all their objects, without further tests
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <vector>
+#include <cfloat>
+#include <cstdint>
+#include <algorithm>
+#include <numeric>
+
+#include <glm/glm.hpp>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+/////////////////// BVH class ///////////////////////
+class BVH
+{
+public:
+    // children of a node (lanes of the plane tests)
+    static const int WIDTH = 8;
+    // planes of the frustum
+    static const int PLANES = 6;
+
+#if defined(__AVX__)
+    static const char* SIMDName() { return "AVX"; }
+#else
+    static const char* SIMDName() { return "none"; }
+#endif
+
+    // plane tests with the SIMD instructions (false: plain C++ test of each child)
+    bool useSIMD = true;
+
+    //////////////////////////////////////////
+    // it builds the hierarchy of count objects, with the given boxes (the object i is identified by i)
+    void Build(const glm::vec3 *minimums, const glm::vec3 *maximums, size_t count)
+    {
+        this->nodes.clear();
+        this->dirtyNodes.clear();
+        this->objectNodes.assign(count, 0);
+        this->objectSlots.assign(count, 0);
+        if (count == 0)
+            return;
+        vector<uint32_t> order(count);
+        iota(order.begin(), order.end(), 0u);
+        vector<glm::vec3> centers(count);
+        for (size_t i = 0; i < count; i++)
+            centers[i] = (minimums[i] + maximums[i]) * 0.5f;
+        this->nodes.reserve(count / (WIDTH / 2) + 1);
+        this->buildNode(order, centers, minimums, maximums, 0, count, -1, 0);
+    }
+
+    // it changes the box of an object: the nodes above it are updated by the next Refit
+    void Update(uint32_t object, const glm::vec3 &minimum, const glm::vec3 &maximum)
+    {
+        uint32_t index = this->objectNodes[object];
+        if (this->setSlot(this->nodes[index], this->objectSlots[object], minimum, maximum))
+            this->markDirty(index);
+    }
+
+    // it updates the boxes of the nodes above the objects changed by Update, and it returns the number of nodes updated
+    size_t Refit()
+    {
+        // the children are always stored after their parent: the dirty nodes are processed from the last one, so the
+        // box of a node is computed from its updated children (its parent is marked dirty only if its box changed)
+        size_t refitted = 0;
+        make_heap(this->dirtyNodes.begin(), this->dirtyNodes.end());
+        while (!this->dirtyNodes.empty())
+        {
+            pop_heap(this->dirtyNodes.begin(), this->dirtyNodes.end());
+            uint32_t index = this->dirtyNodes.back();
+            this->dirtyNodes.pop_back();
+            Node &node = this->nodes[index];
+            node.dirty = false;
+            refitted++;
+            if (node.parent < 0)
+                continue;
+            glm::vec3 minimum, maximum;
+            this->nodeBounds(node, minimum, maximum);
+            if (this->setSlot(this->nodes[node.parent], node.slot, minimum, maximum) && !this->nodes[node.parent].dirty)
+            {
+                this->nodes[node.parent].dirty = true;
+                this->dirtyNodes.push_back(node.parent);
+                push_heap(this->dirtyNodes.begin(), this->dirtyNodes.end());
+            }
+        }
+        return refitted;
+    }
+
+    //////////////////////////////////////////
+    // it appends to visible the objects whose box intersects the view frustum of the viewProjection matrix
+    // (OpenGL clip space). The boxes near the edges of the frustum can be accepted even if outside it
+    void Cull(const glm::mat4 &viewProjection, vector<uint32_t> &visible) const
+    {
+        if (this->nodes.empty())
+            return;
+        glm::vec4 planes[PLANES];
+        FrustumPlanes(viewProjection, planes);
+        // stack of the nodes to visit, with the mask of the planes intersecting their box
+        uint32_t stack[256][2];
+        int size = 0;
+        stack[size][0] = 0;
+        stack[size++][1] = (1u << PLANES) - 1;
+        while (size > 0)
+        {
+            size--;
+            const Node &node = this->nodes[stack[size][0]];
+            uint32_t planeMask = stack[size][1];
+            // for each plane: the children outside it, and the ones fully inside it
+            uint32_t outside = 0, inside[PLANES] = {};
+            for (int p = 0; p < PLANES; p++)
+                if (planeMask & (1u << p))
+                    outside |= this->testPlane(node, planes[p], inside[p]);
+            uint32_t accepted = ~outside & ((1u << node.count) - 1);
+            for (int c = 0; c < node.count; c++)
+            {
+                if (!(accepted & (1u << c)))
+                    continue;
+                uint32_t childMask = planeMask;
+                for (int p = 0; p < PLANES; p++)
+                    if (inside[p] & (1u << c))
+                        childMask &= ~(1u << p);
+                int32_t child = node.children[c];
+                if (child < 0)
+                    visible.push_back((uint32_t)~child);
+                else if (childMask == 0)
+                    this->collect(child, visible);
+                else
+                {
+                    stack[size][0] = (uint32_t)child;
+                    stack[size++][1] = childMask;
+                }
+            }
+        }
+    }
+
+    size_t Objects() const { return this->objectNodes.size(); }
+    size_t Nodes() const { return this->nodes.size(); }
+
+    //////////////////////////////////////////
+    // planes of the view frustum (normals towards the inside, not normalized), from the rows of the matrix
+    // (see "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix", Gribb and Hartmann)
+    static void FrustumPlanes(const glm::mat4 &viewProjection, glm::vec4 planes[PLANES])
+    {
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++)
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        for (int i = 0; i < 3; i++)
+        {
+            planes[2 * i] = rows[3] + rows[i];
+            planes[2 * i + 1] = rows[3] - rows[i];
+        }
+    }
+
+    // box of a transformed box (see "Transforming Axis-Aligned Bounding Boxes", Arvo - Graphics Gems 1990)
+    static void TransformBox(const glm::mat4 &matrix, const glm::vec3 &minimum, const glm::vec3 &maximum, glm::vec3 &transformedMinimum, glm::vec3 &transformedMaximum)
+    {
+        glm::vec3 center = glm::vec3(matrix * glm::vec4((minimum + maximum) * 0.5f, 1.0f));
+        glm::vec3 extent = (maximum - minimum) * 0.5f;
+        glm::mat3 absolute = glm::mat3(matrix);
+        for (int i = 0; i < 3; i++)
+            absolute[i] = glm::abs(absolute[i]);
+        glm::vec3 transformedExtent = absolute * extent;
+        transformedMinimum = center - transformedExtent;
+        transformedMaximum = center + transformedExtent;
+    }
+
+private:
+    // node: boxes of the children as a structure of arrays; a child >= 0 is a node, a child < 0 is the object ~child
+    struct Node {
+        float minX[WIDTH], minY[WIDTH], minZ[WIDTH];
+        float maxX[WIDTH], maxY[WIDTH], maxZ[WIDTH];
+        int32_t children[WIDTH];
+        int32_t count;
+        // parent node (-1 for the root), and slot of the node in its parent
+        int32_t parent;
+        int32_t slot;
+        bool dirty;
+    };
+
+    vector<Node> nodes;
+    // node and slot of each object
+    vector<uint32_t> objectNodes;
+    vector<uint8_t> objectSlots;
+    // nodes with a changed child, to refit (max heap of the indices)
+    vector<uint32_t> dirtyNodes;
+
+    //////////////////////////////////////////
+    // it tests the children of a node against a plane: it returns the mask of the children outside the plane, and it
+    // sets in inside the mask of the children fully inside it. The nearest and the farthest corners of the boxes along
+    // the normal are selected once for all the children, from the signs of the normal
+    // (the unused slots have an empty box, always outside)
+    uint32_t testPlane(const Node &node, const glm::vec4 &plane, uint32_t &inside) const
+    {
+        const float *farX = plane.x >= 0.0f ? node.maxX : node.minX;
+        const float *farY = plane.y >= 0.0f ? node.maxY : node.minY;
+        const float *farZ = plane.z >= 0.0f ? node.maxZ : node.minZ;
+        const float *nearX = plane.x >= 0.0f ? node.minX : node.maxX;
+        const float *nearY = plane.y >= 0.0f ? node.minY : node.maxY;
+        const float *nearZ = plane.z >= 0.0f ? node.minZ : node.maxZ;
+#if defined(__AVX__)
+        if (this->useSIMD)
+        {
+            __m256 x = _mm256_set1_ps(plane.x), y = _mm256_set1_ps(plane.y), z = _mm256_set1_ps(plane.z), w = _mm256_set1_ps(plane.w);
+            __m256 zero = _mm256_setzero_ps();
+            __m256 farDistance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_loadu_ps(farX)), _mm256_mul_ps(y, _mm256_loadu_ps(farY))),
+                                               _mm256_add_ps(_mm256_mul_ps(z, _mm256_loadu_ps(farZ)), w));
+            __m256 nearDistance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_loadu_ps(nearX)), _mm256_mul_ps(y, _mm256_loadu_ps(nearY))),
+                                                _mm256_add_ps(_mm256_mul_ps(z, _mm256_loadu_ps(nearZ)), w));
+            inside = (uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(nearDistance, zero, _CMP_GE_OQ));
+            return (uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(farDistance, zero, _CMP_LT_OQ));
+        }
+#endif
+        uint32_t outside = 0;
+        inside = 0;
+        for (int c = 0; c < WIDTH; c++)
+        {
+            if ((plane.x * farX[c] + plane.y * farY[c]) + (plane.z * farZ[c] + plane.w) < 0.0f)
+                outside |= 1u << c;
+            if ((plane.x * nearX[c] + plane.y * nearY[c]) + (plane.z * nearZ[c] + plane.w) >= 0.0f)
+                inside |= 1u << c;
+        }
+        return outside;
+    }
+
+    // all the objects below a node
+    void collect(int32_t index, vector<uint32_t> &visible) const
+    {
+        const Node &node = this->nodes[index];
+        for (int c = 0; c < node.count; c++)
+        {
+            if (node.children[c] < 0)
+                visible.push_back((uint32_t)~node.children[c]);
+            else
+                this->collect(node.children[c], visible);
+        }
+    }
+
+    //////////////////////////////////////////
+    // it creates the node of the objects in order[begin, end): they are split in up to WIDTH ranges (splitting the
+    // largest range at the median of the centers along its longest axis), each one becoming a child node, or an object
+    // if it has a single one
+    int32_t buildNode(vector<uint32_t> &order, const vector<glm::vec3> &centers, const glm::vec3 *minimums, const glm::vec3 *maximums,
+                      size_t begin, size_t end, int32_t parent, int32_t slot)
+    {
+        int32_t index = (int32_t)this->nodes.size();
+        this->nodes.emplace_back();
+        Node &node = this->nodes.back();
+        for (int c = 0; c < WIDTH; c++)
+        {
+            this->setSlot(node, c, glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+            node.children[c] = 0;
+        }
+        node.parent = parent;
+        node.slot = slot;
+        node.dirty = false;
+
+        // objects of a full subtree of the children: each range is split at a multiple of it, so the subtrees are
+        // full except the last one
+        size_t chunk = 1;
+        while (chunk * WIDTH < end - begin)
+            chunk *= WIDTH;
+        size_t ranges[WIDTH][2] = { { begin, end } };
+        int numRanges = 1;
+        while (numRanges < WIDTH)
+        {
+            int largest = 0;
+            for (int r = 1; r < numRanges; r++)
+                if (ranges[r][1] - ranges[r][0] > ranges[largest][1] - ranges[largest][0])
+                    largest = r;
+            size_t first = ranges[largest][0], last = ranges[largest][1];
+            if (last - first <= chunk)
+                break;
+            glm::vec3 minimum(FLT_MAX), maximum(-FLT_MAX);
+            for (size_t i = first; i < last; i++)
+            {
+                minimum = glm::min(minimum, centers[order[i]]);
+                maximum = glm::max(maximum, centers[order[i]]);
+            }
+            glm::vec3 size = maximum - minimum;
+            int axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+            size_t middle = first + ((last - first) / 2 + chunk - 1) / chunk * chunk;
+            nth_element(order.begin() + first, order.begin() + middle, order.begin() + last,
+                        [&centers, axis](uint32_t a, uint32_t b) { return centers[a][axis] < centers[b][axis]; });
+            ranges[largest][1] = middle;
+            ranges[numRanges][0] = middle;
+            ranges[numRanges++][1] = last;
+        }
+
+        this->nodes[index].count = numRanges;
+        for (int r = 0; r < numRanges; r++)
+        {
+            if (ranges[r][1] - ranges[r][0] == 1)
+            {
+                uint32_t object = order[ranges[r][0]];
+                this->setSlot(this->nodes[index], r, minimums[object], maximums[object]);
+                this->nodes[index].children[r] = ~(int32_t)object;
+                this->objectNodes[object] = (uint32_t)index;
+                this->objectSlots[object] = (uint8_t)r;
+            }
+            else
+            {
+                // (the recursion can reallocate the nodes: the node is accessed again by its index)
+                int32_t child = this->buildNode(order, centers, minimums, maximums, ranges[r][0], ranges[r][1], index, r);
+                glm::vec3 minimum, maximum;
+                this->nodeBounds(this->nodes[child], minimum, maximum);
+                this->setSlot(this->nodes[index], r, minimum, maximum);
+                this->nodes[index].children[r] = child;
+            }
+        }
+        return index;
+    }
+
+    // box of all the children of a node
+    void nodeBounds(const Node &node, glm::vec3 &minimum, glm::vec3 &maximum) const
+    {
+        minimum = glm::vec3(FLT_MAX);
+        maximum = glm::vec3(-FLT_MAX);
+        for (int c = 0; c < node.count; c++)
+        {
+            minimum = glm::min(minimum, glm::vec3(node.minX[c], node.minY[c], node.minZ[c]));
+            maximum = glm::max(maximum, glm::vec3(node.maxX[c], node.maxY[c], node.maxZ[c]));
+        }
+    }
+
+    // it sets the box of a child, and it returns true if it changed
+    bool setSlot(Node &node, int slot, const glm::vec3 &minimum, const glm::vec3 &maximum)
+    {
+        if (node.minX[slot] == minimum.x && node.minY[slot] == minimum.y && node.minZ[slot] == minimum.z &&
+            node.maxX[slot] == maximum.x && node.maxY[slot] == maximum.y && node.maxZ[slot] == maximum.z)
+            return false;
+        node.minX[slot] = minimum.x;
+        node.minY[slot] = minimum.y;
+        node.minZ[slot] = minimum.z;
+        node.maxX[slot] = maximum.x;
+        node.maxY[slot] = maximum.y;
+        node.maxZ[slot] = maximum.z;
+        return true;
+    }
+
+    void markDirty(uint32_t index)
+    {
+        if (this->nodes[index].dirty)
+            return;
+        this->nodes[index].dirty = true;
+        this->dirtyNodes.push_back(index);
+    }
+};
@@ -0,0 +1,125 @@
+/*
+DepthPyramid class
+- hierarchical linear depth buffer: a R32F texture with the full mip chain, where each level is the reduction
+  (minimum, maximum or average) of the 2x2 blocks of the previous one (when a size of the previous level is odd, the
+  blocks of the last column or row are 3 texels wide, so that every texel is covered)
+- a framebuffer for each level, used to render it from the previous level
+
+The levels are rendered by the application, in order: BeginLevel(level) binds the framebuffer of the level, with
+a viewport covering it, and restricts the levels of the texture which can be sampled to the previous one (so that
+the texture can be bound for sampling while one of its levels is rendered, without a feedback loop): the
+reduction shader reads the previous level as level 0 of the texture. End() enables the sampling of all the levels.
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include <utils/gl_state.h>
+
+/////////////////// DEPTH PYRAMID class ///////////////////////
+class DepthPyramid
+{
+public:
+    DepthPyramid(const DepthPyramid& copy) = delete; //disallow copy
+    DepthPyramid& operator=(const DepthPyramid &) = delete;
+
+    DepthPyramid() {}
+
+    //////////////////////////////////////////
+    // it (re)allocates the pyramid if the size of its level 0 is different
+    void Resize(GLsizei width, GLsizei height)
+    {
+        if (width == this->width && height == this->height)
+            return;
+        this->Delete();
+        this->width = width;
+        this->height = height;
+
+        int levels = 1;
+        while ((max(width, height) >> levels) > 0)
+            levels++;
+
+        GLState &state = GLState::Get();
+        glGenTextures(1, &this->texture);
+        state.BindTexture(0, GL_TEXTURE_2D, this->texture);
+        for (int level = 0; level < levels; level++)
+            glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, this->Width(level), this->Height(level), 0, GL_RED, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+        this->framebuffers.resize(levels);
+        glGenFramebuffers(levels, this->framebuffers.data());
+        for (int level = 0; level < levels; level++)
+        {
+            state.BindFramebuffer(GL_FRAMEBUFFER, this->framebuffers[level]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->texture, level);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                cout << "ERROR::DEPTH_PYRAMID:: framebuffer of level " << level << " is not complete" << endl;
+        }
+    }
+
+    //////////////////////////////////////////
+    GLuint Texture() const { return this->texture; }
+    int Levels() const { return (int)this->framebuffers.size(); }
+    GLsizei Width(int level) const { return max(1, this->width >> level); }
+    GLsizei Height(int level) const { return max(1, this->height >> level); }
+
+    //////////////////////////////////////////
+    // it binds the framebuffer of a level: the previous level is the only one which can be sampled
+    void BeginLevel(int level)
+    {
+        GLState &state = GLState::Get();
+        state.BindFramebuffer(GL_FRAMEBUFFER, this->framebuffers[level]);
+        state.Viewport(0, 0, this->Width(level), this->Height(level));
+        if (level > 0)
+            this->setLevels(level - 1, level - 1);
+    }
+
+    // all the levels can be sampled
+    void End()
+    {
+        this->setLevels(0, this->Levels() - 1);
+    }
+
+    //////////////////////////////////////////
+    // it releases the texture and the framebuffers
+    void Delete()
+    {
+        if (this->texture == 0)
+            return;
+        GLState &state = GLState::Get();
+        for (GLuint framebuffer : this->framebuffers)
+            state.ForgetFramebuffer(framebuffer);
+        state.ForgetTexture(this->texture);
+        glDeleteFramebuffers((GLsizei)this->framebuffers.size(), this->framebuffers.data());
+        glDeleteTextures(1, &this->texture);
+        this->framebuffers.clear();
+        this->texture = 0;
+        this->width = this->height = 0;
+    }
+
+private:
+    GLuint texture = 0;
+    vector<GLuint> framebuffers;
+    GLsizei width = 0, height = 0;
+
+    void setLevels(int base, int last)
+    {
+        GLState::Get().BindTexture(0, GL_TEXTURE_2D, this->texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, base);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, last);
+    }
+};
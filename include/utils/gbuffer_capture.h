@@ -0,0 +1,242 @@
+/*
+GBufferCapture class
+- binary capture of the inputs of the ambient occlusion passes: G Buffer textures, noise, sample kernel, camera matrices
+- SaveGBufferCapture writes a capture, GBufferCapture maps it in memory and gives direct access to its chunks (no copies)
+
+File layout (little endian):
+- header: magic "AOGB", format version, number of chunks, 4 reserved bytes
+- chunk table: for each chunk, a 4 characters id, the element format, the offset and the size in bytes of the data
+- chunk data: each chunk starts at a 64 bytes aligned offset, so that the arrays can be used in place
+The readers skip the chunks they do not know, so new chunks can be added without breaking old captures;
+any incompatible change to the existing chunks must increase GBUFFER_CAPTURE_VERSION.
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include <utils/mapped_file.h>
+
+const uint32_t GBUFFER_CAPTURE_VERSION = 1;
+const uint32_t GBUFFER_CAPTURE_ALIGNMENT = 64;
+
+// element format of a chunk
+enum GBufferCaptureFormat {
+    CAPTURE_STRUCT,     // GBufferCaptureInfo
+    CAPTURE_MAT4,       // glm::mat4
+    CAPTURE_R32F,       // one float per texel
+    CAPTURE_RGB32F,     // three floats per texel (glm::vec3)
+    CAPTURE_RGB8        // three unsigned bytes per texel
+};
+
+// chunk ids
+#define CAPTURE_CHUNK_ID(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+const uint32_t CAPTURE_INFO = CAPTURE_CHUNK_ID('I', 'N', 'F', 'O');
+const uint32_t CAPTURE_PROJECTION = CAPTURE_CHUNK_ID('P', 'R', 'O', 'J');
+const uint32_t CAPTURE_VIEW = CAPTURE_CHUNK_ID('V', 'I', 'E', 'W');
+const uint32_t CAPTURE_POSITION = CAPTURE_CHUNK_ID('G', 'P', 'O', 'S');
+const uint32_t CAPTURE_NORMAL = CAPTURE_CHUNK_ID('G', 'N', 'R', 'M');
+const uint32_t CAPTURE_ALBEDO = CAPTURE_CHUNK_ID('G', 'A', 'L', 'B');
+const uint32_t CAPTURE_DEPTH = CAPTURE_CHUNK_ID('G', 'D', 'P', 'T');
+const uint32_t CAPTURE_NOISE = CAPTURE_CHUNK_ID('N', 'O', 'I', 'S');
+const uint32_t CAPTURE_KERNEL = CAPTURE_CHUNK_ID('K', 'E', 'R', 'N');
+
+// application state at capture time
+struct GBufferCaptureInfo {
+    uint32_t width;
+    uint32_t height;
+    int32_t ssao_mode;
+    int32_t kernelSize;
+    int32_t numDirections;
+    int32_t numSteps;
+    float kernelRadius;
+    float kernelBias;
+    float fov;
+    float nearPlane;
+    float farPlane;
+    uint32_t reserved;
+};
+
+// data to be saved: the textures are in the OpenGL layout (width * height texels, bottom row first)
+struct GBufferCaptureData {
+    GBufferCaptureInfo info;
+    glm::mat4 projection;
+    glm::mat4 view;
+    const glm::vec3 *position;
+    const glm::vec3 *normal;
+    const unsigned char *albedo;
+    const float *depth;
+    const vector<glm::vec3> *noise;
+    const vector<glm::vec3> *kernel;
+};
+
+struct GBufferCaptureHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t chunkCount;
+    uint32_t reserved;
+};
+
+struct GBufferCaptureChunk {
+    uint32_t id;
+    uint32_t format;
+    uint64_t offset;
+    uint64_t size;
+};
+
+//////////////////////////////////////////
+// it writes a capture file
+inline bool SaveGBufferCapture(const string &path, const GBufferCaptureData &data)
+{
+    size_t texels = (size_t)data.info.width * data.info.height;
+    struct Source { uint32_t id; uint32_t format; const void *data; size_t size; };
+    vector<Source> sources = {
+        { CAPTURE_INFO, CAPTURE_STRUCT, &data.info, sizeof(GBufferCaptureInfo) },
+        { CAPTURE_PROJECTION, CAPTURE_MAT4, &data.projection, sizeof(glm::mat4) },
+        { CAPTURE_VIEW, CAPTURE_MAT4, &data.view, sizeof(glm::mat4) },
+        { CAPTURE_POSITION, CAPTURE_RGB32F, data.position, texels * sizeof(glm::vec3) },
+        { CAPTURE_NORMAL, CAPTURE_RGB32F, data.normal, texels * sizeof(glm::vec3) },
+        { CAPTURE_ALBEDO, CAPTURE_RGB8, data.albedo, texels * 3 },
+        { CAPTURE_DEPTH, CAPTURE_R32F, data.depth, texels * sizeof(float) },
+        { CAPTURE_NOISE, CAPTURE_RGB32F, data.noise->data(), data.noise->size() * sizeof(glm::vec3) },
+        { CAPTURE_KERNEL, CAPTURE_RGB32F, data.kernel->data(), data.kernel->size() * sizeof(glm::vec3) }
+    };
+
+    GBufferCaptureHeader header = { { 'A', 'O', 'G', 'B' }, GBUFFER_CAPTURE_VERSION, (uint32_t)sources.size(), 0 };
+    vector<GBufferCaptureChunk> table;
+    uint64_t offset = sizeof(GBufferCaptureHeader) + sources.size() * sizeof(GBufferCaptureChunk);
+    for (const Source &source : sources)
+    {
+        offset = (offset + GBUFFER_CAPTURE_ALIGNMENT - 1) / GBUFFER_CAPTURE_ALIGNMENT * GBUFFER_CAPTURE_ALIGNMENT;
+        GBufferCaptureChunk chunk = { source.id, source.format, offset, source.size };
+        table.push_back(chunk);
+        offset += source.size;
+    }
+
+    ofstream file(path, ios::binary);
+    if (!file.is_open())
+    {
+        cout << "ERROR::CAPTURE:: unable to write " << path << endl;
+        return false;
+    }
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)table.data(), table.size() * sizeof(GBufferCaptureChunk));
+    const char padding[GBUFFER_CAPTURE_ALIGNMENT] = {};
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        file.write(padding, (streamsize)(table[i].offset - (uint64_t)file.tellp()));
+        file.write((const char*)sources[i].data, sources[i].size);
+    }
+    if (!file.good())
+    {
+        cout << "ERROR::CAPTURE:: error while writing " << path << endl;
+        return false;
+    }
+    cout << "CAPTURE:: G Buffer " << data.info.width << "x" << data.info.height << " saved in " << path << endl;
+    return true;
+}
+
+/////////////////// GBUFFER CAPTURE class ///////////////////////
+class GBufferCapture
+{
+public:
+    GBufferCapture(const GBufferCapture& copy) = delete; //disallow copy
+    GBufferCapture& operator=(const GBufferCapture &) = delete;
+
+    GBufferCapture() {}
+
+    //////////////////////////////////////////
+    // it maps the file and validates its header and its chunk table
+    bool Open(const string &path)
+    {
+        if (!this->file.Open(path))
+            return false;
+        const GBufferCaptureHeader *header = (const GBufferCaptureHeader*)this->file.Data();
+        if (this->file.Size() < sizeof(GBufferCaptureHeader) || memcmp(header->magic, "AOGB", 4) != 0)
+            return this->fail(path, "not a G Buffer capture");
+        if (header->version != GBUFFER_CAPTURE_VERSION)
+            return this->fail(path, "unsupported version " + to_string(header->version));
+        if (this->file.Size() < sizeof(GBufferCaptureHeader) + header->chunkCount * sizeof(GBufferCaptureChunk))
+            return this->fail(path, "truncated chunk table");
+        this->chunks = (const GBufferCaptureChunk*)(this->file.Data() + sizeof(GBufferCaptureHeader));
+        this->chunkCount = header->chunkCount;
+        for (uint32_t i = 0; i < this->chunkCount; i++)
+            if (this->chunks[i].offset + this->chunks[i].size > this->file.Size())
+                return this->fail(path, "truncated chunk data");
+
+        // mandatory chunks
+        size_t texels = 0;
+        this->info = (const GBufferCaptureInfo*)this->Chunk(CAPTURE_INFO, CAPTURE_STRUCT, sizeof(GBufferCaptureInfo));
+        if (this->info)
+            texels = (size_t)this->info->width * this->info->height;
+        if (!this->info || !this->Chunk(CAPTURE_PROJECTION, CAPTURE_MAT4, sizeof(glm::mat4)) || !this->Chunk(CAPTURE_VIEW, CAPTURE_MAT4, sizeof(glm::mat4)) ||
+            !this->Chunk(CAPTURE_POSITION, CAPTURE_RGB32F, texels * sizeof(glm::vec3)) || !this->Chunk(CAPTURE_NORMAL, CAPTURE_RGB32F, texels * sizeof(glm::vec3)) ||
+            !this->Chunk(CAPTURE_ALBEDO, CAPTURE_RGB8, texels * 3) || !this->Chunk(CAPTURE_DEPTH, CAPTURE_R32F, texels * sizeof(float)) ||
+            !this->Chunk(CAPTURE_NOISE, CAPTURE_RGB32F, 16 * sizeof(glm::vec3)) || !this->Chunk(CAPTURE_KERNEL, CAPTURE_RGB32F, 0))
+            return this->fail(path, "missing or invalid chunks");
+        return true;
+    }
+
+    //////////////////////////////////////////
+    // it returns a pointer to the data of a chunk, or nullptr if the chunk is missing, has a different format or is smaller than minSize
+    const void* Chunk(uint32_t id, uint32_t format, size_t minSize = 0, size_t *size = nullptr) const
+    {
+        for (uint32_t i = 0; i < this->chunkCount; i++)
+        {
+            const GBufferCaptureChunk &chunk = this->chunks[i];
+            if (chunk.id != id)
+                continue;
+            if (chunk.format != format || chunk.size < minSize)
+                return nullptr;
+            if (size)
+                *size = (size_t)chunk.size;
+            return this->file.Data() + chunk.offset;
+        }
+        return nullptr;
+    }
+
+    const GBufferCaptureInfo& Info() const { return *this->info; }
+    const glm::mat4& Projection() const { return *(const glm::mat4*)this->Chunk(CAPTURE_PROJECTION, CAPTURE_MAT4); }
+    const glm::mat4& View() const { return *(const glm::mat4*)this->Chunk(CAPTURE_VIEW, CAPTURE_MAT4); }
+    const glm::vec3* Positions() const { return (const glm::vec3*)this->Chunk(CAPTURE_POSITION, CAPTURE_RGB32F); }
+    const glm::vec3* Normals() const { return (const glm::vec3*)this->Chunk(CAPTURE_NORMAL, CAPTURE_RGB32F); }
+    const unsigned char* Albedo() const { return (const unsigned char*)this->Chunk(CAPTURE_ALBEDO, CAPTURE_RGB8); }
+    const float* Depth() const { return (const float*)this->Chunk(CAPTURE_DEPTH, CAPTURE_R32F); }
+    const glm::vec3* Noise() const { return (const glm::vec3*)this->Chunk(CAPTURE_NOISE, CAPTURE_RGB32F); }
+    const glm::vec3* Kernel() const { return (const glm::vec3*)this->Chunk(CAPTURE_KERNEL, CAPTURE_RGB32F); }
+    int KernelSize() const
+    {
+        size_t size = 0;
+        this->Chunk(CAPTURE_KERNEL, CAPTURE_RGB32F, 0, &size);
+        return (int)(size / sizeof(glm::vec3));
+    }
+
+private:
+    MappedFile file;
+    const GBufferCaptureChunk *chunks = nullptr;
+    uint32_t chunkCount = 0;
+    const GBufferCaptureInfo *info = nullptr;
+
+    bool fail(const string &path, const string &reason)
+    {
+        cout << "ERROR::CAPTURE:: " << path << ": " << reason << endl;
+        this->file.Close();
+        this->chunkCount = 0;
+        this->info = nullptr;
+        return false;
+    }
+};
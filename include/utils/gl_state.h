@@ -0,0 +1,245 @@
+/*
+GLState class
+- shadow copy of the OpenGL state changed by the render loop: program, VAO, framebuffers, texture units,
+  draw buffers of each framebuffer, viewport, enable flags
+- a state change is sent to the driver only if the new value is different from the tracked one
+- per-frame counters of issued and elided state changes
+
+The state is tracked for the (single) context of the application, accessed with GLState::Get().
+Code changing the state with direct OpenGL calls (e.g., texture creation, dear ImGui) must call Invalidate()
+afterwards: the tracked values are discarded, and the next change of each state is always issued.
+Objects deleted while bound must be reported with ForgetProgram(), ForgetVertexArray(), ForgetTexture() and
+ForgetFramebuffer().
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+// counters of the state changes (issued to the driver, and elided because the state was already set)
+struct GLStateStats {
+    unsigned int issued = 0;
+    unsigned int elided = 0;
+};
+
+/////////////////// GL STATE class ///////////////////////
+class GLState
+{
+public:
+    // texture units and texture targets tracked by the cache (the other targets are always issued)
+    static const int MAX_TEXTURE_UNITS = 32;
+    static const int TRACKED_TARGETS = 4;
+
+    GLState(const GLState& copy) = delete; //disallow copy
+    GLState& operator=(const GLState &) = delete;
+
+    // state of the context of the application
+    static GLState& Get()
+    {
+        static GLState state;
+        return state;
+    }
+
+    //////////////////////////////////////////
+    void UseProgram(GLuint program)
+    {
+        if (this->check(this->program, program))
+            glUseProgram(program);
+    }
+
+    void BindVertexArray(GLuint vao)
+    {
+        if (this->check(this->vao, vao))
+            glBindVertexArray(vao);
+    }
+
+    // GL_FRAMEBUFFER sets both the draw and the read framebuffer
+    void BindFramebuffer(GLenum target, GLuint fbo)
+    {
+        if (target == GL_FRAMEBUFFER)
+        {
+            if (this->drawFBO == fbo && this->readFBO == fbo)
+            {
+                this->stats.elided++;
+                return;
+            }
+            this->drawFBO = this->readFBO = fbo;
+            this->stats.issued++;
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        }
+        else if (this->check(target == GL_DRAW_FRAMEBUFFER ? this->drawFBO : this->readFBO, fbo))
+            glBindFramebuffer(target, fbo);
+    }
+
+    //////////////////////////////////////////
+    // it binds a texture to a unit, selecting the unit only when a binding is actually issued
+    void BindTexture(GLuint unit, GLenum target, GLuint texture)
+    {
+        int t = targetIndex(target);
+        if (unit >= (GLuint)MAX_TEXTURE_UNITS || t < 0)
+        {
+            this->activeTexture(unit);
+            this->stats.issued++;
+            glBindTexture(target, texture);
+            return;
+        }
+        if (this->textures[unit][t] == texture)
+        {
+            this->stats.elided++;
+            return;
+        }
+        this->activeTexture(unit);
+        this->textures[unit][t] = texture;
+        this->stats.issued++;
+        glBindTexture(target, texture);
+    }
+
+    //////////////////////////////////////////
+    // the draw buffers are part of the state of the framebuffer currently bound for drawing
+    void DrawBuffers(GLsizei n, const GLenum *buffers)
+    {
+        if (this->drawFBO != UNKNOWN)
+        {
+            vector<GLenum> &current = this->drawBuffers[this->drawFBO];
+            if (current.size() == (size_t)n && equal(current.begin(), current.end(), buffers))
+            {
+                this->stats.elided++;
+                return;
+            }
+            current.assign(buffers, buffers + n);
+        }
+        this->stats.issued++;
+        glDrawBuffers(n, buffers);
+    }
+
+    //////////////////////////////////////////
+    void Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        GLint viewport[4] = { x, y, width, height };
+        if (equal(viewport, viewport + 4, this->viewport))
+        {
+            this->stats.elided++;
+            return;
+        }
+        copy(viewport, viewport + 4, this->viewport);
+        this->stats.issued++;
+        glViewport(x, y, width, height);
+    }
+
+    void Enable(GLenum capability) { this->setCapability(capability, true); }
+    void Disable(GLenum capability) { this->setCapability(capability, false); }
+
+    //////////////////////////////////////////
+    // it discards all the tracked values (the OpenGL state has been changed outside the cache)
+    void Invalidate()
+    {
+        this->program = this->vao = this->drawFBO = this->readFBO = this->activeUnit = UNKNOWN;
+        for (int u = 0; u < MAX_TEXTURE_UNITS; u++)
+            for (int t = 0; t < TRACKED_TARGETS; t++)
+                this->textures[u][t] = UNKNOWN;
+        this->drawBuffers.clear();
+        this->capabilities.clear();
+        fill(this->viewport, this->viewport + 4, -1);
+    }
+
+    // objects deleted while bound: the binding reverts to 0
+    void ForgetProgram(GLuint program) { this->forget(this->program, program); }
+    void ForgetVertexArray(GLuint vao) { this->forget(this->vao, vao); }
+    void ForgetTexture(GLuint texture)
+    {
+        for (int u = 0; u < MAX_TEXTURE_UNITS; u++)
+            for (int t = 0; t < TRACKED_TARGETS; t++)
+                this->forget(this->textures[u][t], texture);
+    }
+    // the names of deleted framebuffers are reused, so their draw buffers are discarded too
+    void ForgetFramebuffer(GLuint fbo)
+    {
+        this->forget(this->drawFBO, fbo);
+        this->forget(this->readFBO, fbo);
+        this->drawBuffers.erase(fbo);
+    }
+
+    // counters since the last ResetStats() (called at the beginning of each frame)
+    GLStateStats& Stats() { return this->stats; }
+    void ResetStats() { this->stats = GLStateStats(); }
+
+private:
+    // value of a state not known by the cache
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;
+
+    GLuint program, vao, drawFBO, readFBO, activeUnit;
+    GLuint textures[MAX_TEXTURE_UNITS][TRACKED_TARGETS];
+    unordered_map<GLuint, vector<GLenum>> drawBuffers;
+    unordered_map<GLenum, bool> capabilities;
+    GLint viewport[4];
+    GLStateStats stats;
+
+    GLState()
+    {
+        this->Invalidate();
+    }
+
+    //////////////////////////////////////////
+    // it updates a tracked value, returning true if the change must be issued
+    bool check(GLuint &current, GLuint value)
+    {
+        if (current == value)
+        {
+            this->stats.elided++;
+            return false;
+        }
+        current = value;
+        this->stats.issued++;
+        return true;
+    }
+
+    void forget(GLuint &current, GLuint object)
+    {
+        if (current == object)
+            current = 0;
+    }
+
+    // the selection of the active unit is counted as a state change of its own
+    void activeTexture(GLuint unit)
+    {
+        if (this->check(this->activeUnit, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    void setCapability(GLenum capability, bool enabled)
+    {
+        unordered_map<GLenum, bool>::iterator it = this->capabilities.find(capability);
+        if (it != this->capabilities.end() && it->second == enabled)
+        {
+            this->stats.elided++;
+            return;
+        }
+        this->capabilities[capability] = enabled;
+        this->stats.issued++;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+
+    static int targetIndex(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_CUBE_MAP: return 1;
+        case GL_TEXTURE_2D_ARRAY: return 2;
+        case GL_TEXTURE_3D: return 3;
+        default: return -1;
+        }
+    }
+};
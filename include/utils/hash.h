@@ -0,0 +1,29 @@
+/*
+FNV-1a hash (http://www.isthe.com/chongo/tech/comp/fnv/), 64 bit version
+- used for the keys of the uniform table (utils/shader.h), of the program cache (utils/program_cache.h) and of the
+  mesh cache (utils/mesh_cache.h)
+- a hash can be continued over several buffers, passing the result of the previous call as seed
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+// Std. Includes
+#include <cstddef>
+#include <cstdint>
+
+// initial value of a new hash
+const uint64_t FNV1A_OFFSET_BASIS = 14695981039346656037ull;
+
+// hash of size bytes, continuing the hash given as seed
+inline uint64_t fnv1a(const void *data, size_t size, uint64_t seed = FNV1A_OFFSET_BASIS)
+{
+    const unsigned char *bytes = (const unsigned char*)data;
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
@@ -0,0 +1,125 @@
+/*
+HeadlessContext class
+- creation of an OpenGL context without any window or display connection, used for automated benchmarks
+
+On Linux the context is created through EGL on the Mesa surfaceless platform (EGL_MESA_platform_surfaceless),
+which works with both hardware drivers and the llvmpipe software rasterizer. Nothing is ever presented on screen:
+the application must render into its own framebuffer objects.
+On the other platforms Create() fails, and the application falls back to an invisible GLFW window.
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+#ifdef __linux__
+// we do not want eglplatform.h to drag in Xlib.h and its macros
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <iostream>
+
+/////////////////// HEADLESS CONTEXT class ///////////////////////
+class HeadlessContext
+{
+public:
+    HeadlessContext(const HeadlessContext& copy) = delete; //disallow copy
+    HeadlessContext& operator=(const HeadlessContext &) = delete;
+
+    HeadlessContext() {}
+
+    ~HeadlessContext()
+    {
+        this->Destroy();
+    }
+
+    //////////////////////////////////////////
+    // we create a Core Profile context of the requested version and we make it current on the calling thread
+    bool Create(int major, int minor)
+    {
+#ifdef __linux__
+        // the surfaceless platform does not need any X11/Wayland connection
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay)
+            this->display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (this->display == EGL_NO_DISPLAY)
+            this->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+        EGLint eglMajor, eglMinor;
+        if (this->display == EGL_NO_DISPLAY || !eglInitialize(this->display, &eglMajor, &eglMinor))
+        {
+            cout << "ERROR::HEADLESS:: unable to initialize EGL display" << endl;
+            return false;
+        }
+        eglBindAPI(EGL_OPENGL_API);
+
+        // we never create a surface, so the config is only used to select an OpenGL capable one (if any)
+        EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLConfig config = nullptr;
+        EGLint numConfigs = 0;
+        eglChooseConfig(this->display, configAttributes, &config, 1, &numConfigs);
+
+        EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, major,
+            EGL_CONTEXT_MINOR_VERSION, minor,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        this->context = eglCreateContext(this->display, numConfigs > 0 ? config : (EGLConfig)nullptr, EGL_NO_CONTEXT, contextAttributes);
+        if (this->context == EGL_NO_CONTEXT)
+        {
+            cout << "ERROR::HEADLESS:: unable to create an OpenGL " << major << "." << minor << " Core context (0x" << hex << eglGetError() << dec << ")" << endl;
+            return false;
+        }
+        if (!eglMakeCurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, this->context))
+        {
+            cout << "ERROR::HEADLESS:: unable to make the context current" << endl;
+            return false;
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    //////////////////////////////////////////
+    // loader function to be passed to GLAD
+    static void* GetProcAddress(const char* name)
+    {
+#ifdef __linux__
+        return (void*)eglGetProcAddress(name);
+#else
+        return nullptr;
+#endif
+    }
+
+    void Destroy()
+    {
+#ifdef __linux__
+        if (this->context != EGL_NO_CONTEXT)
+        {
+            eglMakeCurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroyContext(this->display, this->context);
+            this->context = EGL_NO_CONTEXT;
+        }
+        if (this->display != EGL_NO_DISPLAY)
+        {
+            eglTerminate(this->display);
+            this->display = EGL_NO_DISPLAY;
+        }
+#endif
+    }
+
+private:
+#ifdef __linux__
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+#endif
+};
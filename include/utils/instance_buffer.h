@@ -0,0 +1,145 @@
+/*
+InstanceBuffer class
+- vertex buffer of the model matrices of the instances drawn by Mesh::DrawInstanced (one mat4 per instance, read by
+  the vertex shaders as a per-instance attribute, see INSTANCE_MATRIX_LOCATION)
+- the matrices are written again at each frame: with OpenGL 4.4 (glBufferStorage), the buffer is persistently mapped
+  and split in REGIONS regions used in turn, each protected by a fence, so the CPU writes a region while the GPU reads
+  the previous ones, without any synchronization of the driver; on older contexts, the storage is orphaned and
+  updated with glBufferSubData
+- the storage grows (to the next power of two) when more instances are written
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <vector>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+/////////////////// INSTANCE BUFFER class ///////////////////////
+class InstanceBuffer
+{
+public:
+    // first of the 4 attribute locations of the model matrix of an instance (a mat4 uses one location per column)
+    static const GLuint INSTANCE_MATRIX_LOCATION = 7;
+    // regions of the persistently mapped buffer (the frames the CPU can be ahead of the GPU, plus one)
+    static const int REGIONS = 3;
+
+    InstanceBuffer(const InstanceBuffer& copy) = delete; //disallow copy
+    InstanceBuffer& operator=(const InstanceBuffer &) = delete;
+
+    // the OpenGL objects are created by the first Update
+    InstanceBuffer() {}
+
+    // (after Delete, no OpenGL call is made, so the buffer can be destroyed after the context)
+    ~InstanceBuffer()
+    {
+        this->release();
+    }
+
+    //////////////////////////////////////////
+    // it writes the model matrices of the instances to draw (the offsets of the previous Update are no longer valid)
+    void Update(const glm::mat4 *matrices, size_t count)
+    {
+        if (count > this->capacity)
+        {
+            this->release();
+            this->capacity = 1;
+            while (this->capacity < count)
+                this->capacity *= 2;
+            this->create();
+        }
+        this->count = count;
+        size_t bytes = count * sizeof(glm::mat4);
+        glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+        if (this->mapping)
+        {
+            // the draws of the current region are issued: its fence is set, and we move to the next region, waiting
+            // for the GPU to finish reading it
+            this->fences[this->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            this->region = (this->region + 1) % REGIONS;
+            if (this->fences[this->region])
+            {
+                while (glClientWaitSync(this->fences[this->region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+                    ;
+                glDeleteSync(this->fences[this->region]);
+                this->fences[this->region] = 0;
+            }
+            this->offset = this->region * this->capacity * sizeof(glm::mat4);
+            memcpy(this->mapping + this->offset, matrices, bytes);
+        }
+        else
+        {
+            // the orphaned storage is replaced by the driver, so the previous draws keep reading the old one
+            glBufferData(GL_ARRAY_BUFFER, this->capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, matrices);
+            this->offset = 0;
+        }
+    }
+
+    GLuint Buffer() const { return this->buffer; }
+    // byte offset in the buffer of the matrix of the first instance written by the last Update
+    size_t Offset() const { return this->offset; }
+    size_t Count() const { return this->count; }
+    bool Persistent() const { return this->mapping != nullptr; }
+
+    // it releases the OpenGL objects, while the context is current (a following Update creates them again)
+    void Delete()
+    {
+        this->release();
+        this->capacity = 0;
+        this->count = 0;
+        this->offset = 0;
+    }
+
+private:
+    GLuint buffer = 0;
+    size_t capacity = 0, count = 0, offset = 0;
+    // persistent mapping (nullptr without glBufferStorage)
+    unsigned char *mapping = nullptr;
+    int region = 0;
+    GLsync fences[REGIONS] = {};
+
+    void create()
+    {
+        glGenBuffers(1, &this->buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+        // the context may have a higher version than the requested one
+        if (GLAD_GL_VERSION_4_4)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            GLsizeiptr size = REGIONS * this->capacity * sizeof(glm::mat4);
+            glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+            this->mapping = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+        }
+        else
+            glBufferData(GL_ARRAY_BUFFER, this->capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    }
+
+    void release()
+    {
+        for (GLsync &fence : this->fences)
+        {
+            if (fence)
+                glDeleteSync(fence);
+            fence = 0;
+        }
+        if (this->mapping)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            this->mapping = nullptr;
+        }
+        if (this->buffer)
+            glDeleteBuffers(1, &this->buffer);
+        this->buffer = 0;
+        this->region = 0;
+    }
+};
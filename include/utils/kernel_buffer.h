@@ -0,0 +1,101 @@
+/*
+KernelBuffer class
+- Uniform Buffer Object holding the SSAO sample kernel, shared by all the AO programs
+
+The shaders declare the kernel in a std140 uniform block:
+    layout (std140) uniform SampleKernel {
+        vec3 kernel[256];
+    };
+With std140 each vec3 element of the array is aligned to 16 bytes, so the samples are uploaded as vec4.
+The buffer is uploaded only after Invalidate() has been called (i.e. when the samples are regenerated),
+instead of setting the kernel array of every program at each frame.
+
+N.B.) OpenGL 4.1 does not support layout(binding) for uniform blocks, so each program must be attached with AttachProgram().
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+/////////////////// KERNEL BUFFER class ///////////////////////
+class KernelBuffer
+{
+public:
+    // binding point of the uniform block, and maximum number of samples (size of the array in the shaders)
+    static const GLuint BINDING = 0;
+    static const int MAX_SAMPLES = 256;
+
+    KernelBuffer(const KernelBuffer& copy) = delete; //disallow copy
+    KernelBuffer& operator=(const KernelBuffer &) = delete;
+
+    KernelBuffer() {}
+
+    //////////////////////////////////////////
+    // it creates the buffer (the whole array is allocated) and it binds it to its binding point
+    void Create()
+    {
+        glGenBuffers(1, &this->UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, this->UBO);
+        glBufferData(GL_UNIFORM_BUFFER, MAX_SAMPLES * sizeof(glm::vec4), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, this->UBO);
+        this->dirty = true;
+    }
+
+    //////////////////////////////////////////
+    // it connects the SampleKernel block of a program to the buffer (programs without the block are ignored)
+    void AttachProgram(GLuint program) const
+    {
+        GLuint blockIndex = glGetUniformBlockIndex(program, "SampleKernel");
+        if (blockIndex != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, blockIndex, BINDING);
+    }
+
+    // the samples have been regenerated: the next Update() will upload them
+    void Invalidate() { this->dirty = true; }
+
+    //////////////////////////////////////////
+    // it uploads the samples, if they changed since the last upload. It returns true if an upload happened
+    bool Update(const vector<glm::vec3> &kernel)
+    {
+        if (!this->dirty)
+            return false;
+        size_t count = min(kernel.size(), (size_t)MAX_SAMPLES);
+        this->padded.resize(count);
+        for (size_t i = 0; i < count; i++)
+            this->padded[i] = glm::vec4(kernel[i], 0.0f);
+        glBindBuffer(GL_UNIFORM_BUFFER, this->UBO);
+        if (count > 0)
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, count * sizeof(glm::vec4), this->padded.data());
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        this->dirty = false;
+        this->uploads++;
+        return true;
+    }
+
+    // number of uploads since the creation of the buffer
+    unsigned int Uploads() const { return this->uploads; }
+
+    void Delete()
+    {
+        if (this->UBO)
+            glDeleteBuffers(1, &this->UBO);
+        this->UBO = 0;
+    }
+
+private:
+    GLuint UBO = 0;
+    bool dirty = true;
+    unsigned int uploads = 0;
+    vector<glm::vec4> padded;
+};
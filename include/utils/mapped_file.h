@@ -0,0 +1,131 @@
+/*
+MappedFile class
+- read-only memory mapping of a whole file (mmap on POSIX systems, file mapping objects on Windows)
+
+The content is paged in on demand by the operating system, so the data can be handed to the GPU or to the
+CPU code directly from the mapping, without intermediate copies.
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+#ifdef _WIN32
+// we keep windows.h out of the headers of the application (see the check after the GLAD include in main.cpp)
+extern "C" {
+    __declspec(dllimport) void* __stdcall CreateFileA(const char*, unsigned long, unsigned long, void*, unsigned long, unsigned long, void*);
+    __declspec(dllimport) int __stdcall GetFileSizeEx(void*, long long*);
+    __declspec(dllimport) void* __stdcall CreateFileMappingA(void*, void*, unsigned long, unsigned long, unsigned long, const char*);
+    __declspec(dllimport) void* __stdcall MapViewOfFile(void*, unsigned long, unsigned long, unsigned long, size_t);
+    __declspec(dllimport) int __stdcall UnmapViewOfFile(const void*);
+    __declspec(dllimport) int __stdcall CloseHandle(void*);
+}
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/////////////////// MAPPED FILE class ///////////////////////
+class MappedFile
+{
+public:
+    MappedFile(const MappedFile& copy) = delete; //disallow copy
+    MappedFile& operator=(const MappedFile &) = delete;
+
+    MappedFile() {}
+
+    ~MappedFile()
+    {
+        this->Close();
+    }
+
+    //////////////////////////////////////////
+    // it maps the whole file in memory (read only)
+    bool Open(const string &path)
+    {
+        this->Close();
+#ifdef _WIN32
+        const unsigned long GENERIC_READ_ACCESS = 0x80000000ul, SHARE_READ = 0x1, OPEN_EXISTING_FILE = 3, NORMAL_ATTRIBUTE = 0x80;
+        const unsigned long PAGE_READ = 0x02, MAP_READ = 0x4;
+        void *invalidHandle = (void*)(intptr_t)-1;
+        this->file = CreateFileA(path.c_str(), GENERIC_READ_ACCESS, SHARE_READ, nullptr, OPEN_EXISTING_FILE, NORMAL_ATTRIBUTE, nullptr);
+        long long size = 0;
+        if (this->file == invalidHandle || !GetFileSizeEx(this->file, &size) || size == 0)
+        {
+            if (this->file == invalidHandle)
+                this->file = nullptr;
+            cout << "ERROR::MAPPED_FILE:: unable to open " << path << endl;
+            this->Close();
+            return false;
+        }
+        this->mapping = CreateFileMappingA(this->file, nullptr, PAGE_READ, 0, 0, nullptr);
+        this->data = this->mapping ? (const unsigned char*)MapViewOfFile(this->mapping, MAP_READ, 0, 0, 0) : nullptr;
+        this->size = (size_t)size;
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            if (fd >= 0)
+                close(fd);
+            cout << "ERROR::MAPPED_FILE:: unable to open " << path << endl;
+            return false;
+        }
+        void *address = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping stays valid after the descriptor is closed
+        close(fd);
+        this->data = address != MAP_FAILED ? (const unsigned char*)address : nullptr;
+        this->size = (size_t)info.st_size;
+#endif
+        if (!this->data)
+        {
+            cout << "ERROR::MAPPED_FILE:: unable to map " << path << endl;
+            this->Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (this->data)
+            UnmapViewOfFile(this->data);
+        if (this->mapping)
+            CloseHandle(this->mapping);
+        if (this->file)
+            CloseHandle(this->file);
+        this->mapping = nullptr;
+        this->file = nullptr;
+#else
+        if (this->data)
+            munmap((void*)this->data, this->size);
+#endif
+        this->data = nullptr;
+        this->size = 0;
+    }
+
+    bool IsOpen() const { return this->data != nullptr; }
+    const unsigned char* Data() const { return this->data; }
+    size_t Size() const { return this->size; }
+
+private:
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mapping = nullptr;
+#endif
+};
@@ -6,6 +6,9 @@ VBO : Vertex Buffer Object - memory allocated on GPU memory to store the mesh da
 EBO : Element Buffer Object - a buffer maintaining the indices of vertices composing the mesh faces
 VAO : Vertex Array Object - a buffer that helps to "manage" VBO and its inner structure. It stores pointers to the different vertex attributes stored in the VBO. When we need to render an object, we can just bind the corresponding VAO, and all the needed calls to set up the binding between vertex attributes and memory positions in the VBO are automatically configured.
 See https://learnopengl.com/#!Getting-started/Hello-Triangle for details.
+- the format of the buffers (quantized positions and normals, tangent frames, 16 bit indices, separate stream of the
+  positions) is set by the vertex layout of utils/vertex_layout.h: the Vertex arrays are converted by Encode (on the
+  CPU, e.g. by a worker thread, see the Model class), and the converted arrays are copied as they are in the buffers
 
 N.B. 1)
 Model and Mesh classes follow RAII principles (https://en.cppreference.com/w/cpp/language/raii).
@@ -30,6 +33,12 @@ using namespace std;
 
 // Std. Includes
 #include <vector>
+#include <cstring>
+#include <cstdint>
+
+#include <utils/gl_state.h>
+#include <utils/vertex_layout.h>
+#include <utils/instance_buffer.h>
 
 // data structure for vertices
 struct Vertex {
@@ -45,10 +54,55 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+// level of detail of a mesh: a range of its index array, and its error in model units (see utils/mesh_simplifier.h)
+struct MeshLOD {
+    uint32_t firstIndex;
+    uint32_t numIndices;
+    float error;
+};
+
+// properties of a mesh computed by the conversion to the vertex layout (saved in the mesh cache with its arrays)
+struct MeshInfo {
+    // size in bytes of an index (2 or 4)
+    uint32_t indexSize;
+    // scale and bias of the quantized positions (see utils/vertex_layout.h)
+    glm::vec3 positionScale, positionBias;
+    // bounding sphere and bounding box, in model coordinates
+    glm::vec3 boundingCenter;
+    float boundingRadius;
+    glm::vec3 boundingMinimum, boundingMaximum;
+};
+
+// arrays of a mesh converted to the vertex layout (see Mesh::Encode)
+struct EncodedMesh {
+    // positions (empty if they are interleaved with the other attributes), other attributes, indices
+    vector<unsigned char> positions, attributes, indices;
+    MeshInfo info;
+};
+
+// arrays of a mesh prepared on the CPU (e.g., by a worker thread) in the format of the vertex layout, before the
+// creation of its GPU buffers: the arrays of an EncodedMesh, or of the mesh cache
+// the index array contains all the levels of detail of the mesh (if there is no LOD table, all the indices are the
+// full resolution level)
+// N.B.) the arrays are not owned by the structure (see the Model class)
+struct MeshData {
+    const unsigned char *positions;
+    size_t positionBytes;
+    const unsigned char *attributes;
+    size_t attributeBytes;
+    const void *indices;
+    size_t numIndices;
+    const MeshLOD *lods;
+    size_t numLODs;
+    MeshInfo info;
+};
+
 /////////////////// MESH class ///////////////////////
 class Mesh {
 public:
     // data structures for vertices, and indices of vertices (for faces)
+    // N.B.) they are empty for the meshes created from prepared arrays (MeshData), and they are released after the
+    // upload if the vertex layout does not keep the CPU data
     vector<Vertex> vertices;
     vector<GLuint> indices;
     // VAO
@@ -67,10 +121,67 @@ public:
     // Constructor
     // We use initializer list and std::move in order to avoid a copy of the arguments
     // This constructor empties the source vectors (vertices and indices)
-    Mesh(vector<Vertex>& vertices, vector<GLuint>& indices) noexcept
+    Mesh(vector<Vertex>& vertices, vector<GLuint>& indices, const VertexLayout &layout = VertexLayout::Get()) noexcept
         : vertices(std::move(vertices)), indices(std::move(indices))
     {
-        this->setupMesh();
+        this->lods.push_back({ 0, (uint32_t)this->indices.size(), 0.0f });
+        EncodedMesh encoded;
+        Encode(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size(), layout, encoded);
+        this->setupMesh(Prepared(encoded, nullptr, 0), layout);
+        if (!layout.keepCPUData)
+        {
+            vector<Vertex>().swap(this->vertices);
+            vector<GLuint>().swap(this->indices);
+        }
+    }
+
+    // Constructor from prepared arrays, already in the format of the vertex layout: they are copied in the GPU buffers
+    Mesh(const MeshData &data, const VertexLayout &layout = VertexLayout::Get()) noexcept
+    {
+        if (data.numLODs > 0)
+            this->lods.assign(data.lods, data.lods + data.numLODs);
+        else
+            this->lods.push_back({ 0, (uint32_t)data.numIndices, 0.0f });
+        this->setupMesh(data, layout);
+    }
+
+    //////////////////////////////////////////
+    // conversion of the Vertex and index arrays of a mesh to the vertex layout (it does not call OpenGL, so it can run
+    // on a worker thread)
+    static void Encode(const Vertex *vertices, size_t numVertices, const GLuint *indices, size_t numIndices,
+                       const VertexLayout &layout, EncodedMesh &mesh)
+    {
+        computeBounds(vertices, numVertices, mesh.info);
+        encodePositions(vertices, numVertices, layout, mesh.positions, mesh.info);
+        encodeAttributes(vertices, numVertices, layout, mesh.attributes);
+        if (layout.shortIndices && numVertices <= 65536)
+        {
+            mesh.info.indexSize = sizeof(uint16_t);
+            mesh.indices.resize(numIndices * sizeof(uint16_t));
+            uint16_t *shortIndices = (uint16_t*)mesh.indices.data();
+            for (size_t i = 0; i < numIndices; i++)
+                shortIndices[i] = (uint16_t)indices[i];
+        }
+        else
+        {
+            mesh.info.indexSize = sizeof(GLuint);
+            mesh.indices.resize(numIndices * sizeof(GLuint));
+            if (numIndices > 0)
+                memcpy(mesh.indices.data(), indices, numIndices * sizeof(GLuint));
+        }
+        // without a separate stream, the VBO contains the interleaved positions and attributes
+        if (!layout.splitPositions)
+        {
+            mesh.attributes = interleave(mesh.positions, layout.PositionSize(), mesh.attributes, layout.AttributesSize(), numVertices);
+            vector<unsigned char>().swap(mesh.positions);
+        }
+    }
+
+    // prepared arrays of an encoded mesh, with its LOD table
+    static MeshData Prepared(const EncodedMesh &mesh, const MeshLOD *lods, size_t numLODs)
+    {
+        return { mesh.positions.data(), mesh.positions.size(), mesh.attributes.data(), mesh.attributes.size(),
+                 mesh.indices.data(), mesh.indices.size() / mesh.info.indexSize, lods, numLODs, mesh.info };
     }
 
     // We implement a user-defined move constructor and move assignment
@@ -88,7 +199,10 @@ public:
     Mesh(Mesh&& move) noexcept
         // Calls move for both vectors, which internally consists of a simple pointer swap between the new instance and the source one.
         : vertices(std::move(move.vertices)), indices(std::move(move.indices)),
-        VAO(move.VAO), VBO(move.VBO), EBO(move.EBO)
+        VAO(move.VAO), VBO(move.VBO), positionVBO(move.positionVBO), EBO(move.EBO), positionVAO(move.positionVAO),
+        indexType(move.indexType), lods(std::move(move.lods)), positionScale(move.positionScale),
+        positionBias(move.positionBias), boundingCenter(move.boundingCenter), boundingRadius(move.boundingRadius),
+        boundingMinimum(move.boundingMinimum), boundingMaximum(move.boundingMaximum), gpuBytes(move.gpuBytes)
     {
         move.VAO = 0; // We *could* set VBO and EBO to 0 too,
         // but since we bring all the 3 values around we can use just one of them to check ownership of the 3 resources.
@@ -105,8 +219,19 @@ public:
             vertices = std::move(move.vertices);
             indices = std::move(move.indices);
             VAO = move.VAO;
+            positionVAO = move.positionVAO;
             VBO = move.VBO;
+            positionVBO = move.positionVBO;
             EBO = move.EBO;
+            indexType = move.indexType;
+            lods = std::move(move.lods);
+            positionScale = move.positionScale;
+            positionBias = move.positionBias;
+            boundingCenter = move.boundingCenter;
+            boundingRadius = move.boundingRadius;
+            boundingMinimum = move.boundingMinimum;
+            boundingMaximum = move.boundingMaximum;
+            gpuBytes = move.gpuBytes;
 
             move.VAO = 0;
         }
@@ -126,21 +251,108 @@ public:
 
     //////////////////////////////////////////
 
-    // rendering of mesh
-    void Draw()
+    // rendering of mesh (level of detail 0 is the full resolution one)
+    // it returns the number of triangles drawn
+    GLsizei Draw(int lod = 0)
     {
-        // VAO is made "active"
-        glBindVertexArray(this->VAO);
-        // rendering of data in the VAO
-        glDrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0);
-        // VAO is "detached"
-        glBindVertexArray(0);
+        return this->draw(this->VAO, lod);
+    }
+
+    // rendering of the positions only (e.g., for the skybox): with a separate stream of the positions, the other
+    // attributes are not fetched
+    GLsizei DrawPositions(int lod = 0)
+    {
+        return this->draw(this->positionVAO ? this->positionVAO : this->VAO, lod);
+    }
+
+    // instanced rendering of mesh: count instances, starting from the first one, with the model matrices written in
+    // the instance buffer (the vertex shader must read them, see InstanceBuffer). It returns the number of triangles drawn
+    GLsizei DrawInstanced(const InstanceBuffer &instances, size_t first, size_t count, int lod = 0)
+    {
+        if (count == 0)
+            return 0;
+        const MeshLOD &range = this->lods[lod];
+        GLState::Get().BindVertexArray(this->VAO);
+        // the per-instance attributes of the VAO point to the matrices (without glDrawElementsInstancedBaseInstance,
+        // the first instance is set by the offset of the attributes)
+        glBindBuffer(GL_ARRAY_BUFFER, instances.Buffer());
+        size_t offset = instances.Offset() + first * sizeof(glm::mat4);
+        for (GLuint column = 0; column < 4; column++)
+        {
+            GLuint location = InstanceBuffer::INSTANCE_MATRIX_LOCATION + column;
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (GLvoid*)(offset + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(location, 1);
+        }
+        glVertexAttrib3fv(VertexLayout::POSITION_SCALE_LOCATION, &this->positionScale[0]);
+        glVertexAttrib3fv(VertexLayout::POSITION_BIAS_LOCATION, &this->positionBias[0]);
+        size_t indexSize = this->indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(GLuint);
+        glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)range.numIndices, this->indexType, (GLvoid*)(range.firstIndex * indexSize), (GLsizei)count);
+        return (GLsizei)(range.numIndices / 3 * count);
+    }
+
+    // coarsest level of detail whose error, projected on the screen, is at most maxPixelError
+    // - modelViewMatrix: transformation of the mesh to view coordinates
+    // - pixelsPerUnit: size in pixels of a unit at distance 1 from the camera (projection[1][1] * height / 2)
+    // The distance is the one of the nearest point of the bounding sphere, so the error is never underestimated
+    // (the full resolution level is used when the camera is inside the sphere)
+    int SelectLOD(const glm::mat4 &modelViewMatrix, float pixelsPerUnit, float maxPixelError) const
+    {
+        if (this->lods.size() < 2 || maxPixelError <= 0.0f)
+            return 0;
+        glm::vec3 center = glm::vec3(modelViewMatrix * glm::vec4(this->boundingCenter, 1.0f));
+        float scale = glm::max(glm::length(glm::vec3(modelViewMatrix[0])),
+                               glm::max(glm::length(glm::vec3(modelViewMatrix[1])), glm::length(glm::vec3(modelViewMatrix[2]))));
+        float distance = glm::length(center) - this->boundingRadius * scale;
+        if (distance <= 0.0f)
+            return 0;
+        int lod = 0;
+        while (lod + 1 < (int)this->lods.size() && this->lods[lod + 1].error * scale * pixelsPerUnit / distance <= maxPixelError)
+            lod++;
+        return lod;
     }
 
+    // bounding box, in model coordinates
+    const glm::vec3& BoundsMinimum() const { return this->boundingMinimum; }
+    const glm::vec3& BoundsMaximum() const { return this->boundingMaximum; }
+
+    int NumLODs() const { return (int)this->lods.size(); }
+    const MeshLOD& LOD(int lod) const { return this->lods[lod]; }
+
+    // size of the vertex and index buffers
+    size_t GPUBytes() const { return this->gpuBytes; }
+
 private:
 
-    // VBO and EBO
-    GLuint VBO, EBO;
+    // VBO and EBO (positionVBO is 0 if the positions are interleaved with the other attributes in the VBO)
+    GLuint VBO, positionVBO = 0, EBO;
+    // VAO with only the positions enabled (0 if the positions are not in a separate stream)
+    GLuint positionVAO = 0;
+    // type of the indices in the EBO, and ranges of its levels of detail
+    GLenum indexType = GL_UNSIGNED_INT;
+    vector<MeshLOD> lods;
+    // scale and bias of the quantized positions (see utils/vertex_layout.h)
+    glm::vec3 positionScale = glm::vec3(1.0f), positionBias = glm::vec3(0.0f);
+    // bounding sphere and bounding box, in model coordinates
+    glm::vec3 boundingCenter = glm::vec3(0.0f);
+    float boundingRadius = 0.0f;
+    glm::vec3 boundingMinimum = glm::vec3(0.0f), boundingMaximum = glm::vec3(0.0f);
+    size_t gpuBytes = 0;
+
+    GLsizei draw(GLuint vao, int lod)
+    {
+        const MeshLOD &range = this->lods[lod];
+        // VAO is made "active" (the binding is skipped if it is already active, e.g. when the same mesh is drawn again)
+        GLState::Get().BindVertexArray(vao);
+        // the scale and bias of the positions are the current values of generic attributes (not stored in the VAO)
+        glVertexAttrib3fv(VertexLayout::POSITION_SCALE_LOCATION, &this->positionScale[0]);
+        glVertexAttrib3fv(VertexLayout::POSITION_BIAS_LOCATION, &this->positionBias[0]);
+        // rendering of data in the VAO
+        size_t indexSize = this->indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(GLuint);
+        glDrawElements(GL_TRIANGLES, (GLsizei)range.numIndices, this->indexType, (GLvoid*)(range.firstIndex * indexSize));
+        // the VAO is left bound: the next draw call binds its own VAO through the state cache
+        return (GLsizei)(range.numIndices / 3);
+    }
 
     //////////////////////////////////////////
     // buffer objects\arrays are initialized
@@ -148,41 +360,212 @@ private:
     // https://learnopengl.com/#!Getting-started/Hello-Triangle
     // (in different parts of the page), or here:
     // http://www.informit.com/articles/article.aspx?p=1377833&seqNum=8
-    void setupMesh()
+    // (the arrays are already in the format of the layout, see Encode)
+    void setupMesh(const MeshData &data, const VertexLayout &layout)
     {
+        this->indexType = data.info.indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        this->positionScale = data.info.positionScale;
+        this->positionBias = data.info.positionBias;
+        this->boundingCenter = data.info.boundingCenter;
+        this->boundingRadius = data.info.boundingRadius;
+        this->boundingMinimum = data.info.boundingMinimum;
+        this->boundingMaximum = data.info.boundingMaximum;
+        this->gpuBytes = data.positionBytes + data.attributeBytes + data.numIndices * data.info.indexSize;
+
         // we create the buffers
         glGenVertexArrays(1, &this->VAO);
         glGenBuffers(1, &this->VBO);
         glGenBuffers(1, &this->EBO);
 
         // VAO is made "active"
-        glBindVertexArray(this->VAO);
+        GLState::Get().BindVertexArray(this->VAO);
         // we copy data in the VBO - we must set the data dimension, and the pointer to the structure cointaining the data
         glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-        glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(Vertex), &this->vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, data.attributeBytes, data.attributes, GL_STATIC_DRAW);
         // we copy data in the EBO - we must set the data dimension, and the pointer to the structure cointaining the data
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(GLuint), &this->indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.numIndices * data.info.indexSize, data.indices, GL_STATIC_DRAW);
 
         // we set in the VAO the pointers to the different vertex attributes (with the relative offsets inside the data structure)
-        // vertex positions
         // these will be the positions to use in the layout qualifiers in the shaders ("layout (location = ...)"")
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
+        GLsizei stride = (GLsizei)(layout.splitPositions ? layout.AttributesSize() : layout.VertexSize());
+        size_t offset = layout.splitPositions ? 0 : layout.PositionSize();
         // Normals
         glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Normal));
-        // Texture Coordinates
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, TexCoords));
-        // Tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Tangent));
-        // Bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Bitangent));
+        if (layout.octahedralNormals)
+            glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (GLvoid*)offset);
+        else
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
+        offset += layout.octahedralNormals ? 2 * sizeof(int16_t) : 3 * sizeof(float);
+        if (layout.tangentFrame == VertexLayout::TANGENT_FLOAT)
+        {
+            // Texture Coordinates
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
+            // Tangent
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(offset + 2 * sizeof(float)));
+            // Bitangent
+            glEnableVertexAttribArray(4);
+            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(offset + 5 * sizeof(float)));
+        }
+        else if (layout.tangentFrame == VertexLayout::TANGENT_PACKED)
+        {
+            // Texture Coordinates (half floats)
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (GLvoid*)offset);
+            // Tangent (octahedral) and sign of the Bitangent
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 4, GL_SHORT, GL_TRUE, stride, (GLvoid*)(offset + 2 * sizeof(uint16_t)));
+        }
+
+        // vertex positions
+        if (layout.splitPositions)
+        {
+            glGenBuffers(1, &this->positionVBO);
+            glBindBuffer(GL_ARRAY_BUFFER, this->positionVBO);
+            glBufferData(GL_ARRAY_BUFFER, data.positionBytes, data.positions, GL_STATIC_DRAW);
+            stride = (GLsizei)layout.PositionSize();
+        }
+        setupPositions(layout, stride);
+
+        // the VAO of the positions shares the buffers of the VAO of the mesh
+        if (layout.splitPositions)
+        {
+            glGenVertexArrays(1, &this->positionVAO);
+            GLState::Get().BindVertexArray(this->positionVAO);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
+            setupPositions(layout, stride);
+        }
+    }
+
+    // position attribute of the VAO, from the buffer bound to GL_ARRAY_BUFFER (at the start of each vertex)
+    static void setupPositions(const VertexLayout &layout, GLsizei stride)
+    {
+        glEnableVertexAttribArray(0);
+        if (layout.positions == VertexLayout::POSITION_FLOAT)
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+        else if (layout.positions == VertexLayout::POSITION_HALF)
+            glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+        else
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (GLvoid*)0);
+    }
 
-        glBindVertexArray(0);
+    // bounding box of the positions, and bounding sphere centered in its center
+    static void computeBounds(const Vertex *vertices, size_t numVertices, MeshInfo &info)
+    {
+        info.boundingMinimum = info.boundingMaximum = info.boundingCenter = glm::vec3(0.0f);
+        info.boundingRadius = 0.0f;
+        if (numVertices == 0)
+            return;
+        glm::vec3 minimum = vertices[0].Position, maximum = vertices[0].Position;
+        for (size_t i = 1; i < numVertices; i++)
+        {
+            minimum = glm::min(minimum, vertices[i].Position);
+            maximum = glm::max(maximum, vertices[i].Position);
+        }
+        info.boundingMinimum = minimum;
+        info.boundingMaximum = maximum;
+        info.boundingCenter = (minimum + maximum) * 0.5f;
+        for (size_t i = 0; i < numVertices; i++)
+            info.boundingRadius = glm::max(info.boundingRadius, glm::length(vertices[i].Position - info.boundingCenter));
+    }
+
+    //////////////////////////////////////////
+    // conversion of the positions; the normalized positions are quantized in the bounding box of the mesh, whose
+    // minimum and size become the bias and scale given to the vertex shader
+    static void encodePositions(const Vertex *vertices, size_t numVertices, const VertexLayout &layout, vector<unsigned char> &data, MeshInfo &info)
+    {
+        data.resize(numVertices * layout.PositionSize());
+        info.positionScale = glm::vec3(1.0f);
+        info.positionBias = glm::vec3(0.0f);
+        if (layout.positions == VertexLayout::POSITION_FLOAT)
+        {
+            for (size_t i = 0; i < numVertices; i++)
+                memcpy(&data[i * layout.PositionSize()], &vertices[i].Position, 3 * sizeof(float));
+            return;
+        }
+        if (layout.positions == VertexLayout::POSITION_UNORM16 && numVertices > 0)
+        {
+            glm::vec3 minimum = vertices[0].Position, maximum = vertices[0].Position;
+            for (size_t i = 1; i < numVertices; i++)
+            {
+                minimum = glm::min(minimum, vertices[i].Position);
+                maximum = glm::max(maximum, vertices[i].Position);
+            }
+            info.positionBias = minimum;
+            info.positionScale = maximum - minimum;
+        }
+        uint16_t *packed = (uint16_t*)data.data();
+        for (size_t i = 0; i < numVertices; i++, packed += 4)
+        {
+            glm::vec3 position = vertices[i].Position;
+            for (int c = 0; c < 3; c++)
+            {
+                if (layout.positions == VertexLayout::POSITION_HALF)
+                    packed[c] = glm::packHalf1x16(position[c]);
+                else
+                    packed[c] = glm::packUnorm1x16(info.positionScale[c] > 0.0f ? (position[c] - info.positionBias[c]) / info.positionScale[c] : 0.0f);
+            }
+            packed[3] = 0;
+        }
+    }
+
+    // conversion of the normals and of the tangent frames
+    static void encodeAttributes(const Vertex *vertices, size_t numVertices, const VertexLayout &layout, vector<unsigned char> &data)
+    {
+        data.resize(numVertices * layout.AttributesSize());
+        unsigned char *vertex = data.data();
+        for (size_t i = 0; i < numVertices; i++)
+        {
+            if (layout.octahedralNormals)
+                vertex = packOctahedral(vertex, vertices[i].Normal);
+            else
+                vertex = copy(vertex, &vertices[i].Normal, 3 * sizeof(float));
+            if (layout.tangentFrame == VertexLayout::TANGENT_FLOAT)
+            {
+                vertex = copy(vertex, &vertices[i].TexCoords, 2 * sizeof(float));
+                vertex = copy(vertex, &vertices[i].Tangent, 3 * sizeof(float));
+                vertex = copy(vertex, &vertices[i].Bitangent, 3 * sizeof(float));
+            }
+            else if (layout.tangentFrame == VertexLayout::TANGENT_PACKED)
+            {
+                uint32_t texCoords = glm::packHalf2x16(vertices[i].TexCoords);
+                vertex = copy(vertex, &texCoords, sizeof(texCoords));
+                vertex = packOctahedral(vertex, vertices[i].Tangent);
+                // sign of the bitangent, with respect to cross(normal, tangent)
+                float sign = glm::dot(glm::cross(vertices[i].Normal, vertices[i].Tangent), vertices[i].Bitangent) < 0.0f ? -1.0f : 1.0f;
+                int16_t frame[2] = { (int16_t)glm::packSnorm1x16(sign), 0 };
+                vertex = copy(vertex, frame, sizeof(frame));
+            }
+        }
+    }
+
+    static unsigned char* copy(unsigned char *destination, const void *source, size_t size)
+    {
+        memcpy(destination, source, size);
+        return destination + size;
+    }
+
+    static unsigned char* packOctahedral(unsigned char *destination, const glm::vec3 &vector)
+    {
+        glm::vec2 encoded = VertexLayout::OctEncode(vector);
+        uint16_t packed[2] = { glm::packSnorm1x16(encoded.x), glm::packSnorm1x16(encoded.y) };
+        return copy(destination, packed, sizeof(packed));
+    }
+
+    // a single interleaved array, from the arrays of the positions and of the other attributes
+    static vector<unsigned char> interleave(const vector<unsigned char> &positions, size_t positionSize,
+                                            const vector<unsigned char> &attributes, size_t attributesSize, size_t numVertices)
+    {
+        vector<unsigned char> data(numVertices * (positionSize + attributesSize));
+        unsigned char *vertex = data.data();
+        for (size_t i = 0; i < numVertices; i++)
+        {
+            vertex = copy(vertex, &positions[i * positionSize], positionSize);
+            vertex = copy(vertex, &attributes[i * attributesSize], attributesSize);
+        }
+        return data;
     }
 
     //////////////////////////////////////////
@@ -193,9 +576,16 @@ private:
         // so there's no need for deleting.
         if (VAO)
         {
+            GLState::Get().ForgetVertexArray(this->VAO);
             glDeleteVertexArrays(1, &this->VAO);
             glDeleteBuffers(1, &this->VBO);
             glDeleteBuffers(1, &this->EBO);
+            if (this->positionVAO)
+            {
+                GLState::Get().ForgetVertexArray(this->positionVAO);
+                glDeleteVertexArrays(1, &this->positionVAO);
+                glDeleteBuffers(1, &this->positionVBO);
+            }
         }
     }
 };
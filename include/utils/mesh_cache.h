@@ -0,0 +1,239 @@
+/*
+MeshCache class
+- on-disk cache of the meshes imported by Assimp: the arrays of all the meshes of a model, converted to the vertex
+  layout (see Mesh::Encode), and their tables of the levels of detail are saved in a binary file, which is memory
+  mapped (utils/mapped_file.h) at the next loads
+- the key of a model is the hash of the content of its source file, of the Assimp import flags, of the version of
+  the mesh optimization (utils/mesh_optimizer.h) and of the LOD generation (utils/mesh_simplifier.h), of the vertex
+  layout (utils/vertex_layout.h), and of the format version (which includes the size of the Vertex structure), so an
+  edited model, a change of the import post-processing or of the layout never loads stale data
+
+File layout (all the sections are 16 bytes aligned; the arrays are in the format of the vertex layout, so they are
+handed to glBufferData directly from the mapping, without any conversion):
+    header: magic, format version, key, number of meshes
+    for each mesh: size in bytes of the positions and of the other attributes, number of indices (of all the levels
+    of detail) and of levels of detail, and the MeshInfo of the conversion (index size, position scale and bias, bounds)
+    for each mesh: the positions (empty if interleaved), the attributes, the index array, then the LOD table
+
+The cache is shared by all the models of the application, accessed with MeshCache::Get(). Key, Map and Store can be
+called concurrently by the workers preparing different models (see utils/asset_loader.h).
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include <utils/hash.h>
+#include <utils/mapped_file.h>
+#include <utils/mesh.h>
+
+/////////////////// MESH CACHE class ///////////////////////
+class MeshCache
+{
+public:
+    // the format version must be increased at each change of the file layout or of the Vertex structure
+    static const uint32_t FORMAT_VERSION = 3;
+
+    // the cache can be disabled (e.g., to measure the Assimp import time)
+    bool enabled = true;
+    string directory = "mesh_cache";
+
+    MeshCache(const MeshCache& copy) = delete; //disallow copy
+    MeshCache& operator=(const MeshCache &) = delete;
+
+    // cache of the application
+    static MeshCache& Get()
+    {
+        static MeshCache cache;
+        return cache;
+    }
+
+    //////////////////////////////////////////
+    // key of a model, from the content of its source file, the import flags, the versions of the optimization and of
+    // the LOD generation, and the vertex layout (0 if the file cannot be read)
+    uint64_t Key(const string &path, unsigned int importFlags, uint32_t optimizerVersion, uint32_t simplifierVersion,
+                 const VertexLayout &layout) const
+    {
+        MappedFile source;
+        if (!this->enabled || !source.Open(path))
+            return 0;
+        uint64_t hash = fnv1a(source.Data(), source.Size());
+        // (keepCPUData does not change the arrays)
+        uint32_t values[] = { importFlags, optimizerVersion, simplifierVersion, FORMAT_VERSION, (uint32_t)sizeof(Vertex),
+                              (uint32_t)layout.positions, layout.octahedralNormals, (uint32_t)layout.tangentFrame,
+                              layout.shortIndices, layout.splitPositions };
+        return fnv1a(values, sizeof(values), hash);
+    }
+
+    // it maps the cache file of a model, returning the arrays of its meshes (valid while the file is open). It returns
+    // false if the model is not in the cache or if the file is invalid
+    bool Map(uint64_t key, MappedFile &file, vector<MeshData> &meshes) const
+    {
+        if (key == 0 || !fileExists(this->path(key)))
+            return false;
+        if (!file.Open(this->path(key)))
+            return false;
+
+        const unsigned char *data = file.Data();
+        size_t size = file.Size();
+        const Header *header = (const Header*)data;
+        size_t offset = align(sizeof(Header));
+        if (size < offset || header->magic != MAGIC || header->version != FORMAT_VERSION || header->key != key)
+            return this->invalid(key);
+        const MeshEntry *entries = (const MeshEntry*)(data + offset);
+        offset = align(offset + header->meshes * sizeof(MeshEntry));
+        if (size < offset)
+            return this->invalid(key);
+        // the sizes are checked before the creation of any mesh, so an invalid file does not leave a partial model
+        size_t end = offset;
+        for (uint32_t i = 0; i < header->meshes; i++)
+        {
+            uint32_t indexSize = entries[i].info.indexSize;
+            if (indexSize != sizeof(uint16_t) && indexSize != sizeof(GLuint))
+                return this->invalid(key);
+            end = align(align(align(align(end + entries[i].positionBytes) + entries[i].attributeBytes) + (size_t)entries[i].indices * indexSize)
+                        + (size_t)entries[i].lods * sizeof(MeshLOD));
+        }
+        if (end != size)
+            return this->invalid(key);
+
+        for (uint32_t i = 0; i < header->meshes; i++)
+        {
+            MeshData mesh;
+            mesh.info = entries[i].info;
+            mesh.positions = data + offset;
+            mesh.positionBytes = entries[i].positionBytes;
+            offset = align(offset + mesh.positionBytes);
+            mesh.attributes = data + offset;
+            mesh.attributeBytes = entries[i].attributeBytes;
+            offset = align(offset + mesh.attributeBytes);
+            mesh.indices = data + offset;
+            mesh.numIndices = entries[i].indices;
+            offset = align(offset + mesh.numIndices * mesh.info.indexSize);
+            mesh.lods = (const MeshLOD*)(data + offset);
+            mesh.numLODs = entries[i].lods;
+            offset = align(offset + mesh.numLODs * sizeof(MeshLOD));
+            // the LODs must be ranges of the index array
+            for (size_t l = 0; l < mesh.numLODs; l++)
+                if ((size_t)mesh.lods[l].firstIndex + mesh.lods[l].numIndices > mesh.numIndices)
+                {
+                    meshes.clear();
+                    return this->invalid(key);
+                }
+            meshes.push_back(mesh);
+        }
+        return true;
+    }
+
+    // it saves the meshes of a model, as created by the import and converted to the vertex layout
+    void Store(uint64_t key, const vector<MeshData> &meshes) const
+    {
+        if (key == 0)
+            return;
+        this->createDirectory();
+        ofstream file(this->path(key), ios::binary | ios::trunc);
+
+        Header header = { MAGIC, FORMAT_VERSION, key, (uint32_t)meshes.size(), 0 };
+        vector<MeshEntry> entries;
+        for (const MeshData &mesh : meshes)
+            entries.push_back({ (uint32_t)mesh.positionBytes, (uint32_t)mesh.attributeBytes, (uint32_t)mesh.numIndices,
+                                (uint32_t)mesh.numLODs, mesh.info });
+        size_t offset = 0;
+        write(file, offset, &header, sizeof(header));
+        write(file, offset, entries.data(), entries.size() * sizeof(MeshEntry));
+        for (const MeshData &mesh : meshes)
+        {
+            write(file, offset, mesh.positions, mesh.positionBytes);
+            write(file, offset, mesh.attributes, mesh.attributeBytes);
+            write(file, offset, mesh.indices, mesh.numIndices * mesh.info.indexSize);
+            write(file, offset, mesh.lods, mesh.numLODs * sizeof(MeshLOD));
+        }
+        if (!file)
+            cout << "WARNING::MESH_CACHE:: unable to write " << this->path(key) << endl;
+    }
+
+private:
+    static const uint32_t MAGIC = 0x4843534d; // "MSCH"
+    static const size_t ALIGNMENT = 16;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t meshes;
+        uint32_t padding;
+    };
+    struct MeshEntry {
+        uint32_t positionBytes;
+        uint32_t attributeBytes;
+        uint32_t indices;
+        uint32_t lods;
+        MeshInfo info;
+    };
+
+    MeshCache() {}
+
+    //////////////////////////////////////////
+    string path(uint64_t key) const
+    {
+        stringstream name;
+        name << this->directory << "/" << hex << setw(16) << setfill('0') << key << ".mesh";
+        return name.str();
+    }
+
+    bool invalid(uint64_t key) const
+    {
+        cout << "WARNING::MESH_CACHE:: invalid cache file " << this->path(key) << endl;
+        return false;
+    }
+
+    // (it fails if the directory exists)
+    void createDirectory() const
+    {
+#ifdef _WIN32
+        _mkdir(this->directory.c_str());
+#else
+        mkdir(this->directory.c_str(), 0755);
+#endif
+    }
+
+    // (a missing file is the normal case of a first load, so it is checked before the mapping reports an error)
+    static bool fileExists(const string &path)
+    {
+        return ifstream(path).good();
+    }
+
+    static size_t align(size_t offset)
+    {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    // each section is followed by the padding to the next aligned offset
+    static void write(ofstream &file, size_t &offset, const void *data, size_t size)
+    {
+        static const char zeros[ALIGNMENT] = {};
+        file.write((const char*)data, size);
+        size_t aligned = align(offset + size);
+        file.write(zeros, aligned - offset - size);
+        offset = aligned;
+    }
+};
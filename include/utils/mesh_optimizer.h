@@ -0,0 +1,382 @@
+/*
+MeshOptimizer class
+- post-import optimization of the index and vertex arrays of a mesh, in three steps:
+    1) vertex cache: the triangles are reordered for the locality of the post-transform vertex cache, with the
+       "Linear-Speed Vertex Cache Optimisation" of Tom Forsyth (greedy choice of the triangle with the highest score,
+       computed from the position of its vertices in a simulated LRU cache and from their remaining valence)
+    2) overdraw: the cache-optimized sequence is split in clusters, which are sorted from the outside to the inside of
+       the mesh, so the front faces are more likely drawn first ("Fast Triangle Reordering for Vertex Locality and
+       Reduced Overdraw", Sander, Nehab, Barczak - SIGGRAPH 2007)
+    3) vertex fetch: the vertices are renumbered in the order of their first use, so the vertex fetch reads the buffer
+       linearly (the vertices not referenced by any triangle are removed)
+- ACMR (cache misses per triangle) and ATVR (cache misses per vertex, 1.0 is the optimum) of an index array, with a
+  simulated FIFO cache of STATS_CACHE_SIZE entries
+
+The optimization does not change the shape of the mesh, only the order of its triangles and vertices. It runs on the
+CPU only, so it can run on the workers preparing the models (see utils/asset_loader.h); the optimized arrays are then
+saved in the mesh cache (utils/mesh_cache.h).
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <utils/mesh.h>
+
+// vertex cache statistics of an index array
+struct MeshCacheStats {
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+
+/////////////////// MESH OPTIMIZER class ///////////////////////
+class MeshOptimizer
+{
+public:
+    // the version must be increased at each change of the optimization, as it is part of the key of the mesh cache
+    static const uint32_t VERSION = 1;
+    // size of the simulated LRU cache of the vertex cache optimization
+    static const int CACHE_SIZE = 32;
+    // size of the simulated FIFO cache of the statistics
+    static const int STATS_CACHE_SIZE = 16;
+
+    // the optimization can be disabled (e.g., to measure its effect on the geometry pass)
+    bool enabled = true;
+    // ACMR allowed to the clusters of the overdraw step, relative to the one of the whole mesh (higher values give more
+    // clusters, so a better sort for overdraw, and a worse vertex cache locality)
+    float overdrawThreshold = 1.05f;
+
+    MeshOptimizer(const MeshOptimizer& copy) = delete; //disallow copy
+    MeshOptimizer& operator=(const MeshOptimizer &) = delete;
+
+    // optimizer of the application
+    static MeshOptimizer& Get()
+    {
+        static MeshOptimizer optimizer;
+        return optimizer;
+    }
+
+    // value added to the key of the cached meshes (0 if the meshes are not optimized)
+    uint32_t Version() const { return this->enabled ? VERSION : 0; }
+
+    //////////////////////////////////////////
+    // it optimizes the arrays of a mesh, returning the report of the statistics before and after the optimization
+    string Optimize(vector<Vertex> &vertices, vector<GLuint> &indices) const
+    {
+        stringstream report;
+        size_t numTriangles = indices.size() / 3;
+        if (!this->enabled || numTriangles == 0 || indices.size() % 3 != 0)
+            return report.str();
+        MeshCacheStats before = Analyze(indices, vertices.size());
+
+        OptimizeVertexCache(indices, vertices.size());
+        size_t clusters = OptimizeOverdraw(indices, vertices, this->overdrawThreshold);
+        OptimizeVertexFetch(vertices, indices);
+
+        MeshCacheStats after = Analyze(indices, vertices.size());
+        report << numTriangles << " triangles, ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr
+               << " -> " << after.atvr << " (" << clusters << " clusters sorted for overdraw)";
+        return report.str();
+    }
+
+    //////////////////////////////////////////
+    // ACMR and ATVR of an index array, with a FIFO cache
+    static MeshCacheStats Analyze(const vector<GLuint> &indices, size_t numVertices)
+    {
+        MeshCacheStats stats;
+        vector<unsigned int> timestamps(numVertices, 0);
+        vector<bool> used(numVertices, false);
+        unsigned int time = STATS_CACHE_SIZE + 1;
+        size_t misses = 0, usedVertices = 0;
+        for (GLuint index : indices)
+        {
+            // a vertex is in the cache if it has entered it less than STATS_CACHE_SIZE misses ago
+            if (time - timestamps[index] > (unsigned int)STATS_CACHE_SIZE)
+            {
+                timestamps[index] = time++;
+                misses++;
+            }
+            if (!used[index])
+            {
+                used[index] = true;
+                usedVertices++;
+            }
+        }
+        if (!indices.empty())
+        {
+            stats.acmr = (float)misses / (float)(indices.size() / 3);
+            stats.atvr = (float)misses / (float)usedVertices;
+        }
+        return stats;
+    }
+
+    //////////////////////////////////////////
+    // 1) Forsyth's vertex cache optimization
+    static void OptimizeVertexCache(vector<GLuint> &indices, size_t numVertices)
+    {
+        size_t numTriangles = indices.size() / 3;
+
+        // triangles adjacent to each vertex (the first remaining[v] entries are the triangles not yet added)
+        vector<unsigned int> remaining(numVertices, 0);
+        for (GLuint index : indices)
+            remaining[index]++;
+        vector<unsigned int> offsets(numVertices + 1, 0);
+        for (size_t v = 0; v < numVertices; v++)
+            offsets[v + 1] = offsets[v] + remaining[v];
+        vector<unsigned int> adjacency(indices.size());
+        vector<unsigned int> filled(numVertices, 0);
+        for (size_t t = 0; t < numTriangles; t++)
+            for (int k = 0; k < 3; k++)
+            {
+                GLuint v = indices[t * 3 + k];
+                adjacency[offsets[v] + filled[v]++] = (unsigned int)t;
+            }
+
+        vector<int> cachePosition(numVertices, -1);
+        vector<float> vertexScores(numVertices);
+        for (size_t v = 0; v < numVertices; v++)
+            vertexScores[v] = vertexScore(-1, remaining[v]);
+        vector<float> triangleScores(numTriangles);
+        vector<bool> added(numTriangles, false);
+        for (size_t t = 0; t < numTriangles; t++)
+            triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+        vector<GLuint> optimized;
+        optimized.reserve(indices.size());
+        // simulated LRU cache (with room for the 3 vertices entering it)
+        vector<GLuint> cache, newCache;
+        cache.reserve(CACHE_SIZE + 3);
+        newCache.reserve(CACHE_SIZE + 3);
+        size_t nextUnadded = 0;
+        int best = bestTriangle(triangleScores, added, nextUnadded);
+
+        while (best >= 0)
+        {
+            // we add the best triangle to the output, and its vertices to the front of the cache
+            added[best] = true;
+            newCache.clear();
+            for (int k = 0; k < 3; k++)
+            {
+                GLuint v = indices[best * 3 + k];
+                optimized.push_back(v);
+                // (a degenerate triangle enters the cache only once)
+                if (find(newCache.begin(), newCache.end(), v) == newCache.end())
+                    newCache.push_back(v);
+                // the triangle is removed from the adjacency of its vertices
+                unsigned int *triangles = &adjacency[offsets[v]];
+                for (unsigned int i = 0; i < remaining[v]; i++)
+                    if (triangles[i] == (unsigned int)best)
+                    {
+                        swap(triangles[i], triangles[remaining[v] - 1]);
+                        break;
+                    }
+                remaining[v]--;
+            }
+            size_t entering = newCache.size();
+            for (GLuint v : cache)
+                if (find(newCache.begin(), newCache.begin() + entering, v) == newCache.begin() + entering)
+                    newCache.push_back(v);
+            swap(cache, newCache);
+
+            // the scores change only for the vertices in the cache (or pushed out of it), and for their triangles
+            for (size_t i = 0; i < cache.size(); i++)
+            {
+                GLuint v = cache[i];
+                cachePosition[v] = i < (size_t)CACHE_SIZE ? (int)i : -1;
+                vertexScores[v] = vertexScore(cachePosition[v], remaining[v]);
+            }
+            best = -1;
+            float bestScore = -1.0f;
+            for (GLuint v : cache)
+                for (unsigned int i = 0; i < remaining[v]; i++)
+                {
+                    unsigned int t = adjacency[offsets[v] + i];
+                    float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+                    triangleScores[t] = score;
+                    if (score > bestScore)
+                    {
+                        bestScore = score;
+                        best = (int)t;
+                    }
+                }
+            if (cache.size() > (size_t)CACHE_SIZE)
+                cache.resize(CACHE_SIZE);
+            // no triangle adjacent to the cache: we restart from the best of the remaining ones
+            if (best < 0)
+                best = bestTriangle(triangleScores, added, nextUnadded);
+        }
+        indices.swap(optimized);
+    }
+
+    //////////////////////////////////////////
+    // 2) overdraw step: the triangles are split in clusters where the cache-optimized sequence restarts (a triangle
+    // with 3 cache misses), if the ACMR of the current cluster is under threshold * total ACMR; the clusters are sorted by the distance of their centroid from the center of the mesh, along their normal.
+    // It returns the number of clusters
+    static size_t OptimizeOverdraw(vector<GLuint> &indices, const vector<Vertex> &vertices, float threshold)
+    {
+        size_t numTriangles = indices.size() / 3;
+        float totalACMR = Analyze(indices, vertices.size()).acmr;
+
+        // start triangle of each cluster, with a FIFO cache simulated as in Analyze
+        vector<size_t> clusterStarts;
+        vector<unsigned int> timestamps(vertices.size(), 0);
+        unsigned int time = STATS_CACHE_SIZE + 1;
+        size_t clusterMisses = 0;
+        for (size_t t = 0; t < numTriangles; t++)
+        {
+            int misses = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                GLuint v = indices[t * 3 + k];
+                if (time - timestamps[v] > (unsigned int)STATS_CACHE_SIZE)
+                {
+                    timestamps[v] = time++;
+                    misses++;
+                }
+            }
+            size_t clusterTriangles = clusterStarts.empty() ? 0 : t - clusterStarts.back();
+            bool hardBoundary = misses == 3;
+            bool softBoundary = clusterTriangles > 0 && (float)clusterMisses / (float)clusterTriangles <= threshold * totalACMR;
+            if (clusterStarts.empty() || (hardBoundary && softBoundary))
+            {
+                clusterStarts.push_back(t);
+                clusterMisses = 0;
+            }
+            clusterMisses += misses;
+        }
+        clusterStarts.push_back(numTriangles);
+        size_t numClusters = clusterStarts.size() - 1;
+        if (numClusters < 2)
+            return numClusters;
+
+        // area-weighted centroid of the mesh
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+        for (size_t t = 0; t < numTriangles; t++)
+        {
+            glm::vec3 normal;
+            glm::vec3 centroid = triangleCentroid(indices, vertices, t, normal);
+            float area = glm::length(normal);
+            meshCentroid += centroid * area;
+            meshArea += area;
+        }
+        if (meshArea > 0.0f)
+            meshCentroid /= meshArea;
+
+        // sort key of each cluster: the clusters facing outwards, and far from the center, are drawn first
+        vector<float> sortKeys(numClusters);
+        vector<size_t> order(numClusters);
+        for (size_t c = 0; c < numClusters; c++)
+        {
+            glm::vec3 clusterCentroid(0.0f), clusterNormal(0.0f);
+            float clusterArea = 0.0f;
+            for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+            {
+                glm::vec3 normal;
+                glm::vec3 centroid = triangleCentroid(indices, vertices, t, normal);
+                float area = glm::length(normal);
+                clusterCentroid += centroid * area;
+                clusterNormal += normal;
+                clusterArea += area;
+            }
+            float normalLength = glm::length(clusterNormal);
+            if (clusterArea > 0.0f && normalLength > 0.0f)
+                sortKeys[c] = glm::dot(clusterCentroid / clusterArea - meshCentroid, clusterNormal / normalLength);
+            else
+                sortKeys[c] = 0.0f;
+            order[c] = c;
+        }
+        // (stable, so the result does not depend on the implementation of the sort)
+        stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+        vector<GLuint> sorted;
+        sorted.reserve(indices.size());
+        for (size_t c : order)
+            sorted.insert(sorted.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+        indices.swap(sorted);
+        return numClusters;
+    }
+
+    //////////////////////////////////////////
+    // 3) vertex fetch step: the vertices are renumbered in the order of their first use
+    static void OptimizeVertexFetch(vector<Vertex> &vertices, vector<GLuint> &indices)
+    {
+        const GLuint unused = ~0u;
+        vector<GLuint> remap(vertices.size(), unused);
+        vector<Vertex> ordered;
+        ordered.reserve(vertices.size());
+        for (GLuint &index : indices)
+        {
+            if (remap[index] == unused)
+            {
+                remap[index] = (GLuint)ordered.size();
+                ordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices.swap(ordered);
+    }
+
+private:
+    MeshOptimizer() {}
+
+    //////////////////////////////////////////
+    // score of a vertex, from its position in the LRU cache (-1 if not in the cache) and from the number of its
+    // triangles not yet added (the constants are the ones proposed by Forsyth)
+    static float vertexScore(int cachePosition, unsigned int remainingTriangles)
+    {
+        if (remainingTriangles == 0)
+            return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            // the vertices of the last triangle have a fixed score, so the next triangle does not prefer them too much
+            if (cachePosition < 3)
+                score = 0.75f;
+            else
+                score = pow(1.0f - (float)(cachePosition - 3) / (float)(CACHE_SIZE - 3), 1.5f);
+        }
+        // bonus to the vertices with few remaining triangles, so isolated triangles are not left at the end
+        score += 2.0f * pow((float)remainingTriangles, -0.5f);
+        return score;
+    }
+
+    // triangle with the highest score among the ones not yet added (linear scan from the first one not yet added),
+    // -1 if all the triangles are added
+    static int bestTriangle(const vector<float> &triangleScores, const vector<bool> &added, size_t &nextUnadded)
+    {
+        while (nextUnadded < added.size() && added[nextUnadded])
+            nextUnadded++;
+        int best = -1;
+        float bestScore = -1.0f;
+        for (size_t t = nextUnadded; t < added.size(); t++)
+            if (!added[t] && triangleScores[t] > bestScore)
+            {
+                bestScore = triangleScores[t];
+                best = (int)t;
+            }
+        return best;
+    }
+
+    // centroid of a triangle, and its normal scaled by twice its area
+    static glm::vec3 triangleCentroid(const vector<GLuint> &indices, const vector<Vertex> &vertices, size_t t, glm::vec3 &normal)
+    {
+        const glm::vec3 &a = vertices[indices[t * 3]].Position;
+        const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+        const glm::vec3 &c = vertices[indices[t * 3 + 2]].Position;
+        normal = glm::cross(b - a, c - a);
+        return (a + b + c) / 3.0f;
+    }
+};
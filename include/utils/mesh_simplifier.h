@@ -0,0 +1,373 @@
+/*
+MeshSimplifier class
+- generation of the chain of levels of detail (LODs) of a mesh, with the quadric error metric simplification of
+  Garland and Heckbert ("Surface Simplification Using Quadric Error Metrics" - SIGGRAPH 1997)
+- the simplification collapses edges into one of their endpoints (half-edge collapse), so the LODs are only new index
+  arrays on the vertices of the mesh: all the levels are concatenated in the index buffer of the mesh, and they share
+  its vertex buffer
+- each level halves the triangles of the previous one, and the simplification continues from the previous level, so
+  the error of a level (the largest error of its collapses: the square root of the quadric error divided by the
+  area of the planes of the quadric, i.e. an estimate of the distance of the simplified surface from the original
+  one, in model units) accumulates over the chain
+- the vertices on the borders of the mesh, and the ones shared by several vertices with the same position (seams of
+  the normals or of the texture coordinates), are never collapsed, so the silhouette and the seams are preserved
+- the collapses flipping the normal of a triangle are rejected
+
+The LOD of a mesh is chosen at draw time, from the projection of its error on the screen (see Mesh::SelectLOD).
+Like the optimization of utils/mesh_optimizer.h, the generation runs only at the import, and the LODs are saved in
+the mesh cache (utils/mesh_cache.h).
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <vector>
+#include <string>
+#include <sstream>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <utils/mesh.h>
+#include <utils/mesh_optimizer.h>
+
+/////////////////// MESH SIMPLIFIER class ///////////////////////
+class MeshSimplifier
+{
+public:
+    // the version must be increased at each change of the simplification, as it is part of the key of the mesh cache
+    static const uint32_t VERSION = 1;
+    // maximum number of levels (including the full resolution one)
+    static const int MAX_LODS = 4;
+
+    // the generation can be disabled (the meshes have only the full resolution level)
+    bool enabled = true;
+    // ratio between the triangles of a level and the ones of the previous level
+    float reduction = 0.5f;
+    // the chain stops at the first level under this number of triangles
+    size_t minTriangles = 64;
+
+    MeshSimplifier(const MeshSimplifier& copy) = delete; //disallow copy
+    MeshSimplifier& operator=(const MeshSimplifier &) = delete;
+
+    // simplifier of the application
+    static MeshSimplifier& Get()
+    {
+        static MeshSimplifier simplifier;
+        return simplifier;
+    }
+
+    // value added to the key of the cached meshes (0 if the LODs are not generated)
+    uint32_t Version() const { return this->enabled ? VERSION : 0; }
+
+    //////////////////////////////////////////
+    // it appends the simplified levels to the index array of a mesh, filling the LOD table (level 0 is the full
+    // resolution one), and it returns the report of the triangles and the error of each level
+    string GenerateLODs(const vector<Vertex> &vertices, vector<GLuint> &indices, vector<MeshLOD> &lods) const
+    {
+        stringstream report;
+        lods.clear();
+        lods.push_back({ 0, (uint32_t)indices.size(), 0.0f });
+        if (!this->enabled || indices.size() / 3 < this->minTriangles * 2)
+            return report.str();
+
+        Simplification simplification(vertices, indices);
+        for (int level = 1; level < MAX_LODS; level++)
+        {
+            size_t previous = lods.back().numIndices / 3;
+            size_t target = (size_t)(previous * this->reduction);
+            if (target < this->minTriangles)
+                break;
+            vector<GLuint> simplified = simplification.Simplify(target);
+            // (the simplification stops when no more edges can be collapsed)
+            if (simplified.size() / 3 > previous * (1.0f + this->reduction) / 2.0f)
+                break;
+            // the level is ordered for the vertex cache too (the vertex order is the one of the full resolution level)
+            MeshOptimizer::OptimizeVertexCache(simplified, vertices.size());
+            lods.push_back({ (uint32_t)indices.size(), (uint32_t)simplified.size(), simplification.Error() });
+            indices.insert(indices.end(), simplified.begin(), simplified.end());
+        }
+        for (size_t level = 0; level < lods.size(); level++)
+            report << (level ? ", " : "") << "LOD " << level << " " << lods[level].numIndices / 3 << " triangles (error "
+                   << lods[level].error << ")";
+        return report.str();
+    }
+
+private:
+    MeshSimplifier() {}
+
+    // symmetric 4x4 matrix of a quadric (the 10 coefficients of its upper triangle), with the sum of the weights of
+    // its planes
+    struct Quadric {
+        double a[10] = {};
+        double weight = 0.0;
+
+        // quadric of the plane n.p + d = 0, weighted
+        static Quadric Plane(const glm::dvec3 &n, double d, double weight)
+        {
+            Quadric q;
+            double p[4] = { n.x, n.y, n.z, d };
+            for (int i = 0, k = 0; i < 4; i++)
+                for (int j = i; j < 4; j++)
+                    q.a[k++] = p[i] * p[j] * weight;
+            q.weight = weight;
+            return q;
+        }
+
+        void operator+=(const Quadric &q)
+        {
+            for (int k = 0; k < 10; k++)
+                this->a[k] += q.a[k];
+            this->weight += q.weight;
+        }
+
+        // squared distance of a point from the planes of the quadric (v^T Q v, with v = (p, 1))
+        double Evaluate(const glm::dvec3 &p) const
+        {
+            double v[4] = { p.x, p.y, p.z, 1.0 };
+            double sum = 0.0;
+            for (int i = 0, k = 0; i < 4; i++)
+                for (int j = i; j < 4; j++, k++)
+                    sum += (i == j ? 1.0 : 2.0) * this->a[k] * v[i] * v[j];
+            return max(sum, 0.0);
+        }
+    };
+
+    // collapse of the edge from vertex "from" into vertex "to": its cost is the weighted sum of the squared distances
+    // from the planes of the quadric, and its error the (average) distance
+    struct Collapse {
+        GLuint from, to;
+        double cost;
+        double error;
+    };
+
+    //////////////////////////////////////////
+    // state of the simplification of a mesh, kept between the levels
+    class Simplification
+    {
+    public:
+        Simplification(const vector<Vertex> &vertices, const vector<GLuint> &indices)
+            : vertices(vertices), indices(indices), collapsedInto(vertices.size()), quadrics(vertices.size()),
+              locked(vertices.size(), false)
+        {
+            for (size_t v = 0; v < vertices.size(); v++)
+                this->collapsedInto[v] = (GLuint)v;
+            this->lockSeams();
+            this->lockBorders();
+            // quadrics of the planes of the triangles, weighted by their area
+            for (size_t t = 0; t < this->indices.size() / 3; t++)
+            {
+                glm::dvec3 p0 = this->position(this->indices[t * 3]);
+                glm::dvec3 normal = glm::cross(this->position(this->indices[t * 3 + 1]) - p0, this->position(this->indices[t * 3 + 2]) - p0);
+                double area = glm::length(normal);
+                if (area == 0.0)
+                    continue;
+                normal /= area;
+                Quadric plane = Quadric::Plane(normal, -glm::dot(normal, p0), area * 0.5);
+                for (int k = 0; k < 3; k++)
+                    this->quadrics[this->indices[t * 3 + k]] += plane;
+            }
+        }
+
+        // it collapses edges until the triangles are at most targetTriangles (or no edge can be collapsed), and it
+        // returns the current index array
+        vector<GLuint> Simplify(size_t targetTriangles)
+        {
+            // the collapses are done in passes: in each pass, the edges are sorted by cost, and the cheapest ones
+            // are collapsed if their neighborhood is not changed by a previous collapse of the same pass
+            while (this->indices.size() / 3 > targetTriangles)
+            {
+                vector<Collapse> collapses = this->candidates();
+                if (collapses.empty())
+                    break;
+                sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) { return a.cost < b.cost; });
+                this->buildAdjacency();
+                vector<bool> touched(this->vertices.size(), false);
+                size_t triangles = this->indices.size() / 3;
+                size_t collapsed = 0;
+                for (const Collapse &collapse : collapses)
+                {
+                    if (triangles <= targetTriangles)
+                        break;
+                    if (touched[collapse.from] || touched[collapse.to] || this->flips(collapse))
+                        continue;
+                    // the neighborhood of the collapsed vertex is not changed again in this pass
+                    for (unsigned int i = this->offsets[collapse.from]; i < this->offsets[collapse.from + 1]; i++)
+                    {
+                        unsigned int t = this->adjacency[i];
+                        for (int k = 0; k < 3; k++)
+                            touched[this->indices[t * 3 + k]] = true;
+                        if (this->contains(t, collapse.to))
+                            triangles--;
+                    }
+                    this->collapsedInto[collapse.from] = collapse.to;
+                    this->quadrics[collapse.to] += this->quadrics[collapse.from];
+                    this->error = max(this->error, collapse.error);
+                    collapsed++;
+                }
+                if (collapsed == 0)
+                    break;
+                this->applyCollapses();
+            }
+            return this->indices;
+        }
+
+        // error of the current level, in model units
+        float Error() const { return (float)this->error; }
+
+    private:
+        const vector<Vertex> &vertices;
+        // current triangles, on the vertices not yet collapsed
+        vector<GLuint> indices;
+        vector<GLuint> collapsedInto;
+        vector<Quadric> quadrics;
+        vector<bool> locked;
+        double error = 0.0;
+        // triangles of each vertex (rebuilt at each pass)
+        vector<unsigned int> offsets, adjacency;
+
+        glm::dvec3 position(GLuint v) const { return glm::dvec3(this->vertices[v].Position); }
+
+        bool contains(unsigned int t, GLuint v) const
+        {
+            return this->indices[t * 3] == v || this->indices[t * 3 + 1] == v || this->indices[t * 3 + 2] == v;
+        }
+
+        // the vertices sharing their position with other vertices are locked
+        void lockSeams()
+        {
+            struct PositionHash {
+                size_t operator()(const glm::vec3 &p) const
+                {
+                    const uint32_t *bits = (const uint32_t*)&p;
+                    return ((size_t)bits[0] * 73856093u) ^ ((size_t)bits[1] * 19349663u) ^ ((size_t)bits[2] * 83492791u);
+                }
+            };
+            unordered_map<glm::vec3, GLuint, PositionHash> first;
+            for (size_t v = 0; v < this->vertices.size(); v++)
+            {
+                auto inserted = first.insert(make_pair(this->vertices[v].Position, (GLuint)v));
+                if (!inserted.second)
+                {
+                    this->locked[v] = true;
+                    this->locked[inserted.first->second] = true;
+                }
+            }
+        }
+
+        // the vertices of the edges used by a single triangle are locked
+        void lockBorders()
+        {
+            unordered_map<uint64_t, int> edges;
+            for (size_t t = 0; t < this->indices.size() / 3; t++)
+                for (int k = 0; k < 3; k++)
+                    edges[edgeKey(this->indices[t * 3 + k], this->indices[t * 3 + (k + 1) % 3])]++;
+            for (const auto &edge : edges)
+                if (edge.second == 1)
+                {
+                    this->locked[(GLuint)(edge.first >> 32)] = true;
+                    this->locked[(GLuint)(edge.first & 0xffffffffu)] = true;
+                }
+        }
+
+        static uint64_t edgeKey(GLuint a, GLuint b)
+        {
+            return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+        }
+
+        // cheapest collapse of each edge of the current triangles
+        vector<Collapse> candidates() const
+        {
+            vector<Collapse> collapses;
+            collapses.reserve(this->indices.size());
+            for (size_t i = 0; i < this->indices.size(); i++)
+            {
+                GLuint a = this->indices[i], b = this->indices[i - i % 3 + (i % 3 + 1) % 3];
+                // each edge is considered once, from its lower index (the border edges are locked anyway)
+                if (a > b)
+                    continue;
+                Quadric q = this->quadrics[a];
+                q += this->quadrics[b];
+                Collapse best = { 0, 0, -1.0, 0.0 };
+                if (!this->locked[a])
+                    best = { a, b, q.Evaluate(this->position(b)), 0.0 };
+                if (!this->locked[b])
+                {
+                    double cost = q.Evaluate(this->position(a));
+                    if (best.cost < 0.0 || cost < best.cost)
+                        best = { b, a, cost, 0.0 };
+                }
+                if (best.cost >= 0.0 && q.weight > 0.0)
+                    best.error = sqrt(best.cost / q.weight);
+                if (best.cost >= 0.0)
+                    collapses.push_back(best);
+            }
+            return collapses;
+        }
+
+        void buildAdjacency()
+        {
+            this->offsets.assign(this->vertices.size() + 1, 0);
+            for (GLuint v : this->indices)
+                this->offsets[v + 1]++;
+            for (size_t v = 0; v < this->vertices.size(); v++)
+                this->offsets[v + 1] += this->offsets[v];
+            this->adjacency.resize(this->indices.size());
+            vector<unsigned int> filled(this->offsets.begin(), this->offsets.end() - 1);
+            for (size_t i = 0; i < this->indices.size(); i++)
+                this->adjacency[filled[this->indices[i]]++] = (unsigned int)(i / 3);
+        }
+
+        // a collapse is rejected if it flips a triangle of the collapsed vertex
+        bool flips(const Collapse &collapse) const
+        {
+            for (unsigned int i = this->offsets[collapse.from]; i < this->offsets[collapse.from + 1]; i++)
+            {
+                unsigned int t = this->adjacency[i];
+                if (this->contains(t, collapse.to))
+                    continue;
+                glm::dvec3 before[3], after[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    GLuint v = this->indices[t * 3 + k];
+                    before[k] = this->position(v);
+                    after[k] = this->position(v == collapse.from ? collapse.to : v);
+                }
+                glm::dvec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::dvec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if (glm::dot(normalBefore, normalAfter) <= 0.0)
+                    return true;
+            }
+            return false;
+        }
+
+        // the collapsed vertices are replaced in the triangles, and the degenerate triangles are removed
+        void applyCollapses()
+        {
+            size_t kept = 0;
+            for (size_t t = 0; t < this->indices.size() / 3; t++)
+            {
+                GLuint v[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    v[k] = this->indices[t * 3 + k];
+                    while (this->collapsedInto[v[k]] != v[k])
+                        v[k] = this->collapsedInto[v[k]];
+                }
+                if (v[0] == v[1] || v[1] == v[2] || v[0] == v[2])
+                    continue;
+                for (int k = 0; k < 3; k++)
+                    this->indices[kept * 3 + k] = v[k];
+                kept++;
+            }
+            this->indices.resize(kept * 3);
+        }
+    };
+};
@@ -2,6 +2,15 @@
 Model class
 - OBJ models loading using Assimp library
 - the class converts data from Assimp data structure to a OpenGL-compatible data structure (Mesh class in mesh_v1.h)
+- the imported meshes are optimized for the vertex cache, overdraw and vertex fetch (utils/mesh_optimizer.h), and
+  their levels of detail are generated (utils/mesh_simplifier.h)
+- Draw can select the level of detail of each mesh from its size on the screen, and skip the meshes culled by the
+  application (e.g., with utils/bvh.h, from the bounding boxes of the meshes)
+- the meshes, converted to the vertex layout (utils/vertex_layout.h), are saved in the binary cache of
+  utils/mesh_cache.h: the next loads of the same file map the cached arrays, without calling Assimp and without any
+  conversion
+- the loading is split in Prepare (CPU side: cache mapping, or Assimp import and conversion, which can run on a
+  worker thread) and Upload (creation of the GPU buffers, on the thread of the OpenGL context)
 
 N.B. 1)
 Model and Mesh classes follow RAII principles (https://en.cppreference.com/w/cpp/language/raii).
@@ -23,6 +32,10 @@ Universita' degli Studi di Milano
 #pragma once
 using namespace std;
 
+// Std. Includes
+#include <chrono>
+#include <memory>
+
 // we use GLM data structures to convert data in the Assimp data structures in a data structures suited for VBO, VAO and EBO buffers
 #include <glm/glm.hpp>
 
@@ -33,6 +46,12 @@ using namespace std;
 
 // we include the Mesh class, which manages the "OpenGL side" (= creation and allocation of VBO, VAO, EBO buffers) of the loading of models
 #include <utils/mesh.h>
+// binary cache of the converted meshes
+#include <utils/mesh_cache.h>
+// post-import optimization of the meshes
+#include <utils/mesh_optimizer.h>
+// levels of detail of the meshes
+#include <utils/mesh_simplifier.h>
 
 /////////////////// MODEL class ///////////////////////
 class Model
@@ -70,7 +89,81 @@ public:
     // because we are not writing a user-defined destructor.
     Model(const string& path)
     {
-        this->loadModel(path);
+        this->Prepare(path);
+        this->Upload();
+    }
+
+    // empty model, loaded later with Prepare and Upload (e.g., by utils/asset_loader.h)
+    Model() {}
+
+    //////////////////////////////////////////
+    // CPU side of the loading: the meshes are mapped from the mesh cache, or imported with Assimp (and then saved in
+    // the cache). It does not call OpenGL, so it can run on a worker thread
+    void Prepare(const string& path)
+    {
+        // import flags (part of the key of the cached meshes)
+        const unsigned int importFlags = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        this->path = path;
+        MeshCache &cache = MeshCache::Get();
+        const VertexLayout &layout = VertexLayout::Get();
+        uint64_t key = cache.Key(path, importFlags, MeshOptimizer::Get().Version(), MeshSimplifier::Get().Version(), layout);
+        this->cacheFile.reset(new MappedFile());
+        this->cached = cache.Map(key, *this->cacheFile, this->prepared);
+        if (!this->cached)
+        {
+            this->cacheFile.reset();
+            this->prepared.clear();
+            if (this->importModel(path, importFlags))
+            {
+                // the optimization and the LOD generation run only at the import, the cached arrays already have them
+                this->importedLODs.resize(this->importedVertices.size());
+                for (size_t i = 0; i < this->importedVertices.size(); i++)
+                {
+                    string report = MeshOptimizer::Get().Optimize(this->importedVertices[i], this->importedIndices[i]);
+                    if (!report.empty())
+                        this->report << "MESH_OPTIMIZER:: " << path << " mesh " << i << ": " << report << endl;
+                    report = MeshSimplifier::Get().GenerateLODs(this->importedVertices[i], this->importedIndices[i], this->importedLODs[i]);
+                    if (!report.empty())
+                        this->report << "MESH_SIMPLIFIER:: " << path << " mesh " << i << ": " << report << endl;
+                }
+                // conversion to the vertex layout (the Vertex arrays are no longer needed)
+                this->importedMeshes.resize(this->importedVertices.size());
+                for (size_t i = 0; i < this->importedVertices.size(); i++)
+                {
+                    Mesh::Encode(this->importedVertices[i].data(), this->importedVertices[i].size(), this->importedIndices[i].data(),
+                                 this->importedIndices[i].size(), layout, this->importedMeshes[i]);
+                    this->prepared.push_back(Mesh::Prepared(this->importedMeshes[i], this->importedLODs[i].data(), this->importedLODs[i].size()));
+                }
+                this->importedVertices.clear();
+                this->importedIndices.clear();
+                cache.Store(key, this->prepared);
+            }
+        }
+        this->prepareTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+    // GPU side of the loading, on the thread of the OpenGL context: the buffers of the prepared meshes are created, and
+    // the CPU data are released
+    void Upload()
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        size_t gpuBytes = 0;
+        for (const MeshData &mesh : this->prepared)
+        {
+            this->meshes.emplace_back(mesh);
+            gpuBytes += this->meshes.back().GPUBytes();
+        }
+        this->prepared.clear();
+        this->importedMeshes.clear();
+        this->importedLODs.clear();
+        this->cacheFile.reset();
+        double uploadTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        // (the report of the optimization is printed here, so the lines of different workers are not mixed)
+        cout << this->report.str();
+        this->report.str("");
+        cout << "MODEL:: " << this->path << (this->cached ? " loaded from the mesh cache in " : " imported in ")
+             << this->prepareTime << " ms (upload " << uploadTime << " ms, " << gpuBytes / 1024.0 << " KB of GPU buffers)" << endl;
     }
 
     //////////////////////////////////////////
@@ -82,14 +175,67 @@ public:
             this->meshes[i].Draw();
     }
 
+    // model rendering with the level of detail of each mesh selected from its size on the screen (see
+    // Mesh::SelectLOD): it returns the number of triangles drawn
+    // visible (optional) has a flag for each mesh: the meshes with a 0 flag are not drawn
+    GLsizei Draw(const glm::mat4 &modelViewMatrix, float pixelsPerUnit, float maxPixelError, const uint8_t *visible = nullptr)
+    {
+        GLsizei triangles = 0;
+        for(GLuint i = 0; i < this->meshes.size(); i++)
+            if (!visible || visible[i])
+                triangles += this->meshes[i].Draw(this->meshes[i].SelectLOD(modelViewMatrix, pixelsPerUnit, maxPixelError));
+        return triangles;
+    }
+
+    // instanced rendering (see Mesh::DrawInstanced): count instances of the model, starting from the first one in the
+    // instance buffer, with the given level of detail for all the meshes. It returns the number of triangles drawn
+    GLsizei DrawInstanced(const InstanceBuffer &instances, size_t first, size_t count, int lod = 0)
+    {
+        GLsizei triangles = 0;
+        for(GLuint i = 0; i < this->meshes.size(); i++)
+            triangles += this->meshes[i].DrawInstanced(instances, first, count, glm::min(lod, this->meshes[i].NumLODs() - 1));
+        return triangles;
+    }
+
+    // bounding box of all the meshes, in model coordinates
+    void Bounds(glm::vec3 &minimum, glm::vec3 &maximum) const
+    {
+        minimum = glm::vec3(0.0f);
+        maximum = glm::vec3(0.0f);
+        for(GLuint i = 0; i < this->meshes.size(); i++)
+        {
+            minimum = i == 0 ? this->meshes[i].BoundsMinimum() : glm::min(minimum, this->meshes[i].BoundsMinimum());
+            maximum = i == 0 ? this->meshes[i].BoundsMaximum() : glm::max(maximum, this->meshes[i].BoundsMaximum());
+        }
+    }
+
+    // rendering of the positions only (see Mesh::DrawPositions)
+    void DrawPositions()
+    {
+        for(GLuint i = 0; i < this->meshes.size(); i++)
+            this->meshes[i].DrawPositions();
+    }
+
     //////////////////////////////////////////
 
 
 private:
+    // state of the loading, between Prepare and Upload
+    string path;
+    bool cached = false;
+    double prepareTime = 0.0;
+    stringstream report;
+    // arrays of the meshes: in the mapped cache file, or in the meshes converted after the import
+    vector<MeshData> prepared;
+    unique_ptr<MappedFile> cacheFile;
+    vector<vector<Vertex>> importedVertices;
+    vector<vector<GLuint>> importedIndices;
+    vector<EncodedMesh> importedMeshes;
+    vector<vector<MeshLOD>> importedLODs;
 
     //////////////////////////////////////////
-    // loading of the model using Assimp library. Nodes are processed to build a vector of Mesh class instances
-    void loadModel(string path)
+    // loading of the model using Assimp library. Nodes are processed to build the arrays of each mesh
+    bool importModel(const string &path, unsigned int importFlags)
     {
         // loading using Assimp
         // N.B.: it is possible to set, if needed, some operations to be performed by Assimp after the loading.
@@ -97,17 +243,18 @@ private:
         // VERY IMPORTANT: calculation of Tangents and Bitangents is possible only if the model has Texture Coordinates
         // If they are not present, the calculation is skipped (but no error is provided in the following checks!)
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, importFlags);
 
         // check for errors (see comment above)
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return false;
         }
 
         // we start the recursive processing of nodes in the Assimp data structure
         this->processNode(scene->mRootNode, scene);
+        return true;
     }
 
     //////////////////////////////////////////
@@ -122,11 +269,8 @@ private:
             // "Scene" contains all the data. Class node is used only to point to one or more mesh inside the scene and to maintain informations on relations between nodes
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
             // we start processing of the Assimp mesh using processMesh method.
-            // the result (an istance of the Mesh class) is added to the vector
-            // we use emplace_back instead as push_back, so to have the instance created directly in the
-            // vector memory, without the creation of a temp copy.
-            // https://en.cppreference.com/w/cpp/container/vector/emplace_back
-            this->meshes.emplace_back(processMesh(mesh));
+            // the resulting arrays are added to the imported ones (the instances of the Mesh class are created by Upload)
+            this->processMesh(mesh);
         }
         // we then recursively process each of the children nodes
         for(GLuint i = 0; i < node->mNumChildren; i++)
@@ -138,9 +282,9 @@ private:
 
     //////////////////////////////////////////
 
-    // Processing of the Assimp mesh in order to obtain an "OpenGL mesh"
-    // = we create and allocate the buffers used to send mesh data to the GPU
-    Mesh processMesh(aiMesh* mesh)
+    // Processing of the Assimp mesh in order to obtain the arrays of an "OpenGL mesh"
+    // (the buffers used to send mesh data to the GPU are created and allocated by Upload)
+    void processMesh(aiMesh* mesh)
     {
         // data structures for vertices and indices of vertices (for faces)
         vector<Vertex> vertices;
@@ -200,7 +344,8 @@ private:
                 indices.emplace_back(face.mIndices[j]);
         }
 
-        // we return an instance of the Mesh class created using the vertices and faces data structures we have created above.
-        return Mesh(vertices, indices);
+        // we add the vertices and faces data structures we have created above to the imported ones
+        this->importedVertices.push_back(std::move(vertices));
+        this->importedIndices.push_back(std::move(indices));
     }
 };
@@ -0,0 +1,221 @@
+/*
+ProgramCache class
+- on-disk cache of the linked programs (glGetProgramBinary), one file for each program in the cache directory
+- the key of a program is the hash of its sources (with the defines already inserted) and of the vendor, renderer
+  and version strings of the driver, so a driver update or a change to a shader never loads a stale binary
+- counters of the programs loaded from the cache, compiled from the sources (and linked), failed to link, and of the
+  binaries rejected by the driver
+
+The Shader class asks the cache before compiling: Load() gives the binary to the driver with glProgramBinary, and
+it fails if there is no file for the key or if the driver rejects the binary (e.g., after an update which kept the
+version string); in that case the program is compiled from the sources, and Store() saves the new binary.
+Drivers without any binary format (GL_NUM_PROGRAM_BINARY_FORMATS = 0) always compile.
+
+The cache is used by the single context of the application, accessed with ProgramCache::Get().
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include <utils/hash.h>
+
+// counters of the programs created since the start of the application
+struct ProgramCacheStats {
+    unsigned int loaded = 0;
+    unsigned int compiled = 0;
+    unsigned int failed = 0;
+    unsigned int rejected = 0;
+};
+
+/////////////////// PROGRAM CACHE class ///////////////////////
+class ProgramCache
+{
+public:
+    // the cache can be disabled (e.g., to measure a cold start) before the creation of the first program
+    bool enabled = true;
+    string directory = "program_cache";
+
+    ProgramCache(const ProgramCache& copy) = delete; //disallow copy
+    ProgramCache& operator=(const ProgramCache &) = delete;
+
+    // cache of the context of the application
+    static ProgramCache& Get()
+    {
+        static ProgramCache cache;
+        return cache;
+    }
+
+    //////////////////////////////////////////
+    // key of a program, from the sources of its stages and the driver strings
+    uint64_t Key(const vector<string> &sources)
+    {
+        uint64_t hash = hashString(FNV1A_OFFSET_BASIS, this->driver());
+        for (const string &source : sources)
+            hash = hashString(hash, source);
+        return hash;
+    }
+
+    // it loads the binary of a program, returning false if it is not in the cache or if it is rejected by the driver
+    bool Load(GLuint program, uint64_t key)
+    {
+        if (!this->available())
+            return false;
+        ifstream file(this->path(key), ios::binary);
+        if (!file)
+            return false;
+
+        Header header;
+        file.read((char*)&header, sizeof(header));
+        bool valid = file && header.magic == MAGIC && header.key == key;
+        vector<char> binary(valid ? header.length : 0);
+        if (valid)
+            valid = file.read(binary.data(), binary.size()) && file.peek() == EOF;
+        if (!valid)
+        {
+            cout << "WARNING::PROGRAM_CACHE:: invalid cache file " << this->path(key) << endl;
+            this->stats.rejected++;
+            return false;
+        }
+
+        glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            this->stats.rejected++;
+            return false;
+        }
+        this->stats.loaded++;
+        return true;
+    }
+
+    // it must be called before linking a program which will be stored in the cache
+    void PrepareLink(GLuint program)
+    {
+        if (this->available())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // it saves the binary of a program compiled from the sources (a program which failed to link is not saved)
+    void Store(GLuint program, uint64_t key)
+    {
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            this->stats.failed++;
+            return;
+        }
+        this->stats.compiled++;
+        if (!this->available())
+            return;
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        Header header;
+        header.magic = MAGIC;
+        header.key = key;
+        vector<char> binary(length);
+        glGetProgramBinary(program, length, &length, &header.format, binary.data());
+        header.length = (uint32_t)length;
+
+        this->createDirectory();
+        ofstream file(this->path(key), ios::binary | ios::trunc);
+        file.write((const char*)&header, sizeof(header));
+        file.write(binary.data(), length);
+        if (!file)
+            cout << "WARNING::PROGRAM_CACHE:: unable to write " << this->path(key) << endl;
+    }
+
+    const ProgramCacheStats& Stats() const { return this->stats; }
+
+private:
+    static const uint32_t MAGIC = 0x43425053; // "SPBC"
+
+    // header of a cache file, followed by the binary
+    struct Header {
+        uint32_t magic;
+        GLenum format;
+        uint64_t key;
+        uint32_t length;
+        uint32_t padding = 0;
+    };
+
+    ProgramCacheStats stats;
+    string driverString;
+    int formats = -1;
+    bool directoryCreated = false;
+
+    ProgramCache() {}
+
+    //////////////////////////////////////////
+    bool available()
+    {
+        if (this->formats < 0)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &this->formats);
+        return this->enabled && this->formats > 0;
+    }
+
+    const string& driver()
+    {
+        if (this->driverString.empty())
+        {
+            const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+            for (GLenum name : names)
+            {
+                const GLubyte *value = glGetString(name);
+                this->driverString += value ? (const char*)value : "";
+                this->driverString += "\n";
+            }
+        }
+        return this->driverString;
+    }
+
+    string path(uint64_t key) const
+    {
+        stringstream name;
+        name << this->directory << "/" << hex << setw(16) << setfill('0') << key << ".bin";
+        return name.str();
+    }
+
+    void createDirectory()
+    {
+        if (this->directoryCreated)
+            return;
+#ifdef _WIN32
+        _mkdir(this->directory.c_str());
+#else
+        mkdir(this->directory.c_str(), 0755);
+#endif
+        this->directoryCreated = true;
+    }
+
+    // FNV-1a hash of a string, followed by a separator (so the boundaries between the strings change the hash)
+    static uint64_t hashString(uint64_t hash, const string &value)
+    {
+        const unsigned char separator = 0xff;
+        return fnv1a(&separator, 1, fnv1a(value.data(), value.size(), hash));
+    }
+};
@@ -0,0 +1,267 @@
+/*
+RenderGraph class
+- declarative description of the frame: each pass declares the resources it reads and writes
+- the graph is compiled for each configuration of the application (technique, blur, ...) into an execution order,
+  culling the passes whose outputs are not used to produce the final image
+
+A pass is made of two functions:
+- setup: it is called when the graph is compiled. It returns false if the pass is not part of the current
+  configuration, otherwise it declares the resources read and written by the pass with the Builder
+- execute: it is called at each frame, in the compiled order, for the passes which have not been culled
+The passes are declared in the order of the frame: a resource read by a pass is the one written by the last
+preceding pass of the configuration writing it. A pass drawing on top of a resource (e.g., the skybox) must
+declare it both as read and as written.
+
+The compiled execution orders are cached, indexed by a key identifying the configuration (computed by the
+application from the parameters used in the setup functions).
+
+The resources are imported (textures and framebuffers owned by the application) or transient: the render target
+of a transient resource is acquired from a RenderTargetPool before the first pass using it in the compiled order,
+and released after the last one, so that resources with disjoint lifetimes can share the same target.
+The content of a transient resource is not preserved across frames.
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+
+#include <utils/render_target_pool.h>
+
+/////////////////// RENDER GRAPH class ///////////////////////
+class RenderGraph
+{
+public:
+    // handle of a resource of the graph
+    typedef int Resource;
+
+    // declaration of the resources used by a pass, filled by its setup function
+    class Builder
+    {
+    public:
+        void Read(Resource resource) { this->reads.push_back(resource); }
+        void Write(Resource resource) { this->writes.push_back(resource); }
+    private:
+        friend class RenderGraph;
+        vector<Resource> reads, writes;
+    };
+
+    typedef function<bool(Builder&)> SetupFunction;
+    typedef function<void()> ExecuteFunction;
+
+    RenderGraph(const RenderGraph& copy) = delete; //disallow copy
+    RenderGraph& operator=(const RenderGraph &) = delete;
+
+    RenderGraph(RenderTargetPool &pool) : pool(pool) {}
+
+    //////////////////////////////////////////
+    // it adds a resource created by the application: its texture, and the framebuffer used to render into it
+    Resource Import(const string &name, GLuint texture, GLuint framebuffer)
+    {
+        ResourceEntry entry;
+        entry.name = name;
+        entry.target.texture = texture;
+        entry.target.framebuffer = framebuffer;
+        this->resources.push_back(entry);
+        this->compiled.clear();
+        return (Resource)this->resources.size() - 1;
+    }
+
+    // it adds a transient resource, with the resolution of the graph divided by downscale
+    // (the downscale factor can be changed afterwards, e.g., by a quality option, with SetDownscale)
+    Resource Create(const string &name, GLenum internalFormat, GLenum format, GLenum type, int downscale = 1)
+    {
+        ResourceEntry entry;
+        entry.name = name;
+        entry.transient = true;
+        entry.desc = { internalFormat, format, type, 0, 0 };
+        entry.downscale = downscale;
+        this->resources.push_back(entry);
+        this->compiled.clear();
+        return (Resource)this->resources.size() - 1;
+    }
+
+    // it changes the texture and framebuffer of an imported resource (e.g., the history targets swapped at each frame)
+    void SetImported(Resource resource, GLuint texture, GLuint framebuffer)
+    {
+        this->resources[resource].target.texture = texture;
+        this->resources[resource].target.framebuffer = framebuffer;
+    }
+
+    void SetDownscale(Resource resource, int downscale) { this->resources[resource].downscale = max(1, downscale); }
+
+    // resolution of the transient resources (the current screen resolution)
+    void SetResolution(GLsizei width, GLsizei height)
+    {
+        this->width = width;
+        this->height = height;
+    }
+
+    // target of a resource: for a transient resource, the target used in the last executed frame
+    // (0 if the resource was not used, and possibly overwritten by a following resource sharing the same target)
+    GLuint Texture(Resource resource) const { return this->resources[resource].target.texture; }
+    GLuint Framebuffer(Resource resource) const { return this->resources[resource].target.framebuffer; }
+    // size of a resource (the resolution of the graph for the imported resources)
+    GLsizei Width(Resource resource) const { return max(1, this->width / this->resources[resource].downscale); }
+    GLsizei Height(Resource resource) const { return max(1, this->height / this->resources[resource].downscale); }
+    const string& Name(Resource resource) const { return this->resources[resource].name; }
+
+    //////////////////////////////////////////
+    // it adds a pass at the end of the frame
+    void AddPass(const string &name, SetupFunction setup, ExecuteFunction execute)
+    {
+        PassEntry pass = { name, setup, execute };
+        this->passes.push_back(pass);
+        this->compiled.clear();
+    }
+
+    //////////////////////////////////////////
+    // it executes the passes needed to produce the output resource in the given configuration
+    void Execute(Resource output, uint64_t configuration)
+    {
+        const CompiledGraph &graph = this->compile(output, configuration);
+        for (ResourceEntry &resource : this->resources)
+            if (resource.transient)
+                resource.target = RenderTarget();
+        for (const CompiledPass &pass : graph.passes)
+        {
+            for (Resource r : pass.acquire)
+            {
+                ResourceEntry &resource = this->resources[r];
+                resource.desc.width = this->Width(r);
+                resource.desc.height = this->Height(r);
+                resource.target = this->pool.Acquire(resource.desc);
+            }
+            this->passes[pass.index].execute();
+            for (Resource r : pass.release)
+                this->pool.Release(this->resources[r].target);
+        }
+    }
+
+    // names of the passes executed and culled in a configuration (the configuration is compiled if needed)
+    vector<string> ExecutedPasses(Resource output, uint64_t configuration)
+    {
+        vector<string> names;
+        for (const CompiledPass &pass : this->compile(output, configuration).passes)
+            names.push_back(this->passes[pass.index].name);
+        return names;
+    }
+    vector<string> CulledPasses(Resource output, uint64_t configuration)
+    {
+        vector<string> names;
+        for (int index : this->compile(output, configuration).culled)
+            names.push_back(this->passes[index].name);
+        return names;
+    }
+
+private:
+    struct ResourceEntry {
+        string name;
+        RenderTarget target;
+        bool transient = false;
+        RenderTargetDesc desc = {};
+        int downscale = 1;
+    };
+    struct PassEntry {
+        string name;
+        SetupFunction setup;
+        ExecuteFunction execute;
+    };
+    struct CompiledPass {
+        int index;
+        vector<Resource> reads, writes;
+        // transient resources used for the first and for the last time by the pass
+        vector<Resource> acquire, release;
+    };
+    struct CompiledGraph {
+        vector<CompiledPass> passes;
+        vector<int> culled;
+    };
+
+    RenderTargetPool &pool;
+    GLsizei width = 0, height = 0;
+    vector<ResourceEntry> resources;
+    vector<PassEntry> passes;
+    unordered_map<uint64_t, CompiledGraph> compiled;
+
+    //////////////////////////////////////////
+    // setup of the passes for the configuration, and culling with a backward visit from the output:
+    // a pass is needed if it writes a resource needed by a following pass, and then its inputs become needed
+    const CompiledGraph& compile(Resource output, uint64_t configuration)
+    {
+        // the output is part of the key, so that the same configuration can be compiled for different outputs
+        uint64_t key = configuration * 31 + (uint64_t)output;
+        unordered_map<uint64_t, CompiledGraph>::iterator it = this->compiled.find(key);
+        if (it != this->compiled.end())
+            return it->second;
+
+        vector<CompiledPass> candidates;
+        for (size_t i = 0; i < this->passes.size(); i++)
+        {
+            Builder builder;
+            if (!this->passes[i].setup(builder))
+                continue;
+            CompiledPass pass = { (int)i, builder.reads, builder.writes, {}, {} };
+            candidates.push_back(pass);
+        }
+
+        CompiledGraph &graph = this->compiled[key];
+        vector<bool> needed(this->resources.size(), false);
+        needed[output] = true;
+        vector<bool> executed(candidates.size(), false);
+        for (int i = (int)candidates.size() - 1; i >= 0; i--)
+        {
+            const CompiledPass &pass = candidates[i];
+            bool used = false;
+            for (Resource r : pass.writes)
+                used = used || needed[r];
+            if (!used)
+                continue;
+            executed[i] = true;
+            for (Resource r : pass.writes)
+                needed[r] = false;
+            for (Resource r : pass.reads)
+                needed[r] = true;
+        }
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            if (executed[i])
+                graph.passes.push_back(candidates[i]);
+            else
+                graph.culled.push_back(candidates[i].index);
+        }
+
+        // lifetimes of the transient resources in the execution order
+        vector<int> first(this->resources.size(), -1), last(this->resources.size(), -1);
+        for (int i = 0; i < (int)graph.passes.size(); i++)
+        {
+            const CompiledPass &pass = graph.passes[i];
+            for (const vector<Resource> *list : { &pass.reads, &pass.writes })
+                for (Resource r : *list)
+                {
+                    if (first[r] < 0)
+                        first[r] = i;
+                    last[r] = i;
+                }
+        }
+        for (size_t r = 0; r < this->resources.size(); r++)
+        {
+            if (!this->resources[r].transient || first[r] < 0)
+                continue;
+            graph.passes[first[r]].acquire.push_back((Resource)r);
+            graph.passes[last[r]].release.push_back((Resource)r);
+        }
+        return graph;
+    }
+};
@@ -0,0 +1,199 @@
+/*
+RenderTargetPool class
+- pool of the transient render targets (2D texture + framebuffer) used by the passes of the frame
+- the targets are identified by their description (format and size): a target is allocated the first time its
+  description is requested and no free target is available, and it is reused afterwards
+- the targets not used for longer than the idle time are released
+- GPU memory of the allocated targets, and of the targets used in the current frame
+
+A target is acquired for the part of the frame where its content is needed, and then released: a target released
+by a pass can be acquired by a following pass of the same frame (aliasing), so the memory used by a frame depends
+on the lifetimes of its transient resources instead of their number. The RenderGraph class computes the lifetimes.
+
+The memory of a target is computed from the component sizes reported by the driver for its texture (the
+padding possibly added by the driver, e.g., for RGB formats, is not counted).
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <vector>
+#include <iostream>
+
+#include <utils/gl_state.h>
+
+// format and size of a render target (the parameters of glTexImage2D)
+struct RenderTargetDesc {
+    GLenum internalFormat;
+    GLenum format;
+    GLenum type;
+    GLsizei width;
+    GLsizei height;
+
+    bool operator==(const RenderTargetDesc &other) const
+    {
+        return this->internalFormat == other.internalFormat && this->format == other.format && this->type == other.type &&
+               this->width == other.width && this->height == other.height;
+    }
+};
+
+// texture of a render target, and the framebuffer having it as color attachment 0
+struct RenderTarget {
+    GLuint texture = 0;
+    GLuint framebuffer = 0;
+};
+
+/////////////////// RENDER TARGET POOL class ///////////////////////
+class RenderTargetPool
+{
+public:
+    // time (in seconds) after which a target not used by the frames is released
+    double idleTime = 2.0;
+
+    RenderTargetPool(const RenderTargetPool& copy) = delete; //disallow copy
+    RenderTargetPool& operator=(const RenderTargetPool &) = delete;
+
+    RenderTargetPool() {}
+
+    //////////////////////////////////////////
+    // it must be called at the beginning of each frame, with the current time in seconds:
+    // the targets idle for longer than idleTime are released
+    void BeginFrame(double time)
+    {
+        this->time = time;
+        for (size_t i = 0; i < this->entries.size(); )
+        {
+            Entry &entry = this->entries[i];
+            entry.usedInFrame = false;
+            if (!entry.acquired && time - entry.lastUse > this->idleTime)
+            {
+                this->deleteTarget(entry.target);
+                this->entries[i] = this->entries.back();
+                this->entries.pop_back();
+            }
+            else
+                i++;
+        }
+    }
+
+    //////////////////////////////////////////
+    // it returns a free target with the given description, allocating it if needed
+    RenderTarget Acquire(const RenderTargetDesc &desc)
+    {
+        for (Entry &entry : this->entries)
+        {
+            if (entry.acquired || !(entry.desc == desc))
+                continue;
+            entry.acquired = entry.usedInFrame = true;
+            entry.lastUse = this->time;
+            return entry.target;
+        }
+
+        Entry entry;
+        entry.desc = desc;
+        entry.target = this->createTarget(desc, entry.bytes);
+        entry.acquired = entry.usedInFrame = true;
+        entry.lastUse = this->time;
+        this->entries.push_back(entry);
+        return entry.target;
+    }
+
+    // the content of the target is not needed anymore: the target can be acquired again
+    void Release(const RenderTarget &target)
+    {
+        for (Entry &entry : this->entries)
+            if (entry.target.texture == target.texture)
+            {
+                entry.acquired = false;
+                entry.lastUse = this->time;
+                return;
+            }
+    }
+
+    //////////////////////////////////////////
+    // memory (in bytes) of all the allocated targets, and of the targets used in the current frame
+    size_t AllocatedBytes() const
+    {
+        size_t bytes = 0;
+        for (const Entry &entry : this->entries)
+            bytes += entry.bytes;
+        return bytes;
+    }
+    size_t FrameBytes() const
+    {
+        size_t bytes = 0;
+        for (const Entry &entry : this->entries)
+            if (entry.usedInFrame)
+                bytes += entry.bytes;
+        return bytes;
+    }
+    size_t AllocatedTargets() const { return this->entries.size(); }
+
+    //////////////////////////////////////////
+    // it releases all the targets
+    void Delete()
+    {
+        for (Entry &entry : this->entries)
+            this->deleteTarget(entry.target);
+        this->entries.clear();
+    }
+
+private:
+    struct Entry {
+        RenderTargetDesc desc;
+        RenderTarget target;
+        size_t bytes = 0;
+        bool acquired = false;
+        bool usedInFrame = false;
+        double lastUse = 0.0;
+    };
+
+    vector<Entry> entries;
+    double time = 0.0;
+
+    //////////////////////////////////////////
+    RenderTarget createTarget(const RenderTargetDesc &desc, size_t &bytes)
+    {
+        GLState &state = GLState::Get();
+        RenderTarget target;
+        glGenTextures(1, &target.texture);
+        state.BindTexture(0, GL_TEXTURE_2D, target.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, desc.format, desc.type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // size of a texel from the sizes (in bits) of its components
+        GLenum components[] = {GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE, GL_TEXTURE_DEPTH_SIZE};
+        GLint bits = 0;
+        for (GLenum component : components)
+        {
+            GLint size = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, component, &size);
+            bits += size;
+        }
+        bytes = (size_t)desc.width * desc.height * ((bits + 7) / 8);
+
+        glGenFramebuffers(1, &target.framebuffer);
+        state.BindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::RENDER_TARGET_POOL:: framebuffer of a " << desc.width << "x" << desc.height << " target is not complete" << endl;
+        return target;
+    }
+
+    void deleteTarget(const RenderTarget &target)
+    {
+        GLState::Get().ForgetFramebuffer(target.framebuffer);
+        GLState::Get().ForgetTexture(target.texture);
+        glDeleteFramebuffers(1, &target.framebuffer);
+        glDeleteTextures(1, &target.texture);
+    }
+};
@@ -1,6 +1,18 @@
 /*
 Shader class
 - loading Shader source code, Shader Program creation
+- reflection of the active uniforms at link time: the locations are stored in a table indexed by the hash of the name
+- typed setters (SetInt, SetFloat, SetVec3, SetMat4, ...) which skip the upload if the value is equal to the last one set
+- automatic assignment of a texture unit to each sampler: textures are bound by sampler name with BindTexture
+  (and of an image unit to each image of the compute programs, bound with BindImage)
+- programs and textures are bound through the state cache (utils/gl_state.h)
+- optional header of #define directives, inserted after the #version line of each stage (used by the specialized
+  variants of utils/shader_variants.h)
+- the linked programs are loaded from the on-disk cache of utils/program_cache.h if possible, and compiled otherwise
+- asynchronous compilation: with KHR_parallel_shader_compile all the programs are submitted at creation and compiled
+  by the driver threads, otherwise a program is compiled at its first use (or by CompilePending, e.g., in the
+  background of the first frames). The program is completed (errors check, reflection, setup function) only
+  when it is used, or when CompilePending finds its compilation finished
 
 N.B. ) adaptation of https://github.com/JoeyDeVries/LearnOpenGL/blob/master/includes/learnopengl/shader.h
 
@@ -17,9 +29,33 @@ using namespace std;
 
 // Std. Includes
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <cstring>
+#include <cstdint>
+#include <functional>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <utils/gl_state.h>
+#include <utils/hash.h>
+#include <utils/program_cache.h>
+
+// GL_KHR_parallel_shader_compile (not in the GLAD loader): only the completion query is used
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// counters of the uniform uploads of all the programs (issued, and skipped because the value did not change)
+struct UniformStats {
+    unsigned int uploads = 0;
+    unsigned int skipped = 0;
+};
 
 /////////////////// SHADER class ///////////////////////
 class Shader
@@ -27,10 +63,13 @@ class Shader
 public:
     GLuint Program;
 
+    Shader(const Shader& copy) = delete; //disallow copy
+    Shader& operator=(const Shader &) = delete;
+
     //////////////////////////////////////////
 
     //constructor
-    Shader(const GLchar* vertexPath, const GLchar* fragmentPath)
+    Shader(const GLchar* vertexPath, const GLchar* fragmentPath, const string &defines = "")
     {
         // Step 1: we retrieve shaders source code from provided filepaths
         string vertexCode;
@@ -54,59 +93,451 @@ public:
             vShaderFile.close();
             fShaderFile.close();
             // Convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            vertexCode = insertDefines(vShaderStream.str(), defines);
+            fragmentCode = insertDefines(fShaderStream.str(), defines);
         }
         catch (ifstream::failure e)
         {
             cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << endl;
         }
 
-        // Convert strings to char pointers
-        const GLchar* vShaderCode = vertexCode.c_str();
-        const GLchar * fShaderCode = fragmentCode.c_str();
-
-        // Step 2: we compile the shaders
-        GLuint vertex, fragment;
-
-        // Vertex Shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        // check compilation errors
-        checkCompileErrors(vertex, "VERTEX");
+        // Step 2: we load the program from the cache, or we submit (or defer) its compilation
+        this->stages = { make_pair(GL_VERTEX_SHADER, vertexCode), make_pair(GL_FRAGMENT_SHADER, fragmentCode) };
+        this->create();
+    }
 
-        // Fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        // check compilation errors
-        checkCompileErrors(fragment, "FRAGMENT");
+    // constructor of a compute program (it requires OpenGL 4.3)
+    Shader(const GLchar* computePath)
+    {
+        string computeCode;
+        ifstream cShaderFile;
+        cShaderFile.exceptions (ifstream::failbit | ifstream::badbit);
+        try
+        {
+            cShaderFile.open(computePath);
+            stringstream cShaderStream;
+            cShaderStream << cShaderFile.rdbuf();
+            cShaderFile.close();
+            computeCode = cShaderStream.str();
+        }
+        catch (const ifstream::failure&)
+        {
+            cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << endl;
+        }
 
-        // Step 3: Shader Program creation
-        this->Program = glCreateProgram();
-        glAttachShader(this->Program, vertex);
-        glAttachShader(this->Program, fragment);
-        glLinkProgram(this->Program);
-        // check linking errors
-        checkCompileErrors(this->Program, "PROGRAM");
+        this->stages = { make_pair(GL_COMPUTE_SHADER, computeCode) };
+        this->create();
+    }
 
-        // Step 4: we delete the shaders because they are linked to the Shader Program, and we do not need them anymore
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+    ~Shader()
+    {
+        this->removePending();
     }
 
     //////////////////////////////////////////
 
     // We activate the Shader Program as part of the current rendering process
-    void Use() { glUseProgram(this->Program); }
+    void Use()
+    {
+        this->Wait();
+        GLState::Get().UseProgram(this->Program);
+    }
 
     // We delete the Shader Program when application closes
-    void Delete() { glDeleteProgram(this->Program); }
+    void Delete()
+    {
+        this->removePending();
+        for (GLuint shader : this->shaders)
+            glDeleteShader(shader);
+        this->shaders.clear();
+        GLState::Get().ForgetProgram(this->Program);
+        glDeleteProgram(this->Program);
+    }
+
+    //////////////////////////////////////////
+    // Asynchronous compilation
+
+    // it returns true if the program can be used without waiting for its compilation
+    bool Ready()
+    {
+        if (this->status == COMPILING && ParallelCompile())
+        {
+            GLint completed = GL_FALSE;
+            glGetProgramiv(this->Program, GL_COMPLETION_STATUS_KHR, &completed);
+            if (completed)
+                this->complete();
+        }
+        return this->status == READY;
+    }
+
+    // it completes the program, compiling it (or waiting for its compilation) if needed
+    void Wait()
+    {
+        if (this->status == READY)
+            return;
+        if (this->status == NOT_SUBMITTED)
+            this->submit();
+        this->complete();
+    }
+
+    // it sets the function which initializes the uniforms of the program: it is applied now if the program is
+    // ready, otherwise when the program is completed (and again if it is set again, e.g., at a resolution change)
+    void Setup(function<void(Shader&)> setup)
+    {
+        this->setup = setup;
+        if (this->status == READY)
+            setup(*this);
+    }
+
+    // it completes the programs whose parallel compilation is finished, and it compiles at most count of the
+    // programs not submitted yet (without KHR_parallel_shader_compile). It returns the number of programs not ready
+    static size_t CompilePending(unsigned int count)
+    {
+        vector<Shader*> programs = PendingPrograms();
+        for (Shader *program : programs)
+        {
+            if (program->status == NOT_SUBMITTED && count > 0)
+            {
+                program->Wait();
+                count--;
+            }
+            else
+                program->Ready();
+        }
+        return PendingPrograms().size();
+    }
+
+    // programs created and not completed yet
+    static vector<Shader*>& PendingPrograms()
+    {
+        static vector<Shader*> programs;
+        return programs;
+    }
+
+    // the driver supports KHR_parallel_shader_compile (or its ARB version)
+    static bool ParallelCompile()
+    {
+        static int supported = -1;
+        if (supported < 0)
+        {
+            GLint count = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+            supported = 0;
+            for (GLint i = 0; i < count && !supported; i++)
+            {
+                const char *extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+                supported = strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 || strcmp(extension, "GL_ARB_parallel_shader_compile") == 0;
+            }
+        }
+        return supported != 0;
+    }
+
+    //////////////////////////////////////////
+    // Typed setters: the values are set with glProgramUniform, so the program does not need to be active
+    // Uniforms not used by the program are ignored (as with location -1)
+
+    void SetInt(const char *name, GLint value)
+    {
+        Uniform *u = this->find(name);
+        if (u && this->changed(*u, value))
+            glProgramUniform1i(this->Program, u->location, value);
+    }
+    void SetIVec2(const char *name, const glm::ivec2 &value)
+    {
+        Uniform *u = this->find(name);
+        if (u && this->changed(*u, value))
+            glProgramUniform2iv(this->Program, u->location, 1, glm::value_ptr(value));
+    }
+    void SetFloat(const char *name, GLfloat value)
+    {
+        Uniform *u = this->find(name);
+        if (u && this->changed(*u, value))
+            glProgramUniform1f(this->Program, u->location, value);
+    }
+    void SetVec2(const char *name, const glm::vec2 &value)
+    {
+        Uniform *u = this->find(name);
+        if (u && this->changed(*u, value))
+            glProgramUniform2fv(this->Program, u->location, 1, glm::value_ptr(value));
+    }
+    void SetVec3(const char *name, const glm::vec3 &value)
+    {
+        Uniform *u = this->find(name);
+        if (u && this->changed(*u, value))
+            glProgramUniform3fv(this->Program, u->location, 1, glm::value_ptr(value));
+    }
+    void SetVec4(const char *name, const glm::vec4 &value)
+    {
+        Uniform *u = this->find(name);
+        if (u && this->changed(*u, value))
+            glProgramUniform4fv(this->Program, u->location, 1, glm::value_ptr(value));
+    }
+    void SetMat3(const char *name, const glm::mat3 &value)
+    {
+        Uniform *u = this->find(name);
+        if (u && this->changed(*u, value))
+            glProgramUniformMatrix3fv(this->Program, u->location, 1, GL_FALSE, glm::value_ptr(value));
+    }
+    void SetMat4(const char *name, const glm::mat4 &value)
+    {
+        Uniform *u = this->find(name);
+        if (u && this->changed(*u, value))
+            glProgramUniformMatrix4fv(this->Program, u->location, 1, GL_FALSE, glm::value_ptr(value));
+    }
+
+    //////////////////////////////////////////
+    // it binds a texture to the unit assigned to a sampler of the program
+    void BindTexture(const char *sampler, GLenum target, GLuint texture)
+    {
+        GLint unit = this->SamplerUnit(sampler);
+        if (unit < 0)
+            return;
+        GLState::Get().BindTexture(unit, target, texture);
+    }
+
+    // it binds a level of a texture to the image unit assigned to an image of the program
+    void BindImage(const char *image, GLuint texture, GLenum access, GLenum format)
+    {
+        GLint unit = this->SamplerUnit(image);
+        if (unit < 0)
+            return;
+        glBindImageTexture(unit, texture, 0, GL_FALSE, 0, access, format);
+    }
+
+    // texture (or image) unit assigned to a sampler, or -1 if the program does not use it
+    GLint SamplerUnit(const char *sampler)
+    {
+        Uniform *u = this->find(sampler);
+        return u ? u->unit : -1;
+    }
+
+    // location of a uniform, or -1 if the program does not use it
+    GLint Location(const char *name)
+    {
+        Uniform *u = this->find(name);
+        return u ? u->location : -1;
+    }
+
+    static UniformStats& Stats()
+    {
+        static UniformStats stats;
+        return stats;
+    }
 
 private:
+    enum Status { NOT_SUBMITTED, COMPILING, READY };
+
+    Status status = NOT_SUBMITTED;
+    vector<pair<GLenum, string>> stages; // sources of the stages, until the program is completed
+    vector<GLuint> shaders;
+    uint64_t cacheKey = 0;
+    function<void(Shader&)> setup;
+
+    // uniform data retrieved by reflection, with the last value set (for non-array uniforms up to a mat4)
+    struct Uniform {
+        GLint location;
+        GLenum type;
+        GLint size;
+        GLint unit;
+        bool shadowValid;
+        unsigned char shadow[sizeof(glm::mat4)];
+    };
+    vector<Uniform> uniforms;
+    unordered_map<uint64_t, size_t> uniformTable;
+
     //////////////////////////////////////////
 
+    // FNV-1a hash of the uniform name: the lookups do not allocate any string
+    static uint64_t hashName(const char *name)
+    {
+        return fnv1a(name, strlen(name));
+    }
+
+    Uniform* find(const char *name)
+    {
+        this->Wait();
+        unordered_map<uint64_t, size_t>::iterator it = this->uniformTable.find(hashName(name));
+        return it != this->uniformTable.end() ? &this->uniforms[it->second] : nullptr;
+    }
+
+    // it compares the value with the shadowed one, updating it. Arrays are always uploaded
+    template<typename T>
+    bool changed(Uniform &u, const T &value)
+    {
+        if (u.size == 1 && u.shadowValid && memcmp(u.shadow, &value, sizeof(T)) == 0)
+        {
+            Stats().skipped++;
+            return false;
+        }
+        memcpy(u.shadow, &value, sizeof(T));
+        u.shadowValid = u.size == 1;
+        Stats().uploads++;
+        return true;
+    }
+
+    static bool isSampler(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_1D_SHADOW: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_CUBE_SHADOW:
+        case GL_SAMPLER_1D_ARRAY: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_2D_ARRAY_SHADOW:
+        case GL_SAMPLER_2D_MULTISAMPLE: case GL_SAMPLER_BUFFER: case GL_SAMPLER_2D_RECT:
+        case GL_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D: case GL_SAMPLER_CUBE_MAP_ARRAY:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // the #version directive must be the first one of the source
+    static string insertDefines(const string &code, const string &defines)
+    {
+        if (defines.empty())
+            return code;
+        size_t version = code.find("#version");
+        size_t position = version == string::npos ? 0 : code.find('\n', version);
+        if (position == string::npos)
+            return code + "\n" + defines;
+        position = version == string::npos ? 0 : position + 1;
+        return code.substr(0, position) + defines + code.substr(position);
+    }
+
+    static bool isImage(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_IMAGE_2D: case GL_IMAGE_3D: case GL_IMAGE_2D_ARRAY: case GL_IMAGE_CUBE:
+        case GL_INT_IMAGE_2D: case GL_UNSIGNED_INT_IMAGE_2D:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    //////////////////////////////////////////
+    // Reflection of the active uniforms (the ones in uniform blocks are skipped)
+    // Arrays are registered both as "name" and "name[0]"; the samplers get consecutive texture units, and the images
+    // consecutive image units
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(this->Program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(this->Program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        vector<GLchar> name(maxLength + 1);
+        GLint nextUnit = 0, nextImageUnit = 0;
+        for (GLint i = 0; i < count; i++)
+        {
+            Uniform u;
+            glGetActiveUniform(this->Program, i, (GLsizei)name.size(), nullptr, &u.size, &u.type, name.data());
+            u.location = glGetUniformLocation(this->Program, name.data());
+            if (u.location < 0)
+                continue;
+            u.unit = -1;
+            u.shadowValid = false;
+            if (isSampler(u.type))
+            {
+                u.unit = nextUnit;
+                for (GLint j = 0; j < u.size; j++)
+                    glProgramUniform1i(this->Program, u.location + j, nextUnit++);
+            }
+            else if (isImage(u.type))
+            {
+                u.unit = nextImageUnit;
+                for (GLint j = 0; j < u.size; j++)
+                    glProgramUniform1i(this->Program, u.location + j, nextImageUnit++);
+            }
+            this->uniforms.push_back(u);
+
+            string fullName = name.data();
+            size_t bracket = fullName.find('[');
+            this->addName(fullName, this->uniforms.size() - 1);
+            if (bracket != string::npos)
+                this->addName(fullName.substr(0, bracket), this->uniforms.size() - 1);
+        }
+    }
+
+    void addName(const string &name, size_t index)
+    {
+        if (!this->uniformTable.insert(make_pair(hashName(name.c_str()), index)).second)
+            cout << "WARNING::SHADER:: hash collision for uniform " << name << endl;
+    }
+
+    //////////////////////////////////////////
+
+    // it loads the program from the cache, or it starts its compilation (deferred to the first use without
+    // KHR_parallel_shader_compile)
+    void create()
+    {
+        this->Program = glCreateProgram();
+        ProgramCache &cache = ProgramCache::Get();
+        vector<string> sources;
+        for (const pair<GLenum, string> &stage : this->stages)
+            sources.push_back(stage.second);
+        this->cacheKey = cache.Key(sources);
+        if (cache.Load(this->Program, this->cacheKey))
+        {
+            this->status = COMPILING;
+            this->complete();
+            return;
+        }
+        PendingPrograms().push_back(this);
+        if (ParallelCompile())
+            this->submit();
+    }
+
+    // it compiles the stages and links them in the program, without waiting for the results
+    void submit()
+    {
+        for (const pair<GLenum, string> &stage : this->stages)
+        {
+            const GLchar* code = stage.second.c_str();
+            GLuint shader = glCreateShader(stage.first);
+            glShaderSource(shader, 1, &code, NULL);
+            glCompileShader(shader);
+            glAttachShader(this->Program, shader);
+            this->shaders.push_back(shader);
+        }
+        ProgramCache::Get().PrepareLink(this->Program);
+        glLinkProgram(this->Program);
+        this->status = COMPILING;
+    }
+
+    // it checks the compilation and linking errors (waiting for the compilation, if it is not finished), stores the
+    // program in the cache, retrieves the active uniforms and applies the setup function
+    void complete()
+    {
+        const char *types[] = { "VERTEX", "FRAGMENT", "COMPUTE" };
+        for (size_t i = 0; i < this->shaders.size(); i++)
+        {
+            GLenum stage = this->stages[i].first;
+            checkCompileErrors(this->shaders[i], types[stage == GL_VERTEX_SHADER ? 0 : stage == GL_FRAGMENT_SHADER ? 1 : 2]);
+        }
+        if (!this->shaders.empty())
+        {
+            checkCompileErrors(this->Program, "PROGRAM");
+            // we delete the shaders because they are linked to the Shader Program, and we do not need them anymore
+            for (GLuint shader : this->shaders)
+                glDeleteShader(shader);
+            this->shaders.clear();
+            ProgramCache::Get().Store(this->Program, this->cacheKey);
+        }
+        this->stages.clear();
+        this->removePending();
+        this->status = READY;
+
+        // we retrieve the active uniforms, and we assign the texture units to the samplers
+        reflectUniforms();
+        if (this->setup)
+            this->setup(*this);
+    }
+
+    void removePending()
+    {
+        vector<Shader*> &programs = PendingPrograms();
+        programs.erase(remove(programs.begin(), programs.end(), this), programs.end());
+    }
+
     // Check compilation and linking errors
     void checkCompileErrors(GLuint shader, string type)
 	{
@@ -0,0 +1,122 @@
+/*
+ShaderVariants class
+- permutations of a vertex/fragment program: each variant is compiled with a header of #define directives
+  (e.g., KERNEL_SIZE 64), which the shaders use in place of the corresponding uniforms
+- the variants are compiled at the first request, and cached by their header
+- the generic program (compiled without defines) is used when the specialization is disabled
+
+With compile-time constants the driver can unroll the loops over the samples and fold the constants, at the cost of
+a compilation for each new combination of values (e.g., each value of a slider).
+The uniforms set once (e.g., the projection matrix) are set on all the variants by the setup function: it is applied
+to the existing variants when it is set, and to each new variant after its compilation (the generic program may
+still be compiling: its uniforms are set when it is completed, see utils/shader.h).
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+#include <utils/shader.h>
+
+// macros of a variant: (name, value) pairs
+typedef vector<pair<string, string>> ShaderDefines;
+
+/////////////////// SHADER VARIANTS class ///////////////////////
+class ShaderVariants
+{
+public:
+    ShaderVariants(const ShaderVariants& copy) = delete; //disallow copy
+    ShaderVariants& operator=(const ShaderVariants &) = delete;
+
+    ShaderVariants(const GLchar* vertexPath, const GLchar* fragmentPath)
+        : vertexPath(vertexPath), fragmentPath(fragmentPath), generic(vertexPath, fragmentPath) {}
+
+    //////////////////////////////////////////
+    Shader& Generic() { return this->generic; }
+
+    // it returns the variant specialized with the defines (the generic program if there are none)
+    Shader& Get(const ShaderDefines &defines)
+    {
+        if (defines.empty())
+            return this->generic;
+        string header = Header(defines);
+        unordered_map<string, unique_ptr<Shader>>::iterator it = this->variants.find(header);
+        if (it != this->variants.end())
+            return *it->second;
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        unique_ptr<Shader> &variant = this->variants[header];
+        variant.reset(new Shader(this->vertexPath.c_str(), this->fragmentPath.c_str(), header));
+        if (this->setup)
+            variant->Setup(this->setup);
+        // the variant is used as soon as it is requested
+        variant->Wait();
+        double compileTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "SHADER_VARIANTS:: " << this->fragmentPath << " [" << Describe(defines) << "] compiled in "
+             << compileTime << " ms" << endl;
+        return *variant;
+    }
+
+    //////////////////////////////////////////
+    // it sets the function which initializes the uniforms of the programs, for the generic program and the
+    // variants already compiled, and for the variants compiled later
+    void Setup(function<void(Shader&)> setup)
+    {
+        this->setup = setup;
+        this->generic.Setup(setup);
+        for (auto &entry : this->variants)
+            entry.second->Setup(setup);
+    }
+
+    size_t Count() const { return this->variants.size(); }
+
+    //////////////////////////////////////////
+    // header inserted after the #version directive, one #define for each macro
+    static string Header(const ShaderDefines &defines)
+    {
+        string header;
+        for (const pair<string, string> &define : defines)
+            header += "#define " + define.first + " " + define.second + "\n";
+        return header;
+    }
+
+    // short description of a variant, for logs and statistics (e.g., "KERNEL_SIZE=64 RESOLUTION=ivec2(640, 480)")
+    static string Describe(const ShaderDefines &defines)
+    {
+        stringstream description;
+        for (size_t i = 0; i < defines.size(); i++)
+            description << (i > 0 ? " " : "") << defines[i].first << "=" << defines[i].second;
+        return description.str();
+    }
+
+    //////////////////////////////////////////
+    void Delete()
+    {
+        this->generic.Delete();
+        for (auto &entry : this->variants)
+            entry.second->Delete();
+        this->variants.clear();
+    }
+
+private:
+    string vertexPath, fragmentPath;
+    Shader generic;
+    // variants, indexed by their header (the header is the whole difference between two variants, so the lookup
+    // compares it in full)
+    unordered_map<string, unique_ptr<Shader>> variants;
+    function<void(Shader&)> setup;
+};
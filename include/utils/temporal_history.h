@@ -0,0 +1,118 @@
+/*
+TemporalHistory class
+- pair of render targets used as the history of a temporal accumulation pass: at each frame the pass reads the
+  target written in the previous frame, and writes the other one (ping-pong)
+- each target has two RGBA16F color attachments, drawn together by the pass (e.g., the accumulated value, and
+  the data used to validate the history in the following frame)
+- validity of the history: it is not valid after an allocation, or when the application invalidates it (e.g.,
+  when the accumulated technique or its parameters change)
+
+Unlike the transient targets of the RenderTargetPool, the content of the targets is preserved across frames: they
+are imported in the RenderGraph, updating their textures and framebuffers at each frame after Swap.
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <iostream>
+
+#include <utils/gl_state.h>
+
+/////////////////// TEMPORAL HISTORY class ///////////////////////
+class TemporalHistory
+{
+public:
+    // number of color attachments of each target
+    static const int ATTACHMENTS = 2;
+
+    TemporalHistory(const TemporalHistory& copy) = delete; //disallow copy
+    TemporalHistory& operator=(const TemporalHistory &) = delete;
+
+    TemporalHistory() {}
+
+    //////////////////////////////////////////
+    // it (re)allocates the targets if their size is different, invalidating the history
+    void Resize(GLsizei width, GLsizei height)
+    {
+        if (width == this->width && height == this->height)
+            return;
+        this->Delete();
+        this->width = width;
+        this->height = height;
+
+        GLState &state = GLState::Get();
+        GLenum drawBuffers[ATTACHMENTS];
+        for (int i = 0; i < 2; i++)
+        {
+            glGenTextures(ATTACHMENTS, this->textures[i]);
+            glGenFramebuffers(1, &this->framebuffers[i]);
+            state.BindFramebuffer(GL_FRAMEBUFFER, this->framebuffers[i]);
+            for (int a = 0; a < ATTACHMENTS; a++)
+            {
+                state.BindTexture(0, GL_TEXTURE_2D, this->textures[i][a]);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + a, GL_TEXTURE_2D, this->textures[i][a], 0);
+                drawBuffers[a] = GL_COLOR_ATTACHMENT0 + a;
+            }
+            state.DrawBuffers(ATTACHMENTS, drawBuffers);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                cout << "ERROR::TEMPORAL_HISTORY:: framebuffer of a " << width << "x" << height << " history is not complete" << endl;
+        }
+        this->current = 0;
+        this->valid = false;
+    }
+
+    // it must be called at the beginning of each frame: the target written in the previous frame becomes the history
+    void Swap() { this->current = 1 - this->current; }
+
+    //////////////////////////////////////////
+    // history written in the previous frame, and target of the current frame
+    GLuint ReadTexture(int attachment) const { return this->textures[1 - this->current][attachment]; }
+    GLuint WriteTexture(int attachment) const { return this->textures[this->current][attachment]; }
+    GLuint WriteFramebuffer() const { return this->framebuffers[this->current]; }
+    GLsizei Width() const { return this->width; }
+    GLsizei Height() const { return this->height; }
+
+    //////////////////////////////////////////
+    // the history can be used if it has been written in the previous frame with the same configuration:
+    // the application marks it as valid after the frames writing it, and invalidates it otherwise
+    bool Valid() const { return this->valid; }
+    void MarkValid() { this->valid = true; }
+    void Invalidate() { this->valid = false; }
+
+    //////////////////////////////////////////
+    // it releases the targets
+    void Delete()
+    {
+        if (this->width == 0)
+            return;
+        GLState &state = GLState::Get();
+        for (int i = 0; i < 2; i++)
+        {
+            state.ForgetFramebuffer(this->framebuffers[i]);
+            for (int a = 0; a < ATTACHMENTS; a++)
+                state.ForgetTexture(this->textures[i][a]);
+            glDeleteFramebuffers(1, &this->framebuffers[i]);
+            glDeleteTextures(ATTACHMENTS, this->textures[i]);
+        }
+        this->width = this->height = 0;
+        this->valid = false;
+    }
+
+private:
+    GLuint textures[2][ATTACHMENTS] = {};
+    GLuint framebuffers[2] = {};
+    GLsizei width = 0, height = 0;
+    int current = 0;
+    bool valid = false;
+};
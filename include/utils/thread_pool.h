@@ -0,0 +1,117 @@
+/*
+ThreadPool class
+- a fixed set of worker threads consuming a FIFO queue of tasks
+- ParallelFor, to split an indexed loop across all the workers (the calling thread takes part in the work too)
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+/////////////////// THREAD POOL class ///////////////////////
+class ThreadPool
+{
+public:
+    ThreadPool(const ThreadPool& copy) = delete; //disallow copy
+    ThreadPool& operator=(const ThreadPool &) = delete;
+
+    // constructor: 0 threads means one per hardware core
+    ThreadPool(unsigned int numThreads = 0)
+    {
+        if (numThreads == 0)
+            numThreads = max(1u, thread::hardware_concurrency());
+        for (unsigned int i = 0; i < numThreads; i++)
+            this->workers.emplace_back([this]() { this->workerLoop(); });
+    }
+
+    // destructor: the pending tasks are completed before the workers are joined
+    ~ThreadPool()
+    {
+        {
+            lock_guard<mutex> lock(this->queueMutex);
+            this->stopping = true;
+        }
+        this->condition.notify_all();
+        for (thread &worker : this->workers)
+            worker.join();
+    }
+
+    unsigned int Size() const { return (unsigned int)this->workers.size(); }
+
+    //////////////////////////////////////////
+    // it adds a task to the queue. The returned future becomes ready when the task is completed
+    future<void> Submit(function<void()> task)
+    {
+        shared_ptr<packaged_task<void()>> packaged = make_shared<packaged_task<void()>>(std::move(task));
+        future<void> result = packaged->get_future();
+        {
+            lock_guard<mutex> lock(this->queueMutex);
+            this->tasks.emplace([packaged]() { (*packaged)(); });
+        }
+        this->condition.notify_one();
+        return result;
+    }
+
+    //////////////////////////////////////////
+    // it calls body(i) for each i in [0, count), distributing the indices dynamically among the workers and the calling thread
+    // it returns when all the iterations are completed
+    void ParallelFor(size_t count, const function<void(size_t)> &body)
+    {
+        if (count == 0)
+            return;
+        shared_ptr<atomic<size_t>> next = make_shared<atomic<size_t>>(0);
+        auto worker = [next, count, &body]() {
+            for (size_t i = (*next)++; i < count; i = (*next)++)
+                body(i);
+        };
+        vector<future<void>> helpers;
+        size_t numHelpers = min((size_t)this->Size(), count - 1);
+        for (size_t i = 0; i < numHelpers; i++)
+            helpers.push_back(this->Submit(worker));
+        worker();
+        for (future<void> &helper : helpers)
+            helper.get();
+    }
+
+private:
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex queueMutex;
+    condition_variable condition;
+    bool stopping = false;
+
+    //////////////////////////////////////////
+
+    void workerLoop()
+    {
+        for (;;)
+        {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(this->queueMutex);
+                this->condition.wait(lock, [this]() { return this->stopping || !this->tasks.empty(); });
+                if (this->stopping && this->tasks.empty())
+                    return;
+                task = std::move(this->tasks.front());
+                this->tasks.pop();
+            }
+            task();
+        }
+    }
+};
@@ -0,0 +1,283 @@
+/*
+TransformStore class
+- transformations of the entities of the scene (position, rotation quaternion and scale), stored as a structure of
+  arrays: one array for each component (positionX[], positionY[], ..., rotationW[], ..., scaleZ[])
+- the setters mark the entity as changed, and Update computes the world matrices and the normal matrices only of the
+  changed entities: in batches of 8 entities with AVX when compiled with AVX support (/arch:AVX or -mavx), with the
+  same operations in plain C++ otherwise. Setting useSIMD to false selects the plain C++ path
+- the world matrices of the previous frame are kept for the motion vectors
+- the matrices are shared by all the passes of the frame: each changed entity is transformed once per frame, whatever
+  the number of passes drawing it
+
+The world matrix is T * R * S, and the normal matrix (the inverse transpose of its upper 3x3) is computed without
+inversion as R * S^-1. NormalMatrix(entity, view) returns the normal matrix in view coordinates, valid for a view
+matrix without scale (e.g., the one of utils/camera.h).
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+/////////////////// TRANSFORM STORE class ///////////////////////
+class TransformStore
+{
+public:
+    typedef uint32_t Entity;
+    // entities transformed together (lanes of the SIMD path)
+    static const int BATCH = 8;
+
+#if defined(__AVX__)
+    static const char* SIMDName() { return "AVX"; }
+#else
+    static const char* SIMDName() { return "none"; }
+#endif
+
+    // batches transformed with the SIMD instructions (false: plain C++)
+    bool useSIMD = true;
+
+    TransformStore(const TransformStore& copy) = delete; //disallow copy
+    TransformStore& operator=(const TransformStore &) = delete;
+
+    TransformStore() {}
+
+    //////////////////////////////////////////
+    // it creates an entity: its matrices are computed by the next Update (its previous world matrix is the first one)
+    Entity Create(const glm::vec3 &position = glm::vec3(0.0f), const glm::quat &rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                  const glm::vec3 &scale = glm::vec3(1.0f))
+    {
+        Entity entity = (Entity)this->count++;
+        // the component arrays are padded to a multiple of BATCH, so the SIMD path always loads full batches
+        if (entity % BATCH == 0)
+        {
+            for (int c = 0; c < COMPONENTS; c++)
+                this->components[c].resize(entity + BATCH, c == ROTATION_W || c >= SCALE_X ? 1.0f : 0.0f);
+            this->dirtyBatches.push_back(0);
+        }
+        this->worldMatrices.emplace_back(1.0f);
+        this->previousWorldMatrices.emplace_back(1.0f);
+        this->normalMatrices.emplace_back(1.0f);
+        this->dirty.push_back(0);
+        this->created.push_back(1);
+        this->updated.push_back(0);
+        this->Set(entity, position, rotation, scale);
+        return entity;
+    }
+
+    // it removes the entities created after the first count ones
+    void Truncate(size_t count)
+    {
+        if (count >= this->count)
+            return;
+        this->count = count;
+        size_t padded = (count + BATCH - 1) / BATCH * BATCH;
+        for (int c = 0; c < COMPONENTS; c++)
+            this->components[c].resize(padded);
+        this->dirtyBatches.resize(padded / BATCH);
+        this->worldMatrices.resize(count);
+        this->previousWorldMatrices.resize(count);
+        this->normalMatrices.resize(count);
+        this->dirty.resize(count);
+        this->created.resize(count);
+        this->updated.resize(count);
+        this->updatedEntities.erase(remove_if(this->updatedEntities.begin(), this->updatedEntities.end(),
+                                              [count](Entity entity) { return entity >= count; }), this->updatedEntities.end());
+    }
+
+    //////////////////////////////////////////
+    void Set(Entity entity, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+    {
+        this->SetPosition(entity, position);
+        this->SetRotation(entity, rotation);
+        this->SetScale(entity, scale);
+    }
+
+    void SetPosition(Entity entity, const glm::vec3 &position)
+    {
+        this->setComponents(entity, POSITION_X, &position[0], 3);
+    }
+
+    // (the quaternion is normalized)
+    void SetRotation(Entity entity, const glm::quat &rotation)
+    {
+        glm::quat normalized = glm::normalize(rotation);
+        float values[4] = { normalized.x, normalized.y, normalized.z, normalized.w };
+        this->setComponents(entity, ROTATION_X, values, 4);
+    }
+
+    void SetScale(Entity entity, const glm::vec3 &scale)
+    {
+        this->setComponents(entity, SCALE_X, &scale[0], 3);
+    }
+
+    glm::vec3 Position(Entity entity) const { return glm::vec3(this->components[POSITION_X][entity], this->components[POSITION_Y][entity], this->components[POSITION_Z][entity]); }
+    glm::quat Rotation(Entity entity) const { return glm::quat(this->components[ROTATION_W][entity], this->components[ROTATION_X][entity], this->components[ROTATION_Y][entity], this->components[ROTATION_Z][entity]); }
+    glm::vec3 Scale(Entity entity) const { return glm::vec3(this->components[SCALE_X][entity], this->components[SCALE_Y][entity], this->components[SCALE_Z][entity]); }
+
+    //////////////////////////////////////////
+    // it computes the matrices of the entities changed since the last Update (once per frame, before the passes),
+    // and it returns their number. The previous world matrices become the ones of the last Update
+    size_t Update()
+    {
+        // the entities changed in the last Update, and not since then, have not moved in this frame
+        for (Entity entity : this->updatedEntities)
+        {
+            this->updated[entity] = 0;
+            if (!this->dirty[entity])
+                this->previousWorldMatrices[entity] = this->worldMatrices[entity];
+        }
+        this->updatedEntities.clear();
+        for (size_t batch = 0; batch < this->dirtyBatches.size(); batch++)
+        {
+            if (!this->dirtyBatches[batch])
+                continue;
+            this->dirtyBatches[batch] = 0;
+            size_t first = batch * BATCH, last = min(first + BATCH, this->count);
+            for (size_t i = first; i < last; i++)
+                if (this->dirty[i])
+                    this->previousWorldMatrices[i] = this->worldMatrices[i];
+            // (the entities of the batch not changed get the same matrices again)
+            this->computeBatch(first, last - first);
+            for (size_t i = first; i < last; i++)
+            {
+                if (!this->dirty[i])
+                    continue;
+                if (this->created[i])
+                    this->previousWorldMatrices[i] = this->worldMatrices[i];
+                this->dirty[i] = 0;
+                this->created[i] = 0;
+                this->updated[i] = 1;
+                this->updatedEntities.push_back((Entity)i);
+            }
+        }
+        return this->updatedEntities.size();
+    }
+
+    // entities whose matrices changed in the last Update
+    const vector<Entity>& UpdatedEntities() const { return this->updatedEntities; }
+    bool Updated(Entity entity) const { return this->updated[entity] != 0; }
+
+    const glm::mat4& WorldMatrix(Entity entity) const { return this->worldMatrices[entity]; }
+    const glm::mat4& PreviousWorldMatrix(Entity entity) const { return this->previousWorldMatrices[entity]; }
+    // normal matrix in world coordinates
+    const glm::mat3& WorldNormalMatrix(Entity entity) const { return this->normalMatrices[entity]; }
+    // normal matrix in view coordinates (for a view matrix without scale)
+    glm::mat3 NormalMatrix(Entity entity, const glm::mat4 &view) const { return glm::mat3(view) * this->normalMatrices[entity]; }
+    // world matrices of all the entities, in order (e.g., to copy them in an instance buffer)
+    const glm::mat4* WorldMatrices() const { return this->worldMatrices.data(); }
+
+    size_t Size() const { return this->count; }
+
+private:
+    enum { POSITION_X, POSITION_Y, POSITION_Z, ROTATION_X, ROTATION_Y, ROTATION_Z, ROTATION_W, SCALE_X, SCALE_Y, SCALE_Z, COMPONENTS };
+
+    size_t count = 0;
+    // one array for each component, padded to a multiple of BATCH
+    vector<float> components[COMPONENTS];
+    // flags of the changed entities, and of the batches with a changed entity
+    vector<uint8_t> dirty, created, dirtyBatches;
+    // flags of the entities updated by the last Update, and their list
+    vector<uint8_t> updated;
+    vector<Entity> updatedEntities;
+    // matrices of the entities
+    vector<glm::mat4> worldMatrices, previousWorldMatrices;
+    vector<glm::mat3> normalMatrices;
+
+    //////////////////////////////////////////
+    void setComponents(Entity entity, int first, const float *values, int numValues)
+    {
+        for (int c = 0; c < numValues; c++)
+            this->components[first + c][entity] = values[c];
+        this->dirty[entity] = 1;
+        this->dirtyBatches[entity / BATCH] = 1;
+    }
+
+    // columns of the rotation matrix of the quaternion (the same expressions as glm::mat3_cast) scaled by the scale
+    // (world matrix) and by its inverse (normal matrix): 9 + 9 values, followed by the position
+    void computeBatch(size_t first, size_t numEntities)
+    {
+        float results[21][BATCH];
+        const float *x = &this->components[ROTATION_X][first], *y = &this->components[ROTATION_Y][first];
+        const float *z = &this->components[ROTATION_Z][first], *w = &this->components[ROTATION_W][first];
+        const float *sx = &this->components[SCALE_X][first], *sy = &this->components[SCALE_Y][first], *sz = &this->components[SCALE_Z][first];
+#if defined(__AVX__)
+        if (this->useSIMD)
+        {
+            __m256 qx = _mm256_loadu_ps(x), qy = _mm256_loadu_ps(y), qz = _mm256_loadu_ps(z), qw = _mm256_loadu_ps(w);
+            __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f);
+            __m256 xx = _mm256_mul_ps(qx, qx), yy = _mm256_mul_ps(qy, qy), zz = _mm256_mul_ps(qz, qz);
+            __m256 xy = _mm256_mul_ps(qx, qy), xz = _mm256_mul_ps(qx, qz), yz = _mm256_mul_ps(qy, qz);
+            __m256 wx = _mm256_mul_ps(qw, qx), wy = _mm256_mul_ps(qw, qy), wz = _mm256_mul_ps(qw, qz);
+            __m256 rotation[9] = {
+                _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), _mm256_mul_ps(two, _mm256_add_ps(xy, wz)), _mm256_mul_ps(two, _mm256_sub_ps(xz, wy)),
+                _mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), _mm256_mul_ps(two, _mm256_add_ps(yz, wx)),
+                _mm256_mul_ps(two, _mm256_add_ps(xz, wy)), _mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy)))
+            };
+            __m256 scale[3] = { _mm256_loadu_ps(sx), _mm256_loadu_ps(sy), _mm256_loadu_ps(sz) };
+            for (int column = 0; column < 3; column++)
+            {
+                __m256 inverseScale = _mm256_div_ps(one, scale[column]);
+                for (int row = 0; row < 3; row++)
+                {
+                    _mm256_storeu_ps(results[column * 3 + row], _mm256_mul_ps(rotation[column * 3 + row], scale[column]));
+                    _mm256_storeu_ps(results[9 + column * 3 + row], _mm256_mul_ps(rotation[column * 3 + row], inverseScale));
+                }
+            }
+        }
+        else
+#endif
+        {
+            for (int i = 0; i < BATCH; i++)
+            {
+                float xx = x[i] * x[i], yy = y[i] * y[i], zz = z[i] * z[i];
+                float xy = x[i] * y[i], xz = x[i] * z[i], yz = y[i] * z[i];
+                float wx = w[i] * x[i], wy = w[i] * y[i], wz = w[i] * z[i];
+                float rotation[9] = {
+                    1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy),
+                    2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx),
+                    2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy)
+                };
+                float scale[3] = { sx[i], sy[i], sz[i] };
+                for (int column = 0; column < 3; column++)
+                {
+                    float inverseScale = 1.0f / scale[column];
+                    for (int row = 0; row < 3; row++)
+                    {
+                        results[column * 3 + row][i] = rotation[column * 3 + row] * scale[column];
+                        results[9 + column * 3 + row][i] = rotation[column * 3 + row] * inverseScale;
+                    }
+                }
+            }
+        }
+        for (int c = 0; c < 3; c++)
+            copy(&this->components[POSITION_X + c][first], &this->components[POSITION_X + c][first] + BATCH, results[18 + c]);
+
+        // the results are written in the matrices of the entities
+        for (size_t i = 0; i < numEntities; i++)
+        {
+            glm::mat4 &world = this->worldMatrices[first + i];
+            glm::mat3 &normal = this->normalMatrices[first + i];
+            for (int column = 0; column < 3; column++)
+            {
+                world[column] = glm::vec4(results[column * 3][i], results[column * 3 + 1][i], results[column * 3 + 2][i], 0.0f);
+                normal[column] = glm::vec3(results[9 + column * 3][i], results[9 + column * 3 + 1][i], results[9 + column * 3 + 2][i]);
+            }
+            world[3] = glm::vec4(results[18][i], results[19][i], results[20][i], 1.0f);
+        }
+    }
+};
@@ -0,0 +1,142 @@
+/*
+VertexLayout class
+- format of the vertex and index buffers created by the Mesh class (utils/mesh.h), from the fp32 Vertex arrays of the
+  import (the mesh cache saves the converted arrays, see utils/mesh_cache.h):
+    - positions: fp32, half floats, or 16 bit normalized integers in the bounding box of the mesh (the scale and bias
+      of the box are given to the vertex shaders as generic vertex attributes, see below)
+    - normals: fp32, or octahedral encoding in 2 x 16 bit snorm
+    - tangent frames (texture coordinates, tangent and bitangent): dropped, fp32, or packed (half float texture
+      coordinates, octahedral tangent and sign of the bitangent in 4 x 16 bit snorm)
+    - indices: 16 bit for the meshes with at most 65536 vertices, otherwise 32 bit
+    - positions in a separate stream (buffer) from the other attributes, so the passes reading only the positions
+      (e.g., the skybox) fetch a dense array
+- the CPU copies of the arrays of a mesh can be released after the upload
+
+The vertex shaders of the meshes must declare:
+    layout (location = 0) in vec3 position;
+    layout (location = 5) in vec3 positionScale;
+    layout (location = 6) in vec3 positionBias;
+and use (position * positionScale + positionBias) as position in model coordinates; Mesh::Draw sets the scale and
+the bias of each mesh (1 and 0 for the fp32 and half float positions). The normal is a vec2 to decode with
+octDecode() when the Defines() of the layout are inserted in the shader (OCTAHEDRAL_NORMALS).
+The packed tangent frame is decoded as: tangent = octDecode(tangent.xy), bitangent = tangent.z * cross(normal, tangent).
+
+The layout is the same for all the meshes of the application, accessed with VertexLayout::Get(): it must be set
+before the loading of the models (the meshes are converted by Model::Prepare) and the creation of the programs drawing
+them.
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+#pragma once
+
+using namespace std;
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+/////////////////// VERTEX LAYOUT class ///////////////////////
+class VertexLayout
+{
+public:
+    enum PositionFormat { POSITION_FLOAT, POSITION_HALF, POSITION_UNORM16 };
+    enum TangentFrame { TANGENT_NONE, TANGENT_FLOAT, TANGENT_PACKED };
+
+    // generic vertex attributes with the scale and the bias of the positions of the current mesh
+    static const GLuint POSITION_SCALE_LOCATION = 5;
+    static const GLuint POSITION_BIAS_LOCATION = 6;
+
+    // compact layout (12 bytes per vertex): the geometry passes read only the positions and the normals
+    PositionFormat positions = POSITION_UNORM16;
+    bool octahedralNormals = true;
+    TangentFrame tangentFrame = TANGENT_NONE;
+    bool shortIndices = true;
+    bool splitPositions = true;
+    bool keepCPUData = false;
+
+    // layout of the application
+    static VertexLayout& Get()
+    {
+        static VertexLayout layout;
+        return layout;
+    }
+
+    // full fp32 layout (56 bytes per vertex, interleaved), as the Vertex structure
+    static VertexLayout Full()
+    {
+        VertexLayout layout;
+        layout.positions = POSITION_FLOAT;
+        layout.octahedralNormals = false;
+        layout.tangentFrame = TANGENT_FLOAT;
+        layout.shortIndices = false;
+        layout.splitPositions = false;
+        layout.keepCPUData = true;
+        return layout;
+    }
+
+    // #define directives of the vertex shaders reading the normals
+    string Defines() const
+    {
+        return this->octahedralNormals ? "#define OCTAHEDRAL_NORMALS\n" : "";
+    }
+
+    //////////////////////////////////////////
+    // size in bytes of the position of a vertex (the half and normalized formats are padded to 4 components, so each
+    // attribute is 4 bytes aligned)
+    size_t PositionSize() const
+    {
+        return this->positions == POSITION_FLOAT ? 3 * sizeof(float) : 4 * sizeof(uint16_t);
+    }
+
+    // size in bytes of the other attributes of a vertex
+    size_t AttributesSize() const
+    {
+        size_t size = this->octahedralNormals ? 2 * sizeof(int16_t) : 3 * sizeof(float);
+        if (this->tangentFrame == TANGENT_FLOAT)
+            size += 8 * sizeof(float);
+        else if (this->tangentFrame == TANGENT_PACKED)
+            size += 2 * sizeof(uint16_t) + 4 * sizeof(int16_t);
+        return size;
+    }
+
+    // size in bytes of a vertex (when the positions are not split, the stream of the attributes includes them)
+    size_t VertexSize() const
+    {
+        return this->PositionSize() + this->AttributesSize();
+    }
+
+    //////////////////////////////////////////
+    // octahedral encoding of a unit vector, in [-1, 1]^2
+    // (see "A Survey of Efficient Representations for Independent Unit Vectors", Cigolle et al. - JCGT 2014)
+    static glm::vec2 OctEncode(glm::vec3 n)
+    {
+        float sum = fabs(n.x) + fabs(n.y) + fabs(n.z);
+        if (sum == 0.0f)
+            return glm::vec2(0.0f);
+        n /= sum;
+        glm::vec2 encoded(n.x, n.y);
+        // the lower hemisphere is folded on the corners of the square
+        if (n.z < 0.0f)
+            encoded = glm::vec2((1.0f - fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f), (1.0f - fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+        return encoded;
+    }
+
+    // octahedral decoding (the same as octDecode in the vertex shaders)
+    static glm::vec3 OctDecode(glm::vec2 e)
+    {
+        glm::vec3 n(e.x, e.y, 1.0f - fabs(e.x) - fabs(e.y));
+        float t = glm::max(-n.z, 0.0f);
+        n.x += n.x >= 0.0f ? -t : t;
+        n.y += n.y >= 0.0f ? -t : t;
+        return glm::normalize(n);
+    }
+};
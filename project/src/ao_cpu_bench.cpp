@@ -0,0 +1,190 @@
+/*
+Benchmark of the CPU ambient occlusion engine (utils/ao_cpu.h)
+
+It ray casts a synthetic G Buffer (a floor plane and a group of spheres, seen with the projection of the application),
+then it runs every technique with the SIMD kernels and with the scalar reference, printing the time per frame,
+the throughput in pixels*samples per second, the maximum difference between the two paths and the number of values
+(pixels, or channels for SSDO) which differ by more than the tolerance (1/256, a step of an 8 bit display).
+
+The two paths are not bit exact: the SIMD kernels use FMA where available and a different order of the sums, and UE4
+normalizes the product of the lengths instead of the two vectors. Measured on the synthetic scene (AVX2 and plain C++, from 640x480
+to 1920x1080, 16 to 128 samples):
+- HBAO steps the directions as the scalar code, so it differs only by rounding (below 1e-6)
+- the rounding differences of the other techniques stay below 1e-3, except UE4 with 128 samples and a small radius
+  (2e-3: the cosine of two short vectors is close to +-1, where the derivative of acos is large); Alchemy divides by
+  dot(ray, ray) + 1e-4, so it amplifies the rounding of the samples close to the pixel (up to 6e-4)
+- a few isolated pixels can differ by a whole sample (1/kernelSize, e.g. 1.6e-2 with 64 samples), when the position
+  of a sample falls on the edge of a texel, or its depth on the edge of the range check, and the two roundings select
+  a different texel or result. These are the values counted above the tolerance
+
+usage: AOBench.exe [--width W] [--height H] [--kernel-size N] [--radius R] [--directions N] [--steps N] [--threads N] [--runs N]
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+// Std. Includes
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <utils/ao_kernel.h>
+#include <utils/ao_cpu.h>
+
+// names of the CPU techniques
+const char* techniqueNames[] = { "CryEngine 2 / StarCraft II AO", "CryEngine 2 / StarCraft II AO (Depth Resolve)", "HBAO", "Alchemy AO", "Unreal Engine 4 AO", "SSDO" };
+
+// maximum difference between the SIMD and the scalar results which is not counted as a mismatch
+const float TOLERANCE = 1.0f / 256.0f;
+
+// synthetic G Buffer, bottom row first as in the OpenGL textures
+struct SyntheticScene {
+    vector<glm::vec3> positions;
+    vector<glm::vec3> normals;
+    vector<float> depth;
+};
+
+// ray casting of the view space scene; background texels keep the clear values used by the application
+void buildScene(SyntheticScene &scene, int width, int height, const glm::mat4 &projection)
+{
+    const glm::vec4 spheres[] = {
+        glm::vec4(0.0f, -1.0f, -25.0f, 4.0f), glm::vec4(-9.0f, -2.0f, -30.0f, 3.0f),
+        glm::vec4(8.0f, -3.0f, -22.0f, 2.0f), glm::vec4(3.0f, 2.5f, -38.0f, 6.0f)
+    };
+    const float floorY = -5.0f;
+    glm::mat4 invProjection = glm::inverse(projection);
+    scene.positions.assign((size_t)width * height, glm::vec3(0.8f));
+    scene.normals.assign((size_t)width * height, glm::vec3(0.8f));
+    scene.depth.assign((size_t)width * height, 1.0f);
+
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+        {
+            glm::vec4 target = invProjection * glm::vec4((x + 0.5f) / width * 2.0f - 1.0f, (y + 0.5f) / height * 2.0f - 1.0f, 1.0f, 1.0f);
+            glm::vec3 dir = glm::normalize(glm::vec3(target) / target.w);
+            float tMin = 1e30f;
+            glm::vec3 normal;
+            if (dir.y < 0.0f)
+            {
+                tMin = floorY / dir.y;
+                normal = glm::vec3(0.0f, 1.0f, 0.0f);
+            }
+            for (const glm::vec4 &s : spheres)
+            {
+                glm::vec3 center(s);
+                float b = glm::dot(dir, center);
+                float disc = b * b - glm::dot(center, center) + s.w * s.w;
+                if (disc < 0.0f)
+                    continue;
+                float t = b - sqrt(disc);
+                if (t > 0.0f && t < tMin)
+                {
+                    tMin = t;
+                    normal = (dir * t - center) / s.w;
+                }
+            }
+            glm::vec3 p = dir * tMin;
+            if (tMin > 1e29f || -p.z > 50.0f)
+                continue;
+            size_t i = (size_t)y * width + x;
+            glm::vec4 clip = projection * glm::vec4(p, 1.0f);
+            scene.positions[i] = p;
+            scene.normals[i] = normal;
+            scene.depth[i] = clip.z / clip.w * 0.5f + 0.5f;
+        }
+}
+
+double runTechnique(CPUAmbientOcclusion &engine, AOTechnique technique, const AOInput &input, const AOParameters &params, vector<float> &output, int runs)
+{
+    output.assign((size_t)input.width * input.height * CPUAmbientOcclusion::Channels(technique), 0.0f);
+    engine.Compute(technique, input, params, output.data()); // warmup
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++)
+        engine.Compute(technique, input, params, output.data());
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count() / runs;
+}
+
+/////////////////// MAIN function ///////////////////////
+int main(int argc, char **argv)
+{
+    int width = 1200, height = 900;
+    int kernelSize = 64, numDirections = 16, numSteps = 4, runs = 5;
+    unsigned int threads = 0;
+    float radius = 10.0f;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string option = argv[i];
+        int value = atoi(argv[i + 1]);
+        if (option == "--width") width = value;
+        else if (option == "--height") height = value;
+        else if (option == "--kernel-size") kernelSize = value;
+        else if (option == "--radius") radius = (float)atof(argv[i + 1]);
+        else if (option == "--directions") numDirections = value;
+        else if (option == "--steps") numSteps = value;
+        else if (option == "--threads") threads = (unsigned int)value;
+        else if (option == "--runs") runs = max(1, value);
+        else
+        {
+            cout << "Unknown option " << option << endl;
+            return -1;
+        }
+    }
+
+    AOParameters params;
+    params.kernelSize = kernelSize;
+    params.radius = radius;
+    params.bias = 0.1f;
+    params.numDirections = numDirections;
+    params.numSteps = numSteps;
+    params.projection = glm::perspective(45.0f, (float)width / (float)height, 0.1f, 50.0f);
+    params.invView = glm::mat4(1.0f);
+    generateNoise(params.noise);
+
+    SyntheticScene scene;
+    buildScene(scene, width, height, params.projection);
+    AOInput input = { width, height, scene.positions.data(), scene.normals.data(), scene.depth.data() };
+
+    CPUAmbientOcclusion engine(threads);
+    cout << "CPU AO benchmark: " << width << "x" << height << ", " << engine.Threads() << " threads, "
+         << aosimd::NAME << " (" << aosimd::WIDTH << " lanes)" << endl;
+    cout << fixed << setprecision(3);
+
+    vector<float> simd, scalar;
+    for (int t = 0; t < AO_CPU_TECHNIQUES_NUM; t++)
+    {
+        AOTechnique technique = (AOTechnique)t;
+        // CryEngine 2 derivates use the sphere kernel, the others the oriented hemisphere
+        if (technique == AO_CPU_SSAO || technique == AO_CPU_SSAO_RECONSTR)
+            generateSphereSamples(params.kernel, kernelSize);
+        else
+            generateHemiSphereSamples(params.kernel, kernelSize);
+
+        engine.useSIMD = true;
+        double simdTime = runTechnique(engine, technique, input, params, simd, runs);
+        engine.useSIMD = false;
+        double scalarTime = runTechnique(engine, technique, input, params, scalar, runs);
+
+        float maxDiff = 0.0f;
+        size_t mismatches = 0;
+        for (size_t i = 0; i < simd.size(); i++)
+        {
+            float diff = abs(simd[i] - scalar[i]);
+            maxDiff = max(maxDiff, diff);
+            mismatches += diff > TOLERANCE ? 1 : 0;
+        }
+        double work = (double)width * height * CPUAmbientOcclusion::SamplesPerPixel(technique, params);
+        cout << techniqueNames[t] << ":" << endl
+             << "    SIMD   " << simdTime * 1000.0 << " ms, " << work / simdTime / 1e6 << " Mpixel*samples/s" << endl
+             << "    scalar " << scalarTime * 1000.0 << " ms, " << work / scalarTime / 1e6 << " Mpixel*samples/s" << endl
+             << "    speedup " << scalarTime / simdTime << "x, max difference " << scientific << maxDiff << fixed
+             << ", " << mismatches << " values above the tolerance" << endl;
+    }
+    return 0;
+}
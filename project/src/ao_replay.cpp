@@ -0,0 +1,574 @@
+/*
+Replay of G Buffer captures (utils/gbuffer_capture.h) for offline profiling of the ambient occlusion passes
+
+A capture is saved by the application pressing C (or with the Capture button of the G Buffer Inspector, or
+with the --capture option). The replay maps the file in memory and runs a single AO pass over it in a tight loop,
+on the GPU (the shaders of the application) and/or on the CPU (utils/ao_cpu.h), without geometry pass,
+model loading or camera input. The parameters stored in the capture can be overridden from the command line.
+
+usage: AOReplay.exe capture.aogb [--mode N] [--gl] [--cpu] [--iterations N] [--kernel-size N] [--radius R] [--bias B]
+                                 [--directions N] [--steps N] [--threads N] [--downscale N] [--blur N] [--gather]
+--gl and --cpu select the implementations to run (default: --gl). When both are run, the results are compared.
+--blur N applies the bilateral blur of the application with radius N to the full resolution results (with --gather,
+the GL blur fetches the taps with textureGather, and the radius is rounded up to an even number).
+--downscale 2 (or 4) runs also the GL pass at half (or quarter) resolution, with the downsampling of the G Buffer and
+the joint bilateral upsampling of the application, and measures its difference from the full resolution result.
+The modes are the ones of the application (1 = CryEngine 2 AO, ..., 8 = SSDO, 9 = Deinterleaved HBAO): Deinterleaved
+HBAO runs the deinterleaving, the HBAO pass on the 4x4 layers and the interleaving back, and its CPU reference is HBAO.
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+// Std. Includes
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <memory>
+
+#ifdef _WIN32
+	#define APIENTRY __stdcall
+#endif
+
+#include <glad/glad.h>
+
+// GLFW library, used only if a surfaceless context is not available
+#include <glfw/glfw3.h>
+
+#ifdef _WINDOWS_
+	#error windows.h was included!
+#endif
+
+#include <utils/shader.h>
+#include <utils/headless.h>
+#include <utils/ao_kernel.h>
+#include <utils/kernel_buffer.h>
+#include <utils/ao_cpu.h>
+#include <utils/gbuffer_capture.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// AO passes, in the same order of the ssao modes of main.cpp
+struct ReplayTechnique {
+	const char *name;
+	const char *vertexShader;
+	const char *fragmentShader;
+	int cpuTechnique;
+	bool sphereKernel; // CryEngine 2 derivates use the sphere kernel, the others the oriented hemisphere
+	bool deinterleaved; // the AO pass runs on the 4x4 deinterleaved layers of the positions (see deinterleave.frag)
+};
+const ReplayTechnique techniques[] = {
+	{ "No Ambient Occlusion", nullptr, nullptr, -1, false, false },
+	{ "CryEngine 2 AO", "ssao.vert", "ssao.frag", AO_CPU_SSAO, true, false },
+	{ "CryEngine 2 AO with Depth Resolve", "ssao_reconstr.vert", "ssao_reconstr.frag", AO_CPU_SSAO_RECONSTR, true, false },
+	{ "StarCraft II AO", "ssao.vert", "ssao.frag", AO_CPU_SSAO, false, false },
+	{ "StarCraft II AO with Depth Resolve", "ssao_reconstr.vert", "ssao_reconstr.frag", AO_CPU_SSAO_RECONSTR, false, false },
+	{ "Horizon Based Ambient Occlusion (HBAO)", "ssao.vert", "hbao.frag", AO_CPU_HBAO, false, false },
+	{ "Alchemy AO", "ssao.vert", "alchemy_ao.frag", AO_CPU_ALCHEMY, false, false },
+	{ "Unreal Engine 4 AO", "ssao.vert", "ue4_ao.frag", AO_CPU_UE4, false, false },
+	{ "Screen Space Directional Occlusion (SSDO)", "ssao.vert", "ssdo.frag", AO_CPU_SSDO, false, false },
+	{ "Deinterleaved HBAO", "ssao.vert", "hbao_deinterleaved.frag", AO_CPU_HBAO, false, true }
+};
+const int REPLAY_MODES_NUM = sizeof(techniques) / sizeof(techniques[0]);
+
+// Function to draw a fullscreen quad
+void DrawQuad();
+
+// create a 2D texture with nearest filtering and clamp to edge, filled with the given data
+GLuint CreateTexture(GLint internalFormat, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *data);
+
+// create a framebuffer rendering into the given texture
+GLuint CreateFramebuffer(GLuint texture);
+
+// it prints the differences of an AO result from a reference one
+void PrintDifference(const char *label, const vector<float> &result, const vector<float> &reference);
+
+// it prints the statistics of a list of times in milliseconds
+void PrintTimes(const char *label, vector<double> times, double work);
+
+/////////////////// MAIN function ///////////////////////
+int main(int argc, char **argv)
+{
+	if (argc < 2) {
+		std::cout << "usage: " << argv[0] << " capture.aogb [--mode N] [--gl] [--cpu] [--iterations N] [--kernel-size N] [--radius R] [--bias B] [--directions N] [--steps N] [--threads N] [--downscale N] [--blur N] [--gather]" << std::endl;
+		return -1;
+	}
+	GBufferCapture capture;
+	if (!capture.Open(argv[1]))
+		return -1;
+	const GBufferCaptureInfo &info = capture.Info();
+	if (info.ssao_mode < 0 || info.ssao_mode >= REPLAY_MODES_NUM) {
+		std::cout << "ERROR::CAPTURE:: " << argv[1] << ": invalid ambient occlusion mode " << info.ssao_mode << std::endl;
+		return -1;
+	}
+
+	// Parameters of the capture, overridden by the command line options
+	int mode = info.ssao_mode, kernelSize = info.kernelSize, numDirections = info.numDirections, numSteps = info.numSteps;
+	float kernelRadius = info.kernelRadius, kernelBias = info.kernelBias;
+	int iterations = 100;
+	unsigned int threads = 0;
+	int downscale = 1, blurRadius = 0;
+	bool runGL = false, runCPU = false, newKernel = false, blurGather = false;
+	for (int i = 2; i < argc; i++) {
+		string option = argv[i];
+		if (option == "--gl") {
+			runGL = true;
+		} else if (option == "--cpu") {
+			runCPU = true;
+		} else if (option == "--gather") {
+			blurGather = true;
+		} else if (i + 1 < argc) {
+			const char *value = argv[++i];
+			if (option == "--mode") mode = atoi(value);
+			else if (option == "--iterations") iterations = max(1, atoi(value));
+			else if (option == "--kernel-size") { kernelSize = atoi(value); newKernel = true; }
+			else if (option == "--radius") kernelRadius = (float)atof(value);
+			else if (option == "--bias") kernelBias = (float)atof(value);
+			else if (option == "--directions") numDirections = atoi(value);
+			else if (option == "--steps") numSteps = atoi(value);
+			else if (option == "--threads") threads = (unsigned int)atoi(value);
+			else if (option == "--downscale") downscale = max(1, atoi(value));
+			else if (option == "--blur") blurRadius = max(0, atoi(value));
+			else {
+				std::cout << "Unknown option: " << option << std::endl;
+				return -1;
+			}
+		} else {
+			std::cout << "Unknown option: " << option << std::endl;
+			return -1;
+		}
+	}
+	if ((!runGL && !runCPU) || downscale > 1)
+		runGL = true;
+	// with textureGather, the GL blur fetches the taps in pairs
+	if (blurGather)
+		blurRadius = (blurRadius + 1) / 2 * 2;
+	if (mode <= 0 || mode >= REPLAY_MODES_NUM) {
+		std::cout << "Invalid ambient occlusion mode " << mode << std::endl;
+		return -1;
+	}
+	const ReplayTechnique &technique = techniques[mode];
+	// a different kernel size, or a technique using the other kind of kernel, needs new samples
+	if (mode != info.ssao_mode && techniques[info.ssao_mode].sphereKernel != technique.sphereKernel)
+		newKernel = true;
+	kernelSize = min(kernelSize, 256); // size of the kernel array in the shaders
+	vector<glm::vec3> kernel;
+	if (newKernel) {
+		if (technique.sphereKernel)
+			generateSphereSamples(kernel, kernelSize);
+		else
+			generateHemiSphereSamples(kernel, kernelSize);
+	} else {
+		kernel.assign(capture.Kernel(), capture.Kernel() + capture.KernelSize());
+		kernelSize = min(kernelSize, (int)kernel.size());
+	}
+
+	int width = info.width, height = info.height;
+	int channels = CPUAmbientOcclusion::Channels((AOTechnique)technique.cpuTechnique);
+	bool hbao = technique.cpuTechnique == AO_CPU_HBAO;
+	double work = (double)width * height * (hbao ? numDirections * numSteps : kernelSize);
+	std::cout << "Replaying " << argv[1] << " (" << width << "x" << height << "): " << technique.name << ", ";
+	if (hbao)
+		std::cout << numDirections << " directions, " << numSteps << " steps";
+	else
+		std::cout << kernelSize << " samples";
+	std::cout << ", radius " << kernelRadius << ", " << iterations << " iterations" << std::endl;
+
+	vector<float> glResult, cpuResult, lowResult;
+	if (runGL) {
+		// OpenGL context: surfaceless if possible, otherwise an invisible window
+		GLFWwindow* window = nullptr;
+		HeadlessContext headlessContext;
+		bool contextReady = headlessContext.Create(4, 1) && gladLoadGLLoader((GLADloadproc) HeadlessContext::GetProcAddress);
+		if (!contextReady) {
+			glfwInit();
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+			glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+			glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+			glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+			window = glfwCreateWindow(width, height, "AO Replay", nullptr, nullptr);
+			if (window) {
+				glfwMakeContextCurrent(window);
+				contextReady = gladLoadGLLoader((GLADloadproc) glfwGetProcAddress) != 0;
+			}
+		}
+		if (!contextReady) {
+			std::cout << "Failed to initialize OpenGL context" << std::endl;
+			return -1;
+		}
+		std::cout << "OpenGL renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+		// G Buffer textures, with the same formats of the application, uploaded straight from the mapped file
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		GLuint gPosition = CreateTexture(GL_RGB16F, width, height, GL_RGB, GL_FLOAT, capture.Positions());
+		GLuint gNormal = CreateTexture(GL_RGB16F, width, height, GL_RGB, GL_FLOAT, capture.Normals());
+		GLuint gDepthBuffer = CreateTexture(GL_DEPTH_COMPONENT, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, capture.Depth());
+		GLuint noiseTexture = CreateTexture(GL_RGBA32F, 4, 4, GL_RGB, GL_FLOAT, capture.Noise());
+		glBindTexture(GL_TEXTURE_2D, noiseTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		// SSDO samples the skybox: a white cube map, as the sky light of the CPU engine
+		GLuint whiteCube;
+		glGenTextures(1, &whiteCube);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, whiteCube);
+		unsigned char white[3] = { 255, 255, 255 };
+		for (int face = 0; face < 6; face++)
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, white);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		// AO buffer, with the same format of the application
+		GLenum aoFormat = channels == 3 ? GL_RGB : GL_RED;
+		GLuint aoBuffer = CreateTexture(aoFormat, width, height, aoFormat, GL_FLOAT, nullptr);
+		GLuint aoFBO = CreateFramebuffer(aoBuffer);
+
+		// AO pass and its uniforms (the ones not declared by the shader are ignored)
+		Shader aoPass(technique.vertexShader, technique.fragmentShader);
+		const glm::mat4 &projection = capture.Projection();
+		aoPass.SetMat4("projectionMatrix", projection);
+		aoPass.SetMat4("invProjectionMatrix", glm::inverse(projection));
+		aoPass.SetMat4("invViewMatrix", glm::inverse(capture.View()));
+		aoPass.SetFloat("gAspectRatio", (float)width / (float)height);
+		aoPass.SetFloat("gTanFOV", tan(info.fov));
+		aoPass.SetInt("kernelSize", kernelSize);
+		aoPass.SetFloat("radius", kernelRadius);
+		aoPass.SetFloat("bias", kernelBias);
+		aoPass.SetInt("numDirections", numDirections);
+		aoPass.SetFloat("sampleRadius", kernelRadius);
+		aoPass.SetInt("numSteps", numSteps);
+		KernelBuffer kernelBuffer;
+		kernelBuffer.Create();
+		kernelBuffer.AttachProgram(aoPass.Program);
+		kernelBuffer.Update(kernel);
+
+		// Deinterleaved HBAO (as in the application): the positions are split in 4x4 layers, the AO pass runs on the
+		// atlas of the layers, and its result is interleaved back (the atlas is created again when the size changes)
+		std::unique_ptr<Shader> deinterleavePass(technique.deinterleaved ? new Shader("ssao.vert", "deinterleave.frag") : nullptr);
+		GLuint atlasPosition = 0, atlasAO = 0, atlasPositionFBO = 0, atlasAOFBO = 0;
+		int atlasWidth = 0, atlasHeight = 0;
+		auto releaseAtlas = [&]() {
+			if (!atlasPosition)
+				return;
+			GLuint atlasFBOs[] = { atlasPositionFBO, atlasAOFBO };
+			glDeleteFramebuffers(2, atlasFBOs);
+			GLuint atlasTextures[] = { atlasPosition, atlasAO };
+			glDeleteTextures(2, atlasTextures);
+			atlasPosition = 0;
+		};
+		// it runs the AO pass on the given positions (or depth buffer) and normals, into the given framebuffer
+		bool reconstr = technique.cpuTechnique == AO_CPU_SSAO_RECONSTR;
+		auto drawAO = [&](GLuint source, GLuint normals, GLuint fbo, int passWidth, int passHeight) {
+			if (!technique.deinterleaved) {
+				aoPass.Use();
+				aoPass.BindTexture(reconstr ? "gDepthMap" : "gPosition", GL_TEXTURE_2D, source);
+				aoPass.BindTexture("gNormal", GL_TEXTURE_2D, normals);
+				aoPass.BindTexture("noiseTexture", GL_TEXTURE_2D, noiseTexture);
+				aoPass.BindTexture("skybox", GL_TEXTURE_CUBE_MAP, whiteCube);
+				glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+				glClear(GL_COLOR_BUFFER_BIT);
+				DrawQuad();
+				return;
+			}
+			if (passWidth != atlasWidth || passHeight != atlasHeight) {
+				releaseAtlas();
+				atlasPosition = CreateTexture(GL_RGB16F, passWidth, passHeight, GL_RGB, GL_FLOAT, nullptr);
+				atlasAO = CreateTexture(aoFormat, passWidth, passHeight, aoFormat, GL_FLOAT, nullptr);
+				atlasPositionFBO = CreateFramebuffer(atlasPosition);
+				atlasAOFBO = CreateFramebuffer(atlasAO);
+				atlasWidth = passWidth;
+				atlasHeight = passHeight;
+				// the textures have been bound outside the state cache used by the Shader class
+				GLState::Get().Invalidate();
+			}
+			deinterleavePass->Use();
+			deinterleavePass->SetInt("reinterleave", 0);
+			deinterleavePass->BindTexture("source", GL_TEXTURE_2D, source);
+			glBindFramebuffer(GL_FRAMEBUFFER, atlasPositionFBO);
+			DrawQuad();
+			aoPass.Use();
+			aoPass.BindTexture("gPosition", GL_TEXTURE_2D, atlasPosition);
+			aoPass.BindTexture("gNormal", GL_TEXTURE_2D, normals);
+			aoPass.BindTexture("noiseTexture", GL_TEXTURE_2D, noiseTexture);
+			glBindFramebuffer(GL_FRAMEBUFFER, atlasAOFBO);
+			glClear(GL_COLOR_BUFFER_BIT);
+			DrawQuad();
+			deinterleavePass->Use();
+			deinterleavePass->SetInt("reinterleave", 1);
+			deinterleavePass->BindTexture("source", GL_TEXTURE_2D, atlasAO);
+			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+			DrawQuad();
+		};
+		glViewport(0, 0, width, height);
+		glDisable(GL_DEPTH_TEST);
+
+		// each iteration is measured once the GPU has completed it, as in the benchmark of the application
+		vector<double> times;
+		for (int i = 0; i <= iterations; i++) {
+			auto start = chrono::steady_clock::now();
+			drawAO(reconstr ? gDepthBuffer : gPosition, gNormal, aoFBO, width, height);
+			glFinish();
+			if (i > 0) // the first iteration includes the shader warm up
+				times.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+		}
+		PrintTimes("GL ", times, work);
+
+		glResult.resize((size_t)width * height * channels);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, aoFormat, GL_FLOAT, glResult.data());
+
+		if (downscale > 1) {
+			// Low resolution G Buffer, AO buffer, and upsampled AO buffer (same formats of the application)
+			int lowWidth = max(1, width / downscale), lowHeight = max(1, height / downscale);
+			GLuint lowSource = CreateTexture(reconstr ? GL_R32F : GL_RGB16F, lowWidth, lowHeight, reconstr ? GL_RED : GL_RGB, GL_FLOAT, nullptr);
+			GLuint lowNormal = CreateTexture(GL_RGBA16F, lowWidth, lowHeight, GL_RGBA, GL_FLOAT, nullptr);
+			GLuint lowBuffer = CreateTexture(aoFormat, lowWidth, lowHeight, aoFormat, GL_FLOAT, nullptr);
+			GLuint lowSourceFBO = CreateFramebuffer(lowSource), lowNormalFBO = CreateFramebuffer(lowNormal), lowFBO = CreateFramebuffer(lowBuffer);
+			// the textures have been bound outside the state cache used by the Shader class
+			GLState::Get().Invalidate();
+			Shader downsamplePass("ssao.vert", "downsample.frag");
+			Shader upsamplePass("ssao.vert", "upsample.frag");
+			downsamplePass.SetMat4("projectionMatrix", projection);
+			downsamplePass.SetInt("factor", downscale);
+			upsamplePass.SetMat4("projectionMatrix", projection);
+			upsamplePass.SetFloat("depthSigma", 0.1f);
+
+			// each iteration runs the whole low resolution path: downsampling, AO pass and upsampling
+			// (the programs share the texture units, so each pass binds its textures before drawing)
+			times.clear();
+			for (int i = 0; i <= iterations; i++) {
+				auto start = chrono::steady_clock::now();
+				glViewport(0, 0, lowWidth, lowHeight);
+				downsamplePass.Use();
+				downsamplePass.BindTexture("gDepthMap", GL_TEXTURE_2D, gDepthBuffer);
+				glBindFramebuffer(GL_FRAMEBUFFER, lowNormalFBO);
+				downsamplePass.SetInt("storeDepth", 1);
+				downsamplePass.BindTexture("source", GL_TEXTURE_2D, gNormal);
+				DrawQuad();
+				glBindFramebuffer(GL_FRAMEBUFFER, lowSourceFBO);
+				downsamplePass.SetInt("storeDepth", 0);
+				downsamplePass.BindTexture("source", GL_TEXTURE_2D, reconstr ? gDepthBuffer : gPosition);
+				DrawQuad();
+				drawAO(lowSource, lowNormal, lowFBO, lowWidth, lowHeight);
+				glViewport(0, 0, width, height);
+				upsamplePass.Use();
+				upsamplePass.BindTexture("image", GL_TEXTURE_2D, lowBuffer);
+				upsamplePass.BindTexture("lowNormalDepth", GL_TEXTURE_2D, lowNormal);
+				upsamplePass.BindTexture("gDepthMap", GL_TEXTURE_2D, gDepthBuffer);
+				upsamplePass.BindTexture("gNormal", GL_TEXTURE_2D, gNormal);
+				glBindFramebuffer(GL_FRAMEBUFFER, aoFBO);
+				DrawQuad();
+				glFinish();
+				if (i > 0)
+					times.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+			}
+			string label = "GL 1/" + to_string(downscale);
+			PrintTimes(label.c_str(), times, work);
+
+			lowResult.resize(glResult.size());
+			glReadPixels(0, 0, width, height, aoFormat, GL_FLOAT, lowResult.data());
+			PrintDifference((label + " resolution vs full resolution").c_str(), lowResult, glResult);
+
+			downsamplePass.Delete();
+			upsamplePass.Delete();
+			GLuint lowFBOs[] = { lowSourceFBO, lowNormalFBO, lowFBO };
+			glDeleteFramebuffers(3, lowFBOs);
+			GLuint lowTextures[] = { lowSource, lowNormal, lowBuffer };
+			glDeleteTextures(3, lowTextures);
+		}
+
+		if (blurRadius > 0) {
+			// horizontal pass into a temporary buffer, vertical pass into the AO buffer
+			GLuint blurBuffer = CreateTexture(aoFormat, width, height, aoFormat, GL_FLOAT, nullptr);
+			GLuint blurFBO = CreateFramebuffer(blurBuffer);
+			GLState::Get().Invalidate();
+			Shader blurPass("ssao.vert", "bilateral_blur.frag");
+			blurPass.SetMat4("projectionMatrix", projection);
+			blurPass.SetInt("radius", blurRadius);
+			blurPass.SetInt("useGather", blurGather);
+			blurPass.SetInt("channels", channels);
+			blurPass.SetFloat("depthSigma", 0.1f);
+			glViewport(0, 0, width, height);
+			blurPass.Use();
+			blurPass.BindTexture("gDepthMap", GL_TEXTURE_2D, gDepthBuffer);
+			blurPass.BindTexture("gNormal", GL_TEXTURE_2D, gNormal);
+
+			times.clear();
+			for (int i = 0; i <= iterations; i++) {
+				auto start = chrono::steady_clock::now();
+				// the AO pass is run again, so that each iteration blurs its result
+				drawAO(reconstr ? gDepthBuffer : gPosition, gNormal, aoFBO, width, height);
+				blurPass.Use();
+				blurPass.BindTexture("gDepthMap", GL_TEXTURE_2D, gDepthBuffer);
+				blurPass.BindTexture("gNormal", GL_TEXTURE_2D, gNormal);
+				glBindFramebuffer(GL_FRAMEBUFFER, blurFBO);
+				blurPass.SetIVec2("direction", glm::ivec2(1, 0));
+				blurPass.BindTexture("image", GL_TEXTURE_2D, aoBuffer);
+				DrawQuad();
+				glBindFramebuffer(GL_FRAMEBUFFER, aoFBO);
+				blurPass.SetIVec2("direction", glm::ivec2(0, 1));
+				blurPass.BindTexture("image", GL_TEXTURE_2D, blurBuffer);
+				DrawQuad();
+				glFinish();
+				if (i > 0)
+					times.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+			}
+			PrintTimes("GL with blur", times, work);
+			glReadPixels(0, 0, width, height, aoFormat, GL_FLOAT, glResult.data());
+
+			blurPass.Delete();
+			glDeleteFramebuffers(1, &blurFBO);
+			glDeleteTextures(1, &blurBuffer);
+		}
+
+		aoPass.Delete();
+		if (deinterleavePass)
+			deinterleavePass->Delete();
+		releaseAtlas();
+		kernelBuffer.Delete();
+		glDeleteFramebuffers(1, &aoFBO);
+		GLuint textures[] = { gPosition, gNormal, gDepthBuffer, noiseTexture, aoBuffer, whiteCube };
+		glDeleteTextures(6, textures);
+		if (window)
+			glfwTerminate();
+	}
+
+	if (runCPU) {
+		AOParameters params;
+		params.kernel = kernel;
+		params.kernelSize = kernelSize;
+		params.radius = kernelRadius;
+		params.bias = kernelBias;
+		params.numDirections = numDirections;
+		params.numSteps = numSteps;
+		params.projection = capture.Projection();
+		params.invView = glm::inverse(capture.View());
+		params.noise.assign(capture.Noise(), capture.Noise() + 16);
+		// the engine reads the G Buffer straight from the mapped file
+		AOInput input = { width, height, capture.Positions(), capture.Normals(), capture.Depth() };
+
+		CPUAmbientOcclusion engine(threads);
+		std::cout << "CPU: " << engine.Threads() << " threads, " << aosimd::NAME << " (" << aosimd::WIDTH << " lanes)" << std::endl;
+		cpuResult.resize((size_t)width * height * channels);
+		vector<double> times;
+		for (int i = 0; i <= iterations; i++) {
+			auto start = chrono::steady_clock::now();
+			engine.Compute((AOTechnique)technique.cpuTechnique, input, params, cpuResult.data());
+			if (i > 0)
+				times.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+		}
+		PrintTimes("CPU", times, work);
+		if (blurRadius > 0) {
+			vector<float> blurred(cpuResult.size());
+			times.clear();
+			for (int i = 0; i <= iterations; i++) {
+				auto start = chrono::steady_clock::now();
+				engine.Blur(input, params.projection, blurRadius, 0.1f, channels, cpuResult.data(), blurred.data());
+				if (i > 0)
+					times.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+			}
+			PrintTimes("CPU blur", times, work);
+			cpuResult.swap(blurred);
+		}
+	}
+
+	if (runGL && runCPU) {
+		// the AO buffers of the application have 8 bits per channel: differences up to 1/255 are expected
+		for (float &value : cpuResult)
+			value = glm::clamp(value, 0.0f, 1.0f);
+		PrintDifference("GL vs CPU", glResult, cpuResult);
+	}
+	return 0;
+}
+
+//////////////////////////////////////////
+void PrintDifference(const char *label, const vector<float> &result, const vector<float> &reference)
+{
+	double sum = 0.0, squaredSum = 0.0, maxDiff = 0.0;
+	for (size_t i = 0; i < result.size(); i++) {
+		double diff = fabs(result[i] - reference[i]);
+		sum += diff;
+		squaredSum += diff * diff;
+		maxDiff = max(maxDiff, diff);
+	}
+	double rmse = sqrt(squaredSum / result.size());
+	std::cout << label << ": mean difference " << sum / result.size() << ", max difference " << maxDiff << ", RMSE " << rmse;
+	if (rmse > 0.0)
+		std::cout << ", PSNR " << 20.0 * log10(1.0 / rmse) << " dB";
+	std::cout << std::endl;
+}
+
+//////////////////////////////////////////
+void PrintTimes(const char *label, vector<double> times, double work)
+{
+	sort(times.begin(), times.end());
+	double sum = 0.0;
+	for (double t : times)
+		sum += t;
+	double mean = sum / times.size();
+	std::cout << fixed << setprecision(3) << label << ": mean " << mean << " ms, median " << times[times.size() / 2]
+	          << " ms, min " << times.front() << " ms, max " << times.back() << " ms, "
+	          << work / (mean / 1000.0) / 1e6 << " Mpixel*samples/s" << std::endl;
+	std::cout.unsetf(ios::floatfield);
+}
+
+//////////////////////////////////////////
+GLuint CreateTexture(GLint internalFormat, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *data)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, data);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return texture;
+}
+
+//////////////////////////////////////////
+GLuint CreateFramebuffer(GLuint texture)
+{
+	GLuint fbo;
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	return fbo;
+}
+
+//////////////////////////////////////////
+// Function to draw a fullscreen quad (same of main.cpp)
+void DrawQuad() {
+	static GLuint quadVAO = 0;
+	static GLuint quadVBO;
+	if (quadVAO == 0)
+	{
+		float quadVertices[] = {
+			// positions		// texcoords
+			-1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+			-1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+			 1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+			 1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+		};
+
+		glGenVertexArrays(1, &quadVAO);
+		glGenBuffers(1, &quadVBO);
+		GLState::Get().BindVertexArray(quadVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+	}
+	GLState::Get().BindVertexArray(quadVAO);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
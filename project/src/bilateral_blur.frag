@@ -0,0 +1,133 @@
+#version 410 core
+out vec4 FragColor;
+
+in vec2 vTexcoords;
+
+// One pass of the separable bilateral blur of the AO buffers (horizontal or vertical, selected by direction)
+// Each tap is weighted by a gaussian of its offset, and by its distance from the tangent plane of the fragment
+// (from the depth and normal of the fragment), relative to the depth of the fragment: the blur does not cross
+// depth discontinuities nor creases, so the noise of the AO passes can be removed without bleeding.
+// The gaussian weights are computed incrementally, and the depth weight is rational, to avoid an exp2 per tap.
+// With useGather, the taps are fetched in pairs with textureGather (the radius is rounded up to an even number)
+uniform sampler2D image; // AO buffer (1 or 3 channels)
+uniform sampler2D gDepthMap; // depth buffer, or the low resolution normals with the linear depth in the alpha channel
+uniform sampler2D gNormal;
+
+uniform bool packedDepth; // gDepthMap holds the linear depth in the alpha channel
+uniform ivec2 direction; // (1, 0) for the horizontal pass, (0, 1) for the vertical pass
+#ifdef BLUR_RADIUS
+const int radius = BLUR_RADIUS; // specialized variant (see utils/shader_variants.h)
+const bool useGather = BLUR_GATHER;
+#else
+uniform int radius; // number of taps on each side of the fragment
+uniform bool useGather;
+#endif
+uniform int channels; // channels of the AO buffer: with 3 channels, the image is not gathered
+uniform float depthSigma; // distance from the tangent plane (relative to the depth of the fragment) halving the weight of a tap
+
+uniform mat4 projectionMatrix;
+
+ivec2 size;
+ivec2 center;
+// the position of a tap is depth * (ray + offset * rayStep): its distance from the tangent plane (normal, planeOffset)
+// is |depth * (normalRay + offset * normalRayStep) - planeOffset|
+float normalRay;
+float normalRayStep;
+float planeOffset;
+float sharpness;
+
+// Linear (positive) view space depth from the depth buffer value
+float LinearDepth(float depth)
+{
+	return packedDepth ? depth : projectionMatrix[3][2] / ((depth * 2.0f - 1.0f) + projectionMatrix[2][2]);
+}
+
+// weight of a tap, given the gaussian weight of its offset
+float TapWeight(int offset, float depth, float gaussian)
+{
+	float x = abs(depth * (normalRay + float(offset) * normalRayStep) - planeOffset) * sharpness;
+	return gaussian / (1.0f + x * x);
+}
+
+ivec2 Clamp(ivec2 texel)
+{
+	return clamp(texel, ivec2(0), size - 1);
+}
+
+void main()
+{
+#ifdef RESOLUTION
+	size = RESOLUTION;
+#else
+	size = textureSize(image, 0);
+#endif
+	center = ivec2(gl_FragCoord.xy);
+	vec4 centerDepth = texelFetch(gDepthMap, center, 0);
+	float depth = LinearDepth(packedDepth ? centerDepth.a : centerDepth.x);
+	vec3 normal = texelFetch(gNormal, center, 0).xyz;
+	// view ray through the center of the fragment (the view space position at depth 1), and its change per texel
+	vec2 scale = 1.0f / vec2(projectionMatrix[0][0], projectionMatrix[1][1]);
+	vec3 ray = vec3(((vec2(center) + 0.5f) / vec2(size) * 2.0f - 1.0f) * scale, -1.0f);
+	vec3 rayStep = vec3(vec2(direction) * 2.0f / vec2(size) * scale, 0.0f);
+	normalRay = dot(normal, ray);
+	normalRayStep = dot(normal, rayStep);
+	planeOffset = depth * normalRay;
+	sharpness = 1.0f / (depthSigma * depth);
+	// gaussian with sigma = radius / 2: g(i + 1) = g(i) * ratio(i), with ratio(i + 1) = ratio(i) * exp2(-2 * factor)
+	float sigma = max(float(radius), 1.0f) * 0.5f;
+	float gaussianFactor = 1.4427f / (2.0f * sigma * sigma);
+	float ratioStep = exp2(-2.0f * gaussianFactor);
+	float gaussian = 1.0f;
+	float ratio = exp2(-gaussianFactor);
+
+	vec4 result = texelFetch(image, center, 0);
+	float totalWeight = 1.0f;
+	if (useGather) {
+		// the gathered texels are the 2x2 block with the lower left texel at floor(coords - 0.5): the coordinates are
+		// on the edge between the two taps along the direction, and on the center of the fragment row (or column)
+		vec2 texelSize = 1.0f / vec2(size);
+		for (int i = 1; i <= radius; i += 2) {
+			// gaussian weights of the offsets i and i + 1
+			gaussian *= ratio;
+			ratio *= ratioStep;
+			float g0 = gaussian;
+			gaussian *= ratio;
+			ratio *= ratioStep;
+			float g1 = gaussian;
+			for (int side = -1; side <= 1; side += 2) {
+				// the pair of taps (first, first + 1) along the direction, from the nearest to the fragment
+				int first = side > 0 ? i : -i - 1;
+				vec2 coords = (vec2(center) + 0.5f + vec2(direction) * (float(first) + 0.5f)) * texelSize;
+				vec4 depths = packedDepth ? textureGather(gDepthMap, coords, 3) : textureGather(gDepthMap, coords, 0);
+				// w is the lower left texel, z the lower right one and x the upper left one
+				vec2 pairDepth = vec2(depths.w, direction.x == 1 ? depths.z : depths.x);
+				vec4 firstValue, secondValue;
+				if (channels == 1) {
+					vec4 values = textureGather(image, coords, 0);
+					firstValue = vec4(values.w);
+					secondValue = vec4(direction.x == 1 ? values.z : values.x);
+				} else {
+					firstValue = texelFetch(image, Clamp(center + direction * first), 0);
+					secondValue = texelFetch(image, Clamp(center + direction * (first + 1)), 0);
+				}
+				float w0 = TapWeight(first, LinearDepth(pairDepth.x), side > 0 ? g0 : g1);
+				float w1 = TapWeight(first + 1, LinearDepth(pairDepth.y), side > 0 ? g1 : g0);
+				result += firstValue * w0 + secondValue * w1;
+				totalWeight += w0 + w1;
+			}
+		}
+	} else {
+		for (int i = 1; i <= radius; ++i) {
+			gaussian *= ratio;
+			ratio *= ratioStep;
+			for (int offset = -i; offset <= i; offset += 2 * i) {
+				ivec2 texel = Clamp(center + direction * offset);
+				vec4 tapDepth = texelFetch(gDepthMap, texel, 0);
+				float w = TapWeight(offset, LinearDepth(packedDepth ? tapDepth.a : tapDepth.x), gaussian);
+				result += texelFetch(image, texel, 0) * w;
+				totalWeight += w;
+			}
+		}
+	}
+	FragColor = result / totalWeight;
+}
@@ -0,0 +1,169 @@
+/*
+Benchmark of the frustum culling of the scene objects (utils/bvh.h)
+
+It scatters random boxes in a large scene, builds their bounding volume hierarchy, and culls it with cameras looking
+in several directions: the hierarchy is traversed with the SIMD plane tests and with the plain C++ ones, and compared
+with a test of every box (the reference). It prints the time per culling and the throughput in objects per
+millisecond, and the time of the refit after moving a part of the objects.
+
+usage: CullBench.exe [--objects N] [--moving N] [--views N] [--runs N]
+
+Real-Time Graphics Programming - a.a. 2021/2022
+Master degree in Computer Science
+Universita' degli Studi di Milano
+*/
+
+// Std. Includes
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <utils/bvh.h>
+
+// test of each box against the planes of the frustum (the same test of BVH::Cull, without the hierarchy)
+void cullBoxes(const vector<glm::vec3> &minimums, const vector<glm::vec3> &maximums, const glm::mat4 &viewProjection, vector<uint32_t> &visible)
+{
+    glm::vec4 planes[BVH::PLANES];
+    BVH::FrustumPlanes(viewProjection, planes);
+    for (size_t i = 0; i < minimums.size(); i++)
+    {
+        bool inside = true;
+        for (int p = 0; p < BVH::PLANES && inside; p++)
+        {
+            glm::vec3 farCorner(planes[p].x >= 0.0f ? maximums[i].x : minimums[i].x,
+                                planes[p].y >= 0.0f ? maximums[i].y : minimums[i].y,
+                                planes[p].z >= 0.0f ? maximums[i].z : minimums[i].z);
+            inside = (planes[p].x * farCorner.x + planes[p].y * farCorner.y) + (planes[p].z * farCorner.z + planes[p].w) >= 0.0f;
+        }
+        if (inside)
+            visible.push_back((uint32_t)i);
+    }
+}
+
+// time in milliseconds of runs cullings of each view, and number of visible objects (summed over the views)
+template<typename CullFunction>
+double timeCulling(const vector<glm::mat4> &views, int runs, CullFunction cull, vector<vector<uint32_t>> &visible, size_t &numVisible)
+{
+    visible.assign(views.size(), vector<uint32_t>());
+    for (size_t v = 0; v < views.size(); v++)
+        cull(views[v], visible[v]); // warmup
+    numVisible = 0;
+    vector<uint32_t> scratch;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++)
+        for (size_t v = 0; v < views.size(); v++)
+        {
+            scratch.clear();
+            cull(views[v], scratch);
+            numVisible += scratch.size();
+        }
+    numVisible /= runs;
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / (runs * views.size());
+}
+
+/////////////////// MAIN function ///////////////////////
+int main(int argc, char **argv)
+{
+    int numObjects = 100000, numMoving = 1000, numViews = 16, runs = 20;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string option = argv[i];
+        int value = atoi(argv[i + 1]);
+        if (option == "--objects") numObjects = max(1, value);
+        else if (option == "--moving") numMoving = max(0, value);
+        else if (option == "--views") numViews = max(1, value);
+        else if (option == "--runs") runs = max(1, value);
+        else
+        {
+            cout << "Unknown option " << option << endl;
+            return -1;
+        }
+    }
+    numMoving = min(numMoving, numObjects);
+
+    // boxes of random size on a 200 x 200 area, up to 20 units high
+    mt19937 generator(1234);
+    uniform_real_distribution<float> position(-100.0f, 100.0f), height(0.0f, 20.0f), size(0.1f, 2.0f);
+    vector<glm::vec3> minimums(numObjects), maximums(numObjects);
+    for (int i = 0; i < numObjects; i++)
+    {
+        minimums[i] = glm::vec3(position(generator), height(generator), position(generator));
+        maximums[i] = minimums[i] + glm::vec3(size(generator), size(generator), size(generator));
+    }
+    // cameras at the center of the area, turning around the vertical axis, with the projection of the application
+    glm::mat4 projection = glm::perspective(45.0f, 4.0f / 3.0f, 0.1f, 50.0f);
+    vector<glm::mat4> views(numViews);
+    for (int v = 0; v < numViews; v++)
+    {
+        float angle = 6.2831853f * v / numViews;
+        glm::vec3 eye(0.0f, 5.0f, 0.0f);
+        views[v] = projection * glm::lookAt(eye, eye + glm::vec3(sin(angle), -0.1f, cos(angle)), glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    BVH bvh;
+    auto start = chrono::steady_clock::now();
+    bvh.Build(minimums.data(), maximums.data(), minimums.size());
+    double buildTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "Culling benchmark: " << numObjects << " objects, " << numViews << " views, SIMD: " << BVH::SIMDName() << endl;
+    cout << fixed << setprecision(3);
+    cout << "build: " << buildTime << " ms (" << bvh.Nodes() << " nodes)" << endl;
+
+    // the results of the hierarchy must be the same objects of the reference
+    vector<vector<uint32_t>> reference, visible;
+    size_t numVisible = 0;
+    auto report = [&](const string &name, double time, bool check) {
+        bool same = true;
+        for (size_t v = 0; check && v < views.size(); v++)
+        {
+            sort(visible[v].begin(), visible[v].end());
+            same = same && visible[v] == reference[v];
+        }
+        cout << setw(24) << left << name << right << setw(10) << time << " ms, " << setw(12) << setprecision(0) << numObjects / time
+             << setprecision(3) << " objects/ms, " << numVisible / views.size() << " visible" << (check ? (same ? "" : " (MISMATCH)") : "") << endl;
+    };
+    double time = timeCulling(views, runs, [&](const glm::mat4 &view, vector<uint32_t> &result) { cullBoxes(minimums, maximums, view, result); }, reference, numVisible);
+    report("boxes (reference)", time, false);
+    bvh.useSIMD = false;
+    time = timeCulling(views, runs, [&](const glm::mat4 &view, vector<uint32_t> &result) { bvh.Cull(view, result); }, visible, numVisible);
+    report("hierarchy", time, true);
+    bvh.useSIMD = true;
+    time = timeCulling(views, runs, [&](const glm::mat4 &view, vector<uint32_t> &result) { bvh.Cull(view, result); }, visible, numVisible);
+    report(string("hierarchy (") + BVH::SIMDName() + ")", time, true);
+
+    // incremental refit: a part of the objects moves at each run
+    if (numMoving > 0)
+    {
+        uniform_real_distribution<float> offset(-0.5f, 0.5f);
+        uniform_int_distribution<int> object(0, numObjects - 1);
+        double updateTime = 0.0;
+        size_t refitted = 0;
+        for (int r = 0; r < runs; r++)
+        {
+            start = chrono::steady_clock::now();
+            for (int i = 0; i < numMoving; i++)
+            {
+                int o = object(generator);
+                glm::vec3 move(offset(generator), 0.0f, offset(generator));
+                minimums[o] += move;
+                maximums[o] += move;
+                bvh.Update(o, minimums[o], maximums[o]);
+            }
+            refitted += bvh.Refit();
+            updateTime += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        }
+        cout << "refit of " << numMoving << " moved objects: " << updateTime / runs << " ms (" << refitted / runs << " nodes)" << endl;
+        // the refitted hierarchy must cull the moved boxes as the reference
+        timeCulling(views, 1, [&](const glm::mat4 &view, vector<uint32_t> &result) { cullBoxes(minimums, maximums, view, result); }, reference, numVisible);
+        time = timeCulling(views, runs, [&](const glm::mat4 &view, vector<uint32_t> &result) { bvh.Cull(view, result); }, visible, numVisible);
+        report("refitted hierarchy", time, true);
+    }
+    return 0;
+}
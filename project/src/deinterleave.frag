@@ -0,0 +1,51 @@
+#version 410 core
+out vec4 FragColor;
+
+in vec2 vTexcoords;
+
+// Deinterleaving of a buffer in 4x4 layers (and interleaving back, with reinterleave)
+// The layer (i, j) holds the texels (4x + i, 4y + j) of the buffer: the layers are placed side by side in an atlas
+// with the size of the buffer (the layers of the first rows and columns are one texel larger when the size of the
+// buffer is not a multiple of 4)
+uniform sampler2D source; // buffer to deinterleave, or atlas of the layers to interleave
+uniform bool reinterleave;
+
+// size of a layer along one axis, from its index and the size of the buffer
+int LayerSize(int layer, int size)
+{
+	return (size - layer + 3) / 4;
+}
+
+// position of a layer in the atlas
+ivec2 LayerOrigin(ivec2 layer, ivec2 size)
+{
+	ivec2 origin = ivec2(0);
+	for (int k = 0; k < 3; ++k)
+		origin += ivec2(k < layer.x ? LayerSize(k, size.x) : 0, k < layer.y ? LayerSize(k, size.y) : 0);
+	return origin;
+}
+
+// layer containing a texel of the atlas
+ivec2 AtlasLayer(ivec2 texel, ivec2 size)
+{
+	ivec2 layer = ivec2(0);
+	ivec2 end = ivec2(0);
+	for (int k = 0; k < 3; ++k) {
+		end += ivec2(LayerSize(k, size.x), LayerSize(k, size.y));
+		layer += ivec2(greaterThanEqual(texel, end));
+	}
+	return layer;
+}
+
+void main()
+{
+	ivec2 size = textureSize(source, 0);
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	if (reinterleave) {
+		ivec2 layer = texel % 4;
+		FragColor = texelFetch(source, LayerOrigin(layer, size) + texel / 4, 0);
+	} else {
+		ivec2 layer = AtlasLayer(texel, size);
+		FragColor = texelFetch(source, (texel - LayerOrigin(layer, size)) * 4 + layer, 0);
+	}
+}
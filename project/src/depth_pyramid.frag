@@ -0,0 +1,39 @@
+#version 410 core
+out float FragColor;
+
+in vec2 vTexcoords;
+
+// Level of the hierarchical depth buffer (see utils/depth_pyramid.h): level 0 is the linear depth of the positions,
+// each following level is the reduction of the 2x2 blocks of the previous one, which is the only level of the
+// pyramid that can be sampled while the level is rendered (so it is read as level 0)
+uniform sampler2D source; // positions (level 0), or the pyramid
+uniform bool linearize;
+uniform int reduction; // 0 = minimum (nearest), 1 = maximum (farthest), 2 = average
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	if (linearize) {
+		FragColor = -texelFetch(source, texel, 0).z;
+		return;
+	}
+	// the 2x2 block of the texel: when a size of the previous level is odd, the last texel of the row (or column)
+	// covers also its last column (or row), with a 3 texels wide footprint, so that no texel of the border is skipped
+	ivec2 size = textureSize(source, 0);
+	ivec2 lastTexel = max(size / 2, 1) - 1;
+	ivec2 first = min(texel * 2, size - 1);
+	ivec2 last = min(ivec2(texel.x == lastTexel.x ? size.x - 1 : first.x + 1, texel.y == lastTexel.y ? size.y - 1 : first.y + 1), size - 1);
+	float result = texelFetch(source, first, 0).x;
+	float sum = 0.0f;
+	for (int y = first.y; y <= last.y; ++y)
+		for (int x = first.x; x <= last.x; ++x) {
+			float d = texelFetch(source, ivec2(x, y), 0).x;
+			if (reduction == 0)
+				result = min(result, d);
+			else if (reduction == 1)
+				result = max(result, d);
+			sum += d;
+		}
+	ivec2 footprint = last - first + 1;
+	FragColor = reduction == 2 ? sum / float(footprint.x * footprint.y) : result;
+}
@@ -0,0 +1,44 @@
+#version 410 core
+out vec4 FragColor;
+
+in vec2 vTexcoords;
+
+// Downsampling of the G Buffer for the AO passes evaluated at a lower resolution
+// Each texel takes the value of the texel nearest to the camera in its block of the full resolution buffers,
+// so that the low resolution positions, depths and normals all describe the same surface
+uniform sampler2D gDepthMap;
+uniform sampler2D source; // positions, normals or depth buffer to downsample
+uniform int factor; // size of the block (2 for half resolution, 4 for quarter resolution)
+uniform bool storeDepth; // the linear depth of the texel is stored in the alpha channel (used by the upsampling)
+
+uniform mat4 projectionMatrix;
+
+// Linear (positive) view space depth from the depth buffer value
+float LinearDepth(float depth)
+{
+	return projectionMatrix[3][2] / ((depth * 2.0f - 1.0f) + projectionMatrix[2][2]);
+}
+
+void main()
+{
+	ivec2 first = ivec2(gl_FragCoord.xy) * factor;
+	ivec2 last = textureSize(gDepthMap, 0) - 1;
+	
+	// Selecting the nearest texel of the block
+	ivec2 nearest = min(first, last);
+	float nearestDepth = texelFetch(gDepthMap, nearest, 0).x;
+	for (int y = 0; y < factor; ++y) {
+		for (int x = 0; x < factor; ++x) {
+			ivec2 texel = min(first + ivec2(x, y), last);
+			float depth = texelFetch(gDepthMap, texel, 0).x;
+			if (depth < nearestDepth) {
+				nearest = texel;
+				nearestDepth = depth;
+			}
+		}
+	}
+	
+	FragColor = texelFetch(source, nearest, 0);
+	if (storeDepth)
+		FragColor.a = LinearDepth(nearestDepth);
+}
@@ -1,21 +1,66 @@
 #version 410 core
 layout (location = 0) in vec3 position;
+#ifdef OCTAHEDRAL_NORMALS
+// octahedral encoding of the normal (see utils/vertex_layout.h)
+layout (location = 1) in vec2 normal;
+#else
 layout (location = 1) in vec3 normal;
+#endif
+// scale and bias of the (quantized) positions of the mesh
+layout (location = 5) in vec3 positionScale;
+layout (location = 6) in vec3 positionBias;
 
 out vec3 vPosition;
 out vec3 vNormal;
+// clip space positions in the current and in the previous frame, for the motion vectors
+out vec4 vClipPosition;
+out vec4 vPreviousClipPosition;
 
+#ifdef INSTANCED
+// model matrix of the instance (see utils/instance_buffer.h): the instances are static, so it is also the one of the
+// previous frame, and the normal matrix is computed here
+layout (location = 7) in mat4 instanceMatrix;
+#else
 uniform mat4 modelMatrix;
+uniform mat3 normalMatrix;
+// model matrix of the previous frame
+uniform mat4 previousModelMatrix;
+#endif
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
-uniform mat3 normalMatrix;
+// view matrix of the previous frame
+uniform mat4 previousViewMatrix;
+
+#ifdef OCTAHEDRAL_NORMALS
+vec3 octDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0f);
+	n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0f)));
+	return normalize(n);
+}
+#endif
 
 void main()
 {
-	vec4 viewPos = viewMatrix * modelMatrix * vec4(position, 1.0f);
+	vec3 modelPosition = position * positionScale + positionBias;
+#ifdef OCTAHEDRAL_NORMALS
+	vec3 modelNormal = octDecode(normal);
+#else
+	vec3 modelNormal = normal;
+#endif
+#ifdef INSTANCED
+	mat4 modelMatrix = instanceMatrix;
+	mat4 previousModelMatrix = instanceMatrix;
+	mat3 normalMatrix = transpose(inverse(mat3(viewMatrix * instanceMatrix)));
+#endif
+
+	vec4 viewPos = viewMatrix * modelMatrix * vec4(modelPosition, 1.0f);
 	vPosition = viewPos.xyz; 
 	
-	vNormal = normalMatrix * normal;
+	vNormal = normalMatrix * modelNormal;
 	
 	gl_Position = projectionMatrix * viewPos;
+	vClipPosition = gl_Position;
+	vPreviousClipPosition = projectionMatrix * previousViewMatrix * previousModelMatrix * vec4(modelPosition, 1.0f);
 }
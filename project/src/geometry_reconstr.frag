@@ -1,11 +1,15 @@
 #version 410 core
 layout (location = 1) out vec3 gNormal;
 layout (location = 2) out vec3 gAlbedo;
+layout (location = 3) out vec3 gMotion; // motion from the previous frame in texture coordinates (xy), linear depth in the previous frame (z)
 
 in vec3 vNormal;
+in vec4 vClipPosition;
+in vec4 vPreviousClipPosition;
 
 void main()
 {	
 	gNormal = normalize(vNormal);
 	gAlbedo = vec3(0.95f);
+	gMotion = vec3((vClipPosition.xy / vClipPosition.w - vPreviousClipPosition.xy / vPreviousClipPosition.w) * 0.5f, vPreviousClipPosition.w);
 }
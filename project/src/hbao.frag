@@ -6,22 +6,32 @@ in vec2 vTexcoords;
 uniform sampler2D gPosition;
 uniform sampler2D gNormal;
 uniform sampler2D noiseTexture;
+uniform vec2 noiseOffset; // shift of the noise tiling (0.25 = one noise texel), changed at each frame by the temporal AO
 
+#ifdef NUM_DIRECTIONS
+const int numDirections = NUM_DIRECTIONS; // specialized variant (see utils/shader_variants.h)
+const int numSteps = NUM_STEPS;
+#else
 uniform int numDirections; // Number of directions displacements to perform
 uniform int numSteps; // Number of steps to perform per direction
+#endif
 uniform float sampleRadius; // Radius size to consider for our hemisphere
 
 const float PI = 3.14159265f;
 
-// Tile noise texture over screen based on screen dimensions divided by noise size
-const vec2 noiseScale = vec2(1200.0/4.0, 900.0/4.0); 
-
 void main()
 {
+	// Tile noise texture over screen based on screen dimensions divided by noise size
+#ifdef RESOLUTION
+	vec2 noiseScale = vec2(RESOLUTION) / 4.0;
+#else
+	vec2 noiseScale = vec2(textureSize(gPosition, 0)) / 4.0;
+#endif
+	
 	// get input for HBAO algorithm
 	vec3 fragPos = texture(gPosition, vTexcoords).xyz;
 	vec3 normal = normalize(texture(gNormal, vTexcoords).xyz);
-	vec3 randomVec = texture(noiseTexture, vTexcoords * noiseScale).xyz;
+	vec3 randomVec = texture(noiseTexture, vTexcoords * noiseScale + noiseOffset).xyz;
 	
 	// Rotation displacement per direction so that we perform a full circle sampling
 	float deltaRot = 2.0 * PI / numDirections;
@@ -0,0 +1,129 @@
+#version 410 core
+out float FragColor;
+
+in vec2 vTexcoords;
+
+// HBAO on the 4x4 deinterleaved layers of the positions (see deinterleave.frag): the fragment is a texel of the
+// atlas, and its samples are taken from the texels of its own layer nearest to the sample positions of hbao.frag.
+// All the texels of a layer use the same noise vector, so neighbouring fragments sample neighbouring texels
+// and the texture cache is not thrashed by the scattered samples of a large radius
+uniform sampler2D gPosition; // atlas of the deinterleaved positions
+uniform sampler2D gNormal; // normals (not deinterleaved)
+uniform sampler2D noiseTexture;
+uniform vec2 noiseOffset; // shift of the noise tiling (0.25 = one noise texel), changed at each frame by the temporal AO
+
+#ifdef NUM_DIRECTIONS
+const int numDirections = NUM_DIRECTIONS; // specialized variant (see utils/shader_variants.h)
+const int numSteps = NUM_STEPS;
+#else
+uniform int numDirections; // Number of directions displacements to perform
+uniform int numSteps; // Number of steps to perform per direction
+#endif
+uniform float sampleRadius; // Radius size to consider for our hemisphere
+
+const float PI = 3.14159265f;
+
+// size of a layer along one axis, from its index and the size of the buffer
+int LayerSize(int layer, int size)
+{
+	return (size - layer + 3) / 4;
+}
+
+// position of a layer in the atlas
+ivec2 LayerOrigin(ivec2 layer, ivec2 size)
+{
+	ivec2 origin = ivec2(0);
+	for (int k = 0; k < 3; ++k)
+		origin += ivec2(k < layer.x ? LayerSize(k, size.x) : 0, k < layer.y ? LayerSize(k, size.y) : 0);
+	return origin;
+}
+
+// layer containing a texel of the atlas
+ivec2 AtlasLayer(ivec2 texel, ivec2 size)
+{
+	ivec2 layer = ivec2(0);
+	ivec2 end = ivec2(0);
+	for (int k = 0; k < 3; ++k) {
+		end += ivec2(LayerSize(k, size.x), LayerSize(k, size.y));
+		layer += ivec2(greaterThanEqual(texel, end));
+	}
+	return layer;
+}
+
+void main()
+{
+#ifdef RESOLUTION
+	ivec2 size = RESOLUTION;
+#else
+	ivec2 size = textureSize(gPosition, 0);
+#endif
+	ivec2 atlasTexel = ivec2(gl_FragCoord.xy);
+	ivec2 layer = AtlasLayer(atlasTexel, size);
+	ivec2 origin = LayerOrigin(layer, size);
+	ivec2 last = ivec2(LayerSize(layer.x, size.x), LayerSize(layer.y, size.y)) - 1;
+	// texel of the fragment in the interleaved buffer, and its texture coordinates
+	ivec2 texel = (atlasTexel - origin) * 4 + layer;
+	vec2 texcoords = (vec2(texel) + 0.5f) / vec2(size);
+
+	// get input for HBAO algorithm (the noise vector of the interleaved texel is the same for the whole layer)
+	vec3 fragPos = texelFetch(gPosition, atlasTexel, 0).xyz;
+	vec3 normal = normalize(texelFetch(gNormal, texel, 0).xyz);
+	vec3 randomVec = texture(noiseTexture, (vec2(layer) + 0.5f) / 4.0f + noiseOffset).xyz;
+
+	// Rotation displacement per direction so that we perform a full circle sampling
+	float deltaRot = 2.0 * PI / numDirections;
+	float cosRot = cos(deltaRot);
+	float sinRot = sin(deltaRot);
+
+	// Create a 2D rotation matrix to rotate our sampling vector
+	mat2 deltaRotationMatrix = mat2(cosRot, -sinRot, sinRot, cosRot);
+
+	// Calculate tangent vector since perpendicular to  normal one
+	vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
+
+	vec2 sampleDir = tangent.xy * (sampleRadius / (float(numDirections * numSteps) + 1.0));
+
+	// Apply noise to the base sampling vector
+	mat2 noiseMatrix = mat2(randomVec.x, -randomVec.y, randomVec.y,  randomVec.x);
+	sampleDir = noiseMatrix * sampleDir;
+
+	// Sample positions in the texels of the layer: the texel (4x + i, 4y + j) of the buffer is the texel (x, y) of the
+	// layer (i, j), so the nearest texel of the layer to a position p (in texture coordinates) is floor(p * size / 4 + bias)
+	vec2 layerScale = vec2(size) / 4.0f;
+	vec2 layerBias = 0.5f - (vec2(layer) + 0.5f) / 4.0f;
+	vec2 layerCenter = texcoords * layerScale + layerBias;
+	// the centers of the texels are sampled, since nearest filtering may round a coordinate on a texel edge either way
+	vec2 layerCenterOffset = vec2(origin) + 0.5f;
+	vec2 texelSize = 1.0f / vec2(size);
+
+	// Iterate over the directions and calculate occlusion factor
+	float occlusion = 0.0;
+	for (int i = 0; i < numDirections; ++i) {
+		// Incrementally rotate sample direction
+		sampleDir = deltaRotationMatrix * sampleDir;
+
+		// Perform incremental sampling steps for each direction
+		float oldAngle = 0.0f;
+		vec2 layerDir = sampleDir * layerScale;
+		vec2 layerPos = layerCenter + randomVec.z * layerDir;
+		for (int j = 0; j < numSteps; ++j) {
+			// Displace from current fragment position towards the sample direction with some noise in between
+			// (the texel of the layer is clamped to the layer, as the clamp to edge of hbao.frag)
+			vec2 sampleTexel = clamp(floor(layerPos + float(j) * layerDir), vec2(0.0f), vec2(last));
+			vec3 sampleViewPos = texture(gPosition, (layerCenterOffset + sampleTexel) * texelSize).xyz; // Get view space position for the sampled position
+			vec3 sampleDiff = (sampleViewPos - fragPos); // Calculate the vector going from fragment to sampled position
+			float tangentAngle = (PI / 2.0) - acos(dot(normal, normalize(sampleDiff))); // Calculating angle between fragment and sampled position
+
+			// Add ambient occlusion contribution factor only for samples further than current bias
+			if (tangentAngle > oldAngle) {
+				float value = sin(tangentAngle) - sin(oldAngle);
+				occlusion += value;
+				oldAngle = tangentAngle;
+			}
+		}
+	}
+
+	occlusion = 1.0 - occlusion / numDirections;
+	occlusion = clamp(occlusion, 0.0, 1.0);
+	FragColor = occlusion;
+}
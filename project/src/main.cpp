@@ -24,6 +24,9 @@ positive Z axis points "outside" the screen
 
 // Std. Includes
 #include <string>
+#include <chrono>
+#include <algorithm>
+#include <memory>
 
 // Loader for OpenGL extensions
 // http://glad.dav1d.de/
@@ -46,9 +49,30 @@ positive Z axis points "outside" the screen
 #endif
 
 // classes developed during lab lectures to manage shaders, to load models, and for FPS camera
+#include <utils/gl_state.h>
 #include <utils/shader.h>
+#include <utils/shader_variants.h>
 #include <utils/model.h>
+// parallel loading of images and models, with the OpenGL uploads on the main thread
+#include <utils/asset_loader.h>
 #include <utils/camera.h>
+// sample kernels and noise used by the SSAO techniques
+#include <utils/ao_kernel.h>
+#include <utils/kernel_buffer.h>
+// OpenGL context without window for automated benchmarks, and benchmark sweep manager
+#include <utils/headless.h>
+#include <utils/benchmark.h>
+// binary dump of the inputs of the AO passes, to be replayed offline (ao_replay.cpp)
+#include <utils/gbuffer_capture.h>
+// passes of the frame, with their inputs and outputs, and pool of their render targets
+#include <utils/render_graph.h>
+// ping-pong history of the temporal AO accumulation
+#include <utils/temporal_history.h>
+#include <utils/depth_pyramid.h>
+// bounding volume hierarchy of the objects of the scene, for the frustum culling
+#include <utils/bvh.h>
+// transformations of the entities of the scene
+#include <utils/transform_store.h>
 
 // we load the GLM classes used in the application
 #include <glm/glm.hpp>
@@ -78,8 +102,12 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 // if one of the WASD keys is pressed, we call the corresponding method of the Camera class
 void apply_camera_movements();
 
+// transformations of the objects of the scene for the current frame, and culling of their meshes with the view frustum
+void UpdateScene(Model &cubeModel, Model &sphereModel, Model &bunnyModel);
 // in this application, we have isolated the models rendering using a function, which will be called in each rendering step
 void RenderObjects(Shader &shader, Model &cubeModel, Model &sphereModel, Model &bunnyModel);
+// stress scene: copies of the models drawn with instanced draw calls
+void RenderInstances(Shader &shader, Model &cubeModel, Model &sphereModel, Model &bunnyModel, InstanceBuffer &instances);
 
 // Function to draw a fullscreen quad
 void DrawQuad();
@@ -87,6 +115,15 @@ void DrawQuad();
 // load image from disk and create an OpenGL texture
 GLint LoadTexture(const char* path);
 
+// (re)allocate the storage of the G Buffer and of the offscreen final image using the current screenWidth and screenHeight
+void allocateRenderTargets();
+
+// current time in seconds
+double getTime();
+
+// save the current G Buffer content, noise, kernel and camera matrices in a capture file
+void captureGBuffer(const string &path, const std::vector<glm::vec3> &kernel, const std::vector<glm::vec3> &noise);
+
 // we initialize an array of booleans for each keyboard key
 bool keys[1024];
 
@@ -107,20 +144,27 @@ GLfloat spin_speed = 30.0f;
 bool spinning = false;
 // boolean to show/hide final ambient occlusion buffer values
 bool show_occlusion = false;
+// boolean to run without any window (no input and no UI): the frames are rendered offscreen for benchmarking
+bool headless = false;
+// boolean to save a G Buffer capture at the end of the current frame, and name of the capture file (empty: numbered file)
+bool captureRequested = false;
+string capturePath;
 
 // View matrix: the camera moves, so we just set to indentity now
 glm::mat4 view = glm::mat4(1.0f);
+// View matrix of the previous frame, for the motion vectors
+glm::mat4 previousView = glm::mat4(1.0f);
 
 // Angle FOV of our camera
 GLfloat FOV = 45.0f;
 
-// Model and Normal transformation matrices for the objects in the scene: we set to identity
-glm::mat4 sphereModelMatrix = glm::mat4(1.0f);
-glm::mat3 sphereNormalMatrix = glm::mat3(1.0f);
-glm::mat4 cubeModelMatrix = glm::mat4(1.0f);
-glm::mat3 cubeNormalMatrix = glm::mat3(1.0f);
-glm::mat4 bunnyModelMatrix = glm::mat4(1.0f);
-glm::mat3 bunnyNormalMatrix = glm::mat3(1.0f);
+// Transformations of the entities of the scene (see utils/transform_store.h): their Model and Normal matrices are
+// computed once per frame by UpdateScene, only for the entities changed, and shared by all the passes.
+// The objects of the scene are the first entities, followed by the instances of the stress scene
+TransformStore transforms;
+// entities updated in the last frame, and time of their update (in seconds)
+int transformsUpdated = 0;
+double transformTime = 0.0;
 
 // texture unit for the cube map used for the skybox
 GLuint textureCube;
@@ -149,6 +193,64 @@ GLfloat repeat = 1.0;
 
 // Flag that enables/disables additional blurring pass for the generated AO buffer
 bool have_blur = true;
+// Separable bilateral blur: taps on each side of the pixel, and fetch of the taps in pairs with textureGather
+// (at radius 2 with textureGather, 14 texture fetches per pixel in the two passes, against the 16 of a 4x4 box blur;
+// each pass fetches the AO, depth and normal of the pixel, and gathers the AO and the depths of a pair of taps on each
+// side for every 2 taps of radius)
+int blurRadius = 2;
+bool blurGather = true;
+
+// Resolution of the AO passes: 1 = full resolution, 2 = half resolution, 4 = quarter resolution
+// (at lower resolutions, the AO buffer is upsampled with a joint bilateral filter before the lighting pass)
+int aoDownscale = 1;
+
+// Temporal accumulation of the AO buffer: the noise is shifted at each frame, and the AO of the previous frames is
+// reprojected with the motion vectors of the geometry pass and blended with the current one (up to temporalFrames frames)
+bool temporalAO = false;
+int temporalFrames = 16;
+
+// Compute shader path (OpenGL 4.3, checked at run time): CryEngine 2 and StarCraft II AO and the bilateral blur are
+// evaluated by a single dispatch (see ssao.comp), writing the AO buffer sampled by the lighting pass.
+// It is not used with the temporal accumulation, which must be applied before the blur, nor with a blur radius larger
+// than computeAOMaxBlurRadius: the AO evaluated on the blur apron of each tile grows with the radius, and the radius
+// from which the separate blur passes are faster depends on the GPU (e.g., 4 on llvmpipe at 640x480 with 64 samples).
+// It is set from the UI or with --compute-max-blur-radius, and it can be measured with the benchmark (compute = 0, 1
+// swept over the blur radii); by default the compute path is used for all the radii (up to MAX_BLUR_RADIUS of ssao.comp)
+const int COMPUTE_AO_MAX_BLUR_RADIUS = 8;
+int computeAOMaxBlurRadius = COMPUTE_AO_MAX_BLUR_RADIUS;
+bool computeAO = false;
+bool computeAOSupported = false;
+
+// Specialized shaders: the AO and blur programs are compiled with their parameters (kernel size, directions and steps,
+// blur radius, resolution) as compile-time constants, one variant for each combination of values
+bool specializedShaders = false;
+
+// Levels of detail of the meshes (see utils/mesh_simplifier.h): the LOD of each mesh is the coarsest one whose error,
+// projected on the screen, is at most lodPixelError pixels (0 = always the full resolution meshes)
+float lodPixelError = 1.0f;
+// triangles and draw calls of the last geometry pass, and the CPU time of their submission (in seconds)
+GLsizei geometryTriangles = 0;
+int geometryDrawCalls = 0;
+double geometrySubmitTime = 0.0;
+
+// Stress scene: stressInstances static copies of the models on a cubic grid behind the scene, drawn with one instanced draw
+// call per model and level of detail (see RenderInstances)
+int stressInstances = 0;
+
+// Frustum culling (see utils/bvh.h): the meshes of the objects of the scene and the instances of the stress scene are
+// the objects of a bounding volume hierarchy, culled with the view frustum once per frame (see UpdateScene)
+bool frustumCulling = true;
+BVH sceneBVH;
+// objects of the scene (their entities in the transform store): each one has an object of the hierarchy for each mesh
+// of its model, starting from sceneObjectFirst[object]; the instances of the stress scene follow, starting from
+// sceneObjectFirst[SCENE_OBJECTS_NUM]
+enum { PLANE_OBJECT, SPHERE_OBJECT, CUBE_OBJECT, BUNNY_OBJECT, SCENE_OBJECTS_NUM };
+size_t sceneObjectFirst[SCENE_OBJECTS_NUM + 1] = {};
+// visibility of each object of the hierarchy in the current frame
+std::vector<uint8_t> objectVisible;
+// objects of the hierarchy, visible ones, and time of the culling of the last frame (in seconds)
+int cullObjects = 0, cullVisible = 0;
+double cullTime = 0.0;
 
 // Available ambient occlusion modes
 enum {
@@ -161,6 +263,7 @@ enum {
 	ALCHEMY_AO,
 	UE4_AO,
 	SSDO,
+	DEINTERLEAVED_HBAO,
 	SSAO_MODES_NUM
 };
 const char *techniqueNames[] = {
@@ -172,8 +275,45 @@ const char *techniqueNames[] = {
 	"Horizon Based Ambient Occlusion (HBAO)",
 	"Alchemy AO",
 	"Unreal Engine 4 AO",
-	"Screen Space Directional Occlusion (SSDO)"
+	"Screen Space Directional Occlusion (SSDO)",
+	"Deinterleaved HBAO"
+};
+
+// Hierarchical depth buffer: the samples of the AO passes far from the fragment are fetched from the coarser levels
+// of a mip pyramid of the linear depth, built with the selected reduction of the 2x2 blocks of each level.
+// The mode is selected for each technique (only the ones evaluating the samples from their position)
+enum {
+	DEPTH_PYRAMID_OFF,
+	DEPTH_PYRAMID_MIN,
+	DEPTH_PYRAMID_MAX,
+	DEPTH_PYRAMID_AVERAGE,
+	DEPTH_PYRAMID_MODES_NUM
 };
+const char *depthPyramidNames[] = {
+	"Off",
+	"Minimum (nearest)",
+	"Maximum (farthest)",
+	"Average"
+};
+int depthPyramidModes[SSAO_MODES_NUM] = {};
+bool supportsDepthPyramid(int mode) {
+	return mode == CRYENGINE2_AO || mode == STARCRAFT2_AO || mode == ALCHEMY_AO;
+}
+bool usesSampleKernel(int mode) {
+	return mode != HBAO && mode != DEINTERLEAVED_HBAO;
+}
+bool supportsComputeAO(int mode) {
+	return computeAOSupported && (mode == CRYENGINE2_AO || mode == STARCRAFT2_AO);
+}
+// blurRadius = 0: no blur (the radius of the taps, see BlurTaps)
+bool usesComputeAO(int mode, int blurRadius) {
+	return supportsComputeAO(mode) && blurRadius <= computeAOMaxBlurRadius;
+}
+// taps on each side of the blurred texels: with textureGather the taps are fetched in pairs, so the radius is rounded
+// up to an even number. The fragment and compute paths blur with the same radius
+int BlurTaps(int radius, bool gather) {
+	return gather ? (radius + 1) / 2 * 2 : radius;
+}
 
 // G Buffer buffers
 enum {
@@ -181,6 +321,7 @@ enum {
 	NORMALS,
 	ALBEDO,
 	DEPTH_BUFFER,
+	MOTION_VECTORS,
 	SSAO_BUFFER,
 	FINAL_SSAO_BUFFER,
 	SSDO_BUFFER,
@@ -195,6 +336,7 @@ const char *gbufferNames[] = {
 	"Normals",
 	"Albedo",
 	"Depth Buffer",
+	"Motion Vectors",
 	"SSAO",
 	"SSAO blurred",
 	"SSDO Directional Light",
@@ -203,80 +345,46 @@ const char *gbufferNames[] = {
 	"SSDO Indirect Lighting",
 	"SSDO Indirect Lighting blurred"
 };
-GLuint gPosition, gNormal, gAlbedo, SSAOColorBuffer, SSAOColorBufferBlurred, SSDOColorBuffer, SSDOColorBufferBlurred;
-GLuint SSDOColorBufferLighting, SSDOColorBufferIndirectLighting, SSDOColorBufferIndirectLightingBlurred;
+GLuint gPosition, gNormal, gAlbedo, gDepthBuffer, gMotion;
+// the pass stage buffers are transient resources of the render graph: their entries are updated at each frame
 GLuint gbuffers[GBUFFER_BUFFERS_NUM];
 
+// Framebuffer receiving the final image: 0 (the window) in interactive mode, an offscreen FBO when benchmarking
+GLuint outputFBO = 0;
+GLuint outputColorBuffer, outputDepthBuffer;
+
 // Currently active SSAO mode
 GLint ssao_mode = CRYENGINE2_AO;
 GLboolean camera_mode = GL_TRUE;
 
-// Functions used to generate samples for our SSAO techniques
-void generateSphereSamples(std::vector<glm::vec3>& SSAOKernel) { // CryEngine2-like AO generator (Sphere around a point)
-	std::uniform_real_distribution<GLfloat> randomFloats(0.0, 1.0);
-	std::default_random_engine generator;
-	SSAOKernel.clear();
-	for (unsigned int i = 0; i < kernelSize; ++i)
-	{
-		glm::vec3 sample(
-			randomFloats(generator) * 2.0 - 1.0,
-			randomFloats(generator) * 2.0 - 1.0,
-			randomFloats(generator) * 2.0 - 1.0);
-		sample = glm::normalize(sample);
-		sample *= randomFloats(generator);
-		float scale = float(i) / float(kernelSize);
-
-		// Scale samples so that they're more aligned to the center of the kernel
-		scale = (scale * scale) * 0.9f + 0.1f;
-		sample *= scale;
-		SSAOKernel.push_back(sample);
-	}
-}
-void generateHemiSphereSamples(std::vector<glm::vec3>& SSAOKernel) { // StarCraftII-like AO generator (Oriented Hemisphere considering point normal)
-	std::uniform_real_distribution<GLfloat> randomFloats(0.0, 1.0);
-	std::default_random_engine generator;
-	SSAOKernel.clear();
-	for (unsigned int i = 0; i < kernelSize; ++i)
-	{
-		glm::vec3 sample(
-			randomFloats(generator) * 2.0 - 1.0,
-			randomFloats(generator) * 2.0 - 1.0,
-			randomFloats(generator)); // By sampling Z only in [0, 1] range, we effectively sample inside an hemisphere
-		sample = glm::normalize(sample);
-		sample *= randomFloats(generator);
-		float scale = float(i) / float(kernelSize);
-
-		// Scale samples so that they're more aligned to center of kernel
-		scale = (scale * scale) * 0.9f + 0.1f;
-		sample *= scale;
-		SSAOKernel.push_back(sample);
-	}
-}
-
 ///////////////////////////////////////////
 // load one side of the cubemap, passing the name of the file and the side of the corresponding OpenGL cubemap
-void LoadTextureCubeSide(string path, string side_image, GLuint side_name)
+// the image is decoded by a worker of the loader, and then set as the side of the cubemap on the thread of the context
+void LoadTextureCubeSide(AssetLoader &loader, GLuint textureImage, string path, string side_image, GLuint side_name)
 {
-    int w, h;
-    unsigned char* image;
-    string fullname;
-
-    // full name and path of the side of the cubemap
-    fullname = path + side_image;
-    // we load the image file
-    image = stbi_load(fullname.c_str(), &w, &h, 0, STBI_rgb);
-    if (image == nullptr)
-        std::cout << "Failed to load texture!" << std::endl;
-    // we set the image file as one of the side of the cubemap (passed as a parameter)
-    glTexImage2D(side_name, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-    // we free the memory once we have created an OpenGL texture
-    stbi_image_free(image);
+    loader.Submit([=]() {
+        int w = 0, h = 0;
+        // full name and path of the side of the cubemap
+        string fullname = path + side_image;
+        // we load the image file
+        unsigned char* image = stbi_load(fullname.c_str(), &w, &h, 0, STBI_rgb);
+        if (image == nullptr)
+            std::cout << "Failed to load texture!" << std::endl;
+        return AssetLoader::Upload([=]() {
+            // we set the image file as one of the side of the cubemap (passed as a parameter)
+            glBindTexture(GL_TEXTURE_CUBE_MAP, textureImage);
+            glTexImage2D(side_name, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+            // we free the memory once we have created an OpenGL texture
+            stbi_image_free(image);
+        });
+    });
 }
 
 
 //////////////////////////////////////////
 // we load the 6 images from disk and we create an OpenGL cube map
-GLint LoadTextureCube(string path)
+// the sides are set when the loader uploads its assets (see utils/asset_loader.h)
+GLint LoadTextureCube(string path, AssetLoader &loader)
 {
     GLuint textureImage;
 
@@ -285,16 +393,6 @@ GLint LoadTextureCube(string path)
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureImage);
 
-    // we load and set the 6 images corresponding to the 6 views of the cubemap
-    // we use as convention that the names of the 6 images are "posx, negx, posy, negy, posz, negz", placed at the path passed as parameter
-    // we load the images individually and we assign them to the correct sides of the cube map
-    LoadTextureCubeSide(path, std::string("posx.jpg"), GL_TEXTURE_CUBE_MAP_POSITIVE_X);
-    LoadTextureCubeSide(path, std::string("negx.jpg"), GL_TEXTURE_CUBE_MAP_NEGATIVE_X);
-    LoadTextureCubeSide(path, std::string("posy.jpg"), GL_TEXTURE_CUBE_MAP_POSITIVE_Y);
-    LoadTextureCubeSide(path, std::string("negy.jpg"), GL_TEXTURE_CUBE_MAP_NEGATIVE_Y);
-    LoadTextureCubeSide(path, std::string("posz.jpg"), GL_TEXTURE_CUBE_MAP_POSITIVE_Z);
-    LoadTextureCubeSide(path, std::string("negz.jpg"), GL_TEXTURE_CUBE_MAP_NEGATIVE_Z);
-
     // we set the filtering for minification and magnification
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -307,107 +405,245 @@ GLint LoadTextureCube(string path)
     // we set the binding to 0 once we have finished
     glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
 
+    // we load and set the 6 images corresponding to the 6 views of the cubemap
+    // we use as convention that the names of the 6 images are "posx, negx, posy, negy, posz, negz", placed at the path passed as parameter
+    // we load the images individually and we assign them to the correct sides of the cube map
+    LoadTextureCubeSide(loader, textureImage, path, std::string("posx.jpg"), GL_TEXTURE_CUBE_MAP_POSITIVE_X);
+    LoadTextureCubeSide(loader, textureImage, path, std::string("negx.jpg"), GL_TEXTURE_CUBE_MAP_NEGATIVE_X);
+    LoadTextureCubeSide(loader, textureImage, path, std::string("posy.jpg"), GL_TEXTURE_CUBE_MAP_POSITIVE_Y);
+    LoadTextureCubeSide(loader, textureImage, path, std::string("negy.jpg"), GL_TEXTURE_CUBE_MAP_NEGATIVE_Y);
+    LoadTextureCubeSide(loader, textureImage, path, std::string("posz.jpg"), GL_TEXTURE_CUBE_MAP_POSITIVE_Z);
+    LoadTextureCubeSide(loader, textureImage, path, std::string("negz.jpg"), GL_TEXTURE_CUBE_MAP_NEGATIVE_Z);
+
     return textureImage;
 
 }
 
-// Helper function to setup an FBO + related texture pass stage
-void setupPassFBO(GLuint *fbo_id, GLuint *tex_id, GLenum format, int gbuffer_id) {
-	glGenTextures(1, tex_id);
-	gbuffers[gbuffer_id] = *tex_id;
-	glBindTexture(GL_TEXTURE_2D, *tex_id);
-	glTexImage2D(GL_TEXTURE_2D, 0, format, screenWidth, screenHeight, 0, format, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glGenFramebuffers(1, fbo_id);
-	glBindFramebuffer(GL_FRAMEBUFFER, *fbo_id);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *tex_id, 0);
+//////////////////////////////////////////
+// we load a model: its meshes are prepared by a worker of the loader, and their buffers are created on the thread of the context
+void LoadModel(AssetLoader &loader, Model &model, string path)
+{
+    loader.Submit([&model, path]() {
+        model.Prepare(path);
+        return AssetLoader::Upload([&model]() { model.Upload(); });
+    });
+}
+
+// Helper function to apply a benchmark configuration to the application state
+// It returns true if the resolution changed, so that render targets and resolution dependent uniforms must be updated
+bool applyBenchmarkConfig(const BenchmarkConfig &config) {
+	ssao_mode = config.ssao_mode;
+	kernelSize = config.kernelSize;
+	kernelRadius = config.kernelRadius;
+	numDirections = config.numDirections;
+	numSteps = config.numSteps;
+	have_blur = config.have_blur;
+	aoDownscale = config.aoDownscale;
+	blurRadius = config.blurRadius;
+	blurGather = config.blurGather;
+	temporalAO = config.temporalAO;
+	depthPyramidModes[config.ssao_mode] = config.depthPyramid;
+	computeAO = config.computeAO;
+	specializedShaders = config.specializedShaders;
+	stressInstances = config.stressInstances;
+	if (config.width == screenWidth && config.height == screenHeight)
+		return false;
+	screenWidth = config.width;
+	screenHeight = config.height;
+	return true;
 }
 
 /////////////////// MAIN function ///////////////////////
-int main()
+int main(int argc, char **argv)
 {
-	// Initialization of OpenGL context using GLFW
-	glfwInit();
-	// We set OpenGL specifications required for this application
-	// In this case: 4.1 Core
-	// If not supported by your graphics HW, the context will not be created and the application will close
-	// N.B.) creating GLAD code to load extensions, try to take into account the specifications and any extensions you want to use,
-	// in relation also to the values indicated in these GLFW commands
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-	// we set if the window is resizable
-	glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-
-	// we create the application's window
-	GLFWwindow* window = glfwCreateWindow(screenWidth, screenHeight, "SSAO Analysis", nullptr, nullptr);
-	if (!window)
-	{
-		std::cout << "Failed to create GLFW window" << std::endl;
-		glfwTerminate();
-		return -1;
+	// Parsing command line options
+	// --headless renders offscreen without any window, the other options set up the benchmark sweep (see utils/benchmark.h)
+	Benchmark benchmark;
+	bool benchmarking = false;
+	// pool of the render targets of the pass stages (see utils/render_target_pool.h)
+	RenderTargetPool renderTargets;
+	for (int i = 1; i < argc; i++) {
+		string option = argv[i];
+		if (option == "--headless") {
+			headless = true;
+		} else if (option == "--capture" && i + 1 < argc) {
+			// the first rendered frame is saved in the given capture file
+			captureRequested = true;
+			capturePath = argv[++i];
+		} else if (option == "--config" && i + 1 < argc) {
+			benchmarking = benchmark.LoadConfigFile(argv[++i]) || benchmarking;
+		} else if (option == "--no-program-cache") {
+			// the programs are always compiled from the sources (e.g., to measure a cold start)
+			ProgramCache::Get().enabled = false;
+		} else if (option == "--no-mesh-cache") {
+			// the models are always imported with Assimp
+			MeshCache::Get().enabled = false;
+		} else if (option == "--no-mesh-optimization") {
+			// the imported meshes keep the order of the triangles and of the vertices of their files
+			MeshOptimizer::Get().enabled = false;
+		} else if (option == "--no-mesh-lod") {
+			// the imported meshes have only the full resolution level
+			MeshSimplifier::Get().enabled = false;
+		} else if (option == "--lod-error" && i + 1 < argc) {
+			// maximum error in pixels of the selected levels of detail
+			lodPixelError = (float)atof(argv[++i]);
+		} else if (option == "--compute-max-blur-radius" && i + 1 < argc) {
+			// largest blur radius of the compute shader path (the separate fragment passes are used above it)
+			computeAOMaxBlurRadius = glm::clamp(atoi(argv[++i]), 0, COMPUTE_AO_MAX_BLUR_RADIUS);
+		} else if (option == "--no-culling") {
+			// all the meshes are drawn, without the frustum culling
+			frustumCulling = false;
+		} else if (option == "--vertex-layout" && i + 1 < argc) {
+			// format of the vertex buffers of the meshes (see utils/vertex_layout.h): compact (default), half (half float
+			// positions) or full (the 56 bytes fp32 Vertex, interleaved)
+			string layout = argv[++i];
+			if (layout == "full")
+				VertexLayout::Get() = VertexLayout::Full();
+			else if (layout == "half")
+				VertexLayout::Get().positions = VertexLayout::POSITION_HALF;
+			else if (layout != "compact")
+				std::cout << "WARNING::OPTIONS:: unknown vertex layout " << layout << std::endl;
+		} else if (option == "--target-idle-time" && i + 1 < argc) {
+			// seconds after which the render targets not used by the current technique are released
+			renderTargets.idleTime = atof(argv[++i]);
+		} else if (benchmark.ParseArgument(argc, argv, i)) {
+			benchmarking = true;
+		} else {
+			std::cout << "Unknown option: " << option << std::endl;
+			return -1;
+		}
 	}
-	glfwMakeContextCurrent(window);
+	// A headless run is always a benchmark run, otherwise the application would never end
+	benchmarking = benchmarking || headless;
+
+	GLFWwindow* window = nullptr;
+	HeadlessContext headlessContext;
+	if (headless && headlessContext.Create(4, 1)) {
+		// GLAD tries to load the surfaceless context
+		if (!gladLoadGLLoader((GLADloadproc) HeadlessContext::GetProcAddress))
+		{
+			std::cout << "Failed to initialize OpenGL context" << std::endl;
+			return -1;
+		}
+		std::cout << "Headless rendering on " << glGetString(GL_RENDERER) << std::endl;
+	} else {
+		if (headless)
+			std::cout << "Surfaceless context not available, using an invisible window" << std::endl;
+		
+		// Initialization of OpenGL context using GLFW
+		glfwInit();
+		// We set OpenGL specifications required for this application
+		// In this case: 4.1 Core
+		// If not supported by your graphics HW, the context will not be created and the application will close
+		// N.B.) creating GLAD code to load extensions, try to take into account the specifications and any extensions you want to use,
+		// in relation also to the values indicated in these GLFW commands
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+		// we set if the window is resizable
+		glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+		// in headless mode the window is never shown
+		glfwWindowHint(GLFW_VISIBLE, headless ? GL_FALSE : GL_TRUE);
+
+		// we create the application's window
+		window = glfwCreateWindow(screenWidth, screenHeight, "SSAO Analysis", nullptr, nullptr);
+		if (!window)
+		{
+			std::cout << "Failed to create GLFW window" << std::endl;
+			glfwTerminate();
+			return -1;
+		}
+		glfwMakeContextCurrent(window);
 
-	// we put in relation the window and the callbacks
-	glfwSetKeyCallback(window, key_callback);
-	glfwSetCursorPosCallback(window, mouse_callback);
+		if (!headless) {
+			// we put in relation the window and the callbacks
+			glfwSetKeyCallback(window, key_callback);
+			glfwSetCursorPosCallback(window, mouse_callback);
 
-	// we disable the mouse cursor
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+			// we disable the mouse cursor
+			glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+		}
 
-	// GLAD tries to load the context set by GLFW
-	if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress))
-	{
-		std::cout << "Failed to initialize OpenGL context" << std::endl;
-		return -1;
+		// GLAD tries to load the context set by GLFW
+		if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress))
+		{
+			std::cout << "Failed to initialize OpenGL context" << std::endl;
+			return -1;
+		}
 	}
 
 	// we define the viewport dimensions
-	int width, height;
-	glfwGetFramebufferSize(window, &width, &height);
-
-	ImGui::CreateContext();
-	ImGuiIO& io = ImGui::GetIO(); (void)io;
-	ImGui::StyleColorsDark();
-	ImGui_ImplGlfw_InitForOpenGL(window, true);
-	ImGui_ImplOpenGL3_Init();
+	int width = screenWidth, height = screenHeight;
+	if (!headless) {
+		glfwGetFramebufferSize(window, &width, &height);
+
+		ImGui::CreateContext();
+		ImGuiIO& io = ImGui::GetIO(); (void)io;
+		ImGui::StyleColorsDark();
+		ImGui_ImplGlfw_InitForOpenGL(window, true);
+		ImGui_ImplOpenGL3_Init();
+	}
+	
+	// OpenGL state tracked by the application: the render loop changes it only through the cache
+	GLState &glState = GLState::Get();
+	// the context may have a higher version than the requested one
+	computeAOSupported = GLAD_GL_VERSION_4_3 != 0;
+	// start of the initialization, for the startup time (cold with an empty program cache, warm otherwise)
+	double startupTime = getTime();
+	
+	// Assets loaded in parallel: the images are decoded and the models are prepared by the workers of the loader while
+	// the programs are created, and their OpenGL objects are created on this thread by Finish (see utils/asset_loader.h)
+	AssetLoader assets;
+	textureCube = LoadTextureCube("../../textures/cube/Maskonaive2/", assets);
+
+	// we load the model(s) (code of Model class is in include/utils/model.h)
+	Model cubeModel, sphereModel, bunnyModel;
+	LoadModel(assets, cubeModel, "../../models/cube.obj");
+	LoadModel(assets, sphereModel, "../../models/sphere.obj");
+	LoadModel(assets, bunnyModel, "../../models/bunny_lp.obj");
 	
 	// we enable Z test
-	glEnable(GL_DEPTH_TEST);
+	glState.Enable(GL_DEPTH_TEST);
 
 	//the "clear" color for the frame buffer
 	glClearColor(0.8f, 0.8f, 0.8f, 1.0f);
 
 	// we create the Shader Programs for our scene
-	Shader geometryReconstrPass("geometry_reconstr.vert", "geometry_reconstr.frag");
-	Shader geometryPass("geometry.vert", "geometry.frag");
+	// (the vertex shaders of the meshes decode the attributes of the vertex layout)
+	Shader geometryReconstrPass("geometry_reconstr.vert", "geometry_reconstr.frag", VertexLayout::Get().Defines());
+	Shader geometryPass("geometry.vert", "geometry.frag", VertexLayout::Get().Defines());
+	// instanced variants of the geometry passes, for the stress scene (the model matrices are per-instance attributes)
+	Shader geometryReconstrInstancedPass("geometry_reconstr.vert", "geometry_reconstr.frag", VertexLayout::Get().Defines() + "#define INSTANCED\n");
+	Shader geometryInstancedPass("geometry.vert", "geometry.frag", VertexLayout::Get().Defines() + "#define INSTANCED\n");
+	// model matrices of the instances of the stress scene
+	InstanceBuffer stressInstanceBuffer;
 	Shader lightingReconstrPass("ssao_reconstr.vert", "lighting_reconstr.frag");
 	Shader lightingPass("ssao.vert", "lighting.frag");
 	Shader SSDOIndirectPass("ssao.vert", "ssdo_indirect.frag");
 	Shader SSDOCombinePass("ssao.vert", "ssdo_combine.frag");
-	Shader SSAOPass("ssao.vert", "ssao.frag");
-	Shader SSAOReconstrPass("ssao_reconstr.vert", "ssao_reconstr.frag");
-	Shader HBAOPass("ssao.vert", "hbao.frag");
-	Shader SSDOPass("ssao.vert", "ssdo.frag");
-	Shader AlchemyPass("ssao.vert", "alchemy_ao.frag");
-	Shader UnrealPass("ssao.vert", "ue4_ao.frag");
-	Shader blurPass("ssao.vert", "blur.frag");
-	Shader SSDOblurPass("ssao.vert", "ssdo_blur.frag");
+	ShaderVariants SSAOPass("ssao.vert", "ssao.frag");
+	ShaderVariants SSAOReconstrPass("ssao_reconstr.vert", "ssao_reconstr.frag");
+	ShaderVariants HBAOPass("ssao.vert", "hbao.frag");
+	ShaderVariants HBAODeinterleavedPass("ssao.vert", "hbao_deinterleaved.frag");
+	Shader deinterleavePass("ssao.vert", "deinterleave.frag");
+	ShaderVariants SSDOPass("ssao.vert", "ssdo.frag");
+	ShaderVariants AlchemyPass("ssao.vert", "alchemy_ao.frag");
+	ShaderVariants UnrealPass("ssao.vert", "ue4_ao.frag");
+	ShaderVariants blurPassVariants("ssao.vert", "bilateral_blur.frag");
+	Shader temporalPass("ssao.vert", "temporal_ao.frag");
+	Shader depthPyramidPass("ssao.vert", "depth_pyramid.frag");
+	std::unique_ptr<Shader> SSAOComputePass(computeAOSupported ? new Shader("ssao.comp") : nullptr);
 	Shader simplePass("ssao.vert", "simple.frag");
+	Shader downsamplePass("ssao.vert", "downsample.frag");
+	Shader upsamplePass("ssao.vert", "upsample.frag");
 	Shader skyboxPass("skybox.vert", "skybox.frag");
 	Shader skyboxReconstrPass("skybox.vert", "skybox_reconstr.frag");
+	double programsTime = getTime() - startupTime;
 
-	textureCube = LoadTextureCube("../../textures/cube/Maskonaive2/");
-
-	// we load the model(s) (code of Model class is in include/utils/model.h)
-	Model cubeModel("../../models/cube.obj");
-	Model sphereModel("../../models/sphere.obj");
-	Model bunnyModel("../../models/bunny_lp.obj");
+	// we wait for the assets, and we upload them
+	assets.Finish();
+	double assetsTime = getTime() - startupTime;
 	
 	// Create a full white texture to simulate absence of ambient occlusion
 	GLuint gWhiteTex;
@@ -417,10 +653,10 @@ int main()
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, 1, 1, 0, GL_RED, GL_UNSIGNED_BYTE, &white);
 	
 	// Creating the textures for the G-Buffer framebuffer (gPosition, gNormal, gAlbedo in the geometry fragment shader)
+	// Their storage is allocated by allocateRenderTargets, so that it can be resized when benchmarking different resolutions
 	glGenTextures(1, &gPosition);
 	gbuffers[POSITION] = gPosition;
 	glBindTexture(GL_TEXTURE_2D, gPosition);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, screenWidth, screenHeight, 0, GL_RGB, GL_FLOAT, nullptr); // Float texture to ensure values are not clamped in [0, 1] range
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -428,22 +664,26 @@ int main()
 	glGenTextures(1, &gNormal);
 	gbuffers[NORMALS] = gNormal;
 	glBindTexture(GL_TEXTURE_2D, gNormal);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, screenWidth, screenHeight, 0, GL_RGB, GL_FLOAT, nullptr); // Float texture to ensure values are not clamped in [0, 1] range
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glGenTextures(1, &gAlbedo);
 	gbuffers[ALBEDO] = gAlbedo;
 	glBindTexture(GL_TEXTURE_2D, gAlbedo);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, screenWidth, screenHeight, 0, GL_RGB, GL_FLOAT, nullptr); // Float texture to ensure values are not clamped in [0, 1] range
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	// Motion vectors, written only when the temporal AO accumulation is enabled
+	glGenTextures(1, &gMotion);
+	gbuffers[MOTION_VECTORS] = gMotion;
+	glBindTexture(GL_TEXTURE_2D, gMotion);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	
 	// Create a depth buffer for our framebuffer
-	GLuint gDepthBuffer;
 	glGenTextures(1, &gDepthBuffer); // We create it as a texture instead of a renderbuffer so that we can use it for the depth resolve technique
 	glBindTexture(GL_TEXTURE_2D, gDepthBuffer);
 	gbuffers[DEPTH_BUFFER] = gDepthBuffer;
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, screenWidth, screenHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -458,38 +698,42 @@ int main()
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPosition, 0);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedo, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, gMotion, 0);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gDepthBuffer, 0);
 
 	// Enabling drawing on all the attached buffers for the given framebuffer
-	GLuint full_attachments[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
-	GLuint reconstr_attachments[] = {GL_NONE, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
-
-	// Setting up all pass stage intermediate fbos and textures
-	GLuint SSAOfbo, SSDOfbo, SSAOBlurFBO, SSDOBlurFBO, SSDODirectLightingFBO, SSDOIndirectLightingFBO, SSDOIndirectLightingBlurFBO;
-	setupPassFBO(&SSAOfbo, &SSAOColorBuffer, GL_RED, SSAO_BUFFER);
-	setupPassFBO(&SSDOfbo, &SSDOColorBuffer, GL_RGB, SSDO_BUFFER);
-	setupPassFBO(&SSAOBlurFBO, &SSAOColorBufferBlurred, GL_RED, FINAL_SSAO_BUFFER);
-	setupPassFBO(&SSDOBlurFBO, &SSDOColorBufferBlurred, GL_RGB, FINAL_SSDO_BUFFER);
-	setupPassFBO(&SSDODirectLightingFBO, &SSDOColorBufferLighting, GL_RGB, SSDO_DIRECT_BUFFER);
-	setupPassFBO(&SSDOIndirectLightingFBO, &SSDOColorBufferIndirectLighting, GL_RGB, SSDO_INDIRECT_BUFFER);
-	setupPassFBO(&SSDOIndirectLightingBlurFBO, &SSDOColorBufferIndirectLightingBlurred, GL_RGB, FINAL_SSDO_INDIRECT_BUFFER);
+	// (the motion vectors, in the last attachment, are drawn only with the temporal AO accumulation)
+	GLuint full_attachments[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3};
+	GLuint reconstr_attachments[] = {GL_NONE, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3};
+
+	// When benchmarking, the final image is rendered offscreen, so that the measured resolution does not depend on the window
+	if (benchmarking) {
+		glGenRenderbuffers(1, &outputColorBuffer);
+		glGenRenderbuffers(1, &outputDepthBuffer);
+		glGenFramebuffers(1, &outputFBO);
+	}
+	allocateRenderTargets();
+	// the renderbuffers exist only after their first binding (in allocateRenderTargets), so they are attached here
+	if (benchmarking) {
+		glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, outputColorBuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, outputDepthBuffer);
+	}
 	
 	// Binding back to default framebuffer
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
 	// Generate the sample kernel required for SSAO processing
+	// The samples are stored in a uniform buffer shared by all the AO programs, uploaded only when they are regenerated
 	std::vector<glm::vec3> SSAOKernel;
-	generateSphereSamples(SSAOKernel);
+	generateSphereSamples(SSAOKernel, kernelSize);
+	KernelBuffer kernelBuffer;
+	kernelBuffer.Create();
+	// (the programs reading the samples are attached by their setup, see setupStaticUniforms)
 	
 	// Generate a noise texture required for SSAO processing holding random vectors to use as directions during AO calculation
-	std::uniform_real_distribution<GLfloat> randomFloats(0.0, 1.0);
-	std::default_random_engine generator;
 	std::vector<glm::vec3> SSAONoise;
-	for (unsigned int i = 0; i < 16; i++)
-	{
-		glm::vec3 noise(randomFloats(generator) * 2.0 - 1.0, randomFloats(generator) * 2.0 - 1.0, 0.0f);
-		SSAONoise.push_back(noise);
-	}
+	generateNoise(SSAONoise);
 	GLuint noiseTexture;
 	glGenTextures(1, &noiseTexture);
 	glBindTexture(GL_TEXTURE_2D, noiseTexture);
@@ -499,122 +743,701 @@ int main()
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	
-	// Projection matrix of the camera: FOV angle, aspect ratio, near and far planes
-	glm::mat4 projection = glm::perspective(FOV, (float)screenWidth/(float)screenHeight, 0.1f, 50.0f);
+	// Setting up the uniforms which do not change across frames
+	// N.B. they depend on the screen resolution, so we set them again when a benchmark configuration changes it
+	auto setupStaticUniforms = [&]() {
+		// Projection matrix of the camera: FOV angle, aspect ratio, near and far planes
+		glm::mat4 projection = glm::perspective(FOV, (float)screenWidth/(float)screenHeight, 0.1f, 50.0f);
+
+		// Setting the projection matrices used in our shaders (the texture units of the samplers are assigned by the Shader class)
+		// The uniforms are set by the setup function of each program, when its compilation is completed (so the programs
+		// not used by the first frames do not delay it)
+		auto projectionSetup = [projection](Shader &pass) {
+			pass.SetMat4("projectionMatrix", projection);
+		};
+		auto reconstrSetup = [projection](Shader &pass) {
+			pass.SetFloat("gAspectRatio", (float)screenWidth/(float)screenHeight);
+			pass.SetFloat("gTanFOV", tan(FOV));
+			pass.SetMat4("projectionMatrix", projection);
+			pass.SetMat4("invProjectionMatrix", glm::inverse(projection));
+		};
+		skyboxPass.Setup(projectionSetup);
+		skyboxReconstrPass.Setup(projectionSetup);
+		// the AO programs read the sample kernel (the specialized variants of the AO programs are set up as well)
+		auto aoSetup = [projection, &kernelBuffer](Shader &pass) {
+			kernelBuffer.AttachProgram(pass.Program);
+			pass.SetMat4("projectionMatrix", projection);
+		};
+		SSAOPass.Setup(aoSetup);
+		SSDOPass.Setup(aoSetup);
+		AlchemyPass.Setup(aoSetup);
+		UnrealPass.Setup(aoSetup);
+		HBAOPass.Setup(aoSetup);
+		HBAODeinterleavedPass.Setup(aoSetup);
+		SSDOIndirectPass.Setup(aoSetup);
+		SSAOReconstrPass.Setup([aoSetup, reconstrSetup](Shader &pass) {
+			aoSetup(pass);
+			reconstrSetup(pass);
+		});
+		auto bilateralSetup = [projection](Shader &pass) {
+			pass.SetMat4("projectionMatrix", projection);
+			pass.SetFloat("depthSigma", 0.1f);
+		};
+		blurPassVariants.Setup(bilateralSetup);
+		upsamplePass.Setup(bilateralSetup);
+		if (SSAOComputePass) {
+			SSAOComputePass->Setup([aoSetup, bilateralSetup](Shader &pass) {
+				aoSetup(pass);
+				bilateralSetup(pass);
+			});
+		}
+		lightingPass.Setup(projectionSetup);
+		lightingReconstrPass.Setup(reconstrSetup);
+		geometryPass.Setup(projectionSetup);
+		geometryReconstrPass.Setup(projectionSetup);
+		geometryInstancedPass.Setup(projectionSetup);
+		geometryReconstrInstancedPass.Setup(projectionSetup);
+		downsamplePass.Setup(projectionSetup);
+		temporalPass.Setup([projection](Shader &pass) {
+			pass.SetMat4("projectionMatrix", projection);
+			pass.SetFloat("depthTolerance", 0.05f);
+			pass.SetFloat("normalTolerance", 0.9f);
+		});
+	};
+	setupStaticUniforms();
+
+	// Render graph of the frame: each pass declares the resources it reads and writes, and if it is part of the
+	// current configuration. The passes not needed to produce the final image are culled (e.g., the lighting passes
+	// when only the AO buffer is shown)
+	// The intermediate pass stage buffers are transient: their render targets are allocated only when a technique
+	// uses them, shared by the buffers with disjoint lifetimes, and released when unused for renderTargets.idleTime
+	RenderGraph renderGraph(renderTargets);
+	RenderGraph::Resource position = renderGraph.Import("gPosition", gPosition, gBuffer);
+	RenderGraph::Resource normal = renderGraph.Import("gNormal", gNormal, gBuffer);
+	RenderGraph::Resource albedo = renderGraph.Import("gAlbedo", gAlbedo, gBuffer);
+	RenderGraph::Resource depth = renderGraph.Import("gDepthBuffer", gDepthBuffer, gBuffer);
+	RenderGraph::Resource motion = renderGraph.Import("gMotion", gMotion, gBuffer);
+	// Inputs and outputs of the AO passes, with the resolution selected by aoDownscale (the low resolution G Buffer is
+	// used only at half and quarter resolution, and the AO buffers are then upsampled to full resolution)
+	RenderGraph::Resource lowPosition = renderGraph.Create("Low Res Positions", GL_RGB16F, GL_RGB, GL_FLOAT);
+	RenderGraph::Resource lowDepth = renderGraph.Create("Low Res Depth Buffer", GL_R32F, GL_RED, GL_FLOAT);
+	RenderGraph::Resource lowNormal = renderGraph.Create("Low Res Normals and Depth", GL_RGBA16F, GL_RGBA, GL_FLOAT);
+	RenderGraph::Resource ao = renderGraph.Create("SSAO", GL_RED, GL_RED, GL_FLOAT);
+	RenderGraph::Resource aoBlurredX = renderGraph.Create("SSAO Blurred Horizontally", GL_RED, GL_RED, GL_FLOAT);
+	RenderGraph::Resource aoBlurred = renderGraph.Create("SSAO Blurred", GL_RED, GL_RED, GL_FLOAT);
+	RenderGraph::Resource deinterleavedPosition = renderGraph.Create("Deinterleaved Positions", GL_RGB16F, GL_RGB, GL_FLOAT);
+	RenderGraph::Resource deinterleavedAO = renderGraph.Create("Deinterleaved SSAO", GL_RED, GL_RED, GL_FLOAT);
+	RenderGraph::Resource aoCompute = renderGraph.Create("SSAO Compute", GL_R16F, GL_RED, GL_FLOAT); // written as an image
+	RenderGraph::Resource ssdo = renderGraph.Create("SSDO", GL_RGB, GL_RGB, GL_FLOAT);
+	RenderGraph::Resource ssdoBlurredX = renderGraph.Create("SSDO Blurred Horizontally", GL_RGB, GL_RGB, GL_FLOAT);
+	RenderGraph::Resource ssdoBlurred = renderGraph.Create("SSDO Blurred", GL_RGB, GL_RGB, GL_FLOAT);
+	// History of the temporal accumulation (AO or SSDO): its targets are swapped at each frame
+	TemporalHistory aoHistory;
+	RenderGraph::Resource history = renderGraph.Import("AO History", 0, 0);
+	RenderGraph::Resource accumulated = renderGraph.Import("AO Accumulated", 0, 0);
+	// Hierarchical depth buffer of the AO passes (all its levels are rendered by a single pass)
+	DepthPyramid depthPyramid;
+	RenderGraph::Resource pyramid = renderGraph.Import("Depth Pyramid", 0, 0);
+	RenderGraph::Resource lowResolutionResources[] = {lowPosition, lowDepth, lowNormal, deinterleavedPosition, deinterleavedAO, ao, aoBlurredX, aoBlurred, aoCompute, ssdo, ssdoBlurredX, ssdoBlurred, history, accumulated};
+	RenderGraph::Resource aoUpsampled = renderGraph.Create("SSAO Upsampled", GL_RED, GL_RED, GL_FLOAT);
+	RenderGraph::Resource ssdoUpsampled = renderGraph.Create("SSDO Upsampled", GL_RGB, GL_RGB, GL_FLOAT);
+	RenderGraph::Resource directLighting = renderGraph.Create("SSDO Direct Lighting", GL_RGB, GL_RGB, GL_FLOAT);
+	RenderGraph::Resource indirectLighting = renderGraph.Create("SSDO Indirect Lighting", GL_RGB, GL_RGB, GL_FLOAT);
+	RenderGraph::Resource indirectLightingBlurredX = renderGraph.Create("SSDO Indirect Lighting Blurred Horizontally", GL_RGB, GL_RGB, GL_FLOAT);
+	RenderGraph::Resource indirectLightingBlurred = renderGraph.Create("SSDO Indirect Lighting Blurred", GL_RGB, GL_RGB, GL_FLOAT);
+	RenderGraph::Resource output = renderGraph.Import("Output", 0, outputFBO);
+	
+	// Parameters of the configuration used by the setup functions
+	auto reconstr = [&]() { return ssao_mode == CRYENGINE2_AO_RECONSTR || ssao_mode == STARCRAFT2_AO_RECONSTR; };
+	auto temporal = [&]() { return temporalAO && ssao_mode != NO_SSAO; };
+	auto aoSource = [&]() { return temporal() ? accumulated : ao; };
+	auto ssdoSource = [&]() { return temporal() ? accumulated : ssdo; };
+	auto computePath = [&]() { return computeAO && usesComputeAO(ssao_mode, have_blur ? BlurTaps(blurRadius, blurGather) : 0) && !temporalAO; };
+	auto aoResult = [&]() { return computePath() ? aoCompute : have_blur ? aoBlurred : aoSource(); };
+	auto ssdoResult = [&]() { return have_blur ? ssdoBlurred : ssdoSource(); };
+	auto indirectLightingResult = [&]() { return have_blur ? indirectLightingBlurred : indirectLighting; };
+	auto lowResolutionAO = [&]() { return aoDownscale > 1; };
+	auto depthPyramidMode = [&]() { return supportsDepthPyramid(ssao_mode) ? depthPyramidModes[ssao_mode] : (int)DEPTH_PYRAMID_OFF; };
+	// Shift of the noise texture with the temporal accumulation: the 16 offsets of the 4x4 noise tile, visited
+	// interleaving the bits of the frame index, so that consecutive frames use distant offsets
+	unsigned int temporalFrameIndex = 0;
+	auto noiseOffset = [&]() {
+		if (!temporal())
+			return glm::vec2(0.0f);
+		unsigned int i = temporalFrameIndex % 16;
+		return glm::vec2((i & 1) * 2 + ((i >> 2) & 1), ((i >> 1) & 1) * 2 + ((i >> 3) & 1)) * 0.25f;
+	};
+	// AO buffers used by the lighting passes
+	auto aoOutput = [&]() { return lowResolutionAO() ? aoUpsampled : aoResult(); };
+	auto ssdoOutput = [&]() { return lowResolutionAO() ? ssdoUpsampled : ssdoResult(); };
+	
+	// it binds the framebuffer of a resource, with a viewport covering it
+	auto bindTarget = [&](RenderGraph::Resource resource) {
+		glState.BindFramebuffer(GL_FRAMEBUFFER, renderGraph.Framebuffer(resource));
+		glState.Viewport(0, 0, renderGraph.Width(resource), renderGraph.Height(resource));
+	};
+	
+	// STEP 1 - GEOMETRY PASS
+	// Render the full scene data into our auxiliary G Buffer
+	renderGraph.AddPass("geometry", [&](RenderGraph::Builder &builder) {
+		if (reconstr())
+			return false;
+		builder.Write(position);
+		builder.Write(normal);
+		builder.Write(albedo);
+		builder.Write(depth);
+		if (temporalAO)
+			builder.Write(motion);
+		return true;
+	}, [&]() {
+		bindTarget(position);
+		glState.DrawBuffers(temporalAO ? 4 : 3, full_attachments);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		double submitStart = getTime();
+		geometryPass.Use();
+		geometryPass.SetMat4("viewMatrix", view);
+		geometryPass.SetMat4("previousViewMatrix", previousView);
+		RenderObjects(geometryPass, cubeModel, sphereModel, bunnyModel);
+		RenderInstances(geometryInstancedPass, cubeModel, sphereModel, bunnyModel, stressInstanceBuffer);
+		geometrySubmitTime = getTime() - submitStart;
+	});
+	// If we use CryEngine 2 AO derivatives with depth resolve, we need a different program
+	// to reconstruct view positions instead of using G buffer to store them
+	renderGraph.AddPass("geometry_reconstr", [&](RenderGraph::Builder &builder) {
+		if (!reconstr())
+			return false;
+		builder.Write(normal);
+		builder.Write(albedo);
+		builder.Write(depth);
+		if (temporalAO)
+			builder.Write(motion);
+		return true;
+	}, [&]() {
+		bindTarget(depth);
+		glState.DrawBuffers(temporalAO ? 4 : 3, reconstr_attachments);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		double submitStart = getTime();
+		geometryReconstrPass.Use();
+		geometryReconstrPass.SetMat4("viewMatrix", view);
+		geometryReconstrPass.SetMat4("previousViewMatrix", previousView);
+		RenderObjects(geometryReconstrPass, cubeModel, sphereModel, bunnyModel);
+		RenderInstances(geometryReconstrInstancedPass, cubeModel, sphereModel, bunnyModel, stressInstanceBuffer);
+		geometrySubmitTime = getTime() - submitStart;
+	});
+	
+	// STEP 2a - Downsampling of the G Buffer for the AO passes evaluated at a lower resolution
+	auto addDownsamplePass = [&](const string &name, RenderGraph::Resource source, RenderGraph::Resource target, std::function<bool()> enabled) {
+		renderGraph.AddPass(name, [&, source, target, enabled](RenderGraph::Builder &builder) {
+			if (!lowResolutionAO() || !enabled())
+				return false;
+			builder.Read(depth);
+			builder.Read(source);
+			builder.Write(target);
+			return true;
+		}, [&, source, target]() {
+			bindTarget(target);
+			downsamplePass.Use();
+			downsamplePass.SetInt("factor", aoDownscale);
+			downsamplePass.SetInt("storeDepth", target == lowNormal);
+			downsamplePass.BindTexture("gDepthMap", GL_TEXTURE_2D, renderGraph.Texture(depth));
+			downsamplePass.BindTexture("source", GL_TEXTURE_2D, renderGraph.Texture(source));
+			DrawQuad();
+		});
+	};
+	addDownsamplePass("downsample_normals", normal, lowNormal, [&]() { return true; });
+	addDownsamplePass("downsample_positions", position, lowPosition, [&]() { return !reconstr(); });
+	addDownsamplePass("downsample_depth", depth, lowDepth, [&]() { return reconstr(); });
+	
+	// Hierarchical depth buffer, at the resolution of the AO passes: level 0 is the linear depth of the positions
+	renderGraph.AddPass("depth_pyramid", [&](RenderGraph::Builder &builder) {
+		if (depthPyramidMode() == DEPTH_PYRAMID_OFF)
+			return false;
+		builder.Read(lowResolutionAO() ? lowPosition : position);
+		builder.Write(pyramid);
+		return true;
+	}, [&]() {
+		depthPyramidPass.Use();
+		depthPyramidPass.SetInt("reduction", depthPyramidMode() - DEPTH_PYRAMID_MIN);
+		for (int level = 0; level < depthPyramid.Levels(); level++) {
+			depthPyramid.BeginLevel(level);
+			depthPyramidPass.SetInt("linearize", level == 0);
+			depthPyramidPass.BindTexture("source", GL_TEXTURE_2D, level == 0 ? renderGraph.Texture(lowResolutionAO() ? lowPosition : position) : depthPyramid.Texture());
+			DrawQuad();
+		}
+		depthPyramid.End();
+	});
+	
+	// Defines of the specialized variants of the AO programs (none if the specialization is disabled): the parameters of
+	// the technique and the resolution of the AO passes
+	auto aoDefines = [&]() {
+		ShaderDefines defines;
+		if (!specializedShaders)
+			return defines;
+		if (usesSampleKernel(ssao_mode)) {
+			defines.push_back(std::make_pair("KERNEL_SIZE", std::to_string(kernelSize)));
+		} else {
+			defines.push_back(std::make_pair("NUM_DIRECTIONS", std::to_string(numDirections)));
+			defines.push_back(std::make_pair("NUM_STEPS", std::to_string(numSteps)));
+		}
+		defines.push_back(std::make_pair("RESOLUTION", "ivec2(" + std::to_string(renderGraph.Width(ao)) + ", " + std::to_string(renderGraph.Height(ao)) + ")"));
+		return defines;
+	};
+	
+	// STEP 2 - SSAO Texture generation
+	// One pass for each AO program: the pass is part of the configuration if its program implements the selected technique
+	auto addAOPass = [&](const string &name, ShaderVariants &aoPassVariants, std::initializer_list<int> modes, std::function<void(Shader&)> setParameters) {
+		std::vector<int> techniques(modes);
+		renderGraph.AddPass(name, [&, techniques](RenderGraph::Builder &builder) {
+			if (std::find(techniques.begin(), techniques.end(), ssao_mode) == techniques.end())
+				return false;
+			if (lowResolutionAO()) {
+				builder.Read(reconstr() ? lowDepth : lowPosition);
+				builder.Read(lowNormal);
+			} else {
+				builder.Read(reconstr() ? depth : position);
+				builder.Read(normal);
+			}
+			if (depthPyramidMode() != DEPTH_PYRAMID_OFF)
+				builder.Read(pyramid);
+			builder.Write(ssao_mode != SSDO ? ao : ssdo);
+			return true;
+		}, [&, setParameters]() {
+			bindTarget(ssao_mode != SSDO ? ao : ssdo);
+			glClear(GL_COLOR_BUFFER_BIT);
+			Shader &aoPass = aoPassVariants.Get(aoDefines());
+			setParameters(aoPass);
+			// Textures are bound by sampler name: the ones not used by the selected pass are skipped
+			aoPass.Use();
+			aoPass.BindTexture("gDepthMap", GL_TEXTURE_2D, renderGraph.Texture(lowResolutionAO() ? lowDepth : depth)); // With Depth Resolve, we pass the depth buffer and we reconstruct positions in fragment shader
+			aoPass.BindTexture("gPosition", GL_TEXTURE_2D, renderGraph.Texture(lowResolutionAO() ? lowPosition : position));
+			aoPass.BindTexture("gNormal", GL_TEXTURE_2D, renderGraph.Texture(lowResolutionAO() ? lowNormal : normal));
+			aoPass.BindTexture("noiseTexture", GL_TEXTURE_2D, noiseTexture);
+			aoPass.SetVec2("noiseOffset", noiseOffset());
+			aoPass.SetInt("useDepthPyramid", depthPyramidMode() != DEPTH_PYRAMID_OFF);
+			if (depthPyramidMode() != DEPTH_PYRAMID_OFF) {
+				aoPass.SetInt("pyramidLevels", depthPyramid.Levels());
+				aoPass.BindTexture("depthPyramid", GL_TEXTURE_2D, depthPyramid.Texture());
+			}
+			aoPass.BindTexture("skybox", GL_TEXTURE_CUBE_MAP, textureCube); // We need skybox cubemap for SSDO to calculate directional light
+			DrawQuad();
+			aoPass.BindTexture("skybox", GL_TEXTURE_CUBE_MAP, 0);
+		});
+	};
+	addAOPass("ssao", SSAOPass, {CRYENGINE2_AO, STARCRAFT2_AO}, [&](Shader &pass) {
+		pass.SetInt("kernelSize", kernelSize);
+		pass.SetFloat("radius", kernelRadius);
+		pass.SetFloat("bias", kernelBias);
+	});
+	addAOPass("ssao_reconstr", SSAOReconstrPass, {CRYENGINE2_AO_RECONSTR, STARCRAFT2_AO_RECONSTR}, [&](Shader &pass) {
+		pass.SetInt("kernelSize", kernelSize);
+		pass.SetFloat("radius", kernelRadius);
+		pass.SetFloat("bias", kernelBias);
+	});
+	addAOPass("hbao", HBAOPass, {HBAO}, [&](Shader &pass) {
+		pass.SetInt("numDirections", numDirections);
+		pass.SetFloat("sampleRadius", kernelRadius);
+		pass.SetInt("numSteps", numSteps);
+	});
+	
+	// Deinterleaved HBAO: the positions are split in 4x4 quarter resolution layers, HBAO is evaluated on each layer with
+	// a constant noise vector, and the results are interleaved back into the AO buffer
+	renderGraph.AddPass("deinterleave", [&](RenderGraph::Builder &builder) {
+		if (ssao_mode != DEINTERLEAVED_HBAO)
+			return false;
+		builder.Read(lowResolutionAO() ? lowPosition : position);
+		builder.Write(deinterleavedPosition);
+		return true;
+	}, [&]() {
+		bindTarget(deinterleavedPosition);
+		deinterleavePass.Use();
+		deinterleavePass.SetInt("reinterleave", 0);
+		deinterleavePass.BindTexture("source", GL_TEXTURE_2D, renderGraph.Texture(lowResolutionAO() ? lowPosition : position));
+		DrawQuad();
+	});
+	renderGraph.AddPass("hbao_deinterleaved", [&](RenderGraph::Builder &builder) {
+		if (ssao_mode != DEINTERLEAVED_HBAO)
+			return false;
+		builder.Read(deinterleavedPosition);
+		builder.Read(lowResolutionAO() ? lowNormal : normal);
+		builder.Write(deinterleavedAO);
+		return true;
+	}, [&]() {
+		bindTarget(deinterleavedAO);
+		Shader &hbaoPass = HBAODeinterleavedPass.Get(aoDefines());
+		hbaoPass.Use();
+		hbaoPass.SetInt("numDirections", numDirections);
+		hbaoPass.SetFloat("sampleRadius", kernelRadius);
+		hbaoPass.SetInt("numSteps", numSteps);
+		hbaoPass.SetVec2("noiseOffset", noiseOffset());
+		hbaoPass.BindTexture("gPosition", GL_TEXTURE_2D, renderGraph.Texture(deinterleavedPosition));
+		hbaoPass.BindTexture("gNormal", GL_TEXTURE_2D, renderGraph.Texture(lowResolutionAO() ? lowNormal : normal));
+		hbaoPass.BindTexture("noiseTexture", GL_TEXTURE_2D, noiseTexture);
+		DrawQuad();
+	});
+	renderGraph.AddPass("reinterleave", [&](RenderGraph::Builder &builder) {
+		if (ssao_mode != DEINTERLEAVED_HBAO)
+			return false;
+		builder.Read(deinterleavedAO);
+		builder.Write(ao);
+		return true;
+	}, [&]() {
+		bindTarget(ao);
+		deinterleavePass.Use();
+		deinterleavePass.SetInt("reinterleave", 1);
+		deinterleavePass.BindTexture("source", GL_TEXTURE_2D, renderGraph.Texture(deinterleavedAO));
+		DrawQuad();
+	});
+	addAOPass("alchemy_ao", AlchemyPass, {ALCHEMY_AO}, [&](Shader &pass) {
+		pass.SetInt("kernelSize", kernelSize);
+		pass.SetFloat("radius", kernelRadius);
+		pass.SetFloat("bias", kernelBias);
+	});
+	addAOPass("ue4_ao", UnrealPass, {UE4_AO}, [&](Shader &pass) {
+		pass.SetInt("kernelSize", kernelSize);
+		pass.SetFloat("radius", kernelRadius);
+		pass.SetFloat("bias", kernelBias);
+	});
+	addAOPass("ssdo", SSDOPass, {SSDO}, [&](Shader &pass) {
+		pass.SetMat4("invViewMatrix", glm::inverse(view));
+		pass.SetInt("kernelSize", kernelSize);
+		pass.SetFloat("radius", kernelRadius);
+		pass.SetFloat("bias", kernelBias);
+	});
+	
+	// STEP 2b - Temporal accumulation of the AO buffer, at the resolution of the AO passes
+	renderGraph.AddPass("temporal_ao", [&](RenderGraph::Builder &builder) {
+		if (!temporal())
+			return false;
+		builder.Read(ssao_mode != SSDO ? ao : ssdo);
+		builder.Read(history);
+		builder.Read(motion);
+		if (lowResolutionAO()) {
+			builder.Read(lowNormal);
+		} else {
+			builder.Read(depth);
+			builder.Read(normal);
+		}
+		builder.Write(accumulated);
+		return true;
+	}, [&]() {
+		bindTarget(accumulated);
+		bool packedDepth = lowResolutionAO();
+		temporalPass.Use();
+		temporalPass.SetInt("packedDepth", packedDepth);
+		temporalPass.SetInt("historyValid", aoHistory.Valid());
+		temporalPass.SetInt("maxFrames", temporalFrames);
+		temporalPass.SetMat3("previousViewRotation", glm::mat3(previousView) * glm::transpose(glm::mat3(view)));
+		temporalPass.BindTexture("image", GL_TEXTURE_2D, renderGraph.Texture(ssao_mode != SSDO ? ao : ssdo));
+		temporalPass.BindTexture("history", GL_TEXTURE_2D, aoHistory.ReadTexture(0));
+		temporalPass.BindTexture("historyNormal", GL_TEXTURE_2D, aoHistory.ReadTexture(1));
+		temporalPass.BindTexture("gMotion", GL_TEXTURE_2D, renderGraph.Texture(motion));
+		temporalPass.BindTexture("gDepthMap", GL_TEXTURE_2D, renderGraph.Texture(packedDepth ? lowNormal : depth));
+		temporalPass.BindTexture("gNormal", GL_TEXTURE_2D, renderGraph.Texture(packedDepth ? lowNormal : normal));
+		DrawQuad();
+	});
+	
+	// STEP 3 - Blurring SSAO Texture to avoid noise
+	// Separable bilateral blur (horizontal and vertical pass), guided by the depth and normals of the AO passes: at lower
+	// resolutions, the low resolution normals with the linear depth in the alpha channel
+	auto addBlurPasses = [&](const string &name, std::function<RenderGraph::Resource()> source, RenderGraph::Resource temporary, RenderGraph::Resource target,
+	                         int channels, bool aoResolution, std::function<bool()> enabled) {
+		auto guide = [&, aoResolution](RenderGraph::Builder &builder) {
+			if (aoResolution && lowResolutionAO()) {
+				builder.Read(lowNormal);
+			} else {
+				builder.Read(depth);
+				builder.Read(normal);
+			}
+		};
+		auto blur = [&, aoResolution, channels](RenderGraph::Resource image, glm::ivec2 direction) {
+			bool packedDepth = aoResolution && lowResolutionAO();
+			ShaderDefines defines;
+			if (specializedShaders) {
+				defines.push_back(std::make_pair("BLUR_RADIUS", std::to_string(BlurTaps(blurRadius, blurGather))));
+				defines.push_back(std::make_pair("BLUR_GATHER", blurGather ? "true" : "false"));
+				defines.push_back(std::make_pair("RESOLUTION", "ivec2(" + std::to_string(renderGraph.Width(image)) + ", " + std::to_string(renderGraph.Height(image)) + ")"));
+			}
+			Shader &blurPass = blurPassVariants.Get(defines);
+			blurPass.Use();
+			blurPass.SetIVec2("direction", direction);
+			blurPass.SetInt("radius", BlurTaps(blurRadius, blurGather));
+			blurPass.SetInt("useGather", blurGather);
+			blurPass.SetInt("channels", channels);
+			blurPass.SetInt("packedDepth", packedDepth);
+			blurPass.BindTexture("image", GL_TEXTURE_2D, renderGraph.Texture(image));
+			blurPass.BindTexture("gDepthMap", GL_TEXTURE_2D, renderGraph.Texture(packedDepth ? lowNormal : depth));
+			blurPass.BindTexture("gNormal", GL_TEXTURE_2D, renderGraph.Texture(packedDepth ? lowNormal : normal));
+			DrawQuad();
+		};
+		renderGraph.AddPass(name + "_horizontal", [&, source, temporary, enabled, guide](RenderGraph::Builder &builder) {
+			if (!have_blur || !enabled())
+				return false;
+			builder.Read(source());
+			guide(builder);
+			builder.Write(temporary);
+			return true;
+		}, [&, source, temporary, blur]() {
+			bindTarget(temporary);
+			blur(source(), glm::ivec2(1, 0));
+		});
+		renderGraph.AddPass(name + "_vertical", [&, temporary, target, enabled, guide](RenderGraph::Builder &builder) {
+			if (!have_blur || !enabled())
+				return false;
+			builder.Read(temporary);
+			guide(builder);
+			builder.Write(target);
+			return true;
+		}, [&, temporary, target, blur]() {
+			bindTarget(target);
+			blur(temporary, glm::ivec2(0, 1));
+		});
+	};
+	addBlurPasses("blur", aoSource, aoBlurredX, aoBlurred, 1, true, [&]() { return ssao_mode != NO_SSAO && ssao_mode != SSDO; });
+	addBlurPasses("ssdo_blur", ssdoSource, ssdoBlurredX, ssdoBlurred, 3, true, [&]() { return ssao_mode == SSDO; });
+	
+	// STEP 2-3 (compute path) - AO and blur in a single dispatch: each workgroup (16x16 invocations) produces a 32x32 tile
+	// of the AO buffer (see ssao.comp). The AO and blur passes of the fragment path are culled, since their output is not read
+	renderGraph.AddPass("ssao_compute", [&](RenderGraph::Builder &builder) {
+		if (!computePath())
+			return false;
+		builder.Read(lowResolutionAO() ? lowPosition : position);
+		if (lowResolutionAO()) {
+			builder.Read(lowNormal);
+		} else {
+			builder.Read(depth);
+			builder.Read(normal);
+		}
+		builder.Write(aoCompute);
+		return true;
+	}, [&]() {
+		Shader &computePass = *SSAOComputePass;
+		computePass.Use();
+		computePass.SetInt("kernelSize", kernelSize);
+		computePass.SetFloat("radius", kernelRadius);
+		computePass.SetFloat("bias", kernelBias);
+		computePass.SetInt("blurRadius", have_blur ? BlurTaps(blurRadius, blurGather) : 0);
+		computePass.SetVec2("noiseOffset", noiseOffset());
+		computePass.BindTexture("gPosition", GL_TEXTURE_2D, renderGraph.Texture(lowResolutionAO() ? lowPosition : position));
+		computePass.BindTexture("gNormal", GL_TEXTURE_2D, renderGraph.Texture(lowResolutionAO() ? lowNormal : normal));
+		computePass.SetInt("packedDepth", lowResolutionAO());
+		computePass.BindTexture("gDepthMap", GL_TEXTURE_2D, renderGraph.Texture(lowResolutionAO() ? lowNormal : depth));
+		computePass.BindTexture("noiseTexture", GL_TEXTURE_2D, noiseTexture);
+		computePass.BindImage("result", renderGraph.Texture(aoCompute), GL_WRITE_ONLY, GL_R16F);
+		glDispatchCompute((renderGraph.Width(aoCompute) + 31) / 32, (renderGraph.Height(aoCompute) + 31) / 32, 1); // 32x32 tiles
+		// the AO buffer is then sampled by the upsampling or lighting pass
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	});
+	
+	// STEP 3b - Upsampling of the low resolution AO buffer to full resolution, guided by the full resolution G Buffer
+	auto addUpsamplePass = [&](const string &name, std::function<RenderGraph::Resource()> source, RenderGraph::Resource target, std::function<bool()> enabled) {
+		renderGraph.AddPass(name, [&, source, target, enabled](RenderGraph::Builder &builder) {
+			if (!lowResolutionAO() || !enabled())
+				return false;
+			builder.Read(source());
+			builder.Read(lowNormal);
+			builder.Read(depth);
+			builder.Read(normal);
+			builder.Write(target);
+			return true;
+		}, [&, source, target]() {
+			bindTarget(target);
+			upsamplePass.Use();
+			upsamplePass.BindTexture("image", GL_TEXTURE_2D, renderGraph.Texture(source()));
+			upsamplePass.BindTexture("lowNormalDepth", GL_TEXTURE_2D, renderGraph.Texture(lowNormal));
+			upsamplePass.BindTexture("gDepthMap", GL_TEXTURE_2D, renderGraph.Texture(depth));
+			upsamplePass.BindTexture("gNormal", GL_TEXTURE_2D, renderGraph.Texture(normal));
+			DrawQuad();
+		});
+	};
+	addUpsamplePass("upsample", aoResult, aoUpsampled, [&]() { return ssao_mode != NO_SSAO && ssao_mode != SSDO; });
+	addUpsamplePass("ssdo_upsample", ssdoResult, ssdoUpsampled, [&]() { return ssao_mode == SSDO; });
+	
+	// STEP 4 - Deferred rendering for lighting with added SSAO (only direct lighting for SSDO)
+	renderGraph.AddPass("lighting", [&](RenderGraph::Builder &builder) {
+		builder.Read(reconstr() ? depth : position);
+		builder.Read(normal);
+		builder.Read(albedo);
+		if (ssao_mode != NO_SSAO && ssao_mode != SSDO)
+			builder.Read(aoOutput());
+		builder.Write(ssao_mode == SSDO ? directLighting : output);
+		return true;
+	}, [&]() {
+		bindTarget(ssao_mode == SSDO ? directLighting : output);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		Shader &lighting = reconstr() ? lightingReconstrPass : lightingPass;
+		lighting.Use();
+		glm::vec3 lightPosView = view * glm::vec4(lightPos, 1.0);
+		lighting.SetVec3("lightPosition", lightPosView);
+		lighting.SetVec3("lightColor", lightColor);
+		lighting.SetFloat("linearAttenuation", linearAttenuation);
+		lighting.SetFloat("quadraticAttenuation", quadraticAttenuation);
+		lighting.BindTexture("gDepthMap", GL_TEXTURE_2D, renderGraph.Texture(depth)); // With Depth Resolve, we pass the depth buffer and we reconstruct positions in fragment shader
+		lighting.BindTexture("gPosition", GL_TEXTURE_2D, renderGraph.Texture(position));
+		lighting.BindTexture("gNormal", GL_TEXTURE_2D, renderGraph.Texture(normal));
+		lighting.BindTexture("gAlbedo", GL_TEXTURE_2D, renderGraph.Texture(albedo));
+		lighting.BindTexture("SSAO", GL_TEXTURE_2D, (ssao_mode == NO_SSAO || ssao_mode == SSDO) ? gWhiteTex : renderGraph.Texture(aoOutput()));
+		DrawQuad();
+	});
+	
+	// STEP 5 - Indirect lighting pass
+	renderGraph.AddPass("ssdo_indirect", [&](RenderGraph::Builder &builder) {
+		if (ssao_mode != SSDO)
+			return false;
+		builder.Read(position);
+		builder.Read(normal);
+		builder.Read(directLighting);
+		builder.Write(indirectLighting);
+		return true;
+	}, [&]() {
+		SSDOIndirectPass.Use();
+		bindTarget(indirectLighting);
+		glClear(GL_COLOR_BUFFER_BIT);
+		SSDOIndirectPass.BindTexture("gPosition", GL_TEXTURE_2D, renderGraph.Texture(position));
+		SSDOIndirectPass.BindTexture("gNormal", GL_TEXTURE_2D, renderGraph.Texture(normal));
+		SSDOIndirectPass.BindTexture("noiseTexture", GL_TEXTURE_2D, noiseTexture);
+		SSDOIndirectPass.BindTexture("lightTexture", GL_TEXTURE_2D, renderGraph.Texture(directLighting));
+		SSDOIndirectPass.SetInt("kernelSize", kernelSize);
+		SSDOIndirectPass.SetFloat("radius", kernelRadius);
+		SSDOIndirectPass.SetFloat("bias", kernelBias);
+		DrawQuad();
+	});
+	
+	// STEP 6 -  Blurring SSDO Indirect lighting pass output (always at full resolution)
+	addBlurPasses("ssdo_indirect_blur", [&]() { return indirectLighting; }, indirectLightingBlurredX, indirectLightingBlurred, 3, false, [&]() { return ssao_mode == SSDO; });
+	
+	// STEP 7 - Direct and Indirect Lighting combination pass
+	renderGraph.AddPass("ssdo_combine", [&](RenderGraph::Builder &builder) {
+		if (ssao_mode != SSDO)
+			return false;
+		builder.Read(directLighting);
+		builder.Read(ssdoOutput());
+		builder.Read(indirectLightingResult());
+		builder.Write(output);
+		return true;
+	}, [&]() {
+		bindTarget(output);
+		SSDOCombinePass.Use();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		SSDOCombinePass.BindTexture("lightTex", GL_TEXTURE_2D, renderGraph.Texture(directLighting));
+		SSDOCombinePass.BindTexture("directionalLightTex", GL_TEXTURE_2D, renderGraph.Texture(ssdoOutput()));
+		SSDOCombinePass.BindTexture("indirectLightTex", GL_TEXTURE_2D, renderGraph.Texture(indirectLightingResult()));
+		DrawQuad();
+	});
+	
+	// FINAL STEP - Draw skybox (on top of the lit image)
+	renderGraph.AddPass("skybox", [&](RenderGraph::Builder &builder) {
+		builder.Read(reconstr() ? depth : position);
+		builder.Read(output);
+		builder.Write(output);
+		return true;
+	}, [&]() {
+		bindTarget(output);
+		glState.Disable(GL_DEPTH_TEST);
+		view = glm::mat4(glm::mat3(camera.GetViewMatrix())); // Remove any translation component of the view matrix
+		Shader &skybox = reconstr() ? skyboxReconstrPass : skyboxPass;
+		skybox.Use();
+		skybox.SetMat4("viewMatrix", view);
+		skybox.BindTexture("gPosition", GL_TEXTURE_2D, renderGraph.Texture(reconstr() ? depth : position));
+		skybox.BindTexture("tCube", GL_TEXTURE_CUBE_MAP, textureCube);
+		cubeModel.DrawPositions();
+		skybox.BindTexture("tCube", GL_TEXTURE_CUBE_MAP, 0);
+		glState.Enable(GL_DEPTH_TEST);
+	});
+	
+	// STEP 4 (alternative) - Show ambient occlusion buffer on screen
+	// It is the last pass writing the output, so the lighting passes are culled when it is part of the configuration
+	renderGraph.AddPass("show_occlusion", [&](RenderGraph::Builder &builder) {
+		if (!show_occlusion || ssao_mode == NO_SSAO || ssao_mode == SSDO)
+			return false;
+		builder.Read(aoOutput());
+		builder.Write(output);
+		return true;
+	}, [&]() {
+		bindTarget(output);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		simplePass.Use();
+		simplePass.BindTexture("image", GL_TEXTURE_2D, renderGraph.Texture(aoOutput()));
+		DrawQuad();
+	});
 
-	// Setting bindings for all the samplers and the projection matrices used in our shaders
-	skyboxPass.Use();
-	glUniformMatrix4fv(glGetUniformLocation(skyboxPass.Program, "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projection));
-	glUniform1i(glGetUniformLocation(skyboxPass.Program, "tCube"), 0);
-	glUniform1i(glGetUniformLocation(skyboxPass.Program, "gPosition"), 1);
-	skyboxReconstrPass.Use();
-	glUniformMatrix4fv(glGetUniformLocation(skyboxReconstrPass.Program, "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projection));
-	glUniform1i(glGetUniformLocation(skyboxReconstrPass.Program, "tCube"), 0);
-	glUniform1i(glGetUniformLocation(skyboxReconstrPass.Program, "gPosition"), 1);
-	SSAOPass.Use();
-	glUniform1i(glGetUniformLocation(SSAOPass.Program, "gPosition"), 0);
-	glUniform1i(glGetUniformLocation(SSAOPass.Program, "gNormal"), 1);
-	glUniform1i(glGetUniformLocation(SSAOPass.Program, "noiseTexture"), 2);
-	glUniformMatrix4fv(glGetUniformLocation(SSAOPass.Program, "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projection));
-	SSDOPass.Use();
-	glUniform1i(glGetUniformLocation(SSDOPass.Program, "gPosition"), 0);
-	glUniform1i(glGetUniformLocation(SSDOPass.Program, "gNormal"), 1);
-	glUniform1i(glGetUniformLocation(SSDOPass.Program, "noiseTexture"), 2);
-	glUniform1i(glGetUniformLocation(SSDOPass.Program, "skybox"), 3);
-	glUniformMatrix4fv(glGetUniformLocation(SSDOPass.Program, "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projection));
-	SSDOCombinePass.Use();
-	glUniform1i(glGetUniformLocation(SSDOCombinePass.Program, "lightTex"), 0);
-	glUniform1i(glGetUniformLocation(SSDOCombinePass.Program, "directionalLightTex"), 1);
-	glUniform1i(glGetUniformLocation(SSDOCombinePass.Program, "indirectLightTex"), 2);
-	SSDOIndirectPass.Use();
-	glUniform1i(glGetUniformLocation(SSDOIndirectPass.Program, "gPosition"), 0);
-	glUniform1i(glGetUniformLocation(SSDOIndirectPass.Program, "gNormal"), 1);
-	glUniform1i(glGetUniformLocation(SSDOIndirectPass.Program, "noiseTexture"), 2);
-	glUniform1i(glGetUniformLocation(SSDOIndirectPass.Program, "lightTexture"), 3);
-	glUniformMatrix4fv(glGetUniformLocation(SSDOIndirectPass.Program, "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projection));
-	HBAOPass.Use();
-	glUniform1i(glGetUniformLocation(HBAOPass.Program, "gPosition"), 0);
-	glUniform1i(glGetUniformLocation(HBAOPass.Program, "gNormal"), 1);
-	glUniform1i(glGetUniformLocation(HBAOPass.Program, "noiseTexture"), 2);
-	AlchemyPass.Use();
-	glUniform1i(glGetUniformLocation(AlchemyPass.Program, "gPosition"), 0);
-	glUniform1i(glGetUniformLocation(AlchemyPass.Program, "gNormal"), 1);
-	glUniform1i(glGetUniformLocation(AlchemyPass.Program, "noiseTexture"), 2);
-	glUniformMatrix4fv(glGetUniformLocation(AlchemyPass.Program, "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projection));
-	UnrealPass.Use();
-	glUniform1i(glGetUniformLocation(UnrealPass.Program, "gPosition"), 0);
-	glUniform1i(glGetUniformLocation(UnrealPass.Program, "gNormal"), 1);
-	glUniform1i(glGetUniformLocation(UnrealPass.Program, "noiseTexture"), 2);
-	glUniformMatrix4fv(glGetUniformLocation(UnrealPass.Program, "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projection));
-	SSAOReconstrPass.Use();
-	glUniform1f(glGetUniformLocation(SSAOReconstrPass.Program, "gAspectRatio"), (float)screenWidth/(float)screenHeight);
-	glUniform1f(glGetUniformLocation(SSAOReconstrPass.Program, "gTanFOV"), tan(FOV));
-	glUniform1i(glGetUniformLocation(SSAOReconstrPass.Program, "gDepthMap"), 0);
-	glUniform1i(glGetUniformLocation(SSAOReconstrPass.Program, "gNormal"), 1);
-	glUniform1i(glGetUniformLocation(SSAOReconstrPass.Program, "noiseTexture"), 2);
-	glUniformMatrix4fv(glGetUniformLocation(SSAOReconstrPass.Program, "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projection));
-	glUniformMatrix4fv(glGetUniformLocation(SSAOReconstrPass.Program, "invProjectionMatrix"), 1, GL_FALSE, glm::value_ptr(glm::inverse(projection)));
-	lightingPass.Use();
-	glUniform1i(glGetUniformLocation(lightingPass.Program, "gPosition"), 0);
-	glUniform1i(glGetUniformLocation(lightingPass.Program, "gNormal"), 1);
-	glUniform1i(glGetUniformLocation(lightingPass.Program, "gAlbedo"), 2);
-	glUniform1i(glGetUniformLocation(lightingPass.Program, "SSAO"), 3);
-	glUniformMatrix4fv(glGetUniformLocation(lightingPass.Program, "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projection));
-	lightingReconstrPass.Use();
-	glUniform1f(glGetUniformLocation(lightingReconstrPass.Program, "gAspectRatio"), (float)screenWidth/(float)screenHeight);
-	glUniform1f(glGetUniformLocation(lightingReconstrPass.Program, "gTanFOV"), tan(FOV));
-	glUniform1i(glGetUniformLocation(lightingReconstrPass.Program, "gDepthMap"), 0);
-	glUniform1i(glGetUniformLocation(lightingReconstrPass.Program, "gNormal"), 1);
-	glUniform1i(glGetUniformLocation(lightingReconstrPass.Program, "gAlbedo"), 2);
-	glUniform1i(glGetUniformLocation(lightingReconstrPass.Program, "SSAO"), 3);
-	glUniformMatrix4fv(glGetUniformLocation(lightingReconstrPass.Program, "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projection));
-	glUniformMatrix4fv(glGetUniformLocation(lightingReconstrPass.Program, "invProjectionMatrix"), 1, GL_FALSE, glm::value_ptr(glm::inverse(projection)));
-	blurPass.Use();
-	glUniform1i(glGetUniformLocation(blurPass.Program, "SSAOtex"), 0);
-	SSDOblurPass.Use();
-	glUniform1i(glGetUniformLocation(SSDOblurPass.Program, "SSAOtex"), 0);
-	geometryPass.Use();
-	glUniformMatrix4fv(glGetUniformLocation(geometryPass.Program, "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projection));
-	geometryReconstrPass.Use();
-	glUniformMatrix4fv(glGetUniformLocation(geometryReconstrPass.Program, "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projection));
-	simplePass.Use();
-	glUniform1i(glGetUniformLocation(simplePass.Program, "image"), 0);
+	const ProgramCacheStats &programStats = ProgramCache::Get().Stats();
+	std::cout << "STARTUP:: programs ready in " << programsTime * 1000.0 << " ms (" << programStats.loaded << " loaded from the program cache, "
+	          << programStats.compiled << " compiled, " << programStats.failed << " failed, " << programStats.rejected << " rejected), assets ready in " << assetsTime * 1000.0
+	          << " ms (" << assets.Submitted() << " assets, " << assets.Threads() << " threads), initialization done in "
+	          << (getTime() - startupTime) * 1000.0 << " ms" << std::endl;
 
 	// Rendering loop: this code is executed at each frame
 	int oldKernelSize = kernelSize;
 	int old_ssao_mode = ssao_mode;
 	int64_t numFrames = -1;
+	bool firstFrame = true;
 	GLfloat deltaTimeSum = 0.0f;
 	GLfloat averageFrameTime = 0.0f;
-	while(!glfwWindowShouldClose(window))
+	
+	// When benchmarking, the sweep starts from the current configuration values, and the first configuration is applied immediately
+	auto startBenchmarkConfig = [&]() {
+		if (applyBenchmarkConfig(benchmark.Current())) {
+			allocateRenderTargets();
+			setupStaticUniforms();
+			width = screenWidth;
+			height = screenHeight;
+		}
+	};
+	if (benchmarking) {
+		BenchmarkConfig current = {ssao_mode, kernelSize, kernelRadius, numDirections, numSteps, have_blur, screenWidth, screenHeight, aoDownscale, blurRadius, blurGather, temporalAO,
+		                          depthPyramidModes[ssao_mode], computeAO, specializedShaders, stressInstances};
+		benchmark.BuildSweep(current, usesSampleKernel, supportsDepthPyramid, [](int mode, int radius, bool gather) {
+			return usesComputeAO(mode, BlurTaps(radius, gather));
+		});
+		width = screenWidth;
+		height = screenHeight;
+		if (!benchmark.Done())
+			startBenchmarkConfig();
+	}
+	
+	// the setup code has changed the OpenGL state directly
+	glState.Invalidate();
+	
+	// parameters of the AO passes accumulated in the history: when they change, the history is discarded
+	std::vector<float> historyParameters;
+	previousView = camera.GetViewMatrix();
+	
+	while(headless ? !benchmark.Done() : !glfwWindowShouldClose(window))
 	{
 		// Regenerate the kernel samples if its size changes or if the SSAO mode changes
 		if (kernelSize != oldKernelSize || ssao_mode != old_ssao_mode) {
 			switch (ssao_mode) {
 			case CRYENGINE2_AO:
 			case CRYENGINE2_AO_RECONSTR:
-				generateSphereSamples(SSAOKernel);
+				generateSphereSamples(SSAOKernel, kernelSize);
+				kernelBuffer.Invalidate();
 				break;
 			case SSDO:
 			case UE4_AO:
 			case ALCHEMY_AO:
 			case STARCRAFT2_AO:
 			case STARCRAFT2_AO_RECONSTR:
-				generateHemiSphereSamples(SSAOKernel);
+				generateHemiSphereSamples(SSAOKernel, kernelSize);
+				kernelBuffer.Invalidate();
 				break;
 			default:
 				break;
 			}
 		}
+		kernelBuffer.Update(SSAOKernel);
 		oldKernelSize = kernelSize;
 		old_ssao_mode = ssao_mode;
 		
 		// Handling changes in input mode for the mouse
-		glfwSetInputMode(window, GLFW_CURSOR, camera_mode ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
+		if (!headless)
+			glfwSetInputMode(window, GLFW_CURSOR, camera_mode ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
 
 		// we determine the time passed from the beginning
 		// and we calculate time difference between current frame rendering and the previous one
-		GLfloat currentFrame = glfwGetTime();
+		double frameStart = getTime();
+		Shader::Stats() = UniformStats();
+		glState.ResetStats();
+		GLfloat currentFrame = frameStart;
 		deltaTime = currentFrame - lastFrame;
 		numFrames++;
 		if (numFrames > 0) {
@@ -624,7 +1447,8 @@ int main()
 		lastFrame = currentFrame;
 
 		// Check is an I/O event is happening
-		glfwPollEvents();
+		if (!headless)
+			glfwPollEvents();
 		// we apply FPS camera movements
 		apply_camera_movements();
 		
@@ -635,256 +1459,128 @@ int main()
 		if (spinning)
 			orientationY+=(deltaTime*spin_speed);
 		
+		// we place the objects, and we cull them with the view frustum
+		UpdateScene(cubeModel, sphereModel, bunnyModel);
+		
 		// we set the viewport for the final rendering step
-		glViewport(0, 0, width, height);
+		glState.Viewport(0, 0, width, height);
 		
-		// STEP 1 - GEOMETRY PASS
-		// Render the full scene data into our auxiliary G Buffer
+		// Rendering the passes of the graph needed by the current configuration
+		// (the key of the configuration contains the parameters checked by the setup functions of the passes)
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-		if (ssao_mode == CRYENGINE2_AO_RECONSTR || ssao_mode == STARCRAFT2_AO_RECONSTR) { // If we use CryEngine 2 AO derivatives with depth resolve, we need a different program
-			// Using different geometry pass program if we want to reconstruct view positions instead of using G buffer to store them
-			glDrawBuffers(3, reconstr_attachments);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			geometryReconstrPass.Use();
-			glUniformMatrix4fv(glGetUniformLocation(geometryReconstrPass.Program, "viewMatrix"), 1, GL_FALSE, glm::value_ptr(view));
-			RenderObjects(geometryReconstrPass, cubeModel, sphereModel, bunnyModel);
+		uint64_t configuration = (uint64_t)ssao_mode | (have_blur ? 1u << 8 : 0u) | (show_occlusion ? 1u << 9 : 0u) | ((uint64_t)aoDownscale << 10) |
+		                         (temporalAO ? 1u << 16 : 0u) | ((uint64_t)depthPyramidMode() << 17) |
+		                         (computePath() ? 1u << 20 : 0u);
+		renderTargets.BeginFrame(frameStart);
+		renderGraph.SetResolution(width, height);
+		for (RenderGraph::Resource resource : lowResolutionResources)
+			renderGraph.SetDownscale(resource, aoDownscale);
+		if (depthPyramidMode() != DEPTH_PYRAMID_OFF)
+			depthPyramid.Resize(renderGraph.Width(ao), renderGraph.Height(ao));
+		if (temporal()) {
+			// the history written in the previous frame is read by the temporal pass, which writes the other target
+			aoHistory.Resize(renderGraph.Width(ao), renderGraph.Height(ao));
+			aoHistory.Swap();
+			std::vector<float> parameters = {(float)ssao_mode, (float)kernelSize, kernelRadius, kernelBias, (float)numDirections, (float)numSteps, (float)depthPyramidMode()};
+			if (parameters != historyParameters)
+				aoHistory.Invalidate();
+			historyParameters = parameters;
+			renderGraph.SetImported(history, aoHistory.ReadTexture(0), 0);
+			renderGraph.SetImported(accumulated, aoHistory.WriteTexture(0), aoHistory.WriteFramebuffer());
+		}
+		renderGraph.Execute(output, configuration);
+		// the history is valid for the next frame only if it has been written in this one
+		if (temporal()) {
+			aoHistory.MarkValid();
+			temporalFrameIndex++;
 		} else {
-			glDrawBuffers(3, full_attachments);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			geometryPass.Use();
-			glUniformMatrix4fv(glGetUniformLocation(geometryPass.Program, "viewMatrix"), 1, GL_FALSE, glm::value_ptr(view));
-			RenderObjects(geometryPass, cubeModel, sphereModel, bunnyModel);
+			aoHistory.Invalidate();
 		}
+		previousView = camera.GetViewMatrix(); // the global view matrix has lost its translation in the skybox step
 		
-		if (ssao_mode != NO_SSAO) {
-			// STEP 2 - SSAO Texture generation
-			glBindFramebuffer(GL_FRAMEBUFFER, ssao_mode != SSDO ? SSAOfbo : SSDOfbo);
-			glClear(GL_COLOR_BUFFER_BIT);
-			switch (ssao_mode) {
-			case CRYENGINE2_AO_RECONSTR:
-			case STARCRAFT2_AO_RECONSTR:
-				SSAOReconstrPass.Use();
-				glUniform1i(glGetUniformLocation(SSAOReconstrPass.Program, "kernelSize"), kernelSize);
-				glUniform1f(glGetUniformLocation(SSAOReconstrPass.Program, "radius"), kernelRadius);
-				glUniform1f(glGetUniformLocation(SSAOReconstrPass.Program, "bias"), kernelBias);
-				for (int i = 0; i < kernelSize; i++) {
-					char binding[32];
-					sprintf(binding, "kernel[%d]", i);
-					glUniform3fv(glGetUniformLocation(SSAOReconstrPass.Program, binding), 1, glm::value_ptr(SSAOKernel[i]));
-				}
-				break;
-			case HBAO:
-				HBAOPass.Use();
-				glUniform1i(glGetUniformLocation(HBAOPass.Program, "numDirections"), numDirections);
-				glUniform1f(glGetUniformLocation(HBAOPass.Program, "sampleRadius"), kernelRadius);
-				glUniform1i(glGetUniformLocation(HBAOPass.Program, "numSteps"), numSteps);
-				break;
-				break;
-			case ALCHEMY_AO:
-				AlchemyPass.Use();
-				glUniform1i(glGetUniformLocation(AlchemyPass.Program, "kernelSize"), kernelSize);
-				glUniform1f(glGetUniformLocation(AlchemyPass.Program, "radius"), kernelRadius);
-				glUniform1f(glGetUniformLocation(AlchemyPass.Program, "bias"), kernelBias);
-				for (int i = 0; i < kernelSize; i++) {
-					char binding[32];
-					sprintf(binding, "kernel[%d]", i);
-					glUniform3fv(glGetUniformLocation(AlchemyPass.Program, binding), 1, glm::value_ptr(SSAOKernel[i]));
-				}
-				break;
-			case UE4_AO:
-				UnrealPass.Use();
-				glUniform1i(glGetUniformLocation(UnrealPass.Program, "kernelSize"), kernelSize);
-				glUniform1f(glGetUniformLocation(UnrealPass.Program, "radius"), kernelRadius);
-				glUniform1f(glGetUniformLocation(UnrealPass.Program, "bias"), kernelBias);
-				for (int i = 0; i < kernelSize; i++) {
-					char binding[32];
-					sprintf(binding, "kernel[%d]", i);
-					glUniform3fv(glGetUniformLocation(UnrealPass.Program, binding), 1, glm::value_ptr(SSAOKernel[i]));
-				}
-				break;
-			case SSDO:
-				SSDOPass.Use();
-				glUniformMatrix4fv(glGetUniformLocation(SSDOPass.Program, "invViewMatrix"), 1, GL_FALSE, glm::value_ptr(glm::inverse(view)));
-				glUniform1i(glGetUniformLocation(SSDOPass.Program, "kernelSize"), kernelSize);
-				glUniform1f(glGetUniformLocation(SSDOPass.Program, "radius"), kernelRadius);
-				glUniform1f(glGetUniformLocation(SSDOPass.Program, "bias"), kernelBias);
-				for (int i = 0; i < kernelSize; i++) {
-					char binding[32];
-					sprintf(binding, "kernel[%d]", i);
-					glUniform3fv(glGetUniformLocation(SSDOPass.Program, binding), 1, glm::value_ptr(SSAOKernel[i]));
-				}
-				break;
-			default:
-				SSAOPass.Use();
-				glUniform1i(glGetUniformLocation(SSAOPass.Program, "kernelSize"), kernelSize);
-				glUniform1f(glGetUniformLocation(SSAOPass.Program, "radius"), kernelRadius);
-				glUniform1f(glGetUniformLocation(SSAOPass.Program, "bias"), kernelBias);
-				for (int i = 0; i < kernelSize; i++) {
-					char binding[32];
-					sprintf(binding, "kernel[%d]", i);
-					glUniform3fv(glGetUniformLocation(SSAOPass.Program, binding), 1, glm::value_ptr(SSAOKernel[i]));
-				}
-				break;
-			}
-
-			glActiveTexture(GL_TEXTURE0);
-			if (ssao_mode == CRYENGINE2_AO_RECONSTR || ssao_mode == STARCRAFT2_AO_RECONSTR)
-				glBindTexture(GL_TEXTURE_2D, gDepthBuffer); // With Depth Resolve, we pass the depth buffer and we reconstruct positions in fragment shader
-			else
-				glBindTexture(GL_TEXTURE_2D, gPosition);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, gNormal);
-			glActiveTexture(GL_TEXTURE2);
-			glBindTexture(GL_TEXTURE_2D, noiseTexture);
-			if (ssao_mode == SSDO) { // We need skybox cubemap for SSDO to calculate directional light
-				glActiveTexture(GL_TEXTURE3);
-				glBindTexture(GL_TEXTURE_CUBE_MAP, textureCube);
-			}	
-			DrawQuad();
-			if (ssao_mode == SSDO) {
-				glActiveTexture(GL_TEXTURE3);
-				glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-			}	
-			
-			if (have_blur) {
-				// STEP 3 - Blurring SSAO Texture to avoid noise
-				if (ssao_mode == SSDO) {
-					glBindFramebuffer(GL_FRAMEBUFFER, SSDOBlurFBO);
-					glClear(GL_COLOR_BUFFER_BIT);
-					SSDOblurPass.Use();
-					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_2D, SSDOColorBuffer);
-					DrawQuad();
-				} else {
-					glBindFramebuffer(GL_FRAMEBUFFER, SSAOBlurFBO);
-					glClear(GL_COLOR_BUFFER_BIT);
-					blurPass.Use();
-					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_2D, SSAOColorBuffer);
-					DrawQuad();
-				}
-			}
+		// The programs are compiled when first used: the latency of the first frame depends only on the programs it needs.
+		// The other ones are compiled in the background of the following frames, one for each frame (the parallel
+		// compilations started at creation are only completed), except in the timed benchmark frames
+		if (firstFrame) {
+			firstFrame = false;
+			glFinish();
+			std::cout << "STARTUP:: first frame rendered after " << (getTime() - startupTime) * 1000.0 << " ms ("
+			          << Shader::PendingPrograms().size() << " programs not compiled yet"
+			          << (Shader::ParallelCompile() ? ", parallel compilation" : "") << ")" << std::endl;
+		} else if (!benchmarking) {
+			Shader::CompilePending(1);
 		}
 		
-		if (show_occlusion && ssao_mode != NO_SSAO && ssao_mode != SSDO) {
-			// STEP 4 - Show ambient occlusion buffer on screen
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			simplePass.Use();
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, have_blur ? SSAOColorBufferBlurred : SSAOColorBuffer);
-			DrawQuad();
-		} else {			
-			// STEP 4 - Deferred rendering for lighting with added SSAO
-			if (ssao_mode == SSDO)
-				glBindFramebuffer(GL_FRAMEBUFFER, SSDODirectLightingFBO);
-			else
-				glBindFramebuffer(GL_FRAMEBUFFER, 0);
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			if (ssao_mode == CRYENGINE2_AO_RECONSTR || ssao_mode == STARCRAFT2_AO_RECONSTR) { // If we use CryEngine 2 AO derivatives with depth resolve, we need a different program
-				lightingReconstrPass.Use();
-				glm::vec3 lightPosView = view * glm::vec4(lightPos, 1.0);
-				glUniform3fv(glGetUniformLocation(lightingReconstrPass.Program, "lightPosition"), 1, glm::value_ptr(lightPosView));
-				glUniform3fv(glGetUniformLocation(lightingReconstrPass.Program, "lightColor"), 1, glm::value_ptr(lightColor));
-				glUniform1f(glGetUniformLocation(lightingReconstrPass.Program, "linearAttenuation"), linearAttenuation);
-				glUniform1f(glGetUniformLocation(lightingReconstrPass.Program, "quadraticAttenuation"), quadraticAttenuation);
-			} else {
-				lightingPass.Use();
-				glm::vec3 lightPosView = view * glm::vec4(lightPos, 1.0);
-				glUniform3fv(glGetUniformLocation(lightingPass.Program, "lightPosition"), 1, glm::value_ptr(lightPosView));
-				glUniform3fv(glGetUniformLocation(lightingPass.Program, "lightColor"), 1, glm::value_ptr(lightColor));
-				glUniform1f(glGetUniformLocation(lightingPass.Program, "linearAttenuation"), linearAttenuation);
-				glUniform1f(glGetUniformLocation(lightingPass.Program, "quadraticAttenuation"), quadraticAttenuation);
-			}
-			glActiveTexture(GL_TEXTURE0);
-			if (ssao_mode == CRYENGINE2_AO_RECONSTR || ssao_mode == STARCRAFT2_AO_RECONSTR)
-				glBindTexture(GL_TEXTURE_2D, gDepthBuffer); // With Depth Resolve, we pass the depth buffer and we reconstruct positions in fragment shader
-			else
-				glBindTexture(GL_TEXTURE_2D, gPosition);
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, gNormal);
-			glActiveTexture(GL_TEXTURE2);
-			glBindTexture(GL_TEXTURE_2D, gAlbedo);
-			glActiveTexture(GL_TEXTURE3);
-			glBindTexture(GL_TEXTURE_2D, (ssao_mode == NO_SSAO || ssao_mode == SSDO) ? gWhiteTex : (have_blur ? SSAOColorBufferBlurred : SSAOColorBuffer));
-			DrawQuad();
+		// render targets of the pass stage buffers shown in the G Buffer Inspector
+		RenderGraph::Resource stages[] = {ao, aoBlurred, ssdo, ssdoBlurred, directLighting, indirectLighting, indirectLightingBlurred};
+		for (int i = 0; i < FINAL_SSDO_INDIRECT_BUFFER - SSAO_BUFFER + 1; i++)
+			gbuffers[SSAO_BUFFER + i] = renderGraph.Texture(stages[i]);
+		
+		if (benchmarking && !benchmark.Done()) {
+			// The benchmark frame time is measured once the GPU has completed the frame, without UI and buffers swap
+			glFinish();
+			double frameTime = getTime() - frameStart;
 			
-			if (ssao_mode == SSDO) {
-				// STEP 5 - Indirect lighting pass
-				SSDOIndirectPass.Use();
-				glBindFramebuffer(GL_FRAMEBUFFER, SSDOIndirectLightingFBO);
-				glClear(GL_COLOR_BUFFER_BIT);
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, gPosition);
-				glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_2D, gNormal);
-				glActiveTexture(GL_TEXTURE2);
-				glBindTexture(GL_TEXTURE_2D, noiseTexture);
-				glActiveTexture(GL_TEXTURE3);
-				glBindTexture(GL_TEXTURE_2D, SSDOColorBufferLighting);
-				glUniform1i(glGetUniformLocation(SSDOIndirectPass.Program, "kernelSize"), kernelSize);
-				glUniform1f(glGetUniformLocation(SSDOIndirectPass.Program, "radius"), kernelRadius);
-				glUniform1f(glGetUniformLocation(SSDOIndirectPass.Program, "bias"), kernelBias);
-				for (int i = 0; i < kernelSize; i++) {
-					char binding[32];
-					sprintf(binding, "kernel[%d]", i);
-					glUniform3fv(glGetUniformLocation(SSDOIndirectPass.Program, binding), 1, glm::value_ptr(SSAOKernel[i]));
-				}
-				DrawQuad();
-				
-				// STEP 6 -  Blurring SSDO Indirect lighting pass output
-				if (have_blur) {
-					glBindFramebuffer(GL_FRAMEBUFFER, SSDOIndirectLightingBlurFBO);
-					glClear(GL_COLOR_BUFFER_BIT);
-					SSDOblurPass.Use();
-					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_2D, SSDOColorBufferIndirectLighting);
-					DrawQuad();
-				}
-				
-				// STEP 7 - Direct and Indirect Lighting combination pass
-				glBindFramebuffer(GL_FRAMEBUFFER, 0);
-				SSDOCombinePass.Use();
-				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, SSDOColorBufferLighting);
-				glActiveTexture(GL_TEXTURE1);
-				glBindTexture(GL_TEXTURE_2D, have_blur ? SSDOColorBufferBlurred : SSDOColorBuffer);
-				glActiveTexture(GL_TEXTURE2);
-				glBindTexture(GL_TEXTURE_2D, have_blur ? SSDOColorBufferIndirectLightingBlurred : SSDOColorBufferIndirectLighting);
-				DrawQuad();
+			// In interactive mode, the offscreen image is shown in the window
+			if (!headless) {
+				int display_w, display_h;
+				glfwGetFramebufferSize(window, &display_w, &display_h);
+				glState.BindFramebuffer(GL_READ_FRAMEBUFFER, outputFBO);
+				glState.BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+				glBlitFramebuffer(0, 0, screenWidth, screenHeight, 0, 0, display_w, display_h, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+				glState.BindFramebuffer(GL_FRAMEBUFFER, 0);
 			}
 			
-			// FINAL STEP - Draw skybox
-			glDisable(GL_DEPTH_TEST);
-			view = glm::mat4(glm::mat3(camera.GetViewMatrix())); // Remove any translation component of the view matrix
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_CUBE_MAP, textureCube);
-			glActiveTexture(GL_TEXTURE1);
-			if (ssao_mode == CRYENGINE2_AO_RECONSTR || ssao_mode == STARCRAFT2_AO_RECONSTR) {
-				skyboxReconstrPass.Use();
-				glUniformMatrix4fv(glGetUniformLocation(skyboxReconstrPass.Program, "viewMatrix"), 1, GL_FALSE, glm::value_ptr(view));
-				glBindTexture(GL_TEXTURE_2D, gDepthBuffer);
-			} else {
-				skyboxPass.Use();
-				glUniformMatrix4fv(glGetUniformLocation(skyboxPass.Program, "viewMatrix"), 1, GL_FALSE, glm::value_ptr(view));
-				glBindTexture(GL_TEXTURE_2D, gPosition);
+			benchmark.RecordCulling(cullObjects, cullVisible, cullTime);
+			if (benchmark.RecordFrame(frameTime, renderTargets.FrameBytes()))
+				startBenchmarkConfig();
+			if (benchmark.Done()) {
+				benchmark.WriteResults(techniqueNames);
+				std::cout << "BENCHMARK:: last frame: " << glState.Stats().issued << " state changes (" << glState.Stats().elided << " elided), "
+				          << Shader::Stats().uploads << " uniform uploads (" << Shader::Stats().skipped << " skipped)" << std::endl;
+				if (!headless)
+					glfwSetWindowShouldClose(window, GL_TRUE);
 			}
-			cubeModel.Draw();
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-			glEnable(GL_DEPTH_TEST);
+		}
+		
+		// Saving the G Buffer content (after the benchmark timing, since the read back stalls the pipeline)
+		if (captureRequested) {
+			static int captureIndex = 0;
+			captureGBuffer(capturePath.empty() ? "gbuffer_capture_" + std::to_string(captureIndex++) + ".aogb" : capturePath, SSAOKernel, SSAONoise);
+			captureRequested = false;
+			capturePath.clear();
 		}
 		
 		// Rendering dear ImGui UI only if in cursor mode
-		if (!camera_mode) {
+		if (!headless && !camera_mode) {
 			ImGui_ImplOpenGL3_NewFrame();
 			ImGui_ImplGlfw_NewFrame();
 			ImGui::NewFrame();
 			ImGui::Begin("Frame Info");
 			ImGui::Text("Average Frame Time: %.06f s", averageFrameTime);
 			ImGui::Text("Last Frame Time: %.06f s", deltaTime);
+			ImGui::Text("Uniform Uploads: %u (%u skipped)", Shader::Stats().uploads, Shader::Stats().skipped);
+			ImGui::Text("State Changes: %u (%u elided)", glState.Stats().issued, glState.Stats().elided);
+			ImGui::Text("Geometry: %d triangles, %d draw calls (submitted in %.3f ms)", (int)geometryTriangles, geometryDrawCalls,
+			            geometrySubmitTime * 1000.0);
+			ImGui::SliderFloat("LOD Pixel Error", &lodPixelError, 0.0f, 8.0f);
+			ImGui::SliderInt("Stress Instances", &stressInstances, 0, 50000);
+			ImGui::Text("Transforms: %d of %d entities updated (%.3f ms)", transformsUpdated, (int)transforms.Size(), transformTime * 1000.0);
+			ImGui::Text("Culling: %d of %d objects visible (%.3f ms, %.0f objects/ms)", cullVisible, cullObjects, cullTime * 1000.0,
+			            cullTime > 0.0 ? cullObjects / (cullTime * 1000.0) : 0.0);
+			ImGui::Checkbox("Frustum Culling", &frustumCulling);
+			if (ImGui::TreeNode("Render Graph")) {
+				for (const string &pass : renderGraph.ExecutedPasses(output, configuration))
+					ImGui::BulletText("%s", pass.c_str());
+				for (const string &pass : renderGraph.CulledPasses(output, configuration))
+					ImGui::TextDisabled("  %s (culled)", pass.c_str());
+				ImGui::TreePop();
+			}
+			ImGui::Text("Render Targets: %.2f MB used, %.2f MB allocated (%d targets)", renderTargets.FrameBytes() / 1048576.0,
+			            renderTargets.AllocatedBytes() / 1048576.0, (int)renderTargets.AllocatedTargets());
+			float idleTime = (float)renderTargets.idleTime;
+			if (ImGui::SliderFloat("Release Targets After (s)", &idleTime, 0.0f, 10.0f))
+				renderTargets.idleTime = idleTime;
 			if (ImGui::Button("Reset Counters")) {
 				numFrames = -1;
 				averageFrameTime = 0.0f;
@@ -904,6 +1600,8 @@ int main()
 				ImGui::EndCombo();
 			}
 			ImGui::Image((void *)(intptr_t)gbuffers[filter_idx], ImVec2(400, 300), ImVec2(0, 1), ImVec2(1, 0)); // Flipping the image upside down
+			if (ImGui::Button("Capture G Buffer"))
+				captureRequested = true;
 			ImGui::End();
 			
 			ImGui::Begin("Configurator");
@@ -930,11 +1628,38 @@ int main()
 				ImGui::EndCombo();
 			}
 			ImGui::Checkbox("Perform Blur Pass", &have_blur);
-			if (ssao_mode != HBAO) {
+			if (have_blur) {
+				ImGui::SliderInt("Blur Radius", &blurRadius, 1, 8);
+				ImGui::Checkbox("Blur with textureGather", &blurGather);
+			}
+			if (ssao_mode != NO_SSAO) {
+				ImGui::Text("AO Resolution:");
+				ImGui::SameLine();
+				ImGui::RadioButton("Full", &aoDownscale, 1);
+				ImGui::SameLine();
+				ImGui::RadioButton("Half", &aoDownscale, 2);
+				ImGui::SameLine();
+				ImGui::RadioButton("Quarter", &aoDownscale, 4);
+				ImGui::Checkbox("Specialized Shaders", &specializedShaders);
+				ImGui::Checkbox("Temporal Accumulation", &temporalAO);
+				if (temporalAO)
+					ImGui::SliderInt("Accumulated Frames", &temporalFrames, 1, 64);
+			}
+			if (ssao_mode != HBAO && ssao_mode != DEINTERLEAVED_HBAO) {
 				ImGui::SliderInt("Kernel Size", &kernelSize, 8, 256);
 				ImGui::SliderFloat("Kernel Radius", &kernelRadius, 0.1f, 20.0f);
 				if (ssao_mode != UE4_AO)
 					ImGui::SliderFloat("Kernel Bias", &kernelBias, 0.01f, 1.0f);
+				if (supportsComputeAO(ssao_mode)) {
+					ImGui::Checkbox("Compute Shader (AO and blur in one dispatch)", &computeAO);
+					if (computeAO) {
+						ImGui::SliderInt("Compute Up To Blur Radius", &computeAOMaxBlurRadius, 0, COMPUTE_AO_MAX_BLUR_RADIUS);
+						if (!usesComputeAO(ssao_mode, have_blur ? BlurTaps(blurRadius, blurGather) : 0))
+							ImGui::Text("(fragment passes above blur radius %d)", computeAOMaxBlurRadius);
+					}
+				}
+				if (supportsDepthPyramid(ssao_mode) && !computePath())
+					ImGui::Combo("Depth Pyramid", &depthPyramidModes[ssao_mode], depthPyramidNames, DEPTH_PYRAMID_MODES_NUM);
 			} else {
 				ImGui::SliderInt("Directions Number", &numDirections, 4, 128);
 				ImGui::SliderFloat("Kernel Radius", &kernelRadius, 0.1f, 2.0f);
@@ -950,11 +1675,15 @@ int main()
 			glfwGetFramebufferSize(window, &display_w, &display_h);
 			glViewport(0, 0, display_w, display_h);
 			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+			// dear ImGui sets the OpenGL state directly
+			glState.Invalidate();
 		}
 		
 		// Swapping back and front buffers
-		glfwMakeContextCurrent(window);
-		glfwSwapBuffers(window);
+		if (!headless) {
+			glfwMakeContextCurrent(window);
+			glfwSwapBuffers(window);
+		}
 	}
 
 	// when I exit from the graphics loop, it is because the application is closing
@@ -962,22 +1691,40 @@ int main()
 	skyboxPass.Delete();
 	skyboxReconstrPass.Delete();
 	geometryPass.Delete();
+	geometryReconstrPass.Delete();
+	geometryInstancedPass.Delete();
+	geometryReconstrInstancedPass.Delete();
 	SSAOPass.Delete();
 	SSDOPass.Delete();
 	SSDOIndirectPass.Delete();
-	SSDOblurPass.Delete();
 	SSDOCombinePass.Delete();
 	SSAOReconstrPass.Delete();
 	HBAOPass.Delete();
+	HBAODeinterleavedPass.Delete();
+	deinterleavePass.Delete();
 	AlchemyPass.Delete();
 	UnrealPass.Delete();
-	blurPass.Delete();
+	blurPassVariants.Delete();
+	temporalPass.Delete();
+	depthPyramidPass.Delete();
+	if (SSAOComputePass)
+		SSAOComputePass->Delete();
+	downsamplePass.Delete();
+	upsamplePass.Delete();
 	lightingPass.Delete();
+	kernelBuffer.Delete();
+	renderTargets.Delete();
+	aoHistory.Delete();
+	depthPyramid.Delete();
+	stressInstanceBuffer.Delete();
 	
-	ImGui_ImplOpenGL3_Shutdown();
-	ImGui_ImplGlfw_Shutdown();
-	ImGui::DestroyContext();
-	glfwTerminate();
+	if (!headless) {
+		ImGui_ImplOpenGL3_Shutdown();
+		ImGui_ImplGlfw_Shutdown();
+		ImGui::DestroyContext();
+	}
+	if (window)
+		glfwTerminate();
 	return 0;
 }
 
@@ -997,7 +1744,7 @@ void DrawQuad() {
 
 		glGenVertexArrays(1, &quadVAO);
 		glGenBuffers(1, &quadVBO);
-		glBindVertexArray(quadVAO);
+		GLState::Get().BindVertexArray(quadVAO);
 		glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
 		glEnableVertexAttribArray(0);
@@ -1005,69 +1752,291 @@ void DrawQuad() {
 		glEnableVertexAttribArray(1);
 		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
 	}
-	glBindVertexArray(quadVAO);
+	GLState::Get().BindVertexArray(quadVAO);
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	glBindVertexArray(0);
 }
 
 //////////////////////////////////////////
-// We render the objects.
+// We place the objects of the scene for the current frame, and we cull their meshes with the view frustum.
+// The entities of the objects are created at the first frame, and then only their rotation changes (when they spin).
+// The instances of the stress scene are static entities on a cubic grid behind the scene (cubes, spheres and bunnies
+// in turn), created again when their number changes: the hierarchy is built again only then, and otherwise it is
+// refitted to the entities updated in the frame
+void UpdateScene(Model &cubeModel, Model &sphereModel, Model &bunnyModel)
+{
+	const glm::quat identity(1.0f, 0.0f, 0.0f, 0.0f);
+	static GLfloat sceneOrientationY = 0.0f;
+	if (transforms.Size() == 0)
+	{
+		// Plane
+		transforms.Create(glm::vec3(0.0f, -8.0f, 0.0f), identity, glm::vec3(7.5f, 7.5f, 7.5f));
+		// SPHERE
+		transforms.Create(glm::vec3(-3.0f, 0.3f, 0.0f), identity, glm::vec3(0.8f, 0.8f, 0.8f));
+		// CUBE
+		transforms.Create(glm::vec3(0.0f, 0.3f, 0.0f), identity, glm::vec3(0.8f, 0.8f, 0.8f));
+		// BUNNY
+		transforms.Create(glm::vec3(3.0f, 0.3f, 0.0f), identity, glm::vec3(0.3f, 0.3f, 0.3f));
+	}
+	// the models spin around their Y axis
+	if (orientationY != sceneOrientationY)
+	{
+		glm::quat rotation = glm::angleAxis(glm::radians(orientationY), glm::vec3(0.0f, 1.0f, 0.0f));
+		for (int o = SPHERE_OBJECT; o <= BUNNY_OBJECT; o++)
+			transforms.SetRotation(o, rotation);
+		sceneOrientationY = orientationY;
+	}
+
+	// STRESS SCENE
+	if ((int)transforms.Size() != SCENE_OBJECTS_NUM + stressInstances)
+	{
+		transforms.Truncate(SCENE_OBJECTS_NUM);
+		int side = (int)ceil(cbrt((double)stressInstances));
+		// scale of the cube, the sphere and the bunny (the bunny model is about 8 units wide)
+		const float scales[3] = { 0.15f, 0.2f, 0.04f };
+		for (int i = 0; i < stressInstances; i++)
+		{
+			glm::vec3 position(((i % side) - (side - 1) * 0.5f) * 0.5f, ((i / side) % side) * 0.5f - 0.2f, -3.0f - (i / (side * side)) * 0.5f);
+			transforms.Create(position, glm::angleAxis(glm::radians(37.0f * i), glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(scales[i % 3]));
+		}
+	}
+
+	// matrices of the changed entities
+	double transformStart = getTime();
+	transformsUpdated = (int)transforms.Update();
+	transformTime = getTime() - transformStart;
+
+	// boxes of the objects of the hierarchy, in world coordinates
+	Model *models[SCENE_OBJECTS_NUM] = { &cubeModel, &sphereModel, &cubeModel, &bunnyModel };
+	Model *instanceModels[3] = { &cubeModel, &sphereModel, &bunnyModel };
+	static std::vector<glm::vec3> minimums, maximums;
+	for (int o = 0; o < SCENE_OBJECTS_NUM; o++)
+		sceneObjectFirst[o + 1] = sceneObjectFirst[o] + models[o]->meshes.size();
+	size_t numObjects = sceneObjectFirst[SCENE_OBJECTS_NUM] + stressInstances;
+	bool rebuild = numObjects != sceneBVH.Objects();
+	minimums.resize(numObjects);
+	maximums.resize(numObjects);
+	auto updateBoxes = [&](TransformStore::Entity entity) {
+		const glm::mat4 &matrix = transforms.WorldMatrix(entity);
+		if (entity < SCENE_OBJECTS_NUM)
+		{
+			for (size_t m = 0; m < models[entity]->meshes.size(); m++)
+			{
+				const Mesh &mesh = models[entity]->meshes[m];
+				size_t object = sceneObjectFirst[entity] + m;
+				BVH::TransformBox(matrix, mesh.BoundsMinimum(), mesh.BoundsMaximum(), minimums[object], maximums[object]);
+				if (!rebuild)
+					sceneBVH.Update((uint32_t)object, minimums[object], maximums[object]);
+			}
+		}
+		else
+		{
+			glm::vec3 minimum, maximum;
+			instanceModels[(entity - SCENE_OBJECTS_NUM) % 3]->Bounds(minimum, maximum);
+			size_t object = sceneObjectFirst[SCENE_OBJECTS_NUM] + entity - SCENE_OBJECTS_NUM;
+			BVH::TransformBox(matrix, minimum, maximum, minimums[object], maximums[object]);
+			if (!rebuild)
+				sceneBVH.Update((uint32_t)object, minimums[object], maximums[object]);
+		}
+	};
+	if (rebuild)
+	{
+		for (TransformStore::Entity entity = 0; entity < transforms.Size(); entity++)
+			updateBoxes(entity);
+		sceneBVH.Build(minimums.data(), maximums.data(), numObjects);
+	}
+	else
+	{
+		for (TransformStore::Entity entity : transforms.UpdatedEntities())
+			updateBoxes(entity);
+		sceneBVH.Refit();
+	}
+
+	// culling with the view frustum of the camera
+	cullObjects = (int)numObjects;
+	if (!frustumCulling)
+	{
+		objectVisible.assign(numObjects, 1);
+		cullVisible = cullObjects;
+		cullTime = 0.0;
+		return;
+	}
+	static std::vector<uint32_t> visible;
+	visible.clear();
+	glm::mat4 projection = glm::perspective(FOV, (float)screenWidth/(float)screenHeight, 0.1f, 50.0f);
+	double cullStart = getTime();
+	sceneBVH.Cull(projection * view, visible);
+	cullTime = getTime() - cullStart;
+	objectVisible.assign(numObjects, 0);
+	for (uint32_t object : visible)
+		objectVisible[object] = 1;
+	cullVisible = (int)visible.size();
+}
+
+//////////////////////////////////////////
+// rendering of the meshes of an object of the scene not culled by UpdateScene, with the matrices of its entity
+void DrawSceneObject(Shader &shader, Model &model, int object, float pixelsPerUnit)
+{
+	const uint8_t *visible = objectVisible.data() + sceneObjectFirst[object];
+	int drawCalls = (int)std::count(visible, visible + model.meshes.size(), 1);
+	if (drawCalls == 0)
+		return;
+	const glm::mat4 &modelMatrix = transforms.WorldMatrix(object);
+	shader.SetMat4("modelMatrix", modelMatrix);
+	// previous frame transformation, for the motion vectors
+	shader.SetMat4("previousModelMatrix", transforms.PreviousWorldMatrix(object));
+	shader.SetMat3("normalMatrix", transforms.NormalMatrix(object, view));
+	geometryTriangles += model.Draw(view * modelMatrix, pixelsPerUnit, lodPixelError, visible);
+	geometryDrawCalls += drawCalls;
+}
+
+//////////////////////////////////////////
+// We render the objects (placed by UpdateScene).
 void RenderObjects(Shader &shader, Model &cubeModel, Model &sphereModel, Model &bunnyModel)
 {
-	// Plane
-	// we reset to identity at each frame
-	cubeModelMatrix = glm::mat4(1.0f);
-	cubeNormalMatrix = glm::mat3(1.0f);
-	cubeModelMatrix = glm::translate(cubeModelMatrix, glm::vec3(0.0f, -8.0f, 0.0f));
-	cubeModelMatrix = glm::scale(cubeModelMatrix, glm::vec3(7.5f, 7.5f, 7.5f));
-	cubeNormalMatrix = glm::inverseTranspose(glm::mat3(view*cubeModelMatrix));
-	glUniformMatrix4fv(glGetUniformLocation(shader.Program, "modelMatrix"), 1, GL_FALSE, glm::value_ptr(cubeModelMatrix));
-	glUniformMatrix3fv(glGetUniformLocation(shader.Program, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(cubeNormalMatrix));
+	// size in pixels of a unit at distance 1 from the camera, for the selection of the levels of detail
+	float pixelsPerUnit = (float)screenHeight * 0.5f / fabs(tan(FOV * 0.5f));
+	geometryTriangles = 0;
+	geometryDrawCalls = 0;
 
 	// we render the plane
-	cubeModel.Draw();
-
-	// SPHERE
-	// we reset to identity at each frame
-	sphereModelMatrix = glm::mat4(1.0f);
-	sphereNormalMatrix = glm::mat3(1.0f);
-	sphereModelMatrix = glm::translate(sphereModelMatrix, glm::vec3(-3.0f, 0.3f, 0.0f));
-	sphereModelMatrix = glm::rotate(sphereModelMatrix, glm::radians(orientationY), glm::vec3(0.0f, 1.0f, 0.0f));
-	sphereModelMatrix = glm::scale(sphereModelMatrix, glm::vec3(0.8f, 0.8f, 0.8f));
-	sphereNormalMatrix = glm::inverseTranspose(glm::mat3(view*sphereModelMatrix));
-	glUniformMatrix4fv(glGetUniformLocation(shader.Program, "modelMatrix"), 1, GL_FALSE, glm::value_ptr(sphereModelMatrix));
-	glUniformMatrix3fv(glGetUniformLocation(shader.Program, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(sphereNormalMatrix));
-
+	DrawSceneObject(shader, cubeModel, PLANE_OBJECT, pixelsPerUnit);
 	// we render the sphere
-	sphereModel.Draw();
+	DrawSceneObject(shader, sphereModel, SPHERE_OBJECT, pixelsPerUnit);
+	// we render the cube
+	DrawSceneObject(shader, cubeModel, CUBE_OBJECT, pixelsPerUnit);
+	// we render the bunny
+	DrawSceneObject(shader, bunnyModel, BUNNY_OBJECT, pixelsPerUnit);
+}
+
+//////////////////////////////////////////
+// The visible instances of the stress scene (placed by UpdateScene) are sorted by model and level of detail (selected
+// for the first mesh of each model): each group is a range of the instance buffer, drawn by a single instanced draw
+// call, so the number of draw calls does not depend on the number of instances
+void RenderInstances(Shader &shader, Model &cubeModel, Model &sphereModel, Model &bunnyModel, InstanceBuffer &instances)
+{
+	static std::vector<glm::mat4> sorted;
+	static std::vector<int> groups;
+	const uint8_t *visible = objectVisible.data() + sceneObjectFirst[SCENE_OBJECTS_NUM];
+	const glm::mat4 *matrices = transforms.WorldMatrices() + SCENE_OBJECTS_NUM;
+	int numInstances = (int)transforms.Size() - SCENE_OBJECTS_NUM;
+
+	Model *models[3] = { &cubeModel, &sphereModel, &bunnyModel };
+	float pixelsPerUnit = (float)screenHeight * 0.5f / fabs(tan(FOV * 0.5f));
+	// counting sort of the visible instances by group (model * MAX_LODS + level of detail; -1 for the culled ones)
+	const int numGroups = 3 * MeshSimplifier::MAX_LODS;
+	int firsts[numGroups + 1] = {};
+	groups.resize(numInstances);
+	for (int i = 0; i < numInstances; i++)
+	{
+		groups[i] = -1;
+		if (!visible[i])
+			continue;
+		Model &model = *models[i % 3];
+		int lod = model.meshes.empty() ? 0 : model.meshes[0].SelectLOD(view * matrices[i], pixelsPerUnit, lodPixelError);
+		groups[i] = (i % 3) * MeshSimplifier::MAX_LODS + lod;
+		firsts[groups[i] + 1]++;
+	}
+	for (int g = 0; g < numGroups; g++)
+		firsts[g + 1] += firsts[g];
+	if (firsts[numGroups] == 0)
+		return;
+	sorted.resize(firsts[numGroups]);
+	int filled[numGroups];
+	std::copy(firsts, firsts + numGroups, filled);
+	for (int i = 0; i < numInstances; i++)
+		if (groups[i] >= 0)
+			sorted[filled[groups[i]]++] = matrices[i];
+	instances.Update(sorted.data(), sorted.size());
+
+	shader.Use();
+	shader.SetMat4("viewMatrix", view);
+	shader.SetMat4("previousViewMatrix", previousView);
+	for (int g = 0; g < numGroups; g++)
+	{
+		if (firsts[g + 1] == firsts[g])
+			continue;
+		geometryTriangles += models[g / MeshSimplifier::MAX_LODS]->DrawInstanced(instances, firsts[g], firsts[g + 1] - firsts[g], g % MeshSimplifier::MAX_LODS);
+		geometryDrawCalls++;
+	}
+}
+
+//////////////////////////////////////////
+// (Re)allocation of the storage of all the screen-sized render targets
+// The textures keep their names, so the framebuffers they are attached to do not need to be rebuilt
+void allocateRenderTargets()
+{
+	// G Buffer
+	glBindTexture(GL_TEXTURE_2D, gPosition);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, screenWidth, screenHeight, 0, GL_RGB, GL_FLOAT, nullptr); // Float texture to ensure values are not clamped in [0, 1] range
+	glBindTexture(GL_TEXTURE_2D, gNormal);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, screenWidth, screenHeight, 0, GL_RGB, GL_FLOAT, nullptr); // Float texture to ensure values are not clamped in [0, 1] range
+	glBindTexture(GL_TEXTURE_2D, gAlbedo);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, screenWidth, screenHeight, 0, GL_RGB, GL_FLOAT, nullptr);
+	glBindTexture(GL_TEXTURE_2D, gMotion);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, screenWidth, screenHeight, 0, GL_RGB, GL_FLOAT, nullptr);
+	glBindTexture(GL_TEXTURE_2D, gDepthBuffer);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, screenWidth, screenHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
 	
-	// CUBE
-	// we reset to identity at each frame
-	cubeModelMatrix = glm::mat4(1.0f);
-	cubeNormalMatrix = glm::mat3(1.0f);
-	cubeModelMatrix = glm::translate(cubeModelMatrix, glm::vec3(0.0f, 0.3f, 0.0f));
-	cubeModelMatrix = glm::rotate(cubeModelMatrix, glm::radians(orientationY), glm::vec3(0.0f, 1.0f, 0.0f));
-	cubeModelMatrix = glm::scale(cubeModelMatrix, glm::vec3(0.8f, 0.8f, 0.8f));
-	cubeNormalMatrix = glm::inverseTranspose(glm::mat3(view*cubeModelMatrix));
-	glUniformMatrix4fv(glGetUniformLocation(shader.Program, "modelMatrix"), 1, GL_FALSE, glm::value_ptr(cubeModelMatrix));
-	glUniformMatrix3fv(glGetUniformLocation(shader.Program, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(cubeNormalMatrix));
+	// (the pass stages are transient render targets, allocated by the render graph with the current resolution)
+	glBindTexture(GL_TEXTURE_2D, 0);
+	
+	// Offscreen final image (only when benchmarking)
+	if (outputFBO) {
+		glBindRenderbuffer(GL_RENDERBUFFER, outputColorBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, screenWidth, screenHeight);
+		glBindRenderbuffer(GL_RENDERBUFFER, outputDepthBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, screenWidth, screenHeight);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	}
+	// the textures have been bound outside the state cache
+	GLState::Get().Invalidate();
+}
 
-	// we render the cube
-	cubeModel.Draw();
-
-	// BUNNY
-	// we reset to identity at each frame
-	bunnyModelMatrix = glm::mat4(1.0f);
-	bunnyNormalMatrix = glm::mat3(1.0f);
-	bunnyModelMatrix = glm::translate(bunnyModelMatrix, glm::vec3(3.0f, 0.3f, 0.0f));
-	bunnyModelMatrix = glm::rotate(bunnyModelMatrix, glm::radians(orientationY), glm::vec3(0.0f, 1.0f, 0.0f));
-	bunnyModelMatrix = glm::scale(bunnyModelMatrix, glm::vec3(0.3f, 0.3f, 0.3f));
-	bunnyNormalMatrix = glm::inverseTranspose(glm::mat3(view*bunnyModelMatrix));
-	glUniformMatrix4fv(glGetUniformLocation(shader.Program, "modelMatrix"), 1, GL_FALSE, glm::value_ptr(bunnyModelMatrix));
-	glUniformMatrix3fv(glGetUniformLocation(shader.Program, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(bunnyNormalMatrix));
+//////////////////////////////////////////
+// Current time in seconds: GLFW timer when a window is available, standard library steady clock in headless mode
+double getTime()
+{
+	if (!headless)
+		return glfwGetTime();
+	static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
 
-	// we render the bunny
-	bunnyModel.Draw();
+//////////////////////////////////////////
+// We read back the G Buffer textures and we save them, together with the other inputs of the AO passes, in a capture file
+// N.B.) with Depth Resolve techniques gPosition is not written by the geometry pass, so only the depth buffer is meaningful
+void captureGBuffer(const string &path, const std::vector<glm::vec3> &kernel, const std::vector<glm::vec3> &noise)
+{
+	size_t texels = (size_t)screenWidth * screenHeight;
+	std::vector<glm::vec3> positions(texels), normals(texels);
+	std::vector<unsigned char> albedo(texels * 3);
+	std::vector<float> depth(texels);
+	
+	// rows of the RGB8 albedo are not 4 bytes aligned
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glBindTexture(GL_TEXTURE_2D, gPosition);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_FLOAT, positions.data());
+	glBindTexture(GL_TEXTURE_2D, gNormal);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_FLOAT, normals.data());
+	glBindTexture(GL_TEXTURE_2D, gAlbedo);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, albedo.data());
+	glBindTexture(GL_TEXTURE_2D, gDepthBuffer);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, GL_FLOAT, depth.data());
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	GLState::Get().Invalidate();
+	
+	GBufferCaptureData data;
+	data.info = {screenWidth, screenHeight, ssao_mode, kernelSize, numDirections, numSteps, kernelRadius, kernelBias, FOV, 0.1f, 50.0f, 0};
+	data.projection = glm::perspective(FOV, (float)screenWidth/(float)screenHeight, 0.1f, 50.0f);
+	data.view = camera.GetViewMatrix(); // the global view matrix has lost its translation in the skybox step
+	data.position = positions.data();
+	data.normal = normals.data();
+	data.albedo = albedo.data();
+	data.depth = depth.data();
+	data.noise = &noise;
+	data.kernel = &kernel;
+	SaveGBufferCapture(path, data);
 }
 
 //////////////////////////////////////////
@@ -1146,6 +2115,10 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 	if (key == GLFW_KEY_Q && action == GLFW_PRESS)
 		camera_mode = !camera_mode;
 	
+	// if C is pressed, we save the G Buffer content at the end of the frame
+	if (key == GLFW_KEY_C && action == GLFW_PRESS)
+		captureRequested = true;
+	
 	// we keep trace of the pressed keys
 	// with this method, we can manage 2 keys pressed at the same time:
 	// many I/O managers often consider only 1 key pressed at the time (the first pressed, until it is released)
@@ -11,7 +11,7 @@ uniform sampler2D gPosition;
 
 void main()
 {
-	float depth = texture(gPosition, gl_FragCoord.xy / vec2(1200, 900)).z;
+	float depth = texture(gPosition, gl_FragCoord.xy / vec2(textureSize(gPosition, 0))).z;
 	if (depth > 0.099)
 		colorFrag = texture(tCube, interp_UVW);
     else
@@ -29,9 +29,12 @@ positive Z axis points "outside" the screen
 #version 410 core
 
 // vertex position in world coordinates
-in vec3 position;
+layout (location = 0) in vec3 position;
 // the numbers used for the location in the layout qualifier are the positions of the vertex attribute
 // as defined in the Mesh class
+// scale and bias of the (quantized) positions of the mesh (see utils/vertex_layout.h)
+layout (location = 5) in vec3 positionScale;
+layout (location = 6) in vec3 positionBias;
 
 // texture coordinates for the environment map sampling (we use 3 coordinates because we are sampling in 3 dimensions)
 out vec3 interp_UVW;
@@ -44,10 +47,11 @@ uniform mat4 projectionMatrix;
 void main()
 {
 		// in this case, we are not using the UV coordinates of the models, but we use the vertex position as 3D texture coordinates, in order to have a 1:1 mapping from the cube map and the cube used as "the world"
-		interp_UVW = position;
+		vec3 modelPosition = position * positionScale + positionBias;
+		interp_UVW = modelPosition;
 
 		// we apply the transformations to the vertex
-    vec4 pos = projectionMatrix * viewMatrix * vec4(position, 1.0);
+    vec4 pos = projectionMatrix * viewMatrix * vec4(modelPosition, 1.0);
 		// we want to set the Z coordinate of the projected vertex at the maximum depth (i.e., we want Z to be equal to 1.0 after the projection divide)
 		// -> we set Z equal to W (because in the projection divide, after clipping, all the components will be divided by W).
 		// This means that, during the depth test, the fragments of the environment map will have maximum depth (see comments in the code of the main application)
@@ -12,7 +12,7 @@ uniform sampler2D gPosition;
 void main()
 {
 
-	float depth = texture(gPosition, gl_FragCoord.xy / vec2(1200, 900)).x;
+	float depth = texture(gPosition, gl_FragCoord.xy / vec2(textureSize(gPosition, 0))).x;
 	if (depth > 0.999)
 		colorFrag = texture(tCube, interp_UVW);
     else
@@ -6,25 +6,56 @@ in vec2 vTexcoords;
 uniform sampler2D gPosition;
 uniform sampler2D gNormal;
 uniform sampler2D noiseTexture;
+uniform vec2 noiseOffset; // shift of the noise tiling (0.25 = one noise texel), changed at each frame by the temporal AO
 
-uniform vec3 kernel[256];
+// Sample kernel, shared by all the AO passes (see utils/kernel_buffer.h)
+layout (std140) uniform SampleKernel {
+	vec3 kernel[256];
+};
 
 // SSAO Configuration
+#ifdef KERNEL_SIZE
+const int kernelSize = KERNEL_SIZE; // specialized variant (see utils/shader_variants.h)
+#else
 uniform int kernelSize;
+#endif
 uniform float radius;
 uniform float bias;
 
-// Tile noise texture over screen based on screen dimensions divided by noise size
-const vec2 noiseScale = vec2(1200.0/4.0, 900.0/4.0); 
-
 uniform mat4 projectionMatrix;
 
+// Hierarchical depth buffer, used for the samples in place of the positions if useDepthPyramid is set
+uniform bool useDepthPyramid;
+uniform sampler2D depthPyramid;
+uniform int pyramidLevels;
+// samples nearer than 2^LOG_MAX_OFFSET pixels are fetched from level 0
+const int LOG_MAX_OFFSET = 3;
+
+// Linear depth of a sample from the hierarchical depth buffer (see depth_pyramid.frag): as in Scalable Ambient
+// Obscurance, the level is chosen from the screen space distance of the sample, so that the samples far from the
+// fragment are fetched from the coarser levels, and the texels read by the neighbouring fragments stay in cache
+float PyramidDepth(vec2 coords)
+{
+	vec2 size = vec2(textureSize(depthPyramid, 0));
+	float distance = length((coords - vTexcoords) * size);
+	int level = clamp(int(floor(log2(max(distance, 1.0f)))) - LOG_MAX_OFFSET, 0, pyramidLevels - 1);
+	ivec2 texel = clamp(ivec2(coords * size) >> level, ivec2(0), textureSize(depthPyramid, level) - 1);
+	return texelFetch(depthPyramid, texel, level).x;
+}
+
 void main()
 {
+	// Tile noise texture over screen based on screen dimensions divided by noise size
+#ifdef RESOLUTION
+	vec2 noiseScale = vec2(RESOLUTION) / 4.0;
+#else
+	vec2 noiseScale = vec2(textureSize(gPosition, 0)) / 4.0;
+#endif
+	
 	// get input for SSAO algorithm
 	vec3 fragPos = texture(gPosition, vTexcoords).xyz;
 	vec3 normal = normalize(texture(gNormal, vTexcoords).xyz);
-	vec3 randomVec = normalize(texture(noiseTexture, vTexcoords * noiseScale).xyz);
+	vec3 randomVec = normalize(texture(noiseTexture, vTexcoords * noiseScale + noiseOffset).xyz);
 	
 	// Create TBN change-of-basis matrix: from tangent-space to view-space
 	vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
@@ -45,7 +76,7 @@ void main()
 		offset.xyz = offset.xyz * 0.5f + 0.5f; // Get it in [0, 1] range
 		
 		// Get sample depth
-		float sampleDepth = texture(gPosition, offset.xy).z;
+		float sampleDepth = useDepthPyramid ? -PyramidDepth(offset.xy) : texture(gPosition, offset.xy).z;
 		
 		// Range check and accumulation (Range check is introduced to avoid very far surfaces to alter sampled position AO factor)
 		float rangeCheck = smoothstep(0.0f, 1.0f, radius / abs(fragPos.z - sampleDepth));
@@ -6,27 +6,39 @@ in vec2 vTexcoords;
 uniform sampler2D gPosition;
 uniform sampler2D gNormal;
 uniform sampler2D noiseTexture;
+uniform vec2 noiseOffset; // shift of the noise tiling (0.25 = one noise texel), changed at each frame by the temporal AO
 uniform samplerCube skybox;
 
-uniform vec3 kernel[256];
+// Sample kernel, shared by all the AO passes (see utils/kernel_buffer.h)
+layout (std140) uniform SampleKernel {
+	vec3 kernel[256];
+};
 
 // SSDO Configuration
+#ifdef KERNEL_SIZE
+const int kernelSize = KERNEL_SIZE; // specialized variant (see utils/shader_variants.h)
+#else
 uniform int kernelSize;
+#endif
 uniform float radius;
 uniform float bias;
 
-// Tile noise texture over screen based on screen dimensions divided by noise size
-const vec2 noiseScale = vec2(1200.0/4.0, 900.0/4.0); 
-
 uniform mat4 projectionMatrix;
 uniform mat4 invViewMatrix;
 
 void main()
 {
+	// Tile noise texture over screen based on screen dimensions divided by noise size
+#ifdef RESOLUTION
+	vec2 noiseScale = vec2(RESOLUTION) / 4.0;
+#else
+	vec2 noiseScale = vec2(textureSize(gPosition, 0)) / 4.0;
+#endif
+	
 	// get input for SSDO algorithm
 	vec3 fragPos = texture(gPosition, vTexcoords).xyz;
 	vec3 normal = texture(gNormal, vTexcoords).xyz;
-	vec3 randomVec = texture(noiseTexture, vTexcoords * noiseScale).xyz;
+	vec3 randomVec = texture(noiseTexture, vTexcoords * noiseScale + noiseOffset).xyz;
 	
 	// Create TBN change-of-basis matrix: from tangent-space to view-space
 	vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
@@ -8,20 +8,23 @@ uniform sampler2D gNormal;
 uniform sampler2D noiseTexture;
 uniform sampler2D lightTexture;
 
-uniform vec3 kernel[256];
+// Sample kernel, shared by all the AO passes (see utils/kernel_buffer.h)
+layout (std140) uniform SampleKernel {
+	vec3 kernel[256];
+};
 
 // SSDO Configuration
 uniform int kernelSize;
 uniform float radius;
 uniform float bias;
 
-// Tile noise texture over screen based on screen dimensions divided by noise size
-const vec2 noiseScale = vec2(1200.0/4.0, 900.0/4.0); 
-
 uniform mat4 projectionMatrix;
 
 void main()
 {
+	// Tile noise texture over screen based on screen dimensions divided by noise size
+	vec2 noiseScale = vec2(textureSize(gPosition, 0)) / 4.0;
+	
 	// get input for SSDO algorithm
 	vec3 fragPos = texture(gPosition, vTexcoords).xyz;
 	vec3 normal = texture(gNormal, vTexcoords).xyz;
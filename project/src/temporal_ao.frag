@@ -0,0 +1,58 @@
+#version 410 core
+layout (location = 0) out vec4 FragColor; // accumulated AO (1 or 3 channels), linear depth in the alpha channel
+layout (location = 1) out vec4 FragNormal; // view space normal, number of accumulated frames in the alpha channel
+
+in vec2 vTexcoords;
+
+// Temporal accumulation of the AO buffer: the history of the previous frame is reprojected with the motion vectors of
+// the geometry pass, and blended with the current AO buffer (computed with a different noise offset at each frame).
+// The history is rejected on disocclusions, detected comparing its depth with the depth of the surface in the
+// previous frame, and its normal with the normal of the surface (rotated in the view space of the previous frame)
+uniform sampler2D image; // current AO buffer
+uniform sampler2D history; // accumulated AO and linear depth of the previous frame
+uniform sampler2D historyNormal; // normals and number of accumulated frames of the previous frame
+uniform sampler2D gMotion;
+uniform sampler2D gDepthMap; // depth buffer, or the low resolution normals with the linear depth in the alpha channel
+uniform sampler2D gNormal;
+
+uniform bool packedDepth; // gDepthMap holds the linear depth in the alpha channel
+uniform bool historyValid; // the history has been written in the previous frame with the same configuration
+uniform int maxFrames; // the weight of the current frame is at least 1 / maxFrames
+uniform float depthTolerance; // relative difference between the depths of the history and of the surface
+uniform float normalTolerance; // minimum cosine between the normals of the history and of the surface
+uniform mat3 previousViewRotation; // from the current view space to the view space of the previous frame
+
+uniform mat4 projectionMatrix;
+
+// Linear (positive) view space depth from the depth buffer value
+float LinearDepth(float depth)
+{
+	return packedDepth ? depth : projectionMatrix[3][2] / ((depth * 2.0f - 1.0f) + projectionMatrix[2][2]);
+}
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	vec4 current = texelFetch(image, texel, 0);
+	vec4 depthSample = texelFetch(gDepthMap, texel, 0);
+	float depth = LinearDepth(packedDepth ? depthSample.a : depthSample.x);
+	vec3 normal = texelFetch(gNormal, texel, 0).xyz;
+	vec3 motion = texture(gMotion, vTexcoords).xyz;
+
+	vec4 result = current;
+	float frames = 1.0f;
+	vec2 previousCoords = vTexcoords - motion.xy;
+	if (historyValid && all(greaterThanEqual(previousCoords, vec2(0.0f))) && all(lessThan(previousCoords, vec2(1.0f)))) {
+		ivec2 previousTexel = ivec2(previousCoords * vec2(textureSize(history, 0)));
+		vec4 previous = texelFetch(history, previousTexel, 0);
+		vec4 previousNormal = texelFetch(historyNormal, previousTexel, 0);
+		bool sameDepth = abs(previous.a - motion.z) <= depthTolerance * motion.z;
+		bool sameNormal = dot(previousNormal.xyz, previousViewRotation * normal) >= normalTolerance;
+		if (sameDepth && sameNormal) {
+			frames = min(previousNormal.a + 1.0f, float(maxFrames));
+			result = mix(previous, current, 1.0f / frames);
+		}
+	}
+	FragColor = vec4(result.rgb, depth);
+	FragNormal = vec4(normal, frames);
+}
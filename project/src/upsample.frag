@@ -0,0 +1,58 @@
+#version 410 core
+out vec4 FragColor;
+
+in vec2 vTexcoords;
+
+// Joint bilateral upsampling of a low resolution AO buffer
+// The 4 low resolution texels around the fragment are weighted by their bilinear weights, and by the similarity
+// of their depth and normal to the full resolution ones, so that the AO does not bleed across depth discontinuities
+uniform sampler2D image; // low resolution AO
+uniform sampler2D lowNormalDepth; // low resolution normals, with linear depth in the alpha channel
+uniform sampler2D gDepthMap;
+uniform sampler2D gNormal;
+
+uniform float depthSigma; // depth difference (relative to the depth of the fragment) halving the weight of a texel
+uniform mat4 projectionMatrix;
+
+// Linear (positive) view space depth from the depth buffer value
+float LinearDepth(float depth)
+{
+	return projectionMatrix[3][2] / ((depth * 2.0f - 1.0f) + projectionMatrix[2][2]);
+}
+
+void main()
+{
+	ivec2 lowSize = textureSize(image, 0);
+	vec2 coords = vTexcoords * vec2(lowSize) - 0.5f;
+	ivec2 first = ivec2(floor(coords));
+	vec2 f = coords - vec2(first);
+	
+	float depth = LinearDepth(texture(gDepthMap, vTexcoords).x);
+	vec3 normal = texture(gNormal, vTexcoords).xyz;
+	
+	vec4 result = vec4(0.0f);
+	float totalWeight = 0.0f;
+	// Texel with the most similar depth, used if all the texels are rejected (e.g., on thin features)
+	vec4 closest = vec4(0.0f);
+	float closestDifference = 1e20f;
+	for (int i = 0; i < 4; ++i) {
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 texel = clamp(first + offset, ivec2(0), lowSize - 1);
+		vec4 value = texelFetch(image, texel, 0);
+		vec4 normalDepth = texelFetch(lowNormalDepth, texel, 0);
+		
+		float difference = abs(normalDepth.a - depth);
+		float bilinearWeight = (offset.x == 1 ? f.x : 1.0f - f.x) * (offset.y == 1 ? f.y : 1.0f - f.y);
+		float depthWeight = exp2(-difference / (depthSigma * depth));
+		float normalWeight = pow(max(dot(normalDepth.xyz, normal), 0.0f), 8.0f);
+		float weight = bilinearWeight * depthWeight * normalWeight;
+		result += value * weight;
+		totalWeight += weight;
+		if (difference < closestDifference) {
+			closest = value;
+			closestDifference = difference;
+		}
+	}
+	
+	FragColor = totalWeight > 1e-4f ? result / totalWeight : closest;
+}